@@ -353,6 +353,7 @@ namespace DSS
 		timer.stop();
 
 		QGuiApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+		tileRenderer.cancel();
 		dssApp->deepStack().reset();
 		dssApp->deepStack().SetProgress(&dlg);
 		ok = dssApp->deepStack().LoadStackedInfo(file);
@@ -373,9 +374,6 @@ namespace DSS
 
 			resetSliders();		// Calls showHistogram
 
-			int height = dssApp->deepStack().GetHeight();
-			rectToProcess.Init(dssApp->deepStack().GetWidth(), height, height / 3);
-
 			processingSettingsList.clear();
 			picture->clear();
 			processAndShow(true);
@@ -445,6 +443,7 @@ namespace DSS
 				// Finally load the file of interest
 				//
 				currentFile = file;				// Remember the current file
+				tileRenderer.cancel();
 				dssApp->deepStack().reset();
 				dssApp->deepStack().SetProgress(&dlg);
 				bool result = dssApp->deepStack().LoadStackedInfo(file);
@@ -468,9 +467,6 @@ namespace DSS
 
 				showHistogram(false);
 				resetSliders();
-				int height = dssApp->deepStack().GetHeight();
-				rectToProcess.Init(dssApp->deepStack().GetWidth(), height, height / 3);
-
 				processingSettingsList.clear();
 				picture->clear();
 				processAndShow(true);
@@ -1201,9 +1197,41 @@ namespace DSS
 		// selectionRect is set whenever signal SelectRect::selectRectChanged is emitted
 		// It will be the null rectangle when no selection has been made by the user
 		// 
-		rectToProcess.SetProcessRect(selectionRect);
+		tileRenderer.cancel();
+		if (!dssApp->deepStack().IsLoaded())
+			return;
+
+		// The bitmap keeps the settings for saving the image and creating star masks, the renderer has its own copy.
+		StackedBitmap& stackedBitmap = dssApp->deepStack().GetStackedBitmap();
+		stackedBitmap.SetBezierAdjust(processingSettings.bezierAdjust_);
+		stackedBitmap.SetHistogramAdjust(processingSettings.histoAdjust_);
+
+		//
+		// When the whole image is shown reduced, display it at once from the matching preview level, the tiles
+		// rendered in the background then refine it to full resolution.
+		//
+		const qreal displayScale = picture->scale() * picture->zoom();
+		if (selectionRect.isEmpty())
+		{
+			const int level = StackedBitmap::previewLevel(displayScale);
+			if (level > 0)
+			{
+				dssApp->deepStack().PreviewProcess(level, processingSettings.bezierAdjust_, processingSettings.histoAdjust_);
+				picture->setPixmap(QPixmap::fromImage(dssApp->deepStack().getImage()));
+			}
+		}
 
-		rectToProcess.Reset();
+		//
+		// Render the tiles in the part of the image shown by the picture first.
+		//
+		DSSRect visible;
+		if (displayScale > 0)
+		{
+			const QRectF rc{ picture->screenToImage(QRectF{ picture->rect() }) };
+			visible.setCoords(static_cast<int>(rc.left()), static_cast<int>(rc.top()), static_cast<int>(std::ceil(rc.right())), static_cast<int>(std::ceil(rc.bottom())));
+		}
+		tileRenderer.start(stackedBitmap, selectionRect, visible,
+			processingSettings.bezierAdjust_, processingSettings.histoAdjust_, QSettings{}.value("ShowBlackWhiteClipping", true).toBool());
 	};
 
 	bool ProcessingDlg::askToSave()
@@ -1366,19 +1394,14 @@ namespace DSS
 
 	void ProcessingDlg::onTimer()
 	{
-		DSSRect			cell;
-
-		if (rectToProcess.GetNextUnProcessedRect(cell))
+		if (dssApp->deepStack().IsLoaded() && dssApp->deepStack().CollectTiles(tileRenderer))
 		{
-			dssApp->deepStack().PartialProcess(cell, processingSettings.bezierAdjust_, processingSettings.histoAdjust_);
-
 			picture->setPixmap(QPixmap::fromImage(dssApp->deepStack().getImage()));
 
 			// showHistogram(false);
 			//resetSliders();		// Will call showHistogram()
 
-			const int nProgress = static_cast<int>(rectToProcess.GetPercentageComplete());
-			progressBar->setValue(min(max(0, nProgress), 100));
+			progressBar->setValue(std::clamp(tileRenderer.percentComplete(), 0, 100));
 		};
 	}
 
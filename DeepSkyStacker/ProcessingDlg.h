@@ -39,6 +39,7 @@
 #include "dssrect.h"
 #include "histogram.h"
 #include "ProcessingSettings.h"
+#include "TileRenderer.h"
 #include "processingcontrols.h"
 #include "ui_ProcessingDlg.h"
 
@@ -48,169 +49,6 @@ namespace DSS
 	class ProcessingControls;
 	class ProcessingSettingsDlg;
 
-	class ValuedRect final
-	{
-	public:
-		DSSRect					m_rc;
-		double					m_fScore;
-
-	public:
-		ValuedRect()
-		{
-			m_fScore = 0.0;
-		};
-
-		~ValuedRect() {};
-
-		ValuedRect(const ValuedRect& vr) = default;
-
-		ValuedRect& operator = (const ValuedRect& vr) = default;
-
-		bool operator < (const ValuedRect& rhs)
-		{
-			return m_fScore < rhs.m_fScore;
-		};
-	};
-
-	class ProcessRect final
-	{
-	private:
-		int						m_lWidth;
-		int						m_lHeight;
-		int						m_lSize;
-		std::vector<ValuedRect>	m_vRects;
-		std::vector<bool>			m_vProcessed;
-		bool						m_bToProcess;
-		DSSRect						m_rcToProcess;
-
-	private:
-		bool IsProcessRectOk()
-		{
-			bool			bResult = false;
-
-			bResult = (m_rcToProcess.left >= 0) && (m_rcToProcess.left < m_lWidth) &&
-				(m_rcToProcess.right >= 0) && (m_rcToProcess.right < m_lWidth) &&
-				(m_rcToProcess.top >= 0) && (m_rcToProcess.top < m_lHeight) &&
-				(m_rcToProcess.bottom >= 0) && (m_rcToProcess.bottom < m_lHeight) &&
-				(m_rcToProcess.left < m_rcToProcess.right) &&
-				(m_rcToProcess.top < m_rcToProcess.bottom);
-
-			return bResult;
-		};
-
-	public:
-		ProcessRect()
-		{
-			m_bToProcess = false;
-			m_rcToProcess.left = 0;
-			m_rcToProcess.top = 0;
-			m_rcToProcess.right = 0;
-			m_rcToProcess.bottom = 0;
-			m_rcToProcess.setEmpty();
-			m_lWidth = 0;
-			m_lHeight = 0;
-			m_lSize = 0;
-		};
-		virtual ~ProcessRect() {};
-
-		ProcessRect(const ValuedRect& vr) = delete;
-
-		ProcessRect& operator = (const ProcessRect& vr) = delete;
-
-
-		void	Init(int lWidth, int lHeight, int lRectSize)
-		{
-			int			i, j;
-
-			m_lWidth = lWidth;
-			m_lHeight = lHeight;
-			m_lSize = lRectSize;
-
-			m_vRects.clear();
-			m_vProcessed.clear();
-			for (i = 0; i < m_lWidth; i += lRectSize)
-			{
-				for (j = 0; j < m_lHeight; j += lRectSize)
-				{
-					ValuedRect	rcCell;
-
-					rcCell.m_rc.left = i;
-					rcCell.m_rc.right = min(i + m_lSize, m_lWidth);
-					rcCell.m_rc.top = j;
-					rcCell.m_rc.bottom = min(j + m_lSize, m_lHeight);
-
-					rcCell.m_fScore = fabs(((i + m_lSize / 2.0) - m_lWidth / 2.0) / (double)m_lWidth) + fabs(((j + m_lSize / 2) - m_lHeight / 2.0) / (double)m_lHeight);
-
-					m_vRects.push_back(rcCell);
-					m_vProcessed.push_back(false);
-				};
-			};
-			std::sort(m_vRects.begin(), m_vRects.end());
-		};
-
-		void	SetProcessRect(const DSSRect& rc)
-		{
-			m_rcToProcess = rc;
-		};
-
-		void	Reset()
-		{
-			for (int i = 0; i < m_vProcessed.size(); i++)
-				m_vProcessed[i] = false;
-			m_bToProcess = true;
-		};
-
-		bool	GetNextUnProcessedRect(DSSRect& rcCell)
-		{
-			bool		bResult = false;
-
-			if (m_bToProcess)
-			{
-				if (!m_rcToProcess.isEmpty() && IsProcessRectOk())
-				{
-					if (!m_vProcessed[0])
-					{
-						rcCell = m_rcToProcess;
-						m_vProcessed[0] = true;
-						bResult = true;
-					};
-				}
-				else
-				{
-					for (int i = 0; i < m_vProcessed.size() && !bResult; i++)
-					{
-						if (!m_vProcessed[i])
-						{
-							bResult = true;
-							rcCell = m_vRects[i].m_rc;
-							m_vProcessed[i] = true;
-						};
-					};
-				};
-
-				m_bToProcess = bResult;
-			};
-
-			return bResult;
-		};
-
-		float GetPercentageComplete() const
-		{
-			if (m_vProcessed.size() == 0)
-				return 100.0f;
-
-			float fPercentage = 0.0f;
-			const float fDelta = 100.0f / static_cast<float>(m_vProcessed.size());
-
-			// The iteration loop here could be corrupted by a call to Init() on a different thread.
-			// To make totally thread safe this should really have a mutex lock associated with it.
-			for (bool bState : m_vProcessed)
-				fPercentage += bState ? fDelta : 0.0f;
-
-			return fPercentage;
-		}
-	};
-
 	typedef std::list<ProcessingSettings>		PROCESSINGSETTINGSLIST;
 	typedef PROCESSINGSETTINGSLIST::iterator	PROCESSINGSETTINGSITERATOR;
 
@@ -358,7 +196,7 @@ namespace DSS
 		ProcessingControls* controls;
 		ProcessingSettings	processingSettings;
 		ProcessingSettingsList processingSettingsList;
-		ProcessRect		rectToProcess;
+		TileRenderer	tileRenderer;
 		bool dirty_;
 		fs::path currentFile;
 		QString iconModifier;
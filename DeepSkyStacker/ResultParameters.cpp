@@ -17,6 +17,17 @@ namespace DSS
 		customRectEnabled{ false }
 	{
 		ui->setupUi(this);
+
+		//
+		// Set the tooltip text
+		//
+		ui->drizzleBands->setToolTip(tr("The light frames are stacked in bands of 512 lines of the drizzled image.\n"
+			"Only the temporary image of each light frame and the Bayer Drizzle coverage are\n"
+			"reduced to one band: the stacked image and the temporary files of the Median,\n"
+			"Kappa-Sigma and Auto Adaptive methods keep the size of the whole drizzled image.\n\n"
+			"Not used with the Entropy Weighted Average, comet stacking or the saving of\n"
+			"intermediate files.",
+			"IDS_TOOLTIP_DRIZZLEBANDS"));
 	}
 
 	ResultParameters::~ResultParameters()
@@ -115,6 +126,8 @@ namespace DSS
 		default:
 			break;
 		}
+		ui->drizzleBands->setEnabled(drizzle > 1);
+		ui->drizzleBands->setChecked(workspace->value("Stacking/DrizzleBands", false).toBool());
 
 		bool alignRGB = workspace->value("Stacking/AlignChannels", false).toBool();
 		ui->alignRGB->setChecked(alignRGB);
@@ -182,6 +195,7 @@ namespace DSS
 		}
 		else
 			workspace->setValue("Stacking/PixelSizeMultiplier", uint(1));
+		ui->drizzleBands->setEnabled(ui->drizzle2x->isChecked());
 	}
 
 	void	ResultParameters::on_drizzle3x_clicked()
@@ -193,6 +207,12 @@ namespace DSS
 		}
 		else
 			workspace->setValue("Stacking/PixelSizeMultiplier", uint(1));
+		ui->drizzleBands->setEnabled(ui->drizzle3x->isChecked());
+	}
+
+	void	ResultParameters::on_drizzleBands_clicked()
+	{
+		workspace->setValue("Stacking/DrizzleBands", ui->drizzleBands->isChecked());
 	}
 
 	void	ResultParameters::on_alignRGB_clicked()
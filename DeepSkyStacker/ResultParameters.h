@@ -44,6 +44,7 @@ namespace DSS
 		void	on_customMode_clicked();
 		void	on_drizzle2x_clicked();
 		void	on_drizzle3x_clicked();
+		void	on_drizzleBands_clicked();
 		void	on_alignRGB_clicked();
 
 	};
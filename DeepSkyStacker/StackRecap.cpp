@@ -333,6 +333,13 @@ namespace DSS
 					.arg(dwDrizzle);
 				insertHTML(strHTML, strText, blueColour, false, false, SSTAB_RESULT);
 				strHTML += "<br>";
+				if (pStackingTasks->GetDrizzleBands())
+				{
+					strText = tr("Stacked in bands: the temporary image of each light frame holds one band, the stacked image is full size",
+						"IDS_RECAP_DRIZZLEBANDS");
+					insertHTML(strHTML, strText, blueColour, false, false, SSTAB_RESULT);
+					strHTML += "<br>";
+				};
 				if (IsRawBayer() || IsFITSRawBayer())
 				{
 					strText = tr("The selected drizzle option is not compatible with Bayer Drizzle mode.",
@@ -0,0 +1,535 @@
+// DeepSkyStackerBenchmark.cpp : Times the main kernels of DeepSkyStackerKernel on synthetic data.
+//
+// The data is generated in memory (see SyntheticData.h), no GPU, network or input files are needed.
+// The results are written as JSON, either to stdout or to the file given with --output, so that CI
+// runners can archive them and track performance regressions between builds.
+//
+#include "stdafx.h"
+#include "SyntheticData.h"
+#include "DSSVersion.h"
+#include "Multitask.h"
+#include "avx_simd_check.h"
+#include "avx.h"
+#include "avx_entropy.h"
+#include "EntropyInfo.h"
+#include "TaskInfo.h"
+#include "PixelTransform.h"
+#include "BackgroundCalibration.h"
+#include "MultiBitmap.h"
+#include "RegisterEngine.h"
+#include "MatchingStars.h"
+#include "BitmapExt.h"
+#include "DarkFrame.h"
+#include "FlatFrame.h"
+#include "MedianFilterEngine.h"
+#include "ConstantTimeMedian.h"
+#include "TIFFUtil.h"
+#include "FITSUtil.h"
+#include "dssrect.h"
+
+using namespace DSS::Benchmark;
+
+namespace
+{
+	class BenchmarkApplication : public QCoreApplication, public DSSBase
+	{
+	public:
+		BenchmarkApplication(int& argc, char** argv) : QCoreApplication(argc, argv)
+		{
+			DSSBase::setInstance(this);
+		}
+
+		virtual void reportError(const QString& message, const QString&, Severity, Method, bool terminate) override
+		{
+			std::cerr << message.toStdString() << std::endl;
+			if (terminate)
+				std::exit(EXIT_FAILURE);
+		}
+	};
+
+	struct BenchmarkSettings
+	{
+		FrameParameters frame;
+		int nrFrames{ 10 };
+		int repetitions{ 5 };
+		QRegularExpression filter;
+		fs::path tempDirectory;
+	};
+
+	class BenchmarkRunner
+	{
+	private:
+		const BenchmarkSettings& settings;
+		QJsonArray results;
+
+	public:
+		explicit BenchmarkRunner(const BenchmarkSettings& s) : settings{ s } {}
+
+		//
+		// Runs prepare() (not timed) and then func() (timed) settings.repetitions times.
+		// prepare() returns the state that func() works on, so that every repetition starts from the same input.
+		// megaPixels is the amount of data processed by one call of func() and is used to compute the throughput.
+		//
+		template <class Prepare, class Func>
+		void run(const QString& name, const QString& variant, const double megaPixels, Prepare&& prepare, Func&& func)
+		{
+			const QString fullName = variant.isEmpty() ? name : QString("%1/%2").arg(name, variant);
+			if (!settings.filter.match(fullName).hasMatch())
+				return;
+
+			std::cerr << "Running " << fullName.toStdString() << std::endl;
+
+			std::vector<double> timesMs;
+			double items = 0;
+			for (int n = 0; n < settings.repetitions; ++n)
+			{
+				auto state = prepare();
+				const auto start = std::chrono::steady_clock::now();
+				items = static_cast<double>(func(state));
+				const auto end = std::chrono::steady_clock::now();
+				timesMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			}
+
+			std::sort(timesMs.begin(), timesMs.end());
+			const double mean = std::accumulate(timesMs.cbegin(), timesMs.cend(), 0.0) / timesMs.size();
+			const double median = timesMs.size() % 2 == 1
+				? timesMs[timesMs.size() / 2]
+				: 0.5 * (timesMs[timesMs.size() / 2 - 1] + timesMs[timesMs.size() / 2]);
+
+			QJsonObject result;
+			result["name"] = name;
+			result["variant"] = variant;
+			result["repetitions"] = settings.repetitions;
+			result["min_ms"] = timesMs.front();
+			result["median_ms"] = median;
+			result["mean_ms"] = mean;
+			result["max_ms"] = timesMs.back();
+			result["megapixels"] = megaPixels;
+			result["megapixels_per_second"] = median > 0 ? megaPixels * 1000.0 / median : 0.0;
+			result["items"] = items; // Benchmark specific: stars found, bytes written, ...
+			results.append(result);
+		}
+
+		const QJsonArray& getResults() const { return results; }
+	};
+
+	// Dummy object for benchmarks without any state to prepare.
+	struct NoState {};
+	constexpr auto noPreparation = []() { return NoState{}; };
+
+	double megaPixels(const FrameParameters& frame)
+	{
+		return static_cast<double>(frame.width) * frame.height / 1.0e6;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> cloneGray(const C16BitGrayBitmap& bitmap)
+	{
+		return std::shared_ptr<C16BitGrayBitmap>{ static_cast<C16BitGrayBitmap*>(bitmap.Clone().release()) };
+	}
+
+	std::vector<std::shared_ptr<C16BitGrayBitmap>> makeLightFrames(const SyntheticStarVector& stars, const BenchmarkSettings& settings)
+	{
+		std::vector<std::shared_ptr<C16BitGrayBitmap>> frames;
+		for (int n = 0; n < settings.nrFrames; ++n)
+		{
+			FrameParameters params = settings.frame;
+			params.seed = settings.frame.seed + 1000 + n;
+			frames.push_back(makeStarField(transformStarCatalog(stars, params, 0.37 * n, -0.21 * n, 0.0002 * n), params));
+		}
+		return frames;
+	}
+
+	//
+	// Registration and star matching.
+	//
+	void benchmarkRegistration(BenchmarkRunner& runner, const BenchmarkSettings& settings, const SyntheticStarVector& stars)
+	{
+		const auto pLight = makeStarField(stars, settings.frame);
+
+		runner.run("RegisterPicture", "gray16", megaPixels(settings.frame), noPreparation, [&pLight](NoState&)
+		{
+			CLightFrameInfo lightFrame;
+			lightFrame.SetDetectionThreshold(0.10);
+			lightFrame.RegisterPicture(pLight.get(), 0);
+			return lightFrame.m_vStars.size();
+		});
+
+		const auto pCfa = makeCfaMosaic(stars, settings.frame);
+		runner.run("RegisterPicture", "cfa_rggb", megaPixels(settings.frame), noPreparation, [&pCfa](NoState&)
+		{
+			CLightFrameInfo lightFrame;
+			lightFrame.SetDetectionThreshold(0.10);
+			lightFrame.RegisterPicture(pCfa.get(), 0);
+			return lightFrame.m_vStars.size();
+		});
+
+		// Matching works on the brightest stars, like the registration engine does.
+		SyntheticStarVector brightest = stars;
+		std::sort(brightest.begin(), brightest.end(), [](const SyntheticStar& a, const SyntheticStar& b) { return a.flux > b.flux; });
+		brightest.resize(std::min<size_t>(brightest.size(), 100));
+		const SyntheticStarVector target = transformStarCatalog(brightest, settings.frame, 13.4, -7.9, 0.004);
+
+		runner.run("CMatchingStars::ComputeCoordinateTransformation", "", 0.0, noPreparation, [&](NoState&)
+		{
+			CMatchingStars matching{ settings.frame.width, settings.frame.height };
+			for (const auto& star : brightest)
+				matching.AddReferenceStar(star.x, star.y);
+			for (const auto& star : target)
+				matching.AddTargetedStar(star.x, star.y);
+			CBilinearParameters transformation;
+			return matching.ComputeCoordinateTransformation(transformation) ? target.size() : 0;
+		});
+	}
+
+	//
+	// AvxStacking::stack - the per frame transformation and calibration of the stacking engine.
+	// Runs with the same row blocking as CStackTask::process().
+	//
+	int stackFrame(std::shared_ptr<CMemoryBitmap> pInput, CMemoryBitmap& temp, CMemoryBitmap* pEntropyCoverage, const CPixelTransform& pixelTransform, const CTaskInfo& taskInfo)
+	{
+		const DSSRect rect{ 0, 0, temp.Width(), temp.Height() };
+		CEntropyInfo entropyInfo;
+		if (taskInfo.m_Method == MBP_ENTROPYAVERAGE)
+			entropyInfo.Init(pInput, 10, nullptr);
+		AvxEntropy avxEntropy{ *pInput, entropyInfo, pEntropyCoverage };
+		CBackgroundCalibration backgroundCalibration;
+		backgroundCalibration.SetMode(BCM_NONE, BCI_LINEAR, RBCM_MAXIMUM);
+
+		const int height = pInput->Height();
+		constexpr int lineBlockSize = 50;
+		AvxStacking avxStacking(0, 0, *pInput, temp, rect, avxEntropy);
+
+#pragma omp parallel for default(shared) firstprivate(avxStacking) if(CMultitask::GetNrProcessors() > 1)
+		for (int row = 0; row < height; row += lineBlockSize)
+		{
+			avxStacking.init(row, std::min(row + lineBlockSize, height));
+			avxStacking.stack(pixelTransform, taskInfo, backgroundCalibration, std::shared_ptr<CMemoryBitmap>{}, 1);
+		}
+		return height;
+	}
+
+	template <class BitmapType>
+	std::shared_ptr<BitmapType> makeEmptyBitmap(const FrameParameters& frame)
+	{
+		auto pBitmap = std::make_shared<BitmapType>();
+		if (!pBitmap->Init(frame.width, frame.height))
+			throw std::runtime_error("Benchmark: cannot allocate bitmap");
+		pBitmap->SetOrientation(true);
+		return pBitmap;
+	}
+
+	void benchmarkStacking(BenchmarkRunner& runner, const BenchmarkSettings& settings, const SyntheticStarVector& stars)
+	{
+		CBilinearParameters transformation;
+		transformation.Type = TT_BILINEAR;
+		transformation.fXWidth = settings.frame.width;
+		transformation.fYWidth = settings.frame.height;
+		transformation.a0 = 0.0021;
+		transformation.a1 = 0.9995;
+		transformation.a2 = 0.0011;
+		transformation.b0 = -0.0013;
+		transformation.b1 = -0.0012;
+		transformation.b2 = 0.9994;
+		const CPixelTransform pixelTransform{ transformation };
+		CTaskInfo taskInfo;
+		taskInfo.m_Method = MBP_AVERAGE;
+
+		const auto makeGrayTemp = [&settings]() { return makeEmptyBitmap<C16BitGrayBitmap>(settings.frame); };
+		const auto makeColorTemp = [&settings]() { return makeEmptyBitmap<C48BitColorBitmap>(settings.frame); };
+
+		const std::shared_ptr<CMemoryBitmap> pGray = makeStarField(stars, settings.frame);
+		runner.run("AvxStacking::stack", "gray16", megaPixels(settings.frame), makeGrayTemp,
+			[&](std::shared_ptr<C16BitGrayBitmap>& pTemp) { return stackFrame(pGray, *pTemp, nullptr, pixelTransform, taskInfo); });
+
+		const std::shared_ptr<CMemoryBitmap> pCfa = makeCfaMosaic(stars, settings.frame);
+		runner.run("AvxStacking::stack", "cfa_rggb", megaPixels(settings.frame), makeColorTemp,
+			[&](std::shared_ptr<C48BitColorBitmap>& pTemp) { return stackFrame(pCfa, *pTemp, nullptr, pixelTransform, taskInfo); });
+
+		const std::shared_ptr<CMemoryBitmap> pColor = makeColorStarField(stars, settings.frame);
+		runner.run("AvxStacking::stack", "rgb16", megaPixels(settings.frame), makeColorTemp,
+			[&](std::shared_ptr<C48BitColorBitmap>& pTemp) { return stackFrame(pColor, *pTemp, nullptr, pixelTransform, taskInfo); });
+
+		// Entropy weighted average, including the computation of the entropy squares (CEntropyInfo::Init).
+		CTaskInfo entropyTask;
+		entropyTask.m_Method = MBP_ENTROPYAVERAGE;
+		runner.run("AvxStacking::stack", "gray16_entropy", megaPixels(settings.frame),
+			[&settings]() { return std::make_pair(makeEmptyBitmap<C16BitGrayBitmap>(settings.frame), makeEmptyBitmap<C32BitFloatGrayBitmap>(settings.frame)); },
+			[&](auto& bitmaps) { return stackFrame(pGray, *bitmaps.first, bitmaps.second.get(), pixelTransform, entropyTask); });
+	}
+
+	//
+	// CMultiBitmap::GetResult for each combination method. AddBitmap is timed separately (it writes the temporary part files).
+	//
+	void benchmarkCombination(BenchmarkRunner& runner, const BenchmarkSettings& settings, const SyntheticStarVector& stars)
+	{
+		const auto frames = makeLightFrames(stars, settings);
+		const double totalMegaPixels = megaPixels(settings.frame) * settings.nrFrames;
+
+		const auto makeMultiBitmap = [&frames, &settings](const MULTIBITMAPPROCESSMETHOD method)
+		{
+			std::shared_ptr<CMultiBitmap> pMulti = frames.front()->CreateEmptyMultiBitmap();
+			pMulti->SetNrBitmaps(settings.nrFrames);
+			pMulti->SetProcessingMethod(method, 2.0, 5);
+			return pMulti;
+		};
+
+		runner.run("CMultiBitmap::AddBitmap", "gray16", totalMegaPixels, [&]() { return makeMultiBitmap(MBP_MEDIAN); },
+			[&frames](std::shared_ptr<CMultiBitmap>& pMulti)
+			{
+				for (const auto& pFrame : frames)
+					pMulti->AddBitmap(pFrame.get());
+				return frames.size();
+			});
+
+		constexpr std::pair<MULTIBITMAPPROCESSMETHOD, const char*> Methods[] = {
+			{ MBP_AVERAGE, "average" },
+			{ MBP_MEDIAN, "median" },
+			{ MBP_MAXIMUM, "maximum" },
+			{ MBP_SIGMACLIP, "kappa_sigma" },
+			{ MBP_MEDIANSIGMACLIP, "median_kappa_sigma" },
+			{ MBP_AUTOADAPTIVE, "auto_adaptive" }
+		};
+
+		for (const auto& entry : Methods)
+		{
+			const MULTIBITMAPPROCESSMETHOD method = entry.first;
+			runner.run("CMultiBitmap::GetResult", entry.second, totalMegaPixels,
+				[&, method]()
+				{
+					auto pMulti = makeMultiBitmap(method);
+					for (const auto& pFrame : frames)
+						pMulti->AddBitmap(pFrame.get());
+					return pMulti;
+				},
+				[](std::shared_ptr<CMultiBitmap>& pMulti) { return static_cast<bool>(pMulti->GetResult()) ? 1 : 0; });
+		}
+	}
+
+	//
+	// Calibration: offset and dark subtraction, flat application.
+	//
+	void benchmarkCalibration(BenchmarkRunner& runner, const BenchmarkSettings& settings, const SyntheticStarVector& stars)
+	{
+		const auto pLight = makeStarField(stars, settings.frame);
+		const auto pCfa = makeCfaMosaic(stars, settings.frame);
+
+		const std::shared_ptr<const CMemoryBitmap> pOffset = makeBias(settings.frame, 200.0);
+		runner.run("Subtract", "offset_gray16", megaPixels(settings.frame), [&pLight]() { return cloneGray(*pLight); },
+			[&pOffset](std::shared_ptr<C16BitGrayBitmap>& pTarget) { return Subtract(pTarget, pOffset) ? 1 : 0; });
+
+		CDarkFrame darkFrame{ makeDark(settings.frame, 300.0, 1.0e-4) };
+		runner.run("CDarkFrame::Subtract", "gray16", megaPixels(settings.frame), [&pLight]() { return cloneGray(*pLight); },
+			[&darkFrame](std::shared_ptr<C16BitGrayBitmap>& pTarget) { return darkFrame.Subtract(pTarget) ? 1 : 0; });
+
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = makeFlat(settings.frame, 30000.0, 0.3);
+		flatFrame.ComputeFlatNormalization();
+		runner.run("CFlatFrame::ApplyFlat", "gray16", megaPixels(settings.frame), [&pLight]() { return cloneGray(*pLight); },
+			[&flatFrame](std::shared_ptr<C16BitGrayBitmap>& pTarget) { return flatFrame.ApplyFlat(pTarget) ? 1 : 0; });
+
+		CFlatFrame cfaFlatFrame;
+		{
+			auto pFlat = makeFlat(settings.frame, 30000.0, 0.3);
+			pFlat->SetCFAType(CFATYPE_RGGB);
+			pFlat->UseBilinear(true);
+			cfaFlatFrame.m_pFlatFrame = pFlat;
+		}
+		cfaFlatFrame.ComputeFlatNormalization();
+		runner.run("CFlatFrame::ApplyFlat", "cfa_rggb", megaPixels(settings.frame), [&pCfa]() { return cloneGray(*pCfa); },
+			[&cfaFlatFrame](std::shared_ptr<C16BitGrayBitmap>& pTarget) { return cfaFlatFrame.ApplyFlat(pTarget) ? 1 : 0; });
+	}
+
+	//
+	// Median filter of 16 bit frames: the engine and the constant time filter alone, for the radii around the filter size
+	// from which on the engine uses the constant time filter (CInternalMedianFilterEngineT::CFilterTask::process).
+	//
+	void benchmarkMedianFilter(BenchmarkRunner& runner, const BenchmarkSettings& settings, const SyntheticStarVector& stars)
+	{
+		const std::shared_ptr<const C16BitGrayBitmap> bitmaps[] = { makeStarField(stars, settings.frame), makeCfaMosaic(stars, settings.frame) };
+
+		for (const auto& pBitmap : bitmaps)
+		{
+			const CFATYPE cfaType = pBitmap->GetCFAType();
+			for (int filterSize = 1; filterSize <= (cfaType == CFATYPE_NONE ? 7 : 4); ++filterSize)
+			{
+				// The engine doubles the filter size of CFA images.
+				const int radius = cfaType == CFATYPE_NONE ? filterSize : 2 * filterSize;
+				const QString variant = QString("%1_r%2").arg(cfaType == CFATYPE_NONE ? "gray16" : "cfa_rggb").arg(radius);
+
+				runner.run("CMedianFilterEngine", variant, megaPixels(settings.frame), noPreparation, [&pBitmap, filterSize](NoState&)
+				{
+					CGrayMedianFilterEngineT<std::uint16_t> engine;
+					engine.SetInputBitmap(pBitmap.get());
+					return static_cast<bool>(engine.GetFilteredImage(filterSize, nullptr)) ? 1 : 0;
+				});
+
+				// Same stripes as the engine.
+				runner.run("ConstantTimeMedianFilter", variant, megaPixels(settings.frame), noPreparation, [&pBitmap, radius, cfaType](NoState&)
+				{
+					const int width = pBitmap->RealWidth();
+					const int height = pBitmap->RealHeight();
+					const int nrStripes = (width + 63) / 64;
+					std::vector<std::uint16_t> output(pBitmap->m_vPixels.size());
+					std::uint16_t* const pOut = output.data();
+					DSS::ConstantTimeMedianFilter filter{ pBitmap->m_vPixels.data(), nullptr, width, height, radius, cfaType };
+
+#pragma omp parallel for default(shared) firstprivate(filter) schedule(dynamic, 1) if(CMultitask::GetNrProcessors() > 1)
+					for (int stripe = 0; stripe < nrStripes; ++stripe)
+						filter.process(stripe * 64, std::min(stripe * 64 + 64, width), [pOut, width](const int col, const int row, const std::uint16_t lower, const std::uint16_t upper, const int)
+						{
+							pOut[static_cast<size_t>(row) * width + col] = static_cast<std::uint16_t>((lower + upper) / 2);
+						});
+					return output.size();
+				});
+			}
+		}
+	}
+
+	//
+	// File I/O: TIFF and FITS, written to and read from the temporary directory.
+	//
+	void benchmarkFileIO(BenchmarkRunner& runner, const BenchmarkSettings& settings, const SyntheticStarVector& stars)
+	{
+		const auto pLight = makeStarField(stars, settings.frame);
+		const auto pColor = makeColorStarField(stars, settings.frame);
+		const fs::path tiffGray = settings.tempDirectory / "benchmark_gray.tif";
+		const fs::path tiffColor = settings.tempDirectory / "benchmark_color.tif";
+		const fs::path fitsGray = settings.tempDirectory / "benchmark_gray.fits";
+
+		const auto fileSize = [](const fs::path& file) { std::error_code ec; return fs::file_size(file, ec); };
+
+		runner.run("WriteTIFF", "gray16", megaPixels(settings.frame), noPreparation, [&](NoState&)
+		{
+			WriteTIFF(tiffGray, pLight.get(), nullptr, TF_16BITGRAY, TC_NONE);
+			return fileSize(tiffGray);
+		});
+		runner.run("ReadTIFF", "gray16", megaPixels(settings.frame), noPreparation, [&](NoState&)
+		{
+			std::shared_ptr<CMemoryBitmap> pBitmap;
+			return ReadTIFF(tiffGray, pBitmap, nullptr) ? 1 : 0;
+		});
+		runner.run("WriteTIFF", "rgb16", megaPixels(settings.frame), noPreparation, [&](NoState&)
+		{
+			WriteTIFF(tiffColor, pColor.get(), nullptr, TF_16BITRGB, TC_NONE);
+			return fileSize(tiffColor);
+		});
+		runner.run("ReadTIFF", "rgb16", megaPixels(settings.frame), noPreparation, [&](NoState&)
+		{
+			std::shared_ptr<CMemoryBitmap> pBitmap;
+			return ReadTIFF(tiffColor, pBitmap, nullptr) ? 1 : 0;
+		});
+		runner.run("WriteFITS", "gray16", megaPixels(settings.frame), noPreparation, [&](NoState&)
+		{
+			fs::remove(fitsGray); // CFITSIO refuses to overwrite existing files.
+			WriteFITS(fitsGray, pLight.get(), nullptr, FF_16BITGRAY);
+			return fileSize(fitsGray);
+		});
+		runner.run("ReadFITS", "gray16", megaPixels(settings.frame), noPreparation, [&](NoState&)
+		{
+			std::shared_ptr<CMemoryBitmap> pBitmap;
+			return ReadFITS(fitsGray, pBitmap, false, nullptr) ? 1 : 0;
+		});
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// Use a dedicated settings domain, so that the user's DeepSkyStacker settings do not influence the results.
+	QCoreApplication::setOrganizationName("DeepSkyStacker");
+	QCoreApplication::setApplicationName("DeepSkyStackerBenchmark");
+	BenchmarkApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Times the DeepSkyStacker kernels on synthetic data and writes the results as JSON.");
+	parser.addHelpOption();
+	const QCommandLineOption widthOption{ "width", "Frame width in pixels.", "pixels", "2048" };
+	const QCommandLineOption heightOption{ "height", "Frame height in pixels.", "pixels", "1536" };
+	const QCommandLineOption framesOption{ "frames", "Number of frames to combine.", "count", "10" };
+	const QCommandLineOption starsOption{ "stars", "Number of stars per frame.", "count", "400" };
+	const QCommandLineOption repetitionsOption{ "repetitions", "Number of timed runs per benchmark.", "count", "5" };
+	const QCommandLineOption seedOption{ "seed", "Seed of the synthetic data.", "seed", "1" };
+	const QCommandLineOption filterOption{ "filter", "Only run benchmarks whose name matches this regular expression.", "regex", "." };
+	const QCommandLineOption outputOption{ "output", "Write the JSON result to this file instead of stdout.", "file" };
+	const QCommandLineOption noSimdOption{ "no-simd", "Disable the SIMD (AVX) code paths." };
+	const QCommandLineOption simdLevelOption{ "simd-level", "Highest SIMD level to use: generic, avx2 or avx512.", "level", "avx512" };
+	parser.addOptions({ widthOption, heightOption, framesOption, starsOption, repetitionsOption, seedOption, filterOption, outputOption, noSimdOption, simdLevelOption });
+	parser.process(app);
+
+	BenchmarkSettings settings;
+	settings.frame.width = std::max(64, parser.value(widthOption).toInt());
+	settings.frame.height = std::max(64, parser.value(heightOption).toInt());
+	settings.frame.nrStars = std::max(10, parser.value(starsOption).toInt());
+	settings.frame.seed = parser.value(seedOption).toUInt();
+	settings.nrFrames = std::max(3, parser.value(framesOption).toInt());
+	settings.repetitions = std::max(1, parser.value(repetitionsOption).toInt());
+	settings.filter = QRegularExpression{ parser.value(filterOption) };
+	if (!settings.filter.isValid())
+	{
+		std::cerr << "Invalid filter expression: " << settings.filter.errorString().toStdString() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const QString simdLevel = parser.value(simdLevelOption).toLower();
+	if (simdLevel == "generic")
+		AvxSimdCheck::limitSimdLevel(AvxSimdCheck::SimdLevel::Generic);
+	else if (simdLevel == "avx2")
+		AvxSimdCheck::limitSimdLevel(AvxSimdCheck::SimdLevel::Avx2);
+	else if (simdLevel != "avx512")
+	{
+		std::cerr << "Invalid SIMD level: " << simdLevel.toStdString() << std::endl;
+		return EXIT_FAILURE;
+	}
+	CMultitask::SetUseSimd(!parser.isSet(noSimdOption));
+	DSSTIFFInitialize();
+
+	QTemporaryDir tempDir;
+	if (!tempDir.isValid())
+	{
+		std::cerr << "Cannot create temporary directory" << std::endl;
+		return EXIT_FAILURE;
+	}
+	settings.tempDirectory = tempDir.path().toStdU16String();
+
+	const SyntheticStarVector stars = makeStarCatalog(settings.frame);
+	BenchmarkRunner runner{ settings };
+
+	benchmarkRegistration(runner, settings, stars);
+	benchmarkStacking(runner, settings, stars);
+	benchmarkCombination(runner, settings, stars);
+	benchmarkCalibration(runner, settings, stars);
+	benchmarkMedianFilter(runner, settings, stars);
+	benchmarkFileIO(runner, settings, stars);
+
+	QJsonObject parameters;
+	parameters["width"] = settings.frame.width;
+	parameters["height"] = settings.frame.height;
+	parameters["frames"] = settings.nrFrames;
+	parameters["stars"] = settings.frame.nrStars;
+	parameters["repetitions"] = settings.repetitions;
+	parameters["seed"] = static_cast<qint64>(settings.frame.seed);
+
+	QJsonObject root;
+	root["version"] = VERSION_DEEPSKYSTACKER;
+	root["platform"] = QSysInfo::prettyProductName();
+	root["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+	root["processors"] = CMultitask::GetNrProcessors();
+	root["simd"] = AvxSimdCheck::checkSimdAvailability();
+	root["simd_level"] = AvxSimdCheck::simdLevelName(AvxSimdCheck::simdLevel());
+	root["parameters"] = parameters;
+	root["results"] = runner.getResults();
+
+	const QByteArray json = QJsonDocument{ root }.toJson(QJsonDocument::Indented);
+	if (parser.isSet(outputOption))
+	{
+		QFile file{ parser.value(outputOption) };
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+		{
+			std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	else
+		std::cout << json.constData();
+
+	return EXIT_SUCCESS;
+}
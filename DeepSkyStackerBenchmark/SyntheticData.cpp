@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "SyntheticData.h"
+
+namespace
+{
+	//
+	// std::normal_distribution and std::uniform_real_distribution are implementation defined,
+	// so the results would differ between libstdc++ and MSVC. The raw output of std::mt19937
+	// is fully specified by the standard, we therefore derive our distributions from it.
+	//
+	class DeterministicRandom
+	{
+	private:
+		std::mt19937 engine;
+		bool hasSpare{ false };
+		double spare{ 0.0 };
+	public:
+		explicit DeterministicRandom(const std::uint32_t seed) : engine{ seed } {}
+
+		// Uniform in [0, 1).
+		double uniform()
+		{
+			return static_cast<double>(engine()) / 4294967296.0;
+		}
+
+		double uniform(const double lo, const double hi)
+		{
+			return lo + (hi - lo) * uniform();
+		}
+
+		// Box-Muller transformation.
+		double gaussian(const double mean, const double sigma)
+		{
+			if (hasSpare)
+			{
+				hasSpare = false;
+				return mean + sigma * spare;
+			}
+			const double u1 = std::max(uniform(), 1e-300);
+			const double u2 = uniform();
+			const double radius = std::sqrt(-2.0 * std::log(u1));
+			constexpr double TwoPi = 6.283185307179586;
+			spare = radius * std::sin(TwoPi * u2);
+			hasSpare = true;
+			return mean + sigma * radius * std::cos(TwoPi * u2);
+		}
+	};
+
+	std::uint16_t clampToWord(const double value)
+	{
+		return static_cast<std::uint16_t>(std::clamp(value + 0.5, 0.0, 65535.0));
+	}
+
+	// Accumulates the gaussian PSFs of all stars into a buffer of doubles (size width * height).
+	std::vector<double> renderStars(const DSS::Benchmark::SyntheticStarVector& stars, const int width, const int height)
+	{
+		std::vector<double> buffer(static_cast<size_t>(width) * height, 0.0);
+
+		for (const auto& star : stars)
+		{
+			const int radius = static_cast<int>(std::ceil(4.0 * star.sigma));
+			const int x0 = std::max(0, static_cast<int>(star.x) - radius);
+			const int x1 = std::min(width - 1, static_cast<int>(star.x) + radius);
+			const int y0 = std::max(0, static_cast<int>(star.y) - radius);
+			const int y1 = std::min(height - 1, static_cast<int>(star.y) + radius);
+			const double factor = -0.5 / (star.sigma * star.sigma);
+
+			for (int y = y0; y <= y1; ++y)
+			{
+				const double dy = y - star.y;
+				double* pLine = buffer.data() + static_cast<size_t>(y) * width;
+				for (int x = x0; x <= x1; ++x)
+				{
+					const double dx = x - star.x;
+					pLine[x] += star.flux * std::exp((dx * dx + dy * dy) * factor);
+				}
+			}
+		}
+		return buffer;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> makeGrayBitmap(const int width, const int height)
+	{
+		auto pBitmap = std::make_shared<C16BitGrayBitmap>();
+		if (!pBitmap->Init(width, height))
+			throw std::runtime_error("Synthetic data: cannot allocate bitmap");
+		return pBitmap;
+	}
+}
+
+namespace DSS::Benchmark
+{
+	SyntheticStarVector makeStarCatalog(const FrameParameters& params)
+	{
+		DeterministicRandom random{ params.seed };
+		SyntheticStarVector stars;
+		stars.reserve(params.nrStars);
+
+		for (int n = 0; n < params.nrStars; ++n)
+		{
+			// Power law for the brightness: many faint stars, few bright ones.
+			const double u = random.uniform();
+			const double flux = std::min(60000.0, 1500.0 / std::max(0.025, u * u));
+			stars.push_back(SyntheticStar{
+				random.uniform(8.0, params.width - 8.0),
+				random.uniform(8.0, params.height - 8.0),
+				flux,
+				random.uniform(1.0, 2.2)
+			});
+		}
+		return stars;
+	}
+
+	SyntheticStarVector transformStarCatalog(const SyntheticStarVector& stars, const FrameParameters& params, const double dx, const double dy, const double angle)
+	{
+		const double xc = params.width / 2.0;
+		const double yc = params.height / 2.0;
+		const double cosA = std::cos(angle);
+		const double sinA = std::sin(angle);
+
+		SyntheticStarVector result;
+		result.reserve(stars.size());
+		for (const auto& star : stars)
+		{
+			const double x = star.x - xc;
+			const double y = star.y - yc;
+			SyntheticStar s = star;
+			s.x = xc + cosA * x - sinA * y + dx;
+			s.y = yc + sinA * x + cosA * y + dy;
+			if (s.x >= 0 && s.x < params.width && s.y >= 0 && s.y < params.height)
+				result.push_back(s);
+		}
+		return result;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> makeStarField(const SyntheticStarVector& stars, const FrameParameters& params)
+	{
+		auto pBitmap = makeGrayBitmap(params.width, params.height);
+		const std::vector<double> signal = renderStars(stars, params.width, params.height);
+		DeterministicRandom random{ params.seed ^ 0x5f3759dfu };
+
+		std::transform(signal.cbegin(), signal.cend(), pBitmap->m_vPixels.begin(), [&random, &params](const double value)
+		{
+			return clampToWord(random.gaussian(params.background + value, params.readNoise));
+		});
+		return pBitmap;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> makeBias(const FrameParameters& params, const double level)
+	{
+		auto pBitmap = makeGrayBitmap(params.width, params.height);
+		DeterministicRandom random{ params.seed ^ 0x00b1a5u };
+
+		for (auto& pixel : pBitmap->m_vPixels)
+			pixel = clampToWord(random.gaussian(level, params.readNoise));
+		return pBitmap;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> makeDark(const FrameParameters& params, const double level, const double hotPixelFraction)
+	{
+		auto pBitmap = makeGrayBitmap(params.width, params.height);
+		DeterministicRandom random{ params.seed ^ 0x00da4cu };
+
+		for (auto& pixel : pBitmap->m_vPixels)
+		{
+			const bool hot = random.uniform() < hotPixelFraction;
+			pixel = clampToWord(hot ? random.uniform(20000.0, 65535.0) : random.gaussian(level, params.readNoise));
+		}
+		return pBitmap;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> makeFlat(const FrameParameters& params, const double peak, const double vignetting)
+	{
+		auto pBitmap = makeGrayBitmap(params.width, params.height);
+		DeterministicRandom random{ params.seed ^ 0x0f1a7u };
+		const double xc = params.width / 2.0;
+		const double yc = params.height / 2.0;
+		const double maxRadius2 = xc * xc + yc * yc;
+
+		for (int y = 0; y < params.height; ++y)
+		{
+			for (int x = 0; x < params.width; ++x)
+			{
+				const double r2 = ((x - xc) * (x - xc) + (y - yc) * (y - yc)) / maxRadius2;
+				const double value = peak * (1.0 - vignetting * r2);
+				pBitmap->m_vPixels[static_cast<size_t>(y) * params.width + x] = clampToWord(random.gaussian(value, std::sqrt(value)));
+			}
+		}
+		return pBitmap;
+	}
+
+	std::shared_ptr<C16BitGrayBitmap> makeCfaMosaic(const SyntheticStarVector& stars, const FrameParameters& params)
+	{
+		auto pBitmap = makeGrayBitmap(params.width, params.height);
+		pBitmap->SetCFAType(CFATYPE_RGGB);
+		pBitmap->UseBilinear(true);
+
+		const std::vector<double> signal = renderStars(stars, params.width, params.height);
+		DeterministicRandom random{ params.seed ^ 0x0cfa0u };
+		// Gains for R, G, B of an RGGB pattern.
+		constexpr double Gains[2][2] = { { 0.8, 1.0 }, { 1.0, 0.6 } };
+
+		for (int y = 0; y < params.height; ++y)
+		{
+			for (int x = 0; x < params.width; ++x)
+			{
+				const size_t ndx = static_cast<size_t>(y) * params.width + x;
+				const double gain = Gains[y & 1][x & 1];
+				pBitmap->m_vPixels[ndx] = clampToWord(random.gaussian(gain * (params.background + signal[ndx]), params.readNoise));
+			}
+		}
+		return pBitmap;
+	}
+
+	std::shared_ptr<C48BitColorBitmap> makeColorStarField(const SyntheticStarVector& stars, const FrameParameters& params)
+	{
+		auto pBitmap = std::make_shared<C48BitColorBitmap>();
+		if (!pBitmap->Init(params.width, params.height))
+			throw std::runtime_error("Synthetic data: cannot allocate bitmap");
+		pBitmap->SetOrientation(true);
+
+		const std::vector<double> signal = renderStars(stars, params.width, params.height);
+		DeterministicRandom random{ params.seed ^ 0x0c010u };
+
+		for (size_t ndx = 0; ndx < signal.size(); ++ndx)
+		{
+			pBitmap->m_Red.m_vPixels[ndx] = clampToWord(random.gaussian(1.10 * params.background + signal[ndx], params.readNoise));
+			pBitmap->m_Green.m_vPixels[ndx] = clampToWord(random.gaussian(params.background + signal[ndx], params.readNoise));
+			pBitmap->m_Blue.m_vPixels[ndx] = clampToWord(random.gaussian(0.85 * params.background + signal[ndx], params.readNoise));
+		}
+		return pBitmap;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+
+//
+// Generators for reproducible synthetic frames. All generators are seeded, so the same
+// parameters always produce the same bitmaps, independent of the standard library in use.
+//
+namespace DSS::Benchmark
+{
+	struct SyntheticStar
+	{
+		double x;
+		double y;
+		double flux;	// Peak value above the background, range [0, 65535].
+		double sigma;	// Gaussian sigma of the PSF in pixels.
+	};
+	using SyntheticStarVector = std::vector<SyntheticStar>;
+
+	struct FrameParameters
+	{
+		int width{ 2048 };
+		int height{ 1536 };
+		int nrStars{ 400 };
+		double background{ 1200.0 };
+		double readNoise{ 12.0 };
+		std::uint32_t seed{ 1 };
+	};
+
+	// Random star catalog covering the frame defined by params.
+	SyntheticStarVector makeStarCatalog(const FrameParameters& params);
+
+	// Shift and rotate a star catalog around the frame centre (used to generate the light frames of a sequence).
+	SyntheticStarVector transformStarCatalog(const SyntheticStarVector& stars, const FrameParameters& params, const double dx, const double dy, const double angle);
+
+	// Render the stars with gaussian PSFs on top of background and read noise.
+	std::shared_ptr<C16BitGrayBitmap> makeStarField(const SyntheticStarVector& stars, const FrameParameters& params);
+
+	// Bias: constant level plus read noise.
+	std::shared_ptr<C16BitGrayBitmap> makeBias(const FrameParameters& params, const double level);
+
+	// Dark: bias level, thermal signal and a sprinkle of hot pixels (hotPixelFraction of all pixels).
+	std::shared_ptr<C16BitGrayBitmap> makeDark(const FrameParameters& params, const double level, const double hotPixelFraction);
+
+	// Flat: radial vignetting profile with a maximum of peak in the frame centre.
+	std::shared_ptr<C16BitGrayBitmap> makeFlat(const FrameParameters& params, const double peak, const double vignetting);
+
+	// RGGB Bayer mosaic of a star field. Colour is simulated by per-channel gains.
+	// The bitmap is flagged as CFA with bilinear interpolation, exactly like a RAW file loaded with default settings.
+	std::shared_ptr<C16BitGrayBitmap> makeCfaMosaic(const SyntheticStarVector& stars, const FrameParameters& params);
+
+	// 16 bit RGB star field (stars are white, background has a slight colour cast).
+	std::shared_ptr<C48BitColorBitmap> makeColorStarField(const SyntheticStarVector& stars, const FrameParameters& params);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Qt
+#include <QtCore>
+#include <QImage>
+#include <QPoint>
+#include <QPointF>
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+// Dependency Libraries
+#include <exiv2/exiv2.hpp>
+
+// Standard Libraries
+#include <shared_mutex>
+#include <omp.h>
+#include <vector>
+#include <tuple>
+#include <deque>
+#include <set>
+#include <type_traits>
+#include <stdexcept>
+#include <iostream>
+#include <mutex>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <inttypes.h>
+#include <filesystem>
+#include <boost/interprocess/sync/named_mutex.hpp>
+#include <ranges>
+
+#include "dssbase.h"
+
+namespace bip = boost::interprocess;
+namespace fs = std::filesystem;
+
+using std::min;
+using std::max;
+
+#include <zexcept.h>
+#include <Ztrace.h>
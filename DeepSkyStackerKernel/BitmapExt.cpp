@@ -199,6 +199,8 @@ bool LoadPicture(const fs::path& file, CAllDepthBitmap& AllDepthBitmap, Progress
 		if (FetchPicture(file, AllDepthBitmap.m_pBitmap, false, pProgress, AllDepthBitmap.m_Image))
 		{
 			std::shared_ptr<CMemoryBitmap> pBitmap = AllDepthBitmap.m_pBitmap;
+			if (AllDepthBitmap.m_bKeepLoadedBitmap)
+				AllDepthBitmap.m_pLoadedBitmap = pBitmap;
 			C16BitGrayBitmap* pGrayBitmap = dynamic_cast<C16BitGrayBitmap*>(pBitmap.get());
 			CCFABitmapInfo* pCFABitmapInfo = dynamic_cast<CCFABitmapInfo*>(AllDepthBitmap.m_pBitmap.get());
 
@@ -1444,6 +1446,7 @@ void CYMGToRGB2(double fCyan, double fYellow, double fMagenta, double, double& f
 void CAllDepthBitmap::Clear()
 {
 	m_pBitmap.reset();
+	m_pLoadedBitmap.reset();
 	m_Image.reset();
 }
 
@@ -76,16 +76,19 @@ class CAllDepthBitmap
 {
 public:
 	bool m_bDontUseAHD;
+	bool m_bKeepLoadedBitmap;
 	std::shared_ptr<CMemoryBitmap> m_pBitmap;
+	std::shared_ptr<CMemoryBitmap> m_pLoadedBitmap; // As loaded, before the CFA conversion (only with m_bKeepLoadedBitmap).
 	std::shared_ptr<QImage> m_Image;
 
-    CAllDepthBitmap() : m_bDontUseAHD(false) {};
+    CAllDepthBitmap() : m_bDontUseAHD(false), m_bKeepLoadedBitmap(false) {};
 	~CAllDepthBitmap() {};
 	CAllDepthBitmap(const CAllDepthBitmap& adb) = default;
 	CAllDepthBitmap& operator=(const CAllDepthBitmap& adb) = default;
 
 	void Clear();
 	void SetDontUseAHD(bool bSet){m_bDontUseAHD = bSet;}
+	void SetKeepLoadedBitmap(bool bSet){m_bKeepLoadedBitmap = bSet;}
 	bool initQImage();
 };
 
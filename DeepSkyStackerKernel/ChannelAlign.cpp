@@ -7,6 +7,7 @@
 #include "Ztrace.h"
 #include "ColorBitmap.h"
 #include "Multitask.h"
+#include "avx_warp.h"
 
 /* ------------------------------------------------------------------- */
 
@@ -42,14 +43,23 @@ std::shared_ptr<CMemoryBitmap> CChannelAlign::AlignChannel(const CMemoryBitmap*
 	std::shared_ptr<CMemoryBitmap> pOutBitmap{ pBitmap->Clone(true) };
 	pOutBitmap->Init(lWidth, lHeight);
 
-	PIXELDISPATCHVECTOR vPixels(16, PIXELDISPATCHVECTOR::value_type{});
-
 	if (pProgress != nullptr)
 	{
 		const QString text(QCoreApplication::translate("ChannelAlign", "Aligning Channel", "IDS_ALIGNINGCHANNEL"));
 		pProgress->Start2(text, lHeight);
 	}
 
+	// 16 bit and float channels: warp of the pixel buffers.
+	AvxWarp avxWarp{ PixTransform };
+	if (avxWarp.warp(*pBitmap, *pOutBitmap, pProgress) == 0)
+	{
+		if (pProgress != nullptr)
+			pProgress->End2();
+		return pOutBitmap;
+	}
+
+	PIXELDISPATCHVECTOR vPixels(16, PIXELDISPATCHVECTOR::value_type{});
+
 #pragma omp parallel for default(none) firstprivate(vPixels) if(CMultitask::GetNrProcessors(false) > 1)
 	for (int j = 0; j < lHeight; j++)
 	{
@@ -5,6 +5,7 @@
 #include "BitmapBase.h"
 #include "ZExcBase.h"
 #include "DSSTools.h"
+#include "MultiBitmapBatch.h"
 
 template <typename TType, typename TTypeOutput = TType>
 std::shared_ptr<CMemoryBitmap> CColorMultiBitmapT<TType, TTypeOutput>::CreateNewMemoryBitmap() const
@@ -62,6 +63,24 @@ bool CColorMultiBitmapT<TType, TTypeOutput>::SetScanLines(CMemoryBitmap* pBitmap
 	pGreenCurrentValue = pRedCurrentValue + lWidth;
 	pBlueCurrentValue = pGreenCurrentValue + lWidth;
 
+	// Without homogenization, blocks of pixels are processed at once (no per-pixel vectors).
+	// The channels are independent, the values of 32 bit integer bitmaps are shifted to 16 bit.
+	if (MultiBitmapBatch<TType>::isSupported(m_Method, m_bHomogenization))
+	{
+		MultiBitmapBatch<TType> batch{ vScanLines.size() };
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			const size_t channelOffset = static_cast<size_t>(channel) * lWidth;
+			for (int i = 0; i < lWidth; i += batch.BatchSize)
+			{
+				batch.load(vScanLines, channelOffset + i, lWidth - i, !m_vImageOrder.empty(), true);
+				batch.combine(m_Method, m_fKappa, m_lNrIterations, outputScanBuffer.data() + channelOffset + i);
+			}
+		}
+		pBitmap->SetScanLine(lLine, outputScanBuffer.data());
+		return true;
+	}
+
 	vRedValues.reserve(vScanLines.size());
 	vGreenValues.reserve(vScanLines.size());
 	vBlueValues.reserve(vScanLines.size());
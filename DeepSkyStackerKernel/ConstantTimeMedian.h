@@ -0,0 +1,264 @@
+#pragma once
+#include "cfa.h"
+#include "Bayer.h"
+
+namespace DSS
+{
+	//
+	// Median filter for 16 bit data with a run time per pixel that does not depend on the filter size.
+	// S. Perreault, P. Hebert: "Median Filtering in Constant Time", IEEE Transactions on Image Processing 16(9), 2007.
+	//
+	// Each image column has a histogram of its pixels within the filter rows, the kernel histogram is the sum of the
+	// column histograms within the filter columns. Moving one pixel to the right adds one column histogram to the kernel
+	// and removes one, moving one row down adds and removes one pixel per column histogram.
+	// The histograms have two levels: 256 coarse bins (high byte) and 256 fine bins per coarse bin (low byte).
+	// At each step only the coarse level of the kernel is updated, a fine segment is brought up to date when the
+	// median is located in it.
+	//
+	// The filter window [x - radius, x + radius] * [y - radius, y + radius] is clipped at the image borders, like in
+	// CInternalMedianFilterEngineT. CFA images: only the pixels with the Bayer colour of the centre pixel are used
+	// (2x2 Bayer patterns only). With a mask, only the pixels with a non-zero mask value are used.
+	//
+	// The image is processed in vertical stripes [colStart, colEnd), each from top to bottom.
+	// One object can process several stripes one after the other, but not concurrently.
+	//
+	class ConstantTimeMedianFilter
+	{
+	public:
+		static constexpr int MaxRadius = 127; // The column histograms count in 8 bits.
+
+	private:
+		static constexpr int NrFineBins = 65536;
+		static constexpr int NrCoarseBins = 256;
+		static constexpr int InvalidColumn = std::numeric_limits<int>::min();
+
+		struct Kernel
+		{
+			std::vector<std::uint16_t> coarse;
+			std::vector<std::uint16_t> fine;
+			std::vector<int> fineColumn; // Centre column for which the fine segment is up to date.
+			int count{ 0 };
+			std::uint8_t parityMask[2]{ 1, 1 }; // For even/odd columns: bit p set -> use the rows with parity p.
+		};
+
+		const std::uint16_t* pImage;
+		const std::uint8_t* pMask;
+		int width;
+		int height;
+		int radius;
+		CFATYPE cfaType;
+		int nrParities; // CFA: separate column histograms for even and odd rows.
+		int firstColumn;
+		std::vector<std::uint8_t> columnCoarse; // [column][parity][NrCoarseBins]
+		std::vector<std::uint8_t> columnFine;   // [column][parity][NrFineBins]
+		std::vector<int> columnCount;           // [column][parity]
+		Kernel kernels[2]; // CFA: one kernel for the centre pixels in even and one for odd columns.
+
+	public:
+		ConstantTimeMedianFilter(const std::uint16_t* pImg, const std::uint8_t* pMsk, const int w, const int h, const int filterRadius, const CFATYPE cfa) :
+			pImage{ pImg },
+			pMask{ pMsk },
+			width{ w },
+			height{ h },
+			radius{ filterRadius },
+			cfaType{ cfa },
+			nrParities{ cfa == CFATYPE_NONE ? 1 : 2 },
+			firstColumn{ 0 }
+		{}
+
+		static bool isSupported(const int filterRadius, const CFATYPE cfa)
+		{
+			return filterRadius >= 0 && filterRadius <= MaxRadius && !IsCYMGType(cfa);
+		}
+
+		//
+		// Calls callback(col, row, lower, upper, count) for all pixels of the stripe.
+		// lower and upper are the elements at the ranks (count - 1) / 2 and count / 2, the same for odd counts.
+		// The median as computed by Median() of DSSTools.h is (lower + upper) / 2. count is 0 if all pixels are masked.
+		//
+		template <class Callback>
+		void process(const int colStart, const int colEnd, Callback&& callback)
+		{
+			firstColumn = std::max(0, colStart - radius);
+			const int lastColumn = std::min(width - 1, colEnd - 1 + radius);
+			const size_t nrColumns = static_cast<size_t>(lastColumn - firstColumn + 1) * nrParities;
+			const int nrKernels = cfaType == CFATYPE_NONE ? 1 : 2;
+
+			columnCoarse.assign(nrColumns * NrCoarseBins, 0);
+			columnFine.assign(nrColumns * NrFineBins, 0);
+			columnCount.assign(nrColumns, 0);
+			for (int k = 0; k < nrKernels; ++k)
+			{
+				kernels[k].coarse.resize(NrCoarseBins);
+				kernels[k].fine.resize(NrFineBins);
+				kernels[k].fineColumn.resize(NrCoarseBins);
+			}
+
+			for (int row = 0; row <= std::min(radius, height - 1); ++row)
+				for (int col = firstColumn; col <= lastColumn; ++col)
+					updateColumn(col, row, 1);
+
+			for (int row = 0; row < height; ++row)
+			{
+				if (row > 0)
+				{
+					for (int col = firstColumn; col <= lastColumn; ++col)
+					{
+						if (row - radius - 1 >= 0)
+							updateColumn(col, row - radius - 1, -1);
+						if (row + radius < height)
+							updateColumn(col, row + radius, 1);
+					}
+				}
+
+				for (int k = 0; k < nrKernels; ++k)
+					initKernel(kernels[k], k, row, colStart);
+
+				for (int col = colStart; col < colEnd; ++col)
+				{
+					if (col > colStart)
+					{
+						for (int k = 0; k < nrKernels; ++k)
+						{
+							if (col + radius < width)
+								addColumnCoarse(kernels[k], col + radius, 1);
+							if (col - radius - 1 >= 0)
+								addColumnCoarse(kernels[k], col - radius - 1, -1);
+						}
+					}
+
+					Kernel& kernel = kernels[nrKernels == 1 ? 0 : (col & 1)];
+					const int count = kernel.count;
+					if (count == 0)
+					{
+						callback(col, row, std::uint16_t{ 0 }, std::uint16_t{ 0 }, 0);
+						continue;
+					}
+					const std::uint16_t upper = valueAtRank(kernel, count / 2, col);
+					const std::uint16_t lower = (count & 1) != 0 ? upper : valueAtRank(kernel, count / 2 - 1, col);
+					callback(col, row, lower, upper, count);
+				}
+			}
+		}
+
+	private:
+		size_t columnIndex(const int col, const int parity) const
+		{
+			return static_cast<size_t>(col - firstColumn) * nrParities + parity;
+		}
+
+		void updateColumn(const int col, const int row, const int delta)
+		{
+			const size_t offset = static_cast<size_t>(row) * width + col;
+			if (pMask != nullptr && pMask[offset] == 0)
+				return;
+			const std::uint16_t value = pImage[offset];
+			const size_t index = columnIndex(col, nrParities == 1 ? 0 : (row & 1));
+			columnCoarse[index * NrCoarseBins + (value >> 8)] += static_cast<std::uint8_t>(delta);
+			columnFine[index * NrFineBins + value] += static_cast<std::uint8_t>(delta);
+			columnCount[index] += delta;
+		}
+
+		// The parity masks select the column histograms with the Bayer colour of the centre pixels (col & 1 == centreParity).
+		void initKernel(Kernel& kernel, const int centreParity, const int row, const int centreColumn)
+		{
+			if (cfaType != CFATYPE_NONE)
+			{
+				const BAYERCOLOR colour = GetBayerColor(centreParity, row & 1, cfaType);
+				for (int columnParity = 0; columnParity < 2; ++columnParity)
+				{
+					kernel.parityMask[columnParity] = 0;
+					for (int rowParity = 0; rowParity < 2; ++rowParity)
+						if (GetBayerColor(columnParity, rowParity, cfaType) == colour)
+							kernel.parityMask[columnParity] |= 1 << rowParity;
+				}
+			}
+
+			std::fill(kernel.coarse.begin(), kernel.coarse.end(), std::uint16_t{ 0 });
+			std::fill(kernel.fineColumn.begin(), kernel.fineColumn.end(), InvalidColumn);
+			kernel.count = 0;
+			for (int col = std::max(0, centreColumn - radius); col <= std::min(width - 1, centreColumn + radius); ++col)
+				addColumnCoarse(kernel, col, 1);
+		}
+
+		void addColumnCoarse(Kernel& kernel, const int col, const int sign)
+		{
+			const std::uint8_t mask = kernel.parityMask[col & 1];
+			for (int parity = 0; parity < nrParities; ++parity)
+			{
+				if ((mask & (1 << parity)) == 0)
+					continue;
+				const size_t index = columnIndex(col, parity);
+				const std::uint8_t* const pColumn = columnCoarse.data() + index * NrCoarseBins;
+				std::uint16_t* const pKernel = kernel.coarse.data();
+				if (sign > 0)
+					for (int n = 0; n < NrCoarseBins; ++n)
+						pKernel[n] += pColumn[n];
+				else
+					for (int n = 0; n < NrCoarseBins; ++n)
+						pKernel[n] -= pColumn[n];
+				kernel.count += sign * columnCount[index];
+			}
+		}
+
+		void addColumnFine(Kernel& kernel, const int col, const int coarseBin, const int sign)
+		{
+			if (col < 0 || col >= width)
+				return;
+			const std::uint8_t mask = kernel.parityMask[col & 1];
+			std::uint16_t* const pKernel = kernel.fine.data() + coarseBin * 256;
+			for (int parity = 0; parity < nrParities; ++parity)
+			{
+				if ((mask & (1 << parity)) == 0)
+					continue;
+				const std::uint8_t* const pColumn = columnFine.data() + columnIndex(col, parity) * NrFineBins + coarseBin * 256;
+				if (sign > 0)
+					for (int n = 0; n < 256; ++n)
+						pKernel[n] += pColumn[n];
+				else
+					for (int n = 0; n < 256; ++n)
+						pKernel[n] -= pColumn[n];
+			}
+		}
+
+		// Brings the fine segment of coarseBin up to date for the kernel centred at column col.
+		void updateFineSegment(Kernel& kernel, const int coarseBin, const int col)
+		{
+			const int lastColumn = kernel.fineColumn[coarseBin];
+			if (lastColumn == col)
+				return;
+
+			if (lastColumn != InvalidColumn && col - lastColumn <= 2 * radius)
+			{
+				for (int x = lastColumn + 1; x <= col; ++x)
+				{
+					addColumnFine(kernel, x + radius, coarseBin, 1);
+					addColumnFine(kernel, x - radius - 1, coarseBin, -1);
+				}
+			}
+			else
+			{
+				std::fill_n(kernel.fine.begin() + coarseBin * 256, 256, std::uint16_t{ 0 });
+				for (int x = col - radius; x <= col + radius; ++x)
+					addColumnFine(kernel, x, coarseBin, 1);
+			}
+			kernel.fineColumn[coarseBin] = col;
+		}
+
+		std::uint16_t valueAtRank(Kernel& kernel, const int rank, const int col)
+		{
+			int accumulated = 0;
+			int coarseBin = 0;
+			while (accumulated + kernel.coarse[coarseBin] <= rank)
+				accumulated += kernel.coarse[coarseBin++];
+
+			updateFineSegment(kernel, coarseBin, col);
+			const std::uint16_t* const pFine = kernel.fine.data() + coarseBin * 256;
+			int fineBin = 0;
+			while (accumulated + pFine[fineBin] <= rank)
+				accumulated += pFine[fineBin++];
+
+			return static_cast<std::uint16_t>(coarseBin * 256 + fineBin);
+		}
+	};
+}
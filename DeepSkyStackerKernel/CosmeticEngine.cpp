@@ -187,23 +187,39 @@ private:
 	bool m_bCFA;
 
 private:
+	// Working buffers of ComputeMedian, one set per thread (no allocations per fixed pixel).
+	struct MedianBuffers
+	{
+		std::vector<double> okValues[3];
+		std::vector<double> allValues[3];
+
+		void clear(const size_t capacity)
+		{
+			for (auto* pVector : { &okValues[0], &okValues[1], &okValues[2], &allValues[0], &allValues[1], &allValues[2] })
+			{
+				pVector->clear();
+				pVector->reserve(capacity);
+			}
+		}
+	};
+
 	static bool IsOkValue(const double fDelta)
 	{
 		return (fDelta > 100) && (fDelta < 200);
 	}
 
-	void ComputeMedian(int x, int y, int lFilterSize, double& fGray);
-	void ComputeMedian(int x, int y, int lFilterSize, double& fRed, double& fGreen, double& fBlue);
+	void ComputeMedian(int x, int y, int lFilterSize, double& fGray, MedianBuffers& buffers);
+	void ComputeMedian(int x, int y, int lFilterSize, double& fRed, double& fGreen, double& fBlue, MedianBuffers& buffers);
 	void ComputeGaussian(int x, int y, int lFilterSize, double& fGray);
 	void ComputeGaussian(int x, int y, int lFilterSize, double& fRed, double& fGreen, double& fBlue);
 
-	void FixPixel(const int x, const int y, const int lFilterSize)
+	void FixPixel(const int x, const int y, const int lFilterSize, MedianBuffers& buffers)
 	{
 		if (m_bMonochrome)
 		{
 			double fGray;
 			if (m_pcs.m_Replace == CR_MEDIAN)
-				ComputeMedian(x, y, lFilterSize, fGray);
+				ComputeMedian(x, y, lFilterSize, fGray, buffers);
 			else
 				ComputeGaussian(x, y, lFilterSize, fGray);
 			m_pOutBitmap->SetPixel(x, y, fGray);
@@ -212,21 +228,21 @@ private:
 		{
 			double fRed, fGreen, fBlue;
 			if (m_pcs.m_Replace == CR_MEDIAN)
-				ComputeMedian(x, y, lFilterSize, fRed, fGreen, fBlue);
+				ComputeMedian(x, y, lFilterSize, fRed, fGreen, fBlue, buffers);
 			else
 				ComputeGaussian(x, y, lFilterSize, fRed, fGreen, fBlue);
 			m_pOutBitmap->SetPixel(x, y, fRed, fGreen, fBlue);
 		}
 	}
 
-	void FixHotPixel(const int x, const int y)
+	void FixHotPixel(const int x, const int y, MedianBuffers& buffers)
 	{
-		FixPixel(x, y, m_lHotFilterSize);
+		FixPixel(x, y, m_lHotFilterSize, buffers);
 	}
 
-	void FixColdPixel(const int x, const int y)
+	void FixColdPixel(const int x, const int y, MedianBuffers& buffers)
 	{
-		FixPixel(x, y, m_lColdFilterSize);
+		FixPixel(x, y, m_lColdFilterSize, buffers);
 	}
 
 public:
@@ -261,8 +277,9 @@ void CCleanCosmeticTask::process()
 	ZFUNCTRACE_RUNTIME();
 	const int nrProcessors = CMultitask::GetNrProcessors();
 	int progress = 0;
+	MedianBuffers buffers;
 
-#pragma omp parallel for schedule(guided, 100) default(none) if(nrProcessors > 1)
+#pragma omp parallel for schedule(guided, 100) default(none) firstprivate(buffers) if(nrProcessors > 1)
 	for (int row = 0; row < m_lHeight; ++row)
 	{
 		if (omp_get_thread_num() == 0 && m_pProgress != nullptr)
@@ -274,24 +291,23 @@ void CCleanCosmeticTask::process()
 			double delta;
 			m_pDelta->GetPixel(col, row, delta);
 			if (delta > 200)
-				FixHotPixel(col, row);
+				FixHotPixel(col, row, buffers);
 			else if (delta < 100)
-				FixColdPixel(col, row);
+				FixColdPixel(col, row, buffers);
 		}
 	}
 }
 
-void CCleanCosmeticTask::ComputeMedian(int x, int y, int lFilterSize, double& fGray)
+void CCleanCosmeticTask::ComputeMedian(int x, int y, int lFilterSize, double& fGray, MedianBuffers& buffers)
 {
-	std::vector<double>			vGrays;
-	std::vector<double>			vAllGrays;
+	std::vector<double>&		vGrays = buffers.okValues[0];
+	std::vector<double>&		vAllGrays = buffers.allValues[0];
 	BAYERCOLOR					BayerColor = BAYER_UNKNOWN;
 
 	if (m_CFAType != CFATYPE_NONE)
 		BayerColor = GetBayerColor(x, y, m_CFAType);
 
-	vGrays.reserve((lFilterSize+1)*2);
-	vAllGrays.reserve((lFilterSize+1)*2);
+	buffers.clear((static_cast<size_t>(lFilterSize) * 2 + 1) * (static_cast<size_t>(lFilterSize) * 2 + 1));
 	for (int i = std::max(0, x-lFilterSize); i <= std::min(m_lWidth-1, x+lFilterSize); i++)
 	{
 		for (int j = std::max(0, y-lFilterSize); j <= std::min(m_lHeight-1, y+lFilterSize); j++)
@@ -323,22 +339,16 @@ void CCleanCosmeticTask::ComputeMedian(int x, int y, int lFilterSize, double& fG
 		fGray = Median(vAllGrays);
 };
 
-void CCleanCosmeticTask::ComputeMedian(int x, int y, int lFilterSize, double& fRed, double& fGreen, double& fBlue)
+void CCleanCosmeticTask::ComputeMedian(int x, int y, int lFilterSize, double& fRed, double& fGreen, double& fBlue, MedianBuffers& buffers)
 {
-	std::vector<double>			vReds;
-	std::vector<double>			vAllReds;
-	std::vector<double>			vGreens;
-	std::vector<double>			vAllGreens;
-	std::vector<double>			vBlues;
-	std::vector<double>			vAllBlues;
-
-	const size_t vectorSize = (static_cast<size_t>(lFilterSize) + 1) * 2;
-	vReds.reserve(vectorSize);
-	vAllReds.reserve(vectorSize);
-	vGreens.reserve(vectorSize);
-	vAllGreens.reserve(vectorSize);
-	vBlues.reserve(vectorSize);
-	vAllBlues.reserve(vectorSize);
+	std::vector<double>&		vReds = buffers.okValues[0];
+	std::vector<double>&		vAllReds = buffers.allValues[0];
+	std::vector<double>&		vGreens = buffers.okValues[1];
+	std::vector<double>&		vAllGreens = buffers.allValues[1];
+	std::vector<double>&		vBlues = buffers.okValues[2];
+	std::vector<double>&		vAllBlues = buffers.allValues[2];
+
+	buffers.clear((static_cast<size_t>(lFilterSize) * 2 + 1) * (static_cast<size_t>(lFilterSize) * 2 + 1));
 	for (int i = std::max(0, x-lFilterSize); i <= std::min(m_lWidth-1, x+lFilterSize); i++)
 	{
 		for (int j = std::max(0, y-lFilterSize); j <= std::min(m_lHeight-1, y+lFilterSize); j++)
@@ -1,8 +1,11 @@
 #include <stdafx.h>
+#include <numeric>
 #include "DarkFrame.h"
 #include "Ztrace.h"
 #include "DSSProgress.h"
 #include "MemoryBitmap.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
 #include "Filters.h"
 #include "histogram.h"
 #include "BitmapIterator.h"
@@ -1486,6 +1489,7 @@ void	CDarkFrame::ComputeDarkFactorFromHotPixels(CMemoryBitmap * pBitmap, STARVEC
 void CDarkFrame::FindBadVerticalLines(ProgressBase*)
 {
 	ZFUNCTRACE_RUNTIME();
+	m_HotPixelIndex.clear();
 	bool				bMonochrome = m_pMasterDark->IsMonochrome();
 	int				i, j;
 
@@ -1696,6 +1700,7 @@ void CDarkFrame::FindHotPixels(ProgressBase* pProgress)
 {
 	ZFUNCTRACE_RUNTIME();
 	m_vHotPixels.clear();
+	m_HotPixelIndex.clear();
 	if (static_cast<bool>(m_pMasterDark))
 	{
 		RGBHistogram rgbHistogram;
@@ -1788,87 +1793,253 @@ void	CDarkFrame::GetValidNeighbors(int lX, int lY, HOTPIXELVECTOR & vPixels, int
 
 /* ------------------------------------------------------------------- */
 
-void	CDarkFrame::InterpolateHotPixels(std::shared_ptr<CMemoryBitmap> pBitmap, ProgressBase*)
+namespace
 {
-	ZFUNCTRACE_RUNTIME();
-	if (static_cast<bool>(pBitmap) && !m_vHotPixels.empty())
+	//
+	// Interpolation of the hot pixels of one plane with the typed pixels, as done with GetPixel() and SetPixel().
+	// The neighbours are never hot pixels, so the hot pixels are independent and interpolated in parallel.
+	//
+	template <class T>
+	void interpolateHotPixelPlane(T* const pPixels, const double multiplier, const CHotPixelIndex& index)
 	{
-		// First set hot pixels to 0
-		for (size_t i = 0; i < m_vHotPixels.size(); i++)
-			pBitmap->SetPixel(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, 0.0);
+		const int nrHotPixels = static_cast<int>(index.m_vOffsets.size());
 
-		// Then Interpolate Hot Pixels
-		if (pBitmap->IsMonochrome())
+#pragma omp parallel for schedule(static) default(none) shared(index) firstprivate(pPixels, multiplier, nrHotPixels) if(CMultitask::GetNrProcessors() > 1)
+		for (int n = 0; n < nrHotPixels; n++)
 		{
-			// Check and remove super pixel settings
-			CFATRANSFORMATION CFATransform = CFAT_NONE;
+			T* const pPixel = pPixels + index.m_vOffsets[n];
+			double fValue = 0.0;
+			int lTotalWeight = 0;
 
-			CCFABitmapInfo* pCFABitmapInfo = dynamic_cast<CCFABitmapInfo*>(pBitmap.get());
-			if (pCFABitmapInfo)
+			for (std::uint32_t k = index.m_vFirstNeighbor[n]; k < index.m_vFirstNeighbor[n + 1]; k++)
 			{
-				CFATransform = pCFABitmapInfo->GetCFATransformation();
-				if (CFATransform == CFAT_SUPERPIXEL)
-					pCFABitmapInfo->UseBilinear(true);
+				const CHotPixelIndex::Neighbor& neighbor = index.m_vNeighbors[k];
+				fValue += (static_cast<double>(pPixel[neighbor.offset]) / multiplier) * neighbor.weight;
+				lTotalWeight += neighbor.weight;
 			}
+			if (lTotalWeight != 0)
+				fValue /= lTotalWeight;
 
-			// Interpolate with neighbor pixels (level 1)
-			const bool bCFA = pBitmap->IsCFA();
+			// As SetPixel(): scaled and clamped to the range of the type (a hot pixel without neighbours is 0).
+			*pPixel = static_cast<T>(std::clamp(fValue * multiplier, 0.0, initClamp<T>()));
+		}
+	}
+}
 
+/* ------------------------------------------------------------------- */
 
-			for (size_t i = 0; i < m_vHotPixels.size(); i++)
+void	CDarkFrame::BuildHotPixelIndex(const bool bCFA)
+{
+	ZFUNCTRACE_RUNTIME();
+	m_HotPixelIndex.clear();
+
+	const int lWidth = m_pMasterDark->RealWidth();
+	const int lHeight = m_pMasterDark->RealHeight();
+	const int lRadius = bCFA ? 2 : 1;
+	const CMemoryBitmap* const pMasterDark = m_pMasterDark.get();
+	CHotPixelIndex& index = m_HotPixelIndex;
+
+	index.m_vOffsets.reserve(m_vHotPixels.size());
+	for (const CHotPixel& hp : m_vHotPixels)
+		index.m_vOffsets.push_back(static_cast<size_t>(hp.m_lY) * lWidth + hp.m_lX);
+	std::sort(index.m_vOffsets.begin(), index.m_vOffsets.end());
+	index.m_vOffsets.erase(std::unique(index.m_vOffsets.begin(), index.m_vOffsets.end()), index.m_vOffsets.end());
+
+	//
+	// Calls addNeighbor(offset, weight) for the valid neighbours of the hot pixel n, in the order of GetValidNeighbors().
+	// The Bayer color is the one of the master dark, InterpolateIndexedHotPixels() only uses the index for light frames
+	// with the same CFA pattern.
+	//
+	const auto forEachNeighbor = [&index, pMasterDark, lWidth, lHeight, lRadius, bCFA](const int n, auto&& addNeighbor)
+	{
+		const size_t offset = index.m_vOffsets[n];
+		const int lX = static_cast<int>(offset % lWidth);
+		const int lY = static_cast<int>(offset / lWidth);
+		const BAYERCOLOR BayerColor = bCFA ? pMasterDark->GetBayerColor(lX, lY) : BAYER_UNKNOWN;
+
+		for (int i = std::max(0, lX - lRadius); i < std::min(lWidth, 1 + lX + lRadius); i++)
+		{
+			for (int j = std::max(0, lY - lRadius); j < std::min(lHeight, 1 + lY + lRadius); j++)
 			{
-				HOTPIXELVECTOR vPixels;
-				BAYERCOLOR BayerColor = BAYER_UNKNOWN;
-				double fValue = 0.0;
-				int lTotalWeight = 0;
+				if ((i == lX) && (j == lY))
+					continue;
+				if (std::binary_search(index.m_vOffsets.cbegin(), index.m_vOffsets.cend(), static_cast<size_t>(j) * lWidth + i))
+					continue;
+				if ((BayerColor != BAYER_UNKNOWN) && (pMasterDark->GetBayerColor(i, j) != BayerColor))
+					continue;
+
+				addNeighbor((j - lY) * lWidth + (i - lX), std::abs(1 + lRadius - std::abs(lX - i)) + std::abs(1 + lRadius - std::abs(lY - j)));
+			}
+		}
+	};
 
-				if (bCFA)
-					BayerColor = pBitmap->GetBayerColor(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY);
+	const int nrHotPixels = static_cast<int>(index.m_vOffsets.size());
+	index.m_vFirstNeighbor.resize(nrHotPixels + 1, 0);
 
-				GetValidNeighbors(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, vPixels, bCFA ? 2 : 1, BayerColor);
-				for (size_t j = 0; j < vPixels.size(); j++)
-				{
-					double fGray;
+	// Count the neighbours of each hot pixel, then store them.
+#pragma omp parallel for schedule(dynamic, 1024) default(none) shared(index, forEachNeighbor) firstprivate(nrHotPixels) if(CMultitask::GetNrProcessors() > 1)
+	for (int n = 0; n < nrHotPixels; n++)
+	{
+		std::uint32_t nrNeighbors = 0;
+		forEachNeighbor(n, [&nrNeighbors](const int, const int) { ++nrNeighbors; });
+		index.m_vFirstNeighbor[n + 1] = nrNeighbors;
+	}
 
-					pBitmap->GetPixel(vPixels[j].m_lX, vPixels[j].m_lY, fGray);
-					fValue += fGray * vPixels[j].m_lWeight;
-					lTotalWeight += vPixels[j].m_lWeight;
-				}
-				if (lTotalWeight)
-					fValue /= lTotalWeight;
-				pBitmap->SetPixel(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, fValue);
+	std::partial_sum(index.m_vFirstNeighbor.cbegin(), index.m_vFirstNeighbor.cend(), index.m_vFirstNeighbor.begin());
+	index.m_vNeighbors.resize(index.m_vFirstNeighbor.back());
 
-			}
+#pragma omp parallel for schedule(dynamic, 1024) default(none) shared(index, forEachNeighbor) firstprivate(nrHotPixels) if(CMultitask::GetNrProcessors() > 1)
+	for (int n = 0; n < nrHotPixels; n++)
+	{
+		CHotPixelIndex::Neighbor* pNeighbor = index.m_vNeighbors.data() + index.m_vFirstNeighbor[n];
+		forEachNeighbor(n, [&pNeighbor](const int offset, const int weight) { *pNeighbor++ = CHotPixelIndex::Neighbor{ offset, weight }; });
+	}
+
+	index.m_bCFA = bCFA;
+	index.m_bValid = true;
+	ZTRACE_RUNTIME("Hot pixel index: %d hot pixels, %d neighbours", nrHotPixels, static_cast<int>(index.m_vNeighbors.size()));
+}
+
+/* ------------------------------------------------------------------- */
+
+//
+// Interpolates the hot pixels of gray and color bitmaps with the hot pixel index. Returns false (nothing done) for other
+// bitmaps, bitmaps with another size than the master dark, and CFA bitmaps with another CFA pattern than the master dark.
+//
+bool	CDarkFrame::InterpolateIndexedHotPixels(CMemoryBitmap* pBitmap)
+{
+	if (pBitmap->RealWidth() != m_pMasterDark->RealWidth() || pBitmap->RealHeight() != m_pMasterDark->RealHeight())
+		return false;
+
+	// As InterpolateHotPixels(): gray CFA bitmaps use the neighbours with the same Bayer color.
+	const bool bCFA = pBitmap->IsMonochrome() && pBitmap->IsCFA();
+	if (bCFA)
+	{
+		const CCFABitmapInfo* pCFAInfo = dynamic_cast<const CCFABitmapInfo*>(pBitmap);
+		const CCFABitmapInfo* pMasterCFAInfo = dynamic_cast<const CCFABitmapInfo*>(m_pMasterDark.get());
+		if (pCFAInfo == nullptr || pMasterCFAInfo == nullptr || !m_pMasterDark->IsMonochrome()
+			|| pCFAInfo->GetCFAType() != pMasterCFAInfo->GetCFAType()
+			|| pCFAInfo->xOffset() != pMasterCFAInfo->xOffset() || pCFAInfo->yOffset() != pMasterCFAInfo->yOffset())
+			return false;
+	}
+
+	const auto interpolate = [this, pBitmap, bCFA]<class T>() -> bool
+	{
+		CGrayBitmapT<T>* pGrayBitmap = dynamic_cast<CGrayBitmapT<T>*>(pBitmap);
+		CColorBitmapT<T>* pColorBitmap = dynamic_cast<CColorBitmapT<T>*>(pBitmap);
+		if (pGrayBitmap == nullptr && pColorBitmap == nullptr)
+			return false;
+
+		if (!m_HotPixelIndex.m_bValid || m_HotPixelIndex.m_bCFA != bCFA)
+			BuildHotPixelIndex(bCFA);
+
+		if (pGrayBitmap != nullptr)
+			interpolateHotPixelPlane(pGrayBitmap->m_vPixels.data(), pGrayBitmap->GetMultiplier(), m_HotPixelIndex);
+		else
+		{
+			interpolateHotPixelPlane(pColorBitmap->m_Red.m_vPixels.data(), initMultiplier<T>(), m_HotPixelIndex);
+			interpolateHotPixelPlane(pColorBitmap->m_Green.m_vPixels.data(), initMultiplier<T>(), m_HotPixelIndex);
+			interpolateHotPixelPlane(pColorBitmap->m_Blue.m_vPixels.data(), initMultiplier<T>(), m_HotPixelIndex);
+		}
+		return true;
+	};
+
+	return interpolate.operator()<std::uint16_t>() || interpolate.operator()<float>() || interpolate.operator()<std::uint32_t>()
+		|| interpolate.operator()<std::uint8_t>() || interpolate.operator()<double>();
+}
+
+/* ------------------------------------------------------------------- */
+
+void	CDarkFrame::InterpolateHotPixels(std::shared_ptr<CMemoryBitmap> pBitmap, ProgressBase*)
+{
+	ZFUNCTRACE_RUNTIME();
+	if (static_cast<bool>(pBitmap) && !m_vHotPixels.empty() && !InterpolateIndexedHotPixels(pBitmap.get()))
+		InterpolateListedHotPixels(pBitmap.get());
+}
+
+/* ------------------------------------------------------------------- */
+
+//
+// Interpolates the hot pixels one at a time with GetPixel() and SetPixel(), for the bitmaps that
+// InterpolateIndexedHotPixels() doesn't handle.
+//
+void	CDarkFrame::InterpolateListedHotPixels(CMemoryBitmap* pBitmap)
+{
+	// First set hot pixels to 0
+	for (size_t i = 0; i < m_vHotPixels.size(); i++)
+		pBitmap->SetPixel(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, 0.0);
+
+	// Then Interpolate Hot Pixels
+	if (pBitmap->IsMonochrome())
+	{
+		// Check and remove super pixel settings
+		CFATRANSFORMATION CFATransform = CFAT_NONE;
+
+		CCFABitmapInfo* pCFABitmapInfo = dynamic_cast<CCFABitmapInfo*>(pBitmap);
+		if (pCFABitmapInfo)
+		{
+			CFATransform = pCFABitmapInfo->GetCFATransformation();
 			if (CFATransform == CFAT_SUPERPIXEL)
-				pCFABitmapInfo->UseSuperPixels(true);
+				pCFABitmapInfo->UseBilinear(true);
 		}
-		else
+
+		// Interpolate with neighbor pixels (level 1)
+		const bool bCFA = pBitmap->IsCFA();
+
+
+		for (size_t i = 0; i < m_vHotPixels.size(); i++)
 		{
-			for (size_t i = 0; i < m_vHotPixels.size(); i++)
+			HOTPIXELVECTOR vPixels;
+			BAYERCOLOR BayerColor = BAYER_UNKNOWN;
+			double fValue = 0.0;
+			int lTotalWeight = 0;
+
+			if (bCFA)
+				BayerColor = pBitmap->GetBayerColor(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY);
+
+			GetValidNeighbors(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, vPixels, bCFA ? 2 : 1, BayerColor);
+			for (size_t j = 0; j < vPixels.size(); j++)
 			{
-				HOTPIXELVECTOR vPixels;
-				double fRedValue	= 0.0, fGreenValue = 0.0, fBlueValue  = 0.0;
-				int lTotalWeight = 0;
+				double fGray;
 
-				GetValidNeighbors(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, vPixels, 1);
-				for (size_t j = 0; j < vPixels.size(); j++)
-				{
-					double			fRed, fGreen, fBlue;
+				pBitmap->GetPixel(vPixels[j].m_lX, vPixels[j].m_lY, fGray);
+				fValue += fGray * vPixels[j].m_lWeight;
+				lTotalWeight += vPixels[j].m_lWeight;
+			}
+			if (lTotalWeight)
+				fValue /= lTotalWeight;
+			pBitmap->SetPixel(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, fValue);
 
-					pBitmap->GetPixel(vPixels[j].m_lX, vPixels[j].m_lY, fRed, fGreen, fBlue);
-					fRedValue	+= fRed * vPixels[j].m_lWeight;
-					fGreenValue += fGreen * vPixels[j].m_lWeight;
-					fBlueValue  += fBlue * vPixels[j].m_lWeight;
-					lTotalWeight += vPixels[j].m_lWeight;
-				}
-				if (lTotalWeight != 0)
-				{
-					fRedValue /= lTotalWeight;
-					fGreenValue /= lTotalWeight;
-					fBlueValue /= lTotalWeight;
-				}
-				pBitmap->SetPixel(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, fRedValue, fGreenValue, fBlueValue);
+		}
+		if (CFATransform == CFAT_SUPERPIXEL)
+			pCFABitmapInfo->UseSuperPixels(true);
+	}
+	else
+	{
+		for (size_t i = 0; i < m_vHotPixels.size(); i++)
+		{
+			HOTPIXELVECTOR vPixels;
+			double fRedValue	= 0.0, fGreenValue = 0.0, fBlueValue  = 0.0;
+			int lTotalWeight = 0;
+
+			GetValidNeighbors(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, vPixels, 1);
+			for (size_t j = 0; j < vPixels.size(); j++)
+			{
+				double			fRed, fGreen, fBlue;
+
+				pBitmap->GetPixel(vPixels[j].m_lX, vPixels[j].m_lY, fRed, fGreen, fBlue);
+				fRedValue	+= fRed * vPixels[j].m_lWeight;
+				fGreenValue += fGreen * vPixels[j].m_lWeight;
+				fBlueValue  += fBlue * vPixels[j].m_lWeight;
+				lTotalWeight += vPixels[j].m_lWeight;
+			}
+			if (lTotalWeight != 0)
+			{
+				fRedValue /= lTotalWeight;
+				fGreenValue /= lTotalWeight;
+				fBlueValue /= lTotalWeight;
 			}
+			pBitmap->SetPixel(m_vHotPixels[i].m_lX, m_vHotPixels[i].m_lY, fRedValue, fGreenValue, fBlueValue);
 		}
 	}
 }
@@ -1936,5 +2107,6 @@ void CDarkFrame::Reset(std::shared_ptr<CMemoryBitmap> pMaster)
 	m_bHotPixelDetected = false;
 	m_pMasterDark = pMaster;
 	m_vHotPixels.clear();
+	m_HotPixelIndex.clear();
 }
 
@@ -203,6 +203,39 @@ public :
 
 /* ------------------------------------------------------------------- */
 
+//
+// The hot pixels of a master dark with their valid neighbours (those of CDarkFrame::GetValidNeighbors()), built once
+// per master dark and used to interpolate the hot pixels of each light frame.
+// The hot pixels are their offsets in the bitmap (y * width + x), sorted and without duplicates. The neighbours of the
+// hot pixel n are m_vNeighbors[m_vFirstNeighbor[n]] to m_vNeighbors[m_vFirstNeighbor[n+1] - 1], with their offsets
+// relative to the hot pixel, in the order of GetValidNeighbors().
+//
+class CHotPixelIndex
+{
+public:
+	struct Neighbor
+	{
+		std::int32_t offset;
+		std::int32_t weight;
+	};
+
+	std::vector<size_t> m_vOffsets;
+	std::vector<std::uint32_t> m_vFirstNeighbor;
+	std::vector<Neighbor> m_vNeighbors;
+	bool m_bCFA{ false };		// Neighbours 2 pixels around with the same Bayer color (else 1 pixel around)
+	bool m_bValid{ false };
+
+	void clear()
+	{
+		m_vOffsets.clear();
+		m_vFirstNeighbor.clear();
+		m_vNeighbors.clear();
+		m_bValid = false;
+	}
+};
+
+/* ------------------------------------------------------------------- */
+
 class CDarkFrame
 {
 private :
@@ -214,7 +247,7 @@ private :
 	std::shared_ptr<CMemoryBitmap> m_pMasterDark;
 	std::shared_ptr<CMemoryBitmap> m_pAmpGlow;
 	std::shared_ptr<CMemoryBitmap> m_pDarkCurrent;
-	HOTPIXELVECTOR				m_vHotPixels;
+	CHotPixelIndex				m_HotPixelIndex;
 	EXCLUDEDPIXELVECTOR			m_vExcludedPixels;
 
 	CDarkFrameHotParameters		m_HotParameters;
@@ -227,6 +260,12 @@ private :
 	void	GetValidNeighbors(int lX, int lY, HOTPIXELVECTOR & vPixels, int lRadius, BAYERCOLOR BayerColor = BAYER_UNKNOWN);
 
 protected :
+	HOTPIXELVECTOR				m_vHotPixels;	// Sorted by FindHotPixels(), FindBadVerticalLines() appends the bad columns
+
+	void	BuildHotPixelIndex(bool bCFA);
+	bool	InterpolateIndexedHotPixels(CMemoryBitmap* pBitmap);
+	void	InterpolateListedHotPixels(CMemoryBitmap* pBitmap);
+
 	void	ComputeOptimalDistributionRatio(CMemoryBitmap * pBitmap, CMemoryBitmap * pDark, double & fRatio, DSS::ProgressBase * pProgress);
 
 	void	ComputeDarkFactorFromMedian(CMemoryBitmap * pBitmap, double & fHotDark, double & fAmpGlow, DSS::ProgressBase * pProgress);
@@ -5,6 +5,7 @@
 #include "DSSProgress.h"
 #include "BackgroundCalibration.h"
 #include "Ztrace.h"
+#include "Multitask.h"
 
 using namespace DSS;
 
@@ -14,6 +15,35 @@ using namespace DSS;
 
 /* ------------------------------------------------------------------- */
 
+template <class T>
+bool CDeBloomPixels::InitPixels(const PixelType type)
+{
+	if (auto* pGrayBitmap = dynamic_cast<CGrayBitmapT<T>*>(m_pBitmap))
+	{
+		m_Type = type;
+		m_pPixels = pGrayBitmap->m_vPixels.data();
+		m_fMultiplier = pGrayBitmap->GetMultiplier();
+		m_fClamp = static_cast<double>(std::numeric_limits<T>::max());
+		return true;
+	}
+	return false;
+}
+
+CDeBloomPixels::CDeBloomPixels(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask) :
+	m_pBitmap{ pBitmap },
+	m_pMask{ pMask->m_vPixels.data() },
+	m_lWidth{ pBitmap->Width() },
+	m_lHeight{ pBitmap->Height() }
+{
+	InitPixels<std::uint8_t>(PixelType::Byte)
+		|| InitPixels<std::uint16_t>(PixelType::Word)
+		|| InitPixels<std::uint32_t>(PixelType::DWord)
+		|| InitPixels<float>(PixelType::Float)
+		|| InitPixels<double>(PixelType::Double);
+}
+
+/* ------------------------------------------------------------------- */
+
 inline bool IsBloomedValue(double fValue)
 {
 	return fValue > 200.0;
@@ -43,15 +73,15 @@ inline bool IsEdge(const double pfGray[])
 }
 
 
-bool CDeBloom::IsLeftEdge(CMemoryBitmap * pBitmap, int x, int y)
+bool CDeBloom::IsLeftEdge(const CDeBloomPixels & pixels, int x, int y) const
 {
 	double			fGray[5];
 
-	pBitmap->GetPixel(std::max(0, x-0), y, fGray[0]); // Current Pixel
-	pBitmap->GetPixel(std::max(0, x-1), y, fGray[1]); //
-	pBitmap->GetPixel(std::max(0, x-2), y, fGray[2]);
-	pBitmap->GetPixel(std::max(0, x-3), y, fGray[3]);
-	pBitmap->GetPixel(std::max(0, x-4), y, fGray[4]);
+	fGray[0] = pixels.GetPixel(std::max(0, x-0), y); // Current Pixel
+	fGray[1] = pixels.GetPixel(std::max(0, x-1), y); //
+	fGray[2] = pixels.GetPixel(std::max(0, x-2), y);
+	fGray[3] = pixels.GetPixel(std::max(0, x-3), y);
+	fGray[4] = pixels.GetPixel(std::max(0, x-4), y);
 
 	for (size_t i = 0; i < 5; i++)
 		fGray[i] = (fGray[i] - m_fBackground) / (256.0 - m_fBackground) * 256.0;
@@ -60,15 +90,15 @@ bool CDeBloom::IsLeftEdge(CMemoryBitmap * pBitmap, int x, int y)
 }
 
 
-bool CDeBloom::IsRightEdge(CMemoryBitmap * pBitmap, int x, int y)
+bool CDeBloom::IsRightEdge(const CDeBloomPixels & pixels, int x, int y) const
 {
 	double			fGray[5];
 
-	pBitmap->GetPixel(std::min(m_lWidth-1, x+0), y, fGray[0]); // Current Pixel
-	pBitmap->GetPixel(std::min(m_lWidth-1, x+1), y, fGray[1]); // Current Pixel
-	pBitmap->GetPixel(std::min(m_lWidth-1, x+2), y, fGray[2]); // Current Pixel
-	pBitmap->GetPixel(std::min(m_lWidth-1, x+3), y, fGray[3]); // Current Pixel
-	pBitmap->GetPixel(std::min(m_lWidth-1, x+4), y, fGray[4]); // Current Pixel
+	fGray[0] = pixels.GetPixel(std::min(m_lWidth-1, x+0), y); // Current Pixel
+	fGray[1] = pixels.GetPixel(std::min(m_lWidth-1, x+1), y); // Current Pixel
+	fGray[2] = pixels.GetPixel(std::min(m_lWidth-1, x+2), y); // Current Pixel
+	fGray[3] = pixels.GetPixel(std::min(m_lWidth-1, x+3), y); // Current Pixel
+	fGray[4] = pixels.GetPixel(std::min(m_lWidth-1, x+4), y); // Current Pixel
 
 	for (size_t i = 0; i < 5; i++)
 		fGray[i] = (fGray[i] - m_fBackground) / (256.0 - m_fBackground) * 256.0;
@@ -77,15 +107,15 @@ bool CDeBloom::IsRightEdge(CMemoryBitmap * pBitmap, int x, int y)
 }
 
 
-bool	CDeBloom::IsTopEdge(CMemoryBitmap * pBitmap, int x, int y)
+bool	CDeBloom::IsTopEdge(const CDeBloomPixels & pixels, int x, int y) const
 {
 	double			fGray[5];
 
-	pBitmap->GetPixel(x, std::max(0, y-0), fGray[0]); // Current Pixel
-	pBitmap->GetPixel(x, std::max(0, y-1), fGray[1]); // Current Pixel
-	pBitmap->GetPixel(x, std::max(0, y-2), fGray[2]); // Current Pixel
-	pBitmap->GetPixel(x, std::max(0, y-3), fGray[3]); // Current Pixel
-	pBitmap->GetPixel(x, std::max(0, y-4), fGray[4]); // Current Pixel
+	fGray[0] = pixels.GetPixel(x, std::max(0, y-0)); // Current Pixel
+	fGray[1] = pixels.GetPixel(x, std::max(0, y-1)); // Current Pixel
+	fGray[2] = pixels.GetPixel(x, std::max(0, y-2)); // Current Pixel
+	fGray[3] = pixels.GetPixel(x, std::max(0, y-3)); // Current Pixel
+	fGray[4] = pixels.GetPixel(x, std::max(0, y-4)); // Current Pixel
 
 	for (size_t i = 0; i < 5; i++)
 		fGray[i] = (fGray[i] - m_fBackground) / (256.0 - m_fBackground) * 256.0;
@@ -94,15 +124,15 @@ bool	CDeBloom::IsTopEdge(CMemoryBitmap * pBitmap, int x, int y)
 }
 
 
-bool CDeBloom::IsBottomEdge(CMemoryBitmap * pBitmap, int x, int y)
+bool CDeBloom::IsBottomEdge(const CDeBloomPixels & pixels, int x, int y) const
 {
 	double			fGray[5];
 
-	pBitmap->GetPixel(x, std::min(m_lHeight-1, y+0), fGray[0]); // Current Pixel
-	pBitmap->GetPixel(x, std::min(m_lHeight-1, y+1), fGray[1]); // Current Pixel
-	pBitmap->GetPixel(x, std::min(m_lHeight-1, y+2), fGray[2]); // Current Pixel
-	pBitmap->GetPixel(x, std::min(m_lHeight-1, y+3), fGray[3]); // Current Pixel
-	pBitmap->GetPixel(x, std::min(m_lHeight-1, y+4), fGray[4]); // Current Pixel
+	fGray[0] = pixels.GetPixel(x, std::min(m_lHeight-1, y+0)); // Current Pixel
+	fGray[1] = pixels.GetPixel(x, std::min(m_lHeight-1, y+1)); // Current Pixel
+	fGray[2] = pixels.GetPixel(x, std::min(m_lHeight-1, y+2)); // Current Pixel
+	fGray[3] = pixels.GetPixel(x, std::min(m_lHeight-1, y+3)); // Current Pixel
+	fGray[4] = pixels.GetPixel(x, std::min(m_lHeight-1, y+4)); // Current Pixel
 
 	for (size_t i = 0; i < 5; i++)
 		fGray[i] = (fGray[i] - m_fBackground) / (256.0 - m_fBackground) * 256.0;
@@ -110,69 +140,6 @@ bool CDeBloom::IsBottomEdge(CMemoryBitmap * pBitmap, int x, int y)
 	return IsEdge(fGray);
 }
 
-
-inline double ComputeCenter(std::vector<double> & vValues)
-{
-	double fResult = -1.0;
-	int i;
-	bool bEmptyValues = false;
-	int lStartEmpty = -1, lEndEmpty = -1;
-	double fSum = 0, fNrValues = 0;
-
-	for (i = 0; i < vValues.size(); i++)
-	{
-		if (vValues[i]<0)
-		{
-			lEndEmpty = i+1;
-			if (lStartEmpty<0)
-				lStartEmpty = i+1;
-			bEmptyValues = true;
-		};
-	};
-
-	if (bEmptyValues)
-	{
-		// Keep only the same number of values on each side
-		//         S    E
-		//   12345678901234567890
-		//
-		int				lNrLeftKeptValues,
-							lNrRightKeptValues,
-							lNrKeptValues;
-
-		lNrLeftKeptValues  = lStartEmpty-1;
-		lNrRightKeptValues = (int)vValues.size()-lEndEmpty;
-		lNrKeptValues = std::min(lNrLeftKeptValues, lNrRightKeptValues);
-
-		if (lNrLeftKeptValues>lNrKeptValues)
-		{
-			for (i = 0;i<lNrLeftKeptValues-lNrKeptValues;i++)
-				vValues[i] = -1.0;
-		}
-		else if (lNrRightKeptValues>lNrKeptValues)
-		{
-			for (i = 0;i<lNrRightKeptValues-lNrKeptValues;i++)
-				vValues[vValues.size()-1-i] = -1.0;
-		};
-	};
-	fSum = 0;
-	fNrValues = 0;
-	for (i = 0;i<vValues.size();i++)
-	{
-		if (vValues[i]>=0)
-		{
-			fSum += vValues[i] * ((double)i+0.5);
-			fNrValues += vValues[i];
-		};
-	};
-
-	if (fNrValues)
-		fResult = fSum/fNrValues;
-
-	return fResult;
-};
-
-
 /* ------------------------------------------------------------------- */
 
 inline double			distance(double x1, double y1, double x2, double y2)
@@ -180,13 +147,13 @@ inline double			distance(double x1, double y1, double x2, double y2)
 	return sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
 };
 
-static double	InterpolatePixelValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, QPointF pt, bool bNoBloom = false)
+static double	InterpolatePixelValue(const CDeBloomPixels & pixels, QPointF pt, bool bNoBloom = false)
 {
 	int				x0 = floor(pt.x() - 0.5), x1 = 1 + x0,
 					y0 = floor(pt.y() - 0.5), y1 = 1 + y0;
 
-	int				width = pBitmap->Width(),
-						height = pBitmap->Height();
+	int				width = pixels.Width(),
+						height = pixels.Height();
 
 
 	double				fd00 = distance(x0+0.5, y0+0.5, pt.x(), pt.y()),
@@ -207,9 +174,9 @@ static double	InterpolatePixelValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * p
 	//
 	if (x0 >= 0 && x0 < (width - 1) && y0 >= 0 && y0 < (height - 1))
 	{
-		pMask->GetPixel(x0, y0, fMask);
+		fMask = pixels.GetMask(x0, y0);
 		if (!IsBloomedValue(fMask))
-			pBitmap->GetPixel(x0, y0, fv00);
+			fv00 = pixels.GetPixel(x0, y0);
 		else
 			bBloom = true;
 	}
@@ -219,9 +186,9 @@ static double	InterpolatePixelValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * p
 	//
 	if (x0 >= 0 && x0 < (width - 1) && y1 >= 0 && y1 < (height - 1))
 	{
-		pMask->GetPixel(x0, y1, fMask);
+		fMask = pixels.GetMask(x0, y1);
 		if (!IsBloomedValue(fMask))
-			pBitmap->GetPixel(x0, y1, fv01);
+			fv01 = pixels.GetPixel(x0, y1);
 		else
 			bBloom = true;
 	}
@@ -231,9 +198,9 @@ static double	InterpolatePixelValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * p
 	//
 	if (x1 >= 0 && x1 < (width - 1) && y0 >= 0 && y0 < (height - 1))
 	{
-		pMask->GetPixel(x1, y0, fMask);
+		fMask = pixels.GetMask(x1, y0);
 		if (!IsBloomedValue(fMask))
-			pBitmap->GetPixel(x1, y0, fv10);
+			fv10 = pixels.GetPixel(x1, y0);
 		else
 			bBloom = true;
 	}
@@ -243,9 +210,9 @@ static double	InterpolatePixelValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * p
 	//
 	if (x1 >= 0 && x1 < (width - 1) && y1 >= 0 && y1 < (height - 1))
 	{
-		pMask->GetPixel(x1, y1, fMask);
+		fMask = pixels.GetMask(x1, y1);
 		if (!IsBloomedValue(fMask))
-			pBitmap->GetPixel(x1, y1, fv11);
+			fv11 = pixels.GetPixel(x1, y1);
 		else
 			bBloom = true;
 	}
@@ -282,7 +249,7 @@ static double	InterpolatePixelValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * p
 
 /* ------------------------------------------------------------------- */
 
-double	CDeBloom::ComputeStarGradient(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStarGradient & bsg, double fRadius)
+double	CDeBloom::ComputeStarGradient(const CDeBloomPixels & pixels, CBloomedStarGradient & bsg, double fRadius) const
 {
 	QPointF			ptNW,
 						ptSW,
@@ -296,10 +263,10 @@ double	CDeBloom::ComputeStarGradient(CMemoryBitmap * pBitmap, C8BitGrayBitmap *
 	ptSW.rx() += -fRadius+bsg.fdX;		ptSW.ry() +=  fRadius+bsg.fdY;
 	ptSE.rx() +=  fRadius+bsg.fdX;		ptSE.ry() +=  fRadius+bsg.fdY;
 
-	bsg.fNW = InterpolatePixelValue(pBitmap, pMask, ptNW, true);
-	bsg.fSW = InterpolatePixelValue(pBitmap, pMask, ptSW, true);
-	bsg.fNE = InterpolatePixelValue(pBitmap, pMask, ptNE, true);
-	bsg.fSE = InterpolatePixelValue(pBitmap, pMask, ptSE, true);
+	bsg.fNW = InterpolatePixelValue(pixels, ptNW, true);
+	bsg.fSW = InterpolatePixelValue(pixels, ptSW, true);
+	bsg.fNE = InterpolatePixelValue(pixels, ptNE, true);
+	bsg.fSE = InterpolatePixelValue(pixels, ptSE, true);
 
 	double			fDiff = 0,
 					fDiffPercent = 0;
@@ -360,7 +327,7 @@ double	CDeBloom::ComputeStarGradient(CMemoryBitmap * pBitmap, C8BitGrayBitmap *
 
 const	double			NOEDGEANGLE = -1000.0;
 
-inline	double			GetEdgeAngle(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, double fX, double fY)
+inline	double			GetEdgeAngle(const CDeBloomPixels & pixels, double fX, double fY)
 {
 	double				fResult = NOEDGEANGLE;
 	double				fValue[8];
@@ -372,14 +339,14 @@ inline	double			GetEdgeAngle(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, d
 	//
 	//     5    6    7
 
-	fValue[0] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX-1.0, fY-1.0), true);
-	fValue[1] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX    , fY-1.0), true);
-	fValue[2] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX+1.0, fY-1.0), true);
-	fValue[3] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX-1.0, fY    ), true);
-	fValue[4] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX+1.0, fY    ), true);
-	fValue[5] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX-1.0, fY+1.0), true);
-	fValue[6] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX    , fY+1.0), true);
-	fValue[7] = InterpolatePixelValue(pBitmap, pMask, QPointF(fX+1.0, fY+1.0), true);
+	fValue[0] = InterpolatePixelValue(pixels, QPointF(fX-1.0, fY-1.0), true);
+	fValue[1] = InterpolatePixelValue(pixels, QPointF(fX    , fY-1.0), true);
+	fValue[2] = InterpolatePixelValue(pixels, QPointF(fX+1.0, fY-1.0), true);
+	fValue[3] = InterpolatePixelValue(pixels, QPointF(fX-1.0, fY    ), true);
+	fValue[4] = InterpolatePixelValue(pixels, QPointF(fX+1.0, fY    ), true);
+	fValue[5] = InterpolatePixelValue(pixels, QPointF(fX-1.0, fY+1.0), true);
+	fValue[6] = InterpolatePixelValue(pixels, QPointF(fX    , fY+1.0), true);
+	fValue[7] = InterpolatePixelValue(pixels, QPointF(fX+1.0, fY+1.0), true);
 
 	for (int i = 0;i<8 && bOk;i++)
 		bOk = (fValue[i]>0);
@@ -417,7 +384,7 @@ inline double NormalizeAngle(double fAngle)
 	return fAngle;
 };
 
-void	CDeBloom::RefineStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs)
+void	CDeBloom::RefineStarCenter(const CDeBloomPixels & pixels, CBloomedStar & bs) const
 {
 	double				fMinimum = NOEDGEANGLE;
 	double fdX = 0;
@@ -433,9 +400,7 @@ void	CDeBloom::RefineStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask
 
 	for (int i = floor(fX+0.5);i>=std::max(0.0, floor(fX+0.5-bs.m_fRadius*2.0)) && !bLeftBloomed;i--)
 	{
-		double			fMask;
-
-		pMask->GetPixel(i, floor(fY+0.5), fMask);
+		const double	fMask = pixels.GetMask(i, floor(fY+0.5));
 		if (IsBloomedBorderValue(fMask))
 			bBloomCross = true;
 		else if (bBloomCross && IsBloomedValue(fMask))
@@ -445,9 +410,7 @@ void	CDeBloom::RefineStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask
 	bBloomCross = false;
 	for (int i = floor(fX+0.5);i<=std::min(static_cast<double>(m_lWidth-1), floor(fX+0.5+bs.m_fRadius*2.0)) && !bRightBloomed;i++)
 	{
-		double			fMask;
-
-		pMask->GetPixel(i, floor(fY+0.5), fMask);
+		const double	fMask = pixels.GetMask(i, floor(fY+0.5));
 		if (IsBloomedBorderValue(fMask))
 			bBloomCross = true;
 		else if (bBloomCross && IsBloomedValue(fMask))
@@ -470,10 +433,10 @@ void	CDeBloom::RefineStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask
 			double			fValueL2,
 							fValueR2;
 
-			fValueL1 = InterpolatePixelValue(pBitmap, pMask, QPointF(fX-fDistance+fndX, fY), true);
-			fValueL2 = InterpolatePixelValue(pBitmap, pMask, QPointF(fX-fDistance-1+fndX, fY), true);
-			fValueR1 = InterpolatePixelValue(pBitmap, pMask, QPointF(fX+fDistance+fndX, fY), true);
-			fValueR2 = InterpolatePixelValue(pBitmap, pMask, QPointF(fX+fDistance+1+fndX, fY), true);
+			fValueL1 = InterpolatePixelValue(pixels, QPointF(fX-fDistance+fndX, fY), true);
+			fValueL2 = InterpolatePixelValue(pixels, QPointF(fX-fDistance-1+fndX, fY), true);
+			fValueR1 = InterpolatePixelValue(pixels, QPointF(fX+fDistance+fndX, fY), true);
+			fValueR2 = InterpolatePixelValue(pixels, QPointF(fX+fDistance+1+fndX, fY), true);
 
 			if  (fValueL1>0 && fValueL2>0 && fValueR1>0 && fValueR2>0 &&
 				 fValueL1>fValueL2 && fValueR1>fValueR2)
@@ -521,7 +484,7 @@ void	CDeBloom::RefineStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask
 
 /* ------------------------------------------------------------------- */
 
-void	CDeBloom::RefineStarCenter2(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs)
+void	CDeBloom::RefineStarCenter2(const CDeBloomPixels & pixels, CBloomedStar & bs) const
 {
 	CBloomedStarGradient	bsg,
 							bsgn;
@@ -541,7 +504,7 @@ void	CDeBloom::RefineStarCenter2(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 
 			double		fGradient;
 
-			fGradient = ComputeStarGradient(pBitmap, pMask, bsgn, fRadius);
+			fGradient = ComputeStarGradient(pixels, bsgn, fRadius);
 			if (fGradient>0 && (fGradient<fMinimum || fMinimum<0))
 			{
 				bsg = bsgn;
@@ -556,22 +519,19 @@ void	CDeBloom::RefineStarCenter2(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 
 /* ------------------------------------------------------------------- */
 
-void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs)
+void	CDeBloom::ComputeStarCenter(const CDeBloomPixels & pixels, CBloomedStar & bs, std::vector<double> & vYCenters) const
 {
 	int				i;
 	double				//fAverageX = 0,
 						fdAverageY = 0;
-	std::vector<double>	vValues;
 	double				fRadius;
 	double				fX = bs.m_ptStar.x();
 	double				fY = bs.m_ptStar.y();
 
 
 	fRadius=bs.m_fRadius;
-	vValues.reserve(fRadius*2+1);
 
-
-	std::vector<double>	vYCenters;
+	vYCenters.clear();
 
 	for (i = std::max(0.0, fX-fRadius-0.5);i<=std::min(static_cast<double>(m_lWidth-1), fX+fRadius+0.5);i++)
 	{
@@ -580,12 +540,11 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 		double			fdYMaximum = -1.0;
 		double			fdY;
 
-		vValues.clear();
 		for (fdY = -fRadius;fdY<=fRadius && !bBloomed;fdY+=0.1)
 		{
 			double			fValue;
 
-			fValue = InterpolatePixelValue(pBitmap, pMask, QPointF(i, fY+fdY), true);
+			fValue = InterpolatePixelValue(pixels, QPointF(i, fY+fdY), true);
 
 			if (fValue>0)
 			{
@@ -606,7 +565,7 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 
 	bs.m_ptStar.ry() += fdAverageY;
 
-	RefineStarCenter(pBitmap, pMask, bs);
+	RefineStarCenter(pixels, bs);
 
 	fX = bs.m_ptStar.x();
 	fY = bs.m_ptStar.y();
@@ -651,8 +610,8 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 		x1L = fX-i;
 		x1R = fX+i;
 
-		fValueL1 = InterpolatePixelValue(pBitmap, pMask, QPointF(std::max(0.0, x1L), fY), true)-m_fBackground;
-		fValueR1 = InterpolatePixelValue(pBitmap, pMask, QPointF(std::max(0.0, x1R), fY), true)-m_fBackground;
+		fValueL1 = InterpolatePixelValue(pixels, QPointF(std::max(0.0, x1L), fY), true)-m_fBackground;
+		fValueR1 = InterpolatePixelValue(pixels, QPointF(std::max(0.0, x1R), fY), true)-m_fBackground;
 
 		if (fValueL1 > 0 && fValueR1 > 0)
 		{
@@ -662,8 +621,8 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 			x2L = x1L-1.0;
 			x2R = x1R+1.0;
 
-			fValueL2 = InterpolatePixelValue(pBitmap, pMask, QPointF(std::max(0.0, x2L), fY), true)-m_fBackground;
-			fValueR2 = InterpolatePixelValue(pBitmap, pMask, QPointF(std::max(0.0, x2R), fY), true)-m_fBackground;
+			fValueL2 = InterpolatePixelValue(pixels, QPointF(std::max(0.0, x2L), fY), true)-m_fBackground;
+			fValueR2 = InterpolatePixelValue(pixels, QPointF(std::max(0.0, x2R), fY), true)-m_fBackground;
 
 			if (fValueL2>0 && fValueR2>0 && (fValueL1>fValueL2) && (fValueR1>fValueR2))
 			{
@@ -689,16 +648,9 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 		};
 	};
 
-	std::vector<double>			vAngles;
-
-	vAngles.push_back(0);
-	vAngles.push_back(45);
-	vAngles.push_back(135);
-	vAngles.push_back(180);
-	vAngles.push_back(225);
-	vAngles.push_back(315);
+	constexpr double			vAngles[] = { 0, 45, 135, 180, 225, 315 };
 
-	for (int a = 0;a<vAngles.size();a++)
+	for (int a = 0;a<std::size(vAngles);a++)
 	{
 		bFound = false;
 		for (i = 1;i<=fRadius*2.0 && !bFound;i++)
@@ -713,8 +665,8 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 			pt2.rx() = fX + (double)(i+1)*cos(vAngles[a]*M_PI/180.0);
 			pt2.ry() = fY + (double)(i+1)*sin(vAngles[a]*M_PI/180.0);
 
-			fValue1 = InterpolatePixelValue(pBitmap, pMask, pt1, true)-m_fBackground;
-			fValue2 = InterpolatePixelValue(pBitmap, pMask, pt2, true)-m_fBackground;
+			fValue1 = InterpolatePixelValue(pixels, pt1, true)-m_fBackground;
+			fValue2 = InterpolatePixelValue(pixels, pt2, true)-m_fBackground;
 
 			if (fValue1 > 0 && fValue2 > 0 && fValue1 > fValue2)
 			{
@@ -744,16 +696,16 @@ void	CDeBloom::ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 
 /* ------------------------------------------------------------------- */
 
-void	CDeBloom::MarkBloomBorder(CMemoryBitmap * pMask, int x, int y, std::vector<QPointF> & vBorders)
+void	CDeBloom::MarkBloomBorder(CDeBloomPixels & pixels, int x, int y, std::vector<QPointF> & vBorders) const
 {
 	double						fMask;
 
 	if (x>=0 && x<m_lWidth && y>=0 && y<m_lHeight)
 	{
-		pMask->GetPixel(x, y, fMask);
+		fMask = pixels.GetMask(x, y);
 		if (fMask<100)
 		{
-			pMask->SetPixel(x, y, 140.0);
+			pixels.SetMask(x, y, 140.0);
 			vBorders.push_back(QPointF(x, y));
 		};
 	};
@@ -761,38 +713,30 @@ void	CDeBloom::MarkBloomBorder(CMemoryBitmap * pMask, int x, int y, std::vector<
 
 /* ------------------------------------------------------------------- */
 
-void	CDeBloom::MarkBorderAsBloomed(CMemoryBitmap * pMask, int x, int y, std::vector<QPoint> & vBloomed)
+void	CDeBloom::MarkBorderAsBloomed(CDeBloomPixels & pixels, int x, int y, std::vector<QPoint> & vBloomed) const
 {
 	if (x>=0 && x<m_lWidth && y>=0 && y<m_lHeight)
 	{
 		bool					bBloomed = true;
-		std::vector<QPointF>	vTests;
-
-		vTests.emplace_back(x - 1, y - 1);
-		vTests.emplace_back(x - 1, y - 0);
-		vTests.emplace_back(x - 1, y + 1);
-		vTests.emplace_back(x - 0, y - 1);
-		vTests.emplace_back(x - 0, y + 1);
-		vTests.emplace_back(x + 1, y - 1);
-		vTests.emplace_back(x + 1, y - 0);
-		vTests.emplace_back(x + 1, y + 1);
-
-		for (int i = 0;i<vTests.size() && bBloomed;i++)
+		const QPoint			vTests[] = {
+			{ x - 1, y - 1 }, { x - 1, y - 0 }, { x - 1, y + 1 },
+			{ x - 0, y - 1 }, { x - 0, y + 1 },
+			{ x + 1, y - 1 }, { x + 1, y - 0 }, { x + 1, y + 1 }
+		};
+
+		for (int i = 0;i<std::size(vTests) && bBloomed;i++)
 		{
 			//
 			// Don't attempt to check Pixel values that are out of bounds
 			//
 			if (false == (vTests[i].x() >= 0 && vTests[i].x() < m_lWidth && vTests[i].y() >= 0 && vTests[i].y() < m_lHeight))
 				continue;
-			double				fMask;
-
-			pMask->GetPixel(vTests[i].x(), vTests[i].y(), fMask);
-			bBloomed = fMask>0;
+			bBloomed = pixels.GetMask(vTests[i].x(), vTests[i].y())>0;
 		};
 
 		if (bBloomed)
 		{
-			pMask->SetPixel(x, y, 255.0);
+			pixels.SetMask(x, y, 255.0);
 			vBloomed.emplace_back(x, y);
 		};
 	};
@@ -800,16 +744,17 @@ void	CDeBloom::MarkBorderAsBloomed(CMemoryBitmap * pMask, int x, int y, std::vec
 
 /* ------------------------------------------------------------------- */
 
-void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, int x, int y)
+void	CDeBloom::ExpandBloomedArea(CDeBloomPixels & pixels, int x, int y)
 {
 	bool bEnd = false;
-	std::vector<QPoint>	vBloomed;
+	std::vector<QPoint>&	vBloomed = m_vBloomedScratch;
 	int	lLargestY = y;
 	int	lTopY = 0;
 	int	lLargestWidth = 0;
 	int	lBloomHeight = 0;
 	CBloomedStar bs;
 
+	vBloomed.clear();
 	// Since it started at the bottom the bloomed are can only go up...well normally
 	// So go down a little to get everything that is above 90% of the threshold
 	do
@@ -820,8 +765,8 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 		bEnd = true;
 		if (y<m_lHeight-1)
 		{
-			pBitmap->GetPixel(x, y+1, fGray);
-			pMask->GetPixel(x, y+1, fMask);
+			fGray = pixels.GetPixel(x, y+1);
+			fMask = pixels.GetMask(x, y+1);
 
 			if ((fGray >= 256.0*m_fBloomThreshold*0.90) &&
 				!IsBloomedValue(fMask) && !IsBloomedBorderValue(fMask))
@@ -849,10 +794,10 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 		// Expand horizontally to the left
 		for (int i = x;i>=0 && !bEndRow;i--)
 		{
-			pBitmap->GetPixel(i, j, fGray);
+			fGray = pixels.GetPixel(i, j);
 			if (fGray >= 256.0*m_fBloomThreshold*0.90)
 			{
-				pMask->GetPixel(i, j, fMask);
+				fMask = pixels.GetMask(i, j);
 				if (!IsBloomedValue(fMask))
 				{
 					lMinX = i;
@@ -869,10 +814,10 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 		bEndRow = false;
 		for (int i = x;i<m_lWidth && !bEndRow;i++)
 		{
-			pBitmap->GetPixel(i, j, fGray);
+			fGray = pixels.GetPixel(i, j);
 			if (fGray >= 256.0*m_fBloomThreshold*0.90)
 			{
-				pMask->GetPixel(i, j, fMask);
+				fMask = pixels.GetMask(i, j);
 				if (!IsBloomedValue(fMask))
 				{
 					lMaxX = i;
@@ -895,21 +840,20 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 			// Check one pixel to the left to expand the mask (edge condition)
 			if (!bEndLeft && lMinX>1)
 			{
-				if (IsLeftEdge(pBitmap, lMinX, j))
+				if (IsLeftEdge(pixels, lMinX, j))
 					lMinX--;
 			};
 
 			// Check one pixel to the right to expand the mask
 			if (!bEndRight && lMaxX<m_lWidth-2)
 			{
-				if (IsRightEdge(pBitmap, lMaxX, j))
+				if (IsRightEdge(pixels, lMaxX, j))
 					lMaxX++;
 			};
 
-			vBloomed.reserve(vBloomed.size()+lMaxX-lMinX+1);
 			for (int i = lMinX;i<=lMaxX;i++)
 			{
-				pMask->SetPixel(i, j, 255.0);
+				pixels.SetMask(i, j, 255.0);
 				vBloomed.emplace_back(i, j);
 			};
 
@@ -920,9 +864,9 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 
 				for (int i = lMinX;i<=lMaxX;i++)
 				{
-					if (IsBottomEdge(pBitmap, i, j))
+					if (IsBottomEdge(pixels, i, j))
 					{
-						pMask->SetPixel(i, j+1, 255.0);
+						pixels.SetMask(i, j+1, 255.0);
 						vBloomed.emplace_back(i, j+1);
 						bExtraHeight=true;
 					};
@@ -944,9 +888,9 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 	// Try to expand one pixel to the top
 	if (lTopY > 1)
 	{
-		if (IsTopEdge(pBitmap, x, lTopY))
+		if (IsTopEdge(pixels, x, lTopY))
 		{
-			pMask->SetPixel(x, lTopY-1, 255.0);
+			pixels.SetMask(x, lTopY-1, 255.0);
 			vBloomed.emplace_back(x, lTopY-1);
 			lBloomHeight++;
 			lTopY--;
@@ -957,36 +901,38 @@ void	CDeBloom::ExpandBloomedArea(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMas
 	{
 		// Mark the possible star
 		double					fRadius = lLargestWidth/2.0+3.0;
-		std::vector<QPointF>	vBorders;
+		std::vector<QPointF>&	vBorders = m_vBordersScratch;
+
+		vBorders.clear();
 
 		//ComputeStarCenter(ptStar.X, ptStar.Y, fRadius);
 
 		// Mark bloom area borders
 		for (int i = 0;i<vBloomed.size();i++)
 		{
-			MarkBloomBorder(pMask, vBloomed[i].x()-1, vBloomed[i].y()-1, vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()  , vBloomed[i].y()-1, vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()+1, vBloomed[i].y()-1, vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()-1, vBloomed[i].y()  , vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()+1, vBloomed[i].y()  , vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()-1, vBloomed[i].y()+1, vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()  , vBloomed[i].y()+1, vBorders);
-			MarkBloomBorder(pMask, vBloomed[i].x()+1, vBloomed[i].y()+1, vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()-1, vBloomed[i].y()-1, vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()  , vBloomed[i].y()-1, vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()+1, vBloomed[i].y()-1, vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()-1, vBloomed[i].y()  , vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()+1, vBloomed[i].y()  , vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()-1, vBloomed[i].y()+1, vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()  , vBloomed[i].y()+1, vBorders);
+			MarkBloomBorder(pixels, vBloomed[i].x()+1, vBloomed[i].y()+1, vBorders);
 		};
 
 		// And mark lonely borders as bloomed
 		for (int i = 0;i<vBorders.size();i++)
-			MarkBorderAsBloomed(pMask, vBorders[i].x(), vBorders[i].y(), vBloomed);
+			MarkBorderAsBloomed(pixels, vBorders[i].x(), vBorders[i].y(), vBloomed);
 
 		bs.m_fRadius = fRadius;
 		bs.m_vBloomed  = vBloomed;
-		m_vBloomedStars.push_back(bs);
+		m_vBloomedStars.push_back(std::move(bs));
 	}
 	else
 	{
 		// Reset the bloomed area
 		for (int i = 0;i<vBloomed.size();i++)
-			pMask->SetPixel(vBloomed[i].x(), vBloomed[i].y(), 0.0);
+			pixels.SetMask(vBloomed[i].x(), vBloomed[i].y(), 0.0);
 	}
 }
 
@@ -1005,6 +951,8 @@ std::shared_ptr<C8BitGrayBitmap> CDeBloom::CreateMask(CMemoryBitmap* pBitmap)
 
 		m_fBackground = ComputeBackgroundValue(pBitmap);
 
+		CDeBloomPixels		pixels{ pBitmap, pMask.get() };
+
 		if (m_pProgress != nullptr)
 			m_pProgress->Start2(m_lHeight);
 
@@ -1016,12 +964,12 @@ std::shared_ptr<C8BitGrayBitmap> CDeBloom::CreateMask(CMemoryBitmap* pBitmap)
 				double				fGray;
 				double				fMask;
 
-				pBitmap->GetPixel(i, j, fGray);
+				fGray = pixels.GetPixel(i, j);
 				if (fGray >= 256.0*m_fBloomThreshold)
 				{
-					pMask->GetPixel(i, j, fMask);
+					fMask = pixels.GetMask(i, j);
 					if (!IsBloomedValue(fMask))
-						ExpandBloomedArea(pBitmap, pMask.get(), i, j);
+						ExpandBloomedArea(pixels, i, j);
 				}
 			}
 			if (m_pProgress != nullptr)
@@ -1030,6 +978,9 @@ std::shared_ptr<C8BitGrayBitmap> CDeBloom::CreateMask(CMemoryBitmap* pBitmap)
 
 		if (m_pProgress != nullptr)
 			m_pProgress->End2();
+
+		m_vBloomedScratch = std::vector<QPoint>{};
+		m_vBordersScratch = std::vector<QPointF>{};
 	}
 
 #ifdef DEBUGDEBLOOM
@@ -1041,7 +992,7 @@ std::shared_ptr<C8BitGrayBitmap> CDeBloom::CreateMask(CMemoryBitmap* pBitmap)
 }
 
 
-double CDeBloom::ComputeValue(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask, int x, int y, bool& bDone)
+double CDeBloom::ComputeValue(const CDeBloomPixels& pixels, int x, int y, bool& bDone) const
 {
 	double						fResult = 255.0;
 	double						fSum = 0,
@@ -1052,15 +1003,12 @@ double CDeBloom::ComputeValue(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask, in
 	{
 		for (int j = std::max(0, y-3);j<=std::min(m_lHeight-1, y+3);j++)
 		{
-			double				fValue,
-								fMask;
+			const double		fMask = pixels.GetMask(i, j);
 
-			pMask->GetPixel(i, j, fMask);
 			if (!IsBloomedValue(fMask) && !IsBloomedBorderValue(fMask))
 			{
 				double			fDistance = 1.0/(1.0+(double)fabs((double)i-x)+(j-y)*(j-y));
-
-				pBitmap->GetPixel(i, j, fValue);
+				const double	fValue = pixels.GetPixel(i, j);
 				fSum += fValue*fDistance;
 				fWeight += fDistance;
 			};
@@ -1078,7 +1026,7 @@ double CDeBloom::ComputeValue(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask, in
 
 /* ------------------------------------------------------------------- */
 
-void	CDeBloom::AddStar(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs)
+void	CDeBloom::AddStar(CDeBloomPixels & pixels, const CBloomedStar & bs) const
 {
 	double					fFactor1;
 
@@ -1091,7 +1039,7 @@ void	CDeBloom::AddStar(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloome
 						fValue3,
 						fValue4;
 
-		pMask->GetPixel(bs.m_vBloomed[i].x(), bs.m_vBloomed[i].y(), fMask);
+		fMask = pixels.GetMask(bs.m_vBloomed[i].x(), bs.m_vBloomed[i].y());
 		if (IsBloomedValue(fMask))
 		{
 			double		fDistance,
@@ -1101,8 +1049,8 @@ void	CDeBloom::AddStar(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloome
 
 			fDistance = distance(pt.x(), pt.y(), bs.m_ptStar.x(), bs.m_ptStar.y());
 
-			fValue3 = InterpolatePixelValue(pBitmap, pMask, QPointF(bs.m_ptStar.x()-fDistance, bs.m_ptStar.y()), true);
-			fValue4 = InterpolatePixelValue(pBitmap, pMask, QPointF(bs.m_ptStar.x()+fDistance, bs.m_ptStar.y()), true);
+			fValue3 = InterpolatePixelValue(pixels, QPointF(bs.m_ptStar.x()-fDistance, bs.m_ptStar.y()), true);
+			fValue4 = InterpolatePixelValue(pixels, QPointF(bs.m_ptStar.x()+fDistance, bs.m_ptStar.y()), true);
 
 			if (fValue3 > 0 && fValue4 > 0)
 				fAverage = std::min(fValue3,fValue4);
@@ -1132,7 +1080,7 @@ void	CDeBloom::AddStar(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloome
 			//fValue1 = m_fBackground + exp(-(fDistance * fDistance)/fFactor1)*bs.m_fBloom;
 			//fValue2 = m_fBackground + exp(-(fDistance * fDistance)/fFactor2)*bs.m_fBloom2;
 
-			pBitmap->GetPixel(bs.m_vBloomed[i].x(), bs.m_vBloomed[i].y(), fBaseValue);
+			fBaseValue = pixels.GetPixel(bs.m_vBloomed[i].x(), bs.m_vBloomed[i].y());
 
 			fValue = fBaseValue;
 			if (fAverage>0 && fBloomValue>0)
@@ -1147,42 +1095,39 @@ void	CDeBloom::AddStar(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloome
 				fValue = fValue*(1.0-fRatio)+fAverage*fRatio;
 			};*/
 
-			pBitmap->SetPixel(bs.m_vBloomed[i].x(), bs.m_vBloomed[i].y(), std::min(255.0, fValue));
+			pixels.SetPixel(bs.m_vBloomed[i].x(), bs.m_vBloomed[i].y(), std::min(255.0, fValue));
 		};
 	};
 };
 
 /* ------------------------------------------------------------------- */
 
-void    CDeBloom::SmoothMaskBorders(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask)
+void    CDeBloom::SmoothMaskBorders(CDeBloomPixels & pixels) const
 {
-	std::vector<double>		vValues;
-
-	vValues.resize(8);
+	std::vector<double>		vValues(8);
 
 	for (int i = 1;i<m_lWidth-1;i++)
 	{
 		for (int j = 1;j<m_lHeight-1;j++)
 		{
-			double				fMask;
+			const double		fMask = pixels.GetMask(i, j);
 
-			pMask->GetPixel(i, j, fMask);
 			if (IsBloomedBorderValue(fMask))
 			{
 				// Interpolate pixel
 				double			fValue;
 
-				pBitmap->GetPixel(i-1, j-1, vValues[0]);
-				pBitmap->GetPixel(i-0, j-1, vValues[1]);
-				pBitmap->GetPixel(i+1, j-1, vValues[2]);
-				pBitmap->GetPixel(i-1, j-0, vValues[3]);
-				pBitmap->GetPixel(i+1, j-0, vValues[4]);
-				pBitmap->GetPixel(i-1, j+1, vValues[5]);
-				pBitmap->GetPixel(i-0, j+1, vValues[6]);
-				pBitmap->GetPixel(i+1, j+1, vValues[7]);
+				vValues[0] = pixels.GetPixel(i-1, j-1);
+				vValues[1] = pixels.GetPixel(i-0, j-1);
+				vValues[2] = pixels.GetPixel(i+1, j-1);
+				vValues[3] = pixels.GetPixel(i-1, j-0);
+				vValues[4] = pixels.GetPixel(i+1, j-0);
+				vValues[5] = pixels.GetPixel(i-1, j+1);
+				vValues[6] = pixels.GetPixel(i-0, j+1);
+				vValues[7] = pixels.GetPixel(i+1, j+1);
 
 				fValue = Median(vValues);
-				pBitmap->SetPixel(i, j, fValue);
+				pixels.SetPixel(i, j, fValue);
 			}
 		}
 	}
@@ -1203,30 +1148,145 @@ double CDeBloom::ComputeBackgroundValue(CMemoryBitmap* pBitmap)
 }
 
 
+//
+// One pass of the filling of the bloomed pixels.
+// The values only come from pixels that are neither bloomed nor border pixels, and the pixels set here stay bloomed
+// in the mask during the pass, so the points can be computed in any order.
+//
+void CDeBloom::ComputeValues(CDeBloomPixels& pixels, const std::vector<QPoint>& vToProcess, std::vector<QPoint>& vProcessed, std::vector<QPoint>& vUnprocessed) const
+{
+	const int nrPoints = static_cast<int>(vToProcess.size());
+	std::atomic_int loopCtr = 0;
+
+#pragma omp parallel default(none) shared(pixels, vToProcess, vProcessed, vUnprocessed, loopCtr) firstprivate(nrPoints) if(CMultitask::GetNrProcessors() > 1)
+	{
+		std::vector<QPoint> vLocalProcessed;
+		std::vector<QPoint> vLocalUnprocessed;
+
+#pragma omp for schedule(dynamic, 1000) nowait
+		for (int i = 0; i < nrPoints; i++)
+		{
+			const QPoint& point = vToProcess[i];
+			bool bDone;
+			const double fValue = ComputeValue(pixels, point.x(), point.y(), bDone);
+
+			if (bDone)
+			{
+				pixels.SetPixel(point.x(), point.y(), fValue);
+				vLocalProcessed.push_back(point);
+			}
+			else
+			{
+				// the coordinates so that they can be processed later on
+				vLocalUnprocessed.push_back(point);
+			}
+
+			++loopCtr;
+			if (m_pProgress != nullptr && omp_get_thread_num() == 0 && (i % 1000) == 0)
+				m_pProgress->Progress2(loopCtr);
+		}
+
+#pragma omp critical(OmpLockDeBloomMerge)
+		{
+			vProcessed.insert(vProcessed.end(), vLocalProcessed.cbegin(), vLocalProcessed.cend());
+			vUnprocessed.insert(vUnprocessed.end(), vLocalUnprocessed.cbegin(), vLocalUnprocessed.cend());
+		}
+	}
+}
+
+//
+// Groups of bloomed stars sharing bloomed pixels (stars are expanded one pixel above and below the detected area,
+// without checking the other stars).
+// AddStar() only writes the pixels of its star and only reads the pixels that are not bloomed, so the groups are
+// independent. The stars of a group keep their order.
+//
+std::vector<std::vector<size_t>> CDeBloom::GroupOverlappingStars() const
+{
+	const size_t nrStars = m_vBloomedStars.size();
+	std::vector<size_t> vRoots(nrStars);
+	for (size_t star = 0; star < nrStars; star++)
+		vRoots[star] = star;
+
+	const auto findRoot = [&vRoots](size_t star) -> size_t
+	{
+		while (vRoots[star] != star)
+			star = vRoots[star] = vRoots[vRoots[star]];
+		return star;
+	};
+
+	// Pixel offset and star of all the bloomed pixels, sorted by offset: identical offsets are shared pixels.
+	std::vector<std::pair<size_t, size_t>> vOwners;
+	size_t nrPixels = 0;
+	for (const CBloomedStar& bs : m_vBloomedStars)
+		nrPixels += bs.m_vBloomed.size();
+	vOwners.reserve(nrPixels);
+	for (size_t star = 0; star < nrStars; star++)
+		for (const QPoint& point : m_vBloomedStars[star].m_vBloomed)
+			vOwners.emplace_back(static_cast<size_t>(m_lWidth) * point.y() + point.x(), star);
+	std::ranges::sort(vOwners);
+
+	for (size_t i = 1; i < vOwners.size(); i++)
+	{
+		if (vOwners[i].first == vOwners[i - 1].first)
+		{
+			const size_t root1 = findRoot(vOwners[i - 1].second);
+			const size_t root2 = findRoot(vOwners[i].second);
+			if (root1 != root2)
+				vRoots[std::max(root1, root2)] = std::min(root1, root2);
+		}
+	}
+
+	std::vector<std::vector<size_t>> vGroups;
+	std::vector<size_t> vGroupOfRoot(nrStars, std::numeric_limits<size_t>::max());
+	for (size_t star = 0; star < nrStars; star++)
+	{
+		size_t& group = vGroupOfRoot[findRoot(star)];
+		if (group == std::numeric_limits<size_t>::max())
+		{
+			group = vGroups.size();
+			vGroups.emplace_back();
+		}
+		vGroups[group].push_back(star);
+	}
+
+	return vGroups;
+}
+
+
 void CDeBloom::DeBloom(CMemoryBitmap* pBitmap, std::shared_ptr<C8BitGrayBitmap> pMask)
 {
 	ZFUNCTRACE_RUNTIME();
 	// First compute background value
 	m_fBackground = ComputeBackgroundValue(pBitmap);
 
+	CDeBloomPixels pixels{ pBitmap, pMask.get() };
+	const int nrStars = static_cast<int>(m_vBloomedStars.size());
+
 	{
 		if (m_pProgress != nullptr)
-			m_pProgress->Start2(static_cast<int>(m_vBloomedStars.size()));
+			m_pProgress->Start2(nrStars);
 
-		for (size_t i = 0; i < m_vBloomedStars.size(); i++)
+		// The star centers only read the image and the mask.
+		std::atomic_int loopCtr = 0;
+#pragma omp parallel default(none) shared(pixels, loopCtr) firstprivate(nrStars) if(CMultitask::GetNrProcessors() > 1)
 		{
-			if (m_pProgress != nullptr)
-				m_pProgress->Progress2(static_cast<int>(i) + 1);
-			ComputeStarCenter(pBitmap, pMask.get(), m_vBloomedStars[i]);
+			std::vector<double> vYCenters;
+
+#pragma omp for schedule(dynamic, 1)
+			for (int i = 0; i < nrStars; i++)
+			{
+				ComputeStarCenter(pixels, m_vBloomedStars[i], vYCenters);
+				++loopCtr;
+				if (m_pProgress != nullptr && omp_get_thread_num() == 0)
+					m_pProgress->Progress2(loopCtr);
+			}
 		}
 
 		if (m_pProgress != nullptr)
 			m_pProgress->End2();
 	}
 
-	if (m_pProgress != nullptr)
-		m_pProgress->Start2(m_lWidth);
-
+	std::vector<QPoint> vToProcess;
 	std::vector<QPoint> vUnprocessed;
 	std::vector<QPoint> vProcessed;
 
@@ -1234,33 +1294,18 @@ void CDeBloom::DeBloom(CMemoryBitmap* pBitmap, std::shared_ptr<C8BitGrayBitmap>
 	{
 		for (int j = 0; j < m_lHeight; j++)
 		{
-			double fMask;
-			pMask->GetPixel(i, j, fMask);
-			if (IsBloomedValue(fMask))
-			{
-				double fValue;
-				bool bDone;
-
-				fValue = ComputeValue(pBitmap, pMask.get(), i, j, bDone);
-
-				if (bDone)
-				{
-					pBitmap->SetPixel(i, j, fValue);
-					vProcessed.emplace_back(i, j);
-				}
-				else
-				{
-					// the coordinates so that they can be processed later on
-					vUnprocessed.emplace_back(i, j);
-				}
-			}
+			if (IsBloomedValue(pixels.GetMask(i, j)))
+				vToProcess.emplace_back(i, j);
 		}
-		if (m_pProgress != nullptr)
-			m_pProgress->Progress2(i+1);
 	}
 
+	if (m_pProgress != nullptr)
+		m_pProgress->Start2(static_cast<int>(vToProcess.size()));
+
+	ComputeValues(pixels, vToProcess, vProcessed, vUnprocessed);
+
 	// Process recursively unprocessed
-	int					lNrUnprocessed = 0;
+	size_t				lNrUnprocessed = 0;
 
 	if (vUnprocessed.size())
 	{
@@ -1268,40 +1313,21 @@ void CDeBloom::DeBloom(CMemoryBitmap* pBitmap, std::shared_ptr<C8BitGrayBitmap>
 
 		while (vUnprocessed.size() && (vUnprocessed.size() != lNrUnprocessed))
 		{
-			for (int i = 0;i<vNewlyProcessed.size();i++)
-				pMask->SetPixel(vNewlyProcessed[i].x(), vNewlyProcessed[i].y(), 190.0);
+			for (const QPoint& point : vNewlyProcessed)
+				pixels.SetMask(point.x(), point.y(), 190.0);
 			vNewlyProcessed.clear();
 
-			lNrUnprocessed = (int)vUnprocessed.size();
-
-			std::vector<QPoint>			vToProcess = vUnprocessed;
+			lNrUnprocessed = vUnprocessed.size();
 
+			vToProcess.swap(vUnprocessed);
 			vUnprocessed.clear();
 
-			for (int i = 0;i<vToProcess.size();i++)
-			{
-				double				fValue;
-				bool				bDone;
-
-				fValue = ComputeValue(pBitmap, pMask.get(), vToProcess[i].x(), vToProcess[i].y(), bDone);
-
-				if (bDone)
-				{
-					pBitmap->SetPixel(vToProcess[i].x(), vToProcess[i].y(), fValue);
-					vProcessed.push_back(vToProcess[i]);
-					vNewlyProcessed.push_back(vToProcess[i]);
-				}
-				else
-				{
-					// the coordinates so that they can be processed later on
-					vUnprocessed.push_back(vToProcess[i]);
-				}
-			}
+			ComputeValues(pixels, vToProcess, vNewlyProcessed, vUnprocessed);
+			vProcessed.insert(vProcessed.end(), vNewlyProcessed.cbegin(), vNewlyProcessed.cend());
 		}
 
-		//for (int i = 0; i < vProcessed.size(); i++)
 		for (const QPoint& point : vProcessed)
-			pMask->SetPixel(point.x(), point.y(), 255.0);
+			pixels.SetMask(point.x(), point.y(), 255.0);
 	}
 
 	if (m_pProgress != nullptr)
@@ -1311,12 +1337,18 @@ void CDeBloom::DeBloom(CMemoryBitmap* pBitmap, std::shared_ptr<C8BitGrayBitmap>
 	WriteTIFF("E:\\BloomImage_Step1.tif", pBitmap, nullptr, nullptr);
 #endif
 
-	for (int i = 0;i<m_vBloomedStars.size();i++)
+	const std::vector<std::vector<size_t>> vGroups = GroupOverlappingStars();
+	const int nrGroups = static_cast<int>(vGroups.size());
+
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(pixels, vGroups) firstprivate(nrGroups) if(CMultitask::GetNrProcessors() > 1)
+	for (int group = 0; group < nrGroups; group++)
 	{
-		AddStar(pBitmap, pMask.get(), m_vBloomedStars[i]);
+		for (const size_t star : vGroups[group])
+			AddStar(pixels, m_vBloomedStars[star]);
 	}
 
-	SmoothMaskBorders(pBitmap, pMask.get());
+	// Serial: each border pixel uses the already smoothed pixels at its left and above.
+	SmoothMaskBorders(pixels);
 #ifdef DEBUGDEBLOOM
 	WriteTIFF("E:\\BloomImage_Step2.tif", pBitmap, nullptr, nullptr);
 #endif
@@ -154,6 +154,91 @@ public:
 	};
 };
 
+/* ------------------------------------------------------------------- */
+
+//
+// Pixels of the monochrome bitmap and of the bloom mask, read and written directly in their buffers.
+// Values have the scale of CMemoryBitmap::GetPixel() (0..256) and are clamped and truncated like SetPixel() does.
+// Bitmaps that are not a CGrayBitmapT fall back to the virtual GetPixel()/SetPixel().
+//
+class CDeBloomPixels
+{
+private:
+	enum class PixelType { Virtual, Byte, Word, DWord, Float, Double };
+
+	CMemoryBitmap* m_pBitmap;
+	std::uint8_t* m_pMask;
+	void* m_pPixels{ nullptr };
+	PixelType m_Type{ PixelType::Virtual };
+	int m_lWidth;
+	int m_lHeight;
+	double m_fMultiplier{ 1.0 };
+	double m_fClamp{ 0.0 };
+
+	template <class T>
+	bool InitPixels(const PixelType type);
+
+	size_t Offset(const int x, const int y) const
+	{
+		return static_cast<size_t>(m_lWidth) * static_cast<size_t>(y) + static_cast<size_t>(x);
+	}
+	template <class T>
+	double Get(const int x, const int y) const
+	{
+		return static_cast<const T*>(m_pPixels)[Offset(x, y)] / m_fMultiplier;
+	}
+	template <class T>
+	void Set(const int x, const int y, const double fValue) const
+	{
+		static_cast<T*>(m_pPixels)[Offset(x, y)] = static_cast<T>(std::clamp(fValue * m_fMultiplier, 0.0, m_fClamp));
+	}
+
+public:
+	CDeBloomPixels(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask);
+
+	int Width() const { return m_lWidth; }
+	int Height() const { return m_lHeight; }
+
+	double GetPixel(const int x, const int y) const
+	{
+		switch (m_Type)
+		{
+		case PixelType::Byte: return Get<std::uint8_t>(x, y);
+		case PixelType::Word: return Get<std::uint16_t>(x, y);
+		case PixelType::DWord: return Get<std::uint32_t>(x, y);
+		case PixelType::Float: return Get<float>(x, y);
+		case PixelType::Double: return Get<double>(x, y);
+		default:
+		{
+			double fValue;
+			m_pBitmap->GetPixel(x, y, fValue);
+			return fValue;
+		}
+		}
+	}
+	void SetPixel(const int x, const int y, const double fValue)
+	{
+		switch (m_Type)
+		{
+		case PixelType::Byte: Set<std::uint8_t>(x, y, fValue); break;
+		case PixelType::Word: Set<std::uint16_t>(x, y, fValue); break;
+		case PixelType::DWord: Set<std::uint32_t>(x, y, fValue); break;
+		case PixelType::Float: Set<float>(x, y, fValue); break;
+		case PixelType::Double: Set<double>(x, y, fValue); break;
+		default: m_pBitmap->SetPixel(x, y, fValue); break;
+		}
+	}
+
+	double GetMask(const int x, const int y) const
+	{
+		return m_pMask[Offset(x, y)];
+	}
+	void SetMask(const int x, const int y, const double fValue)
+	{
+		m_pMask[Offset(x, y)] = static_cast<std::uint8_t>(std::clamp(fValue, 0.0, 255.0));
+	}
+};
+
 /* ------------------------------------------------------------------- */
 namespace DSS { class ProgressBase; }
 class CMemoryBitmap;
@@ -161,34 +246,42 @@ class CDeBloom
 {
 private:
 	double m_fBloomThreshold;
-	BLOOMEDSTARVECTOR m_vBloomedStars;
-	int m_lWidth;
-	int m_lHeight;
-	std::shared_ptr<C8BitGrayBitmap> m_pMask;
 	DSS::ProgressBase* m_pProgress;
-	double m_fBackground;
 
-	bool	IsLeftEdge(CMemoryBitmap * pBitmap, int x, int y);
-	bool	IsRightEdge(CMemoryBitmap * pBitmap, int x, int y);
-	bool	IsTopEdge(CMemoryBitmap * pBitmap, int x, int y);
-	bool	IsBottomEdge(CMemoryBitmap * pBitmap, int x, int y);
+	// Scratch buffers of the mask creation, reused for all bloomed areas.
+	std::vector<QPoint> m_vBloomedScratch;
+	std::vector<QPointF> m_vBordersScratch;
 
-	void	ComputeStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs);
+	bool	IsLeftEdge(const CDeBloomPixels & pixels, int x, int y) const;
+	bool	IsRightEdge(const CDeBloomPixels & pixels, int x, int y) const;
+	bool	IsTopEdge(const CDeBloomPixels & pixels, int x, int y) const;
+	bool	IsBottomEdge(const CDeBloomPixels & pixels, int x, int y) const;
 
-	void	ExpandBloomedArea(CMemoryBitmap* pBitmap, C8BitGrayBitmap * pMask, int x, int y);
+	void	ExpandBloomedArea(CDeBloomPixels & pixels, int x, int y);
 	std::shared_ptr<C8BitGrayBitmap> CreateMask(CMemoryBitmap* pBitmap);
 
-	void	AddStar(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs);
-	double	ComputeValue(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, int x, int y, bool & bDone);
+	void	AddStar(CDeBloomPixels & pixels, const CBloomedStar & bs) const;
+	double	ComputeValue(const CDeBloomPixels & pixels, int x, int y, bool & bDone) const;
+	void	ComputeValues(CDeBloomPixels & pixels, const std::vector<QPoint> & vToProcess, std::vector<QPoint> & vProcessed, std::vector<QPoint> & vUnprocessed) const;
+	std::vector<std::vector<size_t>> GroupOverlappingStars() const;
 	void	DeBloom(CMemoryBitmap * pBitmap, std::shared_ptr<C8BitGrayBitmap> pMask);
-	void    SmoothMaskBorders(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask);
-	void	MarkBloomBorder(CMemoryBitmap * pMask, int x, int y, std::vector<QPointF> & vBorders);
-	void	MarkBorderAsBloomed(CMemoryBitmap * pMask, int x, int y, std::vector<QPoint> & vBloomed);
+	void    SmoothMaskBorders(CDeBloomPixels & pixels) const;
+	void	MarkBloomBorder(CDeBloomPixels & pixels, int x, int y, std::vector<QPointF> & vBorders) const;
+	void	MarkBorderAsBloomed(CDeBloomPixels & pixels, int x, int y, std::vector<QPoint> & vBloomed) const;
+
+	double	ComputeStarGradient(const CDeBloomPixels & pixels, CBloomedStarGradient & bsg, double fRadius) const;
+	void	RefineStarCenter(const CDeBloomPixels & pixels, CBloomedStar & bs) const;
+	void	RefineStarCenter2(const CDeBloomPixels & pixels, CBloomedStar & bs) const;
+
+protected:
+	BLOOMEDSTARVECTOR m_vBloomedStars;
+	int m_lWidth;
+	int m_lHeight;
+	std::shared_ptr<C8BitGrayBitmap> m_pMask;
+	double m_fBackground;
 
+	void	ComputeStarCenter(const CDeBloomPixels & pixels, CBloomedStar & bs, std::vector<double> & vYCenters) const;
 	double	ComputeBackgroundValue(CMemoryBitmap * pBitmap);
-	double	ComputeStarGradient(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStarGradient & bsg, double fRadius);
-	void	RefineStarCenter(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs);
-	void	RefineStarCenter2(CMemoryBitmap * pBitmap, C8BitGrayBitmap * pMask, CBloomedStar & bs);
 
 public:
 	CDeBloom()
@@ -4,6 +4,7 @@
 #include "Ztrace.h"
 #include "Multitask.h"
 #include "DSSProgress.h"
+#include "TileRenderer.h"
 
 using namespace DSS;
 
@@ -51,25 +52,64 @@ void CDeepStack::ComputeOriginalHistogram(RGBHistogram & Histo)
 
 	Histo.SetSize(fMax, 65535);
 
-	if (!m_StackedBitmap.IsMonochrome())
+	//
+	// Each thread puts the values of its rows into its own bins (with the step of Histo), which are merged into Histo at
+	// the end. For monochrome images only the red plane is used.
+	//
+	struct ChannelBins
+	{
+		std::vector<std::uint32_t> counts;
+		double sum{ 0 };
+		double sumOfSquares{ 0 };
+		double minimum{ -1 };
+		double maximum{ 0 };
+	};
+
+	const int nrChannels = m_StackedBitmap.IsMonochrome() ? 1 : 3;
+	const double step = Histo.GetRedHistogram().GetStep();
+	const size_t nrBins = Histo.GetRedHistogram().GetNrValues();
+	const std::array<const float*, 3> planes{ redPixels.data(), greenPixels.data(), bluePixels.data() };
+	const std::array<Histogram*, 3> histograms{ &Histo.GetRedHistogram(), &Histo.GetGreenHistogram(), &Histo.GetBlueHistogram() };
+
+#pragma omp parallel default(none) shared(planes, histograms, step, nrBins, nrChannels, width, height, scalingFactor) if(nrEnabledThreads - 1)
 	{
-#pragma omp parallel sections default(none) shared(Histo, redPixels, greenPixels, bluePixels) if(nrEnabledThreads - 1)
+		std::array<ChannelBins, 3> bins;
+		for (int channel = 0; channel < nrChannels; ++channel)
+			bins[channel].counts.resize(nrBins);
+
+#pragma omp for schedule(guided, 50)
+		for (int row = 0; row < height; ++row)
 		{
-#pragma omp section
-			for (const auto& color: redPixels)
-				Histo.GetRedHistogram().AddValue(color * scalingFactor);
-#pragma omp section
-			for (const auto& color: greenPixels)
-				Histo.GetGreenHistogram().AddValue(color * scalingFactor);
-#pragma omp section
-			for (const auto& color: bluePixels)
-				Histo.GetBlueHistogram().AddValue(color * scalingFactor);
+			for (int channel = 0; channel < nrChannels; ++channel)
+			{
+				ChannelBins& channelBins = bins[channel];
+				const float* const pValues = planes[channel] + row * width;
+				for (size_t col = 0; col < width; ++col)
+				{
+					const double value = pValues[col] * scalingFactor;
+					const int bin = static_cast<int>(value / step);
+					if (bin >= 0 && static_cast<size_t>(bin) < nrBins)
+					{
+						++channelBins.counts[bin];
+						channelBins.sum += value;
+						channelBins.sumOfSquares += value * value;
+						channelBins.maximum = std::max(channelBins.maximum, value);
+						channelBins.minimum = channelBins.minimum < 0 ? value : std::min(channelBins.minimum, value);
+					}
+				}
+			}
+		}
+
+#pragma omp critical(OrigHistoMergeOmpCrit)
+		for (int channel = 0; channel < nrChannels; ++channel)
+		{
+			const ChannelBins& channelBins = bins[channel];
+			histograms[channel]->AddBins(channelBins.counts, channelBins.sum, channelBins.sumOfSquares, channelBins.minimum, channelBins.maximum);
 		}
 	}
-	else
+
+	if (m_StackedBitmap.IsMonochrome())
 	{
-		for (const auto& color: redPixels)
-			Histo.GetRedHistogram().AddValue(color * scalingFactor);
 		Histo.GetGreenHistogram() = Histo.GetRedHistogram();
 		Histo.GetBlueHistogram() = Histo.GetRedHistogram();
 	}
@@ -77,38 +117,36 @@ void CDeepStack::ComputeOriginalHistogram(RGBHistogram & Histo)
 
 /* ------------------------------------------------------------------- */
 
+//
+// The adjusted histogram is derived from the bins of the original one: each non empty bin is moved to the bin of its
+// adjusted value, so no pass over the image is needed.
+//
 void CDeepStack::AdjustHistogram(RGBHistogram & srcHisto, RGBHistogram & tgtHisto, const DSS::RGBHistogramAdjust & histogramAdjust)
 {
 	ZFUNCTRACE_RUNTIME();
 	tgtHisto.clear();
-	bool				bMonochrome;
-
-	bMonochrome = m_StackedBitmap.IsMonochrome();
 
-	for (int i = 0;i<srcHisto.GetSize();i++)
+	const auto adjustChannel = [](Histogram& source, Histogram& target, const HistogramAdjust& adjust)
 	{
-		double			fRed,
-						fGreen,
-						fBlue;
-
-		fRed	= srcHisto.GetRedHistogram().GetComponentValue(i);
-
-		if (!bMonochrome)
+		for (int i = 0; i < source.GetSize(); i++)
 		{
-			fGreen	= srcHisto.GetGreenHistogram().GetComponentValue(i);
-			fBlue	= srcHisto.GetBlueHistogram().GetComponentValue(i);
-			histogramAdjust.Adjust(fRed, fGreen, fBlue);
-		}
-		else
-		{
-			fGreen = fBlue = fRed;
-			histogramAdjust.Adjust(fRed, fGreen, fBlue);
-			fGreen = fBlue = fRed;
+			const int count = source.GetValue(i);
+			if (count != 0)
+				target.AddValue(adjust.Adjust(source.GetComponentValue(i)), count);
 		};
+	};
+
+	adjustChannel(srcHisto.GetRedHistogram(), tgtHisto.GetRedHistogram(), histogramAdjust.GetRedAdjust());
 
-		tgtHisto.GetRedHistogram().AddValue(fRed, srcHisto.GetRedHistogram().GetValue(i));
-		tgtHisto.GetGreenHistogram().AddValue(fGreen, srcHisto.GetGreenHistogram().GetValue(i));
-		tgtHisto.GetBlueHistogram().AddValue(fBlue, srcHisto.GetBlueHistogram().GetValue(i));
+	if (!m_StackedBitmap.IsMonochrome())
+	{
+		adjustChannel(srcHisto.GetGreenHistogram(), tgtHisto.GetGreenHistogram(), histogramAdjust.GetGreenAdjust());
+		adjustChannel(srcHisto.GetBlueHistogram(), tgtHisto.GetBlueHistogram(), histogramAdjust.GetBlueAdjust());
+	}
+	else
+	{
+		tgtHisto.GetGreenHistogram() = tgtHisto.GetRedHistogram();
+		tgtHisto.GetBlueHistogram() = tgtHisto.GetRedHistogram();
 	};
 };
 
@@ -128,3 +166,9 @@ bool CDeepStack::LoadStackedInfo(const fs::path& file)
 };
 
 /* ------------------------------------------------------------------- */
+
+bool CDeepStack::CollectTiles(TileRenderer& renderer)
+{
+	ensureImage();
+	return renderer.collect(imageData_.data(), image_->bytesPerLine());
+}
@@ -9,7 +9,7 @@ namespace fs = std::filesystem;
 #include "StackedBitmap.h"
 #include "BitmapExt.h"
 
-namespace DSS { class ProgressBase; }
+namespace DSS { class ProgressBase; class TileRenderer; }
 class CDeepStack
 {
 private :
@@ -69,25 +69,24 @@ public :
 
 	bool	LoadStackedInfo(const fs::path& file);
 
-	void PartialProcess(DSSRect& rcProcess, const DSS::BezierAdjust& BezierAdjust, const DSS::RGBHistogramAdjust& histogramAdjust)
+	//
+	// Renders the whole image at once from a reduced resolution preview level (see StackedBitmap::previewLevel()),
+	// to be refined afterwards with the full resolution tiles of the TileRenderer (CollectTiles()).
+	//
+	void PreviewProcess(const int level, const DSS::BezierAdjust& BezierAdjust, const DSS::RGBHistogramAdjust& histogramAdjust)
 	{
-		//
-		// Initialise an empty QImage of the right size if necessary using a preallocated buffer (in imageData_)
-		//
-		if (nullptr == image_.get())
-		{
-			int width = GetWidth(); int height = GetHeight();
-			qDebug() << "Creating image data storage: " << width << "*" << height;
-			imageData_.resize(GetWidth() * GetHeight() * sizeof(QRgb));
-			image_ = std::make_unique<QImage>(imageData_.data(), GetWidth(), GetHeight(), QImage::Format_RGB32);
-		}
+		ensureImage();
 
 		m_StackedBitmap.SetBezierAdjust(BezierAdjust);
 		m_StackedBitmap.SetHistogramAdjust(histogramAdjust);
-		m_StackedBitmap.updateQImage(imageData_.data(), image_->bytesPerLine(), &rcProcess);
-		
+		m_StackedBitmap.updateQImagePreview(imageData_.data(), image_->bytesPerLine(), level);
 	}
 
+	//
+	// Copies the tiles rendered in the background by the TileRenderer into the image, false if there were none.
+	//
+	bool	CollectTiles(DSS::TileRenderer& renderer);
+
 	DSS::StackedBitmap& GetStackedBitmap()
 	{
 		return m_StackedBitmap;
@@ -118,4 +117,19 @@ public :
 	{
 		return GetWidth() && GetHeight();
 	};
+
+private:
+	//
+	// Initialise an empty QImage of the right size if necessary using a preallocated buffer (in imageData_)
+	//
+	void ensureImage()
+	{
+		if (nullptr == image_.get())
+		{
+			int width = GetWidth(); int height = GetHeight();
+			qDebug() << "Creating image data storage: " << width << "*" << height;
+			imageData_.resize(GetWidth() * GetHeight() * sizeof(QRgb));
+			image_ = std::make_unique<QImage>(imageData_.data(), GetWidth(), GetHeight(), QImage::Format_RGB32);
+		}
+	}
 };
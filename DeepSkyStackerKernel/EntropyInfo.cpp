@@ -4,10 +4,61 @@
 #include "avx_entropy.h"
 #include "Ztrace.h"
 #include "MemoryBitmap.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+#include "Multitask.h"
 #include "DSSTools.h"
 
 using namespace DSS;
 
+namespace
+{
+	// As CMemoryBitmap::GetPixel16() does with the value returned by GetPixel().
+	template <class T>
+	std::uint16_t toPixel16(const T value, const double fMultiplier)
+	{
+		return static_cast<std::uint16_t>(std::min(static_cast<double>(value) / fMultiplier * 256.0, 65535.0));
+	}
+
+	//
+	// Reads the pixels of the square column by column from the pixel buffers of the bitmap, with the values of GetPixel16().
+	// Returns false if the bitmap is not a color or a (non CFA) gray bitmap of type T.
+	//
+	template <class T>
+	bool readTypedSquare(const CMemoryBitmap& bitmap, const int lMinX, const int lMinY, const int lMaxX, const int lMaxY, std::vector<COLORREF16>& vPixels)
+	{
+		if (const auto* const pGray = dynamic_cast<const CGrayBitmapT<T>*>(&bitmap))
+		{
+			if (pGray->GetCFATransformation() != CFAT_NONE)
+				return false;
+			const double fMultiplier = pGray->GetMultiplier();
+			for (int i = lMinX; i <= lMaxX; i++)
+				for (int j = lMinY; j <= lMaxY; j++)
+				{
+					const std::uint16_t value = toPixel16(pGray->m_vPixels[pGray->GetOffset(static_cast<size_t>(i), static_cast<size_t>(j))], fMultiplier);
+					vPixels.emplace_back(value, value, value);
+				}
+			return true;
+		}
+		if (const auto* const pColor = dynamic_cast<const CColorBitmapT<T>*>(&bitmap))
+		{
+			const double fMultiplier = pColor->GetMultiplier();
+			for (int i = lMinX; i <= lMaxX; i++)
+				for (int j = lMinY; j <= lMaxY; j++)
+				{
+					const size_t offset = pColor->GetOffset(static_cast<size_t>(i), static_cast<size_t>(j));
+					vPixels.emplace_back(
+						toPixel16(pColor->m_Red.m_vPixels[offset], fMultiplier),
+						toPixel16(pColor->m_Green.m_vPixels[offset], fMultiplier),
+						toPixel16(pColor->m_Blue.m_vPixels[offset], fMultiplier)
+					);
+				}
+			return true;
+		}
+		return false;
+	}
+}
+
 void CEntropyInfo::InitSquareEntropies() // virtual
 {
 	ZFUNCTRACE_RUNTIME();
@@ -31,29 +82,47 @@ void CEntropyInfo::InitSquareEntropies() // virtual
 	AvxEntropy avxEntropy(*m_pBitmap, *this, nullptr);
 	if (avxEntropy.calcEntropies(lSquareSize, m_lNrSquaresX, m_lNrSquaresY, m_vRedEntropies, m_vGreenEntropies, m_vBlueEntropies) != 0)
 	{
-		for (int i = 0; i < m_lNrSquaresX; i++)
+		const int width = m_pBitmap->Width();
+		const int height = m_pBitmap->Height();
+		const int nrSquaresX = m_lNrSquaresX;
+		const int nrSquaresY = m_lNrSquaresY;
+		ProgressBase* const pProgress = m_pProgress;
+		std::atomic_int loopCtr = 0;
+
+#pragma omp parallel default(none) shared(loopCtr) firstprivate(lSquareSize, width, height, nrSquaresX, nrSquaresY, pProgress) if(CMultitask::GetNrProcessors() > 1)
 		{
-			const int lMinX = i * lSquareSize;
-			const int lMaxX = std::min((i + 1) * lSquareSize - 1, m_pBitmap->Width() - 1);
-
-			for (int j = 0; j < m_lNrSquaresY; j++)
+			SquareScratch scratch;
+			scratch.vRedHisto.resize(static_cast<size_t>(MAXWORD) + 1);
+			scratch.vGreenHisto.resize(static_cast<size_t>(MAXWORD) + 1);
+			scratch.vBlueHisto.resize(static_cast<size_t>(MAXWORD) + 1);
+			scratch.vPixels.reserve(static_cast<size_t>(lSquareSize) * lSquareSize);
+
+#pragma omp for schedule(dynamic, 1)
+			for (int i = 0; i < nrSquaresX; i++)
 			{
-				const int lMinY = j * lSquareSize;
-				const int lMaxY = std::min((j + 1) * lSquareSize - 1, m_pBitmap->Height() - 1);
-
-				// Compute the entropy for this square
-				double fRedEntropy;
-				double fGreenEntropy;
-				double fBlueEntropy;
-				ComputeEntropies(lMinX, lMinY, lMaxX, lMaxY, fRedEntropy, fGreenEntropy, fBlueEntropy);
-
-				m_vRedEntropies[i + j * m_lNrSquaresX] = fRedEntropy;
-				m_vGreenEntropies[i + j * m_lNrSquaresX] = fGreenEntropy;
-				m_vBlueEntropies[i + j * m_lNrSquaresX] = fBlueEntropy;
+				const int lMinX = i * lSquareSize;
+				const int lMaxX = std::min((i + 1) * lSquareSize - 1, width - 1);
+
+				for (int j = 0; j < nrSquaresY; j++)
+				{
+					const int lMinY = j * lSquareSize;
+					const int lMaxY = std::min((j + 1) * lSquareSize - 1, height - 1);
+
+					// Compute the entropy for this square
+					double fRedEntropy;
+					double fGreenEntropy;
+					double fBlueEntropy;
+					ComputeEntropies(lMinX, lMinY, lMaxX, lMaxY, scratch, fRedEntropy, fGreenEntropy, fBlueEntropy);
+
+					m_vRedEntropies[i + j * nrSquaresX] = fRedEntropy;
+					m_vGreenEntropies[i + j * nrSquaresX] = fGreenEntropy;
+					m_vBlueEntropies[i + j * nrSquaresX] = fBlueEntropy;
+				}
+
+				++loopCtr;
+				if (pProgress != nullptr && omp_get_thread_num() == 0)
+					pProgress->Progress2(loopCtr);
 			}
-
-			if (m_pProgress != nullptr && i % m_lWindowSize == 0)
-				m_pProgress->Progress2(1 + i);
 		}
 	}
 
@@ -63,49 +132,69 @@ void CEntropyInfo::InitSquareEntropies() // virtual
 
 /* ------------------------------------------------------------------- */
 
-void CEntropyInfo::ComputeEntropies(int lMinX, int lMinY, int lMaxX, int lMaxY, double & fRedEntropy, double & fGreenEntropy, double & fBlueEntropy)
+void CEntropyInfo::ReadSquare(int lMinX, int lMinY, int lMaxX, int lMaxY, std::vector<COLORREF16>& vPixels) const
 {
-	std::vector<std::uint16_t> vRedHisto;
-	std::vector<std::uint16_t> vGreenHisto;
-	std::vector<std::uint16_t> vBlueHisto;
+	vPixels.clear();
+	if (readTypedSquare<std::uint16_t>(*m_pBitmap, lMinX, lMinY, lMaxX, lMaxY, vPixels)
+		|| readTypedSquare<float>(*m_pBitmap, lMinX, lMinY, lMaxX, lMaxY, vPixels)
+		|| readTypedSquare<std::uint32_t>(*m_pBitmap, lMinX, lMinY, lMaxX, lMaxY, vPixels)
+		|| readTypedSquare<std::uint8_t>(*m_pBitmap, lMinX, lMinY, lMaxX, lMaxY, vPixels)
+		|| readTypedSquare<double>(*m_pBitmap, lMinX, lMinY, lMaxX, lMaxY, vPixels))
+	{
+		return;
+	}
+
+	// CFA bitmaps (interpolated by GetPixel()) and other bitmaps.
+	COLORREF16 crColor;
+	for (int i = lMinX; i <= lMaxX; i++)
+	{
+		for (int j = lMinY; j <= lMaxY; j++)
+		{
+			m_pBitmap->GetPixel16(i, j, crColor);
+			vPixels.push_back(crColor);
+		}
+	}
+}
+
+void CEntropyInfo::ComputeEntropies(int lMinX, int lMinY, int lMaxX, int lMaxY, SquareScratch& scratch, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy) const
+{
+	// The histograms are all 0 on entry, and reset to 0 on exit.
+	std::vector<std::uint16_t>& vRedHisto = scratch.vRedHisto;
+	std::vector<std::uint16_t>& vGreenHisto = scratch.vGreenHisto;
+	std::vector<std::uint16_t>& vBlueHisto = scratch.vBlueHisto;
 
 	fRedEntropy = 0.0;
 	fGreenEntropy = 0.0;
 	fBlueEntropy = 0.0;
 
-	vRedHisto.resize((int)MAXWORD+1);
-	vGreenHisto.resize((int)MAXWORD+1);
-	vBlueHisto.resize((int)MAXWORD+1);
+	ReadSquare(lMinX, lMinY, lMaxX, lMaxY, scratch.vPixels);
 
-	COLORREF16		crColor;
-	for (int i = lMinX;i<=lMaxX;i++)
+	for (const COLORREF16& crColor : scratch.vPixels)
 	{
-		for (int j = lMinY;j<=lMaxY;j++)
-		{
-			m_pBitmap->GetPixel16(i, j, crColor);
-			vRedHisto[crColor.red]++;
-			vGreenHisto[crColor.green]++;
-			vBlueHisto[crColor.blue]++;
-		};
-	};
+		vRedHisto[crColor.red]++;
+		vGreenHisto[crColor.green]++;
+		vBlueHisto[crColor.blue]++;
+	}
 
 	const double lNrPixels = static_cast<double>(lMaxX - lMinX + 1) * static_cast<double>(lMaxY - lMinY + 1);
 
-	for (int i = lMinX;i<=lMaxX;i++)
+	for (const COLORREF16& crColor : scratch.vPixels)
 	{
-		for (int j = lMinY;j<=lMaxY;j++)
-		{
-			m_pBitmap->GetPixel16(i, j, crColor);
+		const double qRed = static_cast<double>(vRedHisto[crColor.red]) / lNrPixels;
+		const double qGreen = static_cast<double>(vGreenHisto[crColor.green]) / lNrPixels;
+		const double qBlue = static_cast<double>(vBlueHisto[crColor.blue]) / lNrPixels;
 
-			const double qRed = static_cast<double>(vRedHisto[crColor.red]) / lNrPixels;
-			const double qGreen = static_cast<double>(vGreenHisto[crColor.green]) / lNrPixels;
-			const double qBlue = static_cast<double>(vBlueHisto[crColor.blue]) / lNrPixels;
+		fRedEntropy += -qRed * log(qRed)/log(2.0);
+		fGreenEntropy += -qGreen * log(qGreen)/log(2.0);
+		fBlueEntropy += -qBlue * log(qBlue)/log(2.0);
+	}
 
-			fRedEntropy += -qRed * log(qRed)/log(2.0);
-			fGreenEntropy += -qGreen * log(qGreen)/log(2.0);
-			fBlueEntropy += -qBlue * log(qBlue)/log(2.0);
-		};
-	};
+	for (const COLORREF16& crColor : scratch.vPixels)
+	{
+		vRedHisto[crColor.red] = 0;
+		vGreenHisto[crColor.green] = 0;
+		vBlueHisto[crColor.blue] = 0;
+	}
 }
 
 void CEntropyInfo::Init(std::shared_ptr<CMemoryBitmap> pBitmap, int lWindowSize /* = 10 */, DSS::ProgressBase* pProgress /* = nullptr */)
@@ -116,40 +205,45 @@ void CEntropyInfo::Init(std::shared_ptr<CMemoryBitmap> pBitmap, int lWindowSize
 	InitSquareEntropies();
 }
 
-void CEntropyInfo::GetPixel(int x, int y, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy, COLORREF16& crResult) const
+void CEntropyInfo::InterpolateEntropies(int x, int y, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy) const
 {
-	int lSquareX, lSquareY;
-
-	m_pBitmap->GetPixel16(x, y, crResult);
-
-	lSquareX = x / (m_lWindowSize * 2 + 1);
-	lSquareY = y / (m_lWindowSize * 2 + 1);
+	const int lSquareX = x / (m_lWindowSize * 2 + 1);
+	const int lSquareY = y / (m_lWindowSize * 2 + 1);
 
-	CEntropySquare Squares[3];
+	// The square of the pixel, and its horizontal and vertical neighbours on the side of the pixel.
+	int vSquaresX[3];
+	int vSquaresY[3];
 	size_t sizeSquares = 0;
 
-	QPointF ptCenter = GetSquareCenter(lSquareX, lSquareY);
-	AddSquare(Squares[sizeSquares++], lSquareX, lSquareY);
+	const auto addSquare = [&vSquaresX, &vSquaresY, &sizeSquares](const int lX, const int lY)
+	{
+		vSquaresX[sizeSquares] = lX;
+		vSquaresY[sizeSquares] = lY;
+		sizeSquares++;
+	};
+
+	const QPointF ptCenter = GetSquareCenter(lSquareX, lSquareY);
+	addSquare(lSquareX, lSquareY);
 	if (ptCenter.x() > x)
 	{
 		if (lSquareX > 0)
-			AddSquare(Squares[sizeSquares++], lSquareX - 1, lSquareY);
+			addSquare(lSquareX - 1, lSquareY);
 	}
 	else if (ptCenter.x() < x)
 	{
 		if (lSquareX < m_lNrSquaresX - 1)
-			AddSquare(Squares[sizeSquares++], lSquareX + 1, lSquareY);
+			addSquare(lSquareX + 1, lSquareY);
 	};
 
 	if (ptCenter.y() > y)
 	{
 		if (lSquareY > 0)
-			AddSquare(Squares[sizeSquares++], lSquareX, lSquareY - 1);
+			addSquare(lSquareX, lSquareY - 1);
 	}
 	else if (ptCenter.y() < y)
 	{
 		if (lSquareY < m_lNrSquaresY - 1)
-			AddSquare(Squares[sizeSquares++], lSquareX, lSquareY + 1);
+			addSquare(lSquareX, lSquareY + 1);
 	};
 
 	// Compute the gradient entropy from the nearby squares
@@ -163,14 +257,15 @@ void CEntropyInfo::GetPixel(int x, int y, double& fRedEntropy, double& fGreenEnt
 	{
 		double		fDistance;
 		double		fWeight = 1.0;
+		const int	lIndex = vSquaresX[i] + vSquaresY[i] * m_lNrSquaresX;
 
-		fDistance = Distance(ptPixel, Squares[i].m_ptCenter);
+		fDistance = Distance(ptPixel, GetSquareCenter(vSquaresX[i], vSquaresY[i]));
 		if (fDistance > 0)
 			fWeight = 1.0 / fDistance;
 
-		fRedEntropy += fWeight * Squares[i].m_fRedEntropy;
-		fGreenEntropy += fWeight * Squares[i].m_fGreenEntropy;
-		fBlueEntropy += fWeight * Squares[i].m_fBlueEntropy;
+		fRedEntropy += fWeight * m_vRedEntropies[lIndex];
+		fGreenEntropy += fWeight * m_vGreenEntropies[lIndex];
+		fBlueEntropy += fWeight * m_vBlueEntropies[lIndex];
 
 		fTotalWeight += fWeight;
 	}
@@ -178,4 +273,16 @@ void CEntropyInfo::GetPixel(int x, int y, double& fRedEntropy, double& fGreenEnt
 	fRedEntropy /= fTotalWeight;
 	fGreenEntropy /= fTotalWeight;
 	fBlueEntropy /= fTotalWeight;
-}
\ No newline at end of file
+}
+
+void CEntropyInfo::GetPixel(int x, int y, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy, COLORREF16& crResult) const
+{
+	m_pBitmap->GetPixel16(x, y, crResult);
+	InterpolateEntropies(x, y, fRedEntropy, fGreenEntropy, fBlueEntropy);
+}
+
+void CEntropyInfo::GetRowEntropies(int x, int y, int nrPixels, double* pRedEntropies, double* pGreenEntropies, double* pBlueEntropies) const
+{
+	for (int i = 0; i < nrPixels; i++)
+		InterpolateEntropies(x + i, y, pRedEntropies[i], pGreenEntropies[i], pBlueEntropies[i]);
+}
@@ -69,8 +69,19 @@ protected:
 	DSS::ProgressBase* m_pProgress{ nullptr };
 
 private:
+	// Per thread buffers of ComputeEntropies().
+	struct SquareScratch
+	{
+		std::vector<std::uint16_t> vRedHisto;
+		std::vector<std::uint16_t> vGreenHisto;
+		std::vector<std::uint16_t> vBlueHisto;
+		std::vector<COLORREF16> vPixels;	// The pixels of the square, column by column
+	};
+
 	virtual void InitSquareEntropies();
-	void ComputeEntropies(int lMinX, int lMinY, int lMaxX, int lMaxY, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy);
+	void ComputeEntropies(int lMinX, int lMinY, int lMaxX, int lMaxY, SquareScratch& scratch, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy) const;
+	void ReadSquare(int lMinX, int lMinY, int lMaxX, int lMaxY, std::vector<COLORREF16>& vPixels) const;
+	void InterpolateEntropies(int x, int y, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy) const;
 	QPointF GetSquareCenter(int lX, int lY) const
 	{
 		return QPointF{
@@ -79,14 +90,6 @@ private:
 		};
 	}
 
-	void AddSquare(CEntropySquare& Square, int lX, int lY) const
-	{
-		Square.m_ptCenter = GetSquareCenter(lX, lY);
-		Square.m_fRedEntropy	= m_vRedEntropies[lX + lY * m_lNrSquaresX];
-		Square.m_fGreenEntropy	= m_vGreenEntropies[lX + lY * m_lNrSquaresX];
-		Square.m_fBlueEntropy	= m_vBlueEntropies[lX + lY * m_lNrSquaresX];
-	}
-
 public:
 	CEntropyInfo() = default;
 	CEntropyInfo(const CEntropyInfo&) = delete;
@@ -104,5 +107,10 @@ public:
 
 	void Init(std::shared_ptr<CMemoryBitmap> pBitmap, int lWindowSize = 10, DSS::ProgressBase* pProgress = nullptr);
 	void GetPixel(int x, int y, double& fRedEntropy, double& fGreenEntropy, double& fBlueEntropy, COLORREF16& crResult) const;
+	//
+	// The entropies of the pixels (x, y) to (x + nrPixels - 1, y), as returned by GetPixel().
+	// Used by the stacking to compute the weights of a whole line at once.
+	//
+	void GetRowEntropies(int x, int y, int nrPixels, double* pRedEntropies, double* pGreenEntropies, double* pBlueEntropies) const;
 };
 
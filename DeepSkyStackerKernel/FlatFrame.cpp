@@ -3,12 +3,74 @@
 #include "Multitask.h"
 #include "DSSProgress.h"
 #include "MemoryBitmap.h"
+#include "ColorBitmap.h"
 #include "CFABitmapInfo.h"
 #include "Ztrace.h"
 //#include "resource.h"
 
 using namespace DSS;
 
+namespace
+{
+	//
+	// Flat field application directly on the pixel vectors of CGrayBitmapT and CColorBitmapT.
+	// The mean of the flat only depends on the Bayer colour, so it is looked up once for each column of an even and
+	// of an odd row (2x2 Bayer pattern). The loop over a row then is contiguous and branch free and can be vectorised.
+	// The arithmetic is that of GetPixel, CFlatNormalization::Normalize and SetPixel, so the result is the same as
+	// that of the generic path.
+	//
+	template <typename TTarget, typename TFlat>
+	void applyFlatToRow(TTarget* const pTarget, const TFlat* const pFlat, const double* const pMeans, const int width, const double targetMultiplier, const double flatMultiplier)
+	{
+		constexpr double clampValue = initClamp<TTarget>();
+		for (int i = 0; i < width; i++)
+		{
+			const double fFlat = static_cast<double>(pFlat[i]) / flatMultiplier;
+			const double fValue = std::min(static_cast<double>(pTarget[i]) / targetMultiplier * (pMeans[i] / std::max(1.0, fFlat)), 255.0);
+			pTarget[i] = static_cast<TTarget>(std::clamp(fValue * targetMultiplier, 0.0, clampValue));
+		}
+	}
+
+	// means[plane][row parity][column]
+	template <typename TTarget, typename TFlat, size_t NrPlanes>
+	void applyFlatToPlanes(const std::array<TTarget*, NrPlanes>& targetPlanes, const std::array<const TFlat*, NrPlanes>& flatPlanes,
+		const std::array<std::array<std::vector<double>, 2>, NrPlanes>& means, const int width, const int height,
+		const double targetMultiplier, const double flatMultiplier, ProgressBase* const pProgress)
+	{
+		const int nrProcessors = CMultitask::GetNrProcessors();
+		int rowProgress = 0;
+
+#pragma omp parallel for schedule(static, 100) default(none) shared(targetPlanes, flatPlanes, means, rowProgress) firstprivate(width, height, targetMultiplier, flatMultiplier, pProgress, nrProcessors) if(nrProcessors > 1)
+		for (int j = 0; j < height; j++)
+		{
+			const size_t offset = static_cast<size_t>(j) * width;
+			for (size_t plane = 0; plane < NrPlanes; plane++)
+				applyFlatToRow(targetPlanes[plane] + offset, flatPlanes[plane] + offset, means[plane][j & 1].data(), width, targetMultiplier, flatMultiplier);
+
+			if (omp_get_thread_num() == 0 && pProgress != nullptr)
+				pProgress->Progress2(rowProgress += nrProcessors);
+		}
+	}
+
+	// Calls callable(bitmap) with the bitmap cast to TBitmap<T> for the T of TTypes it is an instance of.
+	// Returns false if there is no such T, otherwise the result of callable.
+	template <template <typename> class TBitmap, typename... TTypes, typename Callable>
+	bool visitBitmap(CMemoryBitmap* const pBitmap, Callable&& callable)
+	{
+		const auto visit = [&callable](auto* const pTyped) -> bool
+		{
+			return pTyped != nullptr && callable(*pTyped);
+		};
+		return (visit(dynamic_cast<TBitmap<TTypes>*>(pBitmap)) || ...);
+	}
+
+	template <template <typename> class TBitmap, typename Callable>
+	bool visitPixelType(CMemoryBitmap* const pBitmap, Callable&& callable)
+	{
+		return visitBitmap<TBitmap, std::uint8_t, std::uint16_t, std::uint32_t, float, double>(pBitmap, std::forward<Callable>(callable));
+	}
+}
+
 bool CFlatFrame::IsOk() const
 {
 	return static_cast<bool>(m_pFlatFrame) && m_pFlatFrame->IsOk();
@@ -60,41 +122,45 @@ bool CFlatFrame::ApplyFlat(std::shared_ptr<CMemoryBitmap> pTarget, ProgressBase
 				pProgress->Start2(height);
 			bResult = true;
 
-			int	rowProgress = 0;
+			// Fast path for the usual bitmap types, the generic path for all others.
+			if (!ApplyFlatToPixels(pTarget.get(), pProgress))
+			{
+				int	rowProgress = 0;
 
 #pragma omp parallel for schedule(static, 100) default(none) if(nrProcessors > 1)
-			for (int j = 0; j < height; j++)
-			{
-				for (int i = 0; i < width; i++)
+				for (int j = 0; j < height; j++)
 				{
-					if (bUseGray)
+					for (int i = 0; i < width; i++)
 					{
-						double fSrcGray = 0.0;
-						double fTgtGray = 0.0;
-						pTarget->GetPixel(i, j, fTgtGray);
-						m_pFlatFrame->GetPixel(i, j, fSrcGray);
+						if (bUseGray)
+						{
+							double fSrcGray = 0.0;
+							double fTgtGray = 0.0;
+							pTarget->GetPixel(i, j, fTgtGray);
+							m_pFlatFrame->GetPixel(i, j, fSrcGray);
 
-						if (bUseCFA)
-							m_FlatNormalization.Normalize(fTgtGray, fSrcGray, m_pFlatFrame->GetBayerColor(i, j));
+							if (bUseCFA)
+								m_FlatNormalization.Normalize(fTgtGray, fSrcGray, m_pFlatFrame->GetBayerColor(i, j));
+							else
+								m_FlatNormalization.Normalize(fTgtGray, fSrcGray);
+
+							pTarget->SetPixel(i, j, fTgtGray);
+						}
 						else
-							m_FlatNormalization.Normalize(fTgtGray, fSrcGray);
+						{
+							double fSrcRed, fSrcGreen, fSrcBlue;
+							double fTgtRed, fTgtGreen, fTgtBlue;
 
-						pTarget->SetPixel(i, j, fTgtGray);
+							pTarget->GetPixel(i, j, fTgtRed, fTgtGreen, fTgtBlue);
+							m_pFlatFrame->GetPixel(i, j, fSrcRed, fSrcGreen, fSrcBlue);
+							m_FlatNormalization.Normalize(fTgtRed, fTgtGreen, fTgtBlue, fSrcRed, fSrcGreen, fSrcBlue);
+							pTarget->SetPixel(i, j, fTgtRed, fTgtGreen, fTgtBlue);
+						}
 					}
-					else
-					{
-						double fSrcRed, fSrcGreen, fSrcBlue;
-						double fTgtRed, fTgtGreen, fTgtBlue;
 
-						pTarget->GetPixel(i, j, fTgtRed, fTgtGreen, fTgtBlue);
-						m_pFlatFrame->GetPixel(i, j, fSrcRed, fSrcGreen, fSrcBlue);
-						m_FlatNormalization.Normalize(fTgtRed, fTgtGreen, fTgtBlue, fSrcRed, fSrcGreen, fSrcBlue);
-						pTarget->SetPixel(i, j, fTgtRed, fTgtGreen, fTgtBlue);
-					}
+					if (omp_get_thread_num() == 0 && pProgress != nullptr)
+						pProgress->Progress2(rowProgress += nrProcessors);
 				}
-
-				if (omp_get_thread_num() == 0 && pProgress != nullptr)
-					pProgress->Progress2(rowProgress += nrProcessors);
 			}
 
 			if (pProgress != nullptr)
@@ -116,6 +182,57 @@ bool CFlatFrame::ApplyFlat(std::shared_ptr<CMemoryBitmap> pTarget, ProgressBase
 
 /* ------------------------------------------------------------------- */
 
+bool CFlatFrame::ApplyFlatToPixels(CMemoryBitmap* pTarget, ProgressBase* pProgress) const
+{
+	const int width = pTarget->RealWidth();
+	const int height = pTarget->RealHeight();
+
+	if (m_FlatNormalization.UseGray())
+	{
+		const bool bUseCFA = IsCFA();
+		if (bUseCFA && IsCYMGType(m_pFlatFrame->GetCFAType())) // Not a 2x2 pattern.
+			return false;
+
+		std::array<std::array<std::vector<double>, 2>, 1> means;
+		for (int parity = 0; parity < 2; parity++)
+		{
+			means[0][parity].resize(width);
+			for (int i = 0; i < width; i++)
+				means[0][parity][i] = m_FlatNormalization.GetMean(bUseCFA ? m_pFlatFrame->GetBayerColor(i, parity) : BAYER_UNKNOWN);
+		}
+
+		return visitPixelType<CGrayBitmapT>(pTarget, [&](auto& target)
+		{
+			return visitPixelType<CGrayBitmapT>(m_pFlatFrame.get(), [&](const auto& flat)
+			{
+				applyFlatToPlanes(std::array{ target.m_vPixels.data() }, std::array{ flat.m_vPixels.data() }, means, width, height, target.GetMultiplier(), flat.GetMultiplier(), pProgress);
+				return true;
+			});
+		});
+	}
+	else
+	{
+		std::array<std::array<std::vector<double>, 2>, 3> means;
+		const BAYERCOLOR colors[3] = { BAYER_RED, BAYER_GREEN, BAYER_BLUE };
+		for (size_t plane = 0; plane < 3; plane++)
+			for (int parity = 0; parity < 2; parity++)
+				means[plane][parity].assign(width, m_FlatNormalization.GetMean(colors[plane]));
+
+		return visitPixelType<CColorBitmapT>(pTarget, [&](auto& target)
+		{
+			return visitPixelType<CColorBitmapT>(m_pFlatFrame.get(), [&](const auto& flat)
+			{
+				applyFlatToPlanes(std::array{ target.m_Red.m_vPixels.data(), target.m_Green.m_vPixels.data(), target.m_Blue.m_vPixels.data() },
+					std::array{ flat.m_Red.m_vPixels.data(), flat.m_Green.m_vPixels.data(), flat.m_Blue.m_vPixels.data() },
+					means, width, height, target.GetMultiplier(), flat.GetMultiplier(), pProgress);
+				return true;
+			});
+		});
+	}
+}
+
+/* ------------------------------------------------------------------- */
+
 void CFlatFrame::ComputeFlatNormalization(ProgressBase* pProgress)
 {
 	ZFUNCTRACE_RUNTIME();
@@ -58,11 +58,35 @@ public :
 		m_bUseGray   = false;
 	};
 
-	bool	UseGray()
+	bool	UseGray() const
 	{
 		return m_bUseGray;
 	};
 
+	// The mean of the flat, by which Normalize() multiplies the ratio target / flat.
+	double	GetMean(BAYERCOLOR BayerColor = BAYER_UNKNOWN) const
+	{
+		switch (BayerColor)
+		{
+		case BAYER_RED :
+			return m_fMeanRed;
+		case BAYER_GREEN :
+			return m_fMeanGreen;
+		case BAYER_BLUE :
+			return m_fMeanBlue;
+		case BAYER_CYAN :
+			return m_fMeanCyan;
+		case BAYER_YELLOW :
+			return m_fMeanYellow;
+		case BAYER_MAGENTA :
+			return m_fMeanMagenta;
+		case BAYER_GREEN2 :
+			return m_fMeanGreen2;
+		default :
+			return m_fMeanGray;
+		};
+	};
+
 	void	Normalize(double & fAdjustGray, double fFlatGray, BAYERCOLOR BayerColor = BAYER_UNKNOWN)
 	{
 		switch (BayerColor)
@@ -128,6 +152,10 @@ public :
 	void Clear();
 	void ComputeFlatNormalization(DSS::ProgressBase* pProgress = nullptr);
 	bool ApplyFlat(std::shared_ptr<CMemoryBitmap> pTarget, DSS::ProgressBase * pProgress = nullptr);
+
+private :
+	// Works directly on the pixels of gray/colour bitmaps, returns false for bitmap types it does not handle.
+	bool ApplyFlatToPixels(CMemoryBitmap* pTarget, DSS::ProgressBase* pProgress) const;
 };
 
 /* ------------------------------------------------------------------- */
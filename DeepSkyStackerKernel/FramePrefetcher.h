@@ -0,0 +1,98 @@
+#pragma once
+#include "Multitask.h"
+
+namespace DSS
+{
+	class ProgressBase;
+
+	//
+	// Loads the frames of a sequence ahead of their use, several of them concurrently.
+	// Decoding is often single threaded (e.g. most LibRaw decoders), so with many cores several frames decode in parallel
+	// while the caller processes the current one.
+	//
+	// The frames must be requested in order with get(0), get(1), ... The first frame is loaded on the calling thread (with
+	// the progress), all others asynchronously without progress. At most maxFrames frames are loaded ahead, and only as long
+	// as the estimated memory of these frames stays within memoryLimit. One frame is always loaded ahead (like the
+	// former read-ahead of the engines), even if it alone exceeds the limit.
+	//
+	// Destruction waits for the frames that are still loading.
+	//
+	template <typename Result>
+	class FramePrefetcher
+	{
+	public:
+		using LoadFunction = std::function<Result(size_t, ProgressBase*)>;
+		using SizeFunction = std::function<std::uint64_t(size_t)>;
+
+	private:
+		struct Pending
+		{
+			std::future<Result> future;
+			std::uint64_t bytes;
+		};
+
+		const size_t nrFrames;
+		const LoadFunction loadFrame;
+		const SizeFunction frameSize;
+		ProgressBase* const pProgress;
+		const size_t maxFrames;
+		const std::uint64_t memoryLimit;
+		std::deque<Pending> pending;
+		size_t nextToLoad;
+		size_t nextToGet;
+		std::uint64_t pendingBytes;
+
+	public:
+		FramePrefetcher(const size_t frameCount, LoadFunction loader, SizeFunction sizeEstimate, ProgressBase* const pFirstFrameProgress,
+			const size_t maxPrefetched = static_cast<size_t>(CMultitask::GetMaxPrefetchedFrames()),
+			const std::uint64_t memoryCeiling = CMultitask::GetPrefetchMemoryLimit()) :
+			nrFrames{ frameCount },
+			loadFrame{ std::move(loader) },
+			frameSize{ std::move(sizeEstimate) },
+			pProgress{ pFirstFrameProgress },
+			maxFrames{ std::max<size_t>(maxPrefetched, 1) },
+			memoryLimit{ memoryCeiling },
+			pending{},
+			nextToLoad{ 0 },
+			nextToGet{ 0 },
+			pendingBytes{ 0 }
+		{}
+
+		FramePrefetcher(const FramePrefetcher&) = delete;
+		FramePrefetcher& operator=(const FramePrefetcher&) = delete;
+
+		Result get(const size_t index)
+		{
+			ZASSERTSTATE(index == nextToGet && index < nrFrames);
+			++nextToGet;
+
+			if (pending.empty())
+			{
+				// Nothing loaded ahead: this is the first frame. Start loading the following ones, then load this one here.
+				nextToLoad = index + 1;
+				prefetch();
+				return loadFrame(index, pProgress);
+			}
+
+			Pending current = std::move(pending.front());
+			pending.pop_front();
+			pendingBytes -= current.bytes;
+			prefetch();
+			return current.future.get();
+		}
+
+	private:
+		void prefetch()
+		{
+			while (nextToLoad < nrFrames && pending.size() < maxFrames)
+			{
+				const std::uint64_t bytes = frameSize ? frameSize(nextToLoad) : 0;
+				if (!pending.empty() && pendingBytes + bytes > memoryLimit)
+					break;
+				pending.push_back(Pending{ std::async(std::launch::async, loadFrame, nextToLoad, nullptr), bytes });
+				pendingBytes += bytes;
+				++nextToLoad;
+			}
+		}
+	};
+}
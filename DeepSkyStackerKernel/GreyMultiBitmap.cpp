@@ -5,6 +5,7 @@
 #include "BitmapBase.h"
 #include "ZExcBase.h"
 #include "DSSTools.h"
+#include "MultiBitmapBatch.h"
 
 template <typename TType, typename TTypeOutput>
 std::shared_ptr<CMemoryBitmap> CGrayMultiBitmapT<TType, TTypeOutput>::CreateNewMemoryBitmap() const
@@ -71,6 +72,19 @@ bool CGrayMultiBitmapT<TType, TTypeOutput>::SetScanLines(CMemoryBitmap* pBitmap,
 	}
 	TTypeOutput* pCurrentValue = outputScanBuffer.data();
 
+	// Without homogenization, blocks of pixels are processed at once (no per-pixel vectors).
+	if (MultiBitmapBatch<TType>::isSupported(m_Method, m_bHomogenization))
+	{
+		MultiBitmapBatch<TType> batch{ vScanLines.size() };
+		for (int i = 0; i < lWidth; i += batch.BatchSize)
+		{
+			batch.load(vScanLines, i, lWidth - i, !m_vImageOrder.empty(), false);
+			batch.combine(m_Method, m_fKappa, m_lNrIterations, pCurrentValue + i);
+		}
+		pBitmap->SetScanLine(lLine, outputScanBuffer.data());
+		return true;
+	}
+
 	vValues.reserve(vScanLines.size());
 	vWorkingBuffer1.reserve(vScanLines.size());
 	vWorkingBuffer2.reserve(vScanLines.size());
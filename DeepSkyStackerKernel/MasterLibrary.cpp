@@ -0,0 +1,267 @@
+#include "stdafx.h"
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include "MasterLibrary.h"
+#include "TaskInfo.h"
+#include "Settings.h"
+#include "Multitask.h"
+#include "Ztrace.h"
+
+namespace
+{
+	// Modification time in the units of the file clock (only compared for equality).
+	std::int64_t modificationTime(const fs::path& file, std::error_code& ec)
+	{
+		return static_cast<std::int64_t>(fs::last_write_time(file, ec).time_since_epoch().count());
+	}
+}
+
+namespace DSS
+{
+	MasterLibrary::MasterLibrary() :
+		libraryFolder{},
+		sizeLimit{ &CMultitask::GetMasterLibrarySizeLimit }
+	{}
+
+	MasterLibrary::MasterLibrary(const fs::path& path, LimitFunction sizeBudget) :
+		libraryFolder{ path },
+		sizeLimit{ std::move(sizeBudget) }
+	{}
+
+	MasterLibrary& MasterLibrary::instance()
+	{
+		static MasterLibrary library;
+		return library;
+	}
+
+	fs::path MasterLibrary::getFolder()
+	{
+		const QString defaultFolder = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/MasterLibrary";
+		return fs::path{ QSettings{}.value("MasterLibraryFolder", defaultFolder).toString().toStdU16String() };
+	}
+
+	void MasterLibrary::setFolder(const fs::path& path)
+	{
+		QSettings{}.setValue("MasterLibraryFolder", QString::fromStdU16String(path.generic_u16string()));
+
+		MasterLibrary& library = instance();
+		std::lock_guard lock{ library.mutex };
+		library.entries.clear();
+		library.pinnedKeys.clear();
+		library.loaded = false;
+	}
+
+	QString MasterLibrary::fileIdentity(const fs::path& file)
+	{
+		std::error_code ec;
+		const std::uintmax_t size = fs::file_size(file, ec);
+		if (ec)
+			return {};
+		const std::int64_t modified = modificationTime(file, ec);
+		if (ec)
+			return {};
+
+		return QString("%1|%2|%3").arg(QString::fromStdU16String(file.generic_u16string())).arg(size).arg(modified);
+	}
+
+	QString MasterLibrary::computeKey(const QString& type, const CTaskInfo& task, const CGlobalSettings& settings)
+	{
+		std::vector<QString> vFiles;
+		vFiles.reserve(task.m_vBitmaps.size());
+		for (const CFrameInfo& bitmap : task.m_vBitmaps)
+		{
+			QString identity = fileIdentity(bitmap.filePath);
+			if (identity.isEmpty())
+				return {};
+			vFiles.push_back(std::move(identity));
+		}
+		// The order of the frames doesn't change the master.
+		std::sort(vFiles.begin(), vFiles.end());
+
+		QCryptographicHash hash{ QCryptographicHash::Sha1 };
+		const auto addText = [&hash](const QString& text) { hash.addData(text.toUtf8()); };
+
+		addText(QString("%1\n").arg(type));
+		addText(QString("ISO=%1\nGain=%2\nExposure=%3\n").arg(task.m_lISOSpeed).arg(task.m_lGain).arg(task.m_fExposure, 0, 'g', 17));
+		addText(QString("Method=%1\nKappa=%2\nIterations=%3\n").arg(static_cast<int>(task.m_Method)).arg(task.m_fKappa, 0, 'g', 17).arg(task.m_lNrIterations));
+		addText(settings.GetSettingsText());
+		for (const QString& file : vFiles)
+			addText(file + '\n');
+
+		return QString::fromLatin1(hash.result().toHex());
+	}
+
+	bool MasterLibrary::find(const QString& key, fs::path& masterFile)
+	{
+		std::lock_guard lock{ mutex };
+		load();
+
+		const auto it = entries.find(key);
+		if (it == entries.end())
+			return false;
+
+		const fs::path file = masterPath(key);
+		std::error_code ec;
+		const std::uintmax_t size = fs::file_size(file, ec);
+		const std::int64_t modified = ec ? 0 : modificationTime(file, ec);
+
+		if (ec || size != it->second.size || modified != it->second.modified)
+		{
+			// The master was removed or changed outside of the library.
+			ZTRACE_RUNTIME("Master library: dropping invalid entry %s", key.toUtf8().constData());
+			entries.erase(it);
+			saveIndex();
+			return false;
+		}
+
+		it->second.lastUsed = nextUseTime();
+		appendToIndex(key, it->second);
+		pinnedKeys.insert(key);
+
+		masterFile = file;
+		return true;
+	}
+
+	bool MasterLibrary::add(const QString& key, const fs::path& masterFile)
+	{
+		std::lock_guard lock{ mutex };
+		load();
+
+		const fs::path file = masterPath(key);
+		std::error_code ec;
+		fs::create_directories(folder, ec);
+		if (!ec)
+			fs::copy_file(masterFile, file, fs::copy_options::overwrite_existing, ec);
+		const std::uintmax_t size = ec ? 0 : fs::file_size(file, ec);
+		const std::int64_t modified = ec ? 0 : modificationTime(file, ec);
+		if (ec)
+		{
+			ZTRACE_RUNTIME("Master library: can't add %s (%s)", masterFile.generic_u8string().c_str(), ec.message().c_str());
+			return false;
+		}
+
+		const Entry entry{ size, modified, nextUseTime() };
+		entries.insert_or_assign(key, entry);
+		appendToIndex(key, entry);
+
+		ZTRACE_RUNTIME("Master library: added %s as %s", masterFile.generic_u8string().c_str(), key.toUtf8().constData());
+		pinnedKeys.insert(key);
+		prune();
+		return true;
+	}
+
+	void MasterLibrary::endRun()
+	{
+		std::lock_guard lock{ mutex };
+		pinnedKeys.clear();
+		if (loaded)
+			prune();
+	}
+
+	// The current time, after the last use of all the entries (so that the order of the uses is kept within a millisecond).
+	std::int64_t MasterLibrary::nextUseTime() const
+	{
+		std::int64_t lastUsed = 0;
+		for (const auto& [key, entry] : entries)
+			lastUsed = std::max(lastUsed, entry.lastUsed);
+		return std::max(QDateTime::currentMSecsSinceEpoch(), lastUsed + 1);
+	}
+
+	// Appends the entry to the index, later lines replace the former entries of the same key.
+	void MasterLibrary::appendToIndex(const QString& key, const Entry& entry) const
+	{
+		QFile index{ QString::fromStdU16String(indexPath().generic_u16string()) };
+		if (index.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+			index.write(QString("%1 %2 %3 %4\n").arg(key).arg(entry.size).arg(entry.modified).arg(entry.lastUsed).toUtf8());
+	}
+
+	// Removes the least recently used masters that are not pinned (and not the last one) until the library fits in the size budget.
+	void MasterLibrary::prune()
+	{
+		const std::uint64_t limit = sizeLimit();
+		std::uint64_t totalSize = 0;
+		for (const auto& [key, entry] : entries)
+			totalSize += entry.size;
+
+		bool removed = false;
+		while (totalSize > limit && entries.size() > 1)
+		{
+			auto oldest = entries.end();
+			for (auto it = entries.begin(); it != entries.end(); ++it)
+				if (!pinnedKeys.contains(it->first) && (oldest == entries.end() || it->second.lastUsed < oldest->second.lastUsed))
+					oldest = it;
+			if (oldest == entries.end())
+				break;
+
+			ZTRACE_RUNTIME("Master library: removing %s", oldest->first.toUtf8().constData());
+			std::error_code ec;
+			fs::remove(masterPath(oldest->first), ec);
+			totalSize -= oldest->second.size;
+			entries.erase(oldest);
+			removed = true;
+		}
+
+		if (removed)
+			saveIndex();
+	}
+
+	fs::path MasterLibrary::masterPath(const QString& key) const
+	{
+		return folder / fs::path{ (key + ".tif").toStdU16String() };
+	}
+
+	fs::path MasterLibrary::indexPath() const
+	{
+		return folder / "MasterLibrary.idx";
+	}
+
+	void MasterLibrary::load()
+	{
+		if (loaded)
+			return;
+
+		folder = libraryFolder.empty() ? getFolder() : libraryFolder;
+		entries.clear();
+		loaded = true;
+
+		QFile index{ QString::fromStdU16String(indexPath().generic_u16string()) };
+		if (!index.open(QIODevice::ReadOnly | QIODevice::Text))
+			return;
+
+		int nrLines = 0;
+		while (!index.atEnd())
+		{
+			++nrLines;
+			// "key size modified lastUsed", the time of the last use is missing in the former index files.
+			const QList<QByteArray> fields = index.readLine().trimmed().split(' ');
+			if (fields.size() != 3 && fields.size() != 4)
+				continue;
+
+			bool sizeOk = false;
+			bool modifiedOk = false;
+			bool lastUsedOk = true;
+			const Entry entry{ fields[1].toULongLong(&sizeOk), fields[2].toLongLong(&modifiedOk), fields.size() == 4 ? fields[3].toLongLong(&lastUsedOk) : 0 };
+			if (sizeOk && modifiedOk && lastUsedOk)
+				entries.insert_or_assign(QString::fromLatin1(fields[0]), entry);
+		}
+
+		ZTRACE_RUNTIME("Master library: %d masters in %s", static_cast<int>(entries.size()), folder.generic_u8string().c_str());
+
+		// Each use appends a line, rewrite the index when most of its lines are replaced.
+		index.close();
+		if (nrLines > 2 * static_cast<int>(entries.size()) + 16)
+			saveIndex();
+	}
+
+	void MasterLibrary::saveIndex() const
+	{
+		const QString indexFile = QString::fromStdU16String(indexPath().generic_u16string());
+		QSaveFile index{ indexFile };
+		if (!index.open(QIODevice::WriteOnly | QIODevice::Text))
+			return;
+
+		for (const auto& [key, entry] : entries)
+			index.write(QString("%1 %2 %3 %4\n").arg(key).arg(entry.size).arg(entry.modified).arg(entry.lastUsed).toUtf8());
+		index.commit();
+	}
+}
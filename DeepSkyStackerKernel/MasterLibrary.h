@@ -0,0 +1,87 @@
+#pragma once
+#include <unordered_set>
+
+class CTaskInfo;
+class CGlobalSettings;
+
+namespace DSS
+{
+	//
+	// Library of master offsets, darks, dark flats and flats kept across runs and workspaces.
+	//
+	// A master is stored under a key which is a hash of the type of master, the path, size and modification time of each
+	// source frame, the ISO/gain and exposure, and the settings used to combine the frames (including the keys or files of
+	// the masters subtracted from them). As long as none of these changes, the same key is built again and the master is
+	// loaded from the library instead of being combined.
+	//
+	// The masters are copies (<key>.tif) in one folder with an index file, which is read once into a hash map. Lookups only
+	// check the size and modification time of the library file, an entry whose file was changed or removed is dropped.
+	//
+	// When the masters exceed the size budget, the least recently used ones (found or added) are removed, except the masters
+	// found or added during the current run (their files may still be loaded by the tasks) and the most recently used one.
+	// endRun() releases them and prunes the library.
+	//
+	class MasterLibrary final
+	{
+	public:
+		using LimitFunction = std::function<std::uint64_t()>;
+
+	private:
+		struct Entry
+		{
+			std::uintmax_t size;
+			std::int64_t modified;
+			std::int64_t lastUsed;	// Milliseconds since the epoch, 0 if not known
+		};
+
+		std::mutex mutex;
+		const fs::path libraryFolder;
+		const LimitFunction sizeLimit;
+		fs::path folder;
+		std::unordered_map<QString, Entry> entries;
+		std::unordered_set<QString> pinnedKeys;	// Found or added during the current run
+		bool loaded{ false };
+
+		MasterLibrary();
+
+	public:
+		// A library in the given folder with the given size budget (the instance uses the settings).
+		MasterLibrary(const fs::path& path, LimitFunction sizeBudget);
+		MasterLibrary(const MasterLibrary&) = delete;
+		MasterLibrary& operator=(const MasterLibrary&) = delete;
+
+		static MasterLibrary& instance();
+
+		// Folder of the library (QSettings "MasterLibraryFolder", default: <application data>/MasterLibrary).
+		static fs::path getFolder();
+		static void setFolder(const fs::path& path);
+
+		//
+		// Key of the master built from the frames of the task. The settings must be initialised with InitFromTask() and
+		// the masters the frames are calibrated with.
+		// Returns an empty key if a source frame can't be read.
+		//
+		static QString computeKey(const QString& type, const CTaskInfo& task, const CGlobalSettings& settings);
+
+		// "path|size|modification time" of a file, empty if the file can't be read.
+		static QString fileIdentity(const fs::path& file);
+
+		// Returns true and the library file if a valid master is stored under the key.
+		bool find(const QString& key, fs::path& masterFile);
+
+		// Copies the master file into the library under the key.
+		bool add(const QString& key, const fs::path& masterFile);
+
+		// End of a stacking or registering run: the masters found or added may be removed again.
+		void endRun();
+
+	private:
+		fs::path masterPath(const QString& key) const;
+		fs::path indexPath() const;
+		std::int64_t nextUseTime() const;
+		void appendToIndex(const QString& key, const Entry& entry) const;
+		void prune();
+		void load();
+		void saveIndex() const;
+	};
+}
@@ -5,6 +5,7 @@
 #include "Multitask.h"
 #include "DSSProgress.h"
 #include "DSSTools.h"
+#include "ConstantTimeMedian.h"
 
 using namespace DSS;
 
@@ -17,6 +18,16 @@ void CInternalMedianFilterEngineT<T>::CFilterTask::process()
 	const size_t filterSize = m_pEngine->m_lFilterSize;
 	int progress = 0;
 
+	// 16 bit data: the histogram based filter costs about the same per pixel for all filter sizes, but more than the
+	// per-pixel median for small windows (DeepSkyStackerBenchmark, CMedianFilterEngine vs. ConstantTimeMedianFilter).
+	// It is faster from a filter size of 4 on (window 9x9), with CFA from 6 on (only a quarter to a half of the pixels is used).
+	if constexpr (std::is_same_v<T, std::uint16_t>)
+	{
+		const size_t minConstantTimeSize = m_pEngine->m_CFAType == CFATYPE_NONE ? 4 : 6;
+		if (filterSize >= minConstantTimeSize && ConstantTimeMedianFilter::isSupported(static_cast<int>(filterSize), m_pEngine->m_CFAType))
+			return this->processConstantTime();
+	}
+
 	AvxImageFilter avxFilter(m_pEngine);
 	std::vector<T> values((filterSize * 2 + 1) * (filterSize * 2 + 1));
 
@@ -110,6 +121,41 @@ void CInternalMedianFilterEngineT<T>::CFilterTask::processNonAvx(const int lineS
 	}
 }
 
+//
+// The image is divided into vertical stripes, each stripe is filtered from top to bottom with the constant time median filter.
+// The result is identical to processNonAvx().
+//
+template <typename T>
+void CInternalMedianFilterEngineT<T>::CFilterTask::processConstantTime()
+{
+	if constexpr (std::is_same_v<T, std::uint16_t>)
+	{
+		const int width = m_pEngine->m_lWidth;
+		const int height = m_pEngine->m_lHeight;
+		const int nrProcessors = CMultitask::GetNrProcessors();
+		constexpr int stripeWidth = 64;
+		const int nrStripes = (width + stripeWidth - 1) / stripeWidth;
+		int progress = 0;
+
+		T* const pOutValues = m_pEngine->m_pvOutValues;
+		ConstantTimeMedianFilter filter{ m_pEngine->m_pvInValues, nullptr, width, height, m_pEngine->m_lFilterSize, m_pEngine->m_CFAType };
+
+#pragma omp parallel for default(none) firstprivate(filter) schedule(dynamic, 1) if(nrProcessors > 1)
+		for (int stripe = 0; stripe < nrStripes; ++stripe)
+		{
+			if (omp_get_thread_num() == 0 && m_pProgress != nullptr)
+				m_pProgress->Progress2(progress += (nrProcessors * height) / nrStripes);
+
+			const int colStart = stripe * stripeWidth;
+			filter.process(colStart, std::min(colStart + stripeWidth, width), [pOutValues, width](const int col, const int row, const std::uint16_t lower, const std::uint16_t upper, const int)
+			{
+				// Same as Median(): (a + b) / 2 in integer arithmetic.
+				pOutValues[static_cast<size_t>(row) * width + col] = static_cast<T>((lower + upper) / 2);
+			});
+		}
+	}
+}
+
 template <typename TType>
 void CInternalMedianFilterEngineT<TType>::ApplyFilter(ProgressBase* pProgress)
 {
@@ -113,6 +113,7 @@ public :
 		void process();
 	private:
 		void processNonAvx(const int lineStart, const int lineEnd, std::vector<TType>& vValues);
+		void processConstantTime();
 	};
 
 
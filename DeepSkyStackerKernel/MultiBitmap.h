@@ -5,6 +5,7 @@
 namespace DSS { class ProgressBase; }
 using namespace DSS;
 class CMemoryBitmap;
+class DSSRect;
 class CMultiBitmap
 {
 protected:
@@ -26,6 +27,7 @@ protected:
 private:
 	void	removeTempFiles();
 	void	InitParts();
+	bool	AddBitmapPart(CMemoryBitmap* pBitmap, const DSSRect& rcBitmap, const int lWidth, const int lHeight, const bool bAllRows, ProgressBase* pProgress);
 	std::shared_ptr<CMemoryBitmap> SmoothOut(CMemoryBitmap* pBitmap, ProgressBase* const pProgress) const;
 
 public:
@@ -78,6 +80,16 @@ public:
 	}
 
 	virtual bool AddBitmap(CMemoryBitmap* pMemoryBitmap, ProgressBase* pProgress = nullptr);
+	//
+	// Adds the lines lFirstRow to lFirstRow + pMemoryBitmap->RealHeight() - 1 of a bitmap of lHeight lines (drizzle in bands).
+	// The bands of a bitmap must be added from top to bottom, the bitmap is counted when its last line is added.
+	//
+	bool AddBitmapRows(CMemoryBitmap* pMemoryBitmap, const int lFirstRow, const int lHeight, ProgressBase* pProgress = nullptr);
+	//
+	// Adds a bitmap of lWidth x lHeight pixels of which pMemoryBitmap only holds the rectangle rcBitmap (mosaic frames),
+	// the pixels outside of it are 0.
+	//
+	bool AddBitmapRect(CMemoryBitmap* pMemoryBitmap, const DSSRect& rcBitmap, const int lWidth, const int lHeight, ProgressBase* pProgress = nullptr);
 	virtual std::shared_ptr<CMemoryBitmap> GetResult(ProgressBase* pProgress = nullptr);
 	virtual int GetNrChannels() const = 0;
 	virtual int GetNrBytesPerChannel() const = 0;
@@ -0,0 +1,267 @@
+#pragma once
+#include "DSSCommon.h"
+#include "avx_median.h"
+
+namespace DSS
+{
+	//
+	// Combines the values of the same pixel in all frames (the "pixel column") for a block of pixels at once.
+	// This is the portable path of CGrayMultiBitmapT/CColorMultiBitmapT::SetScanLines, used when the AVX output composition declines.
+	//
+	// The values of BatchSize consecutive pixels are transposed into a frame-major buffer:
+	//   values[k * BatchSize + p] = k-th (non-zero) value of pixel p
+	// Each pixel column is compacted (zeros removed, unless keepZeros), counts[p] is the number of values of pixel p.
+	// The statistics loops run over the pixels of the block for each frame, so the compiler can vectorise them.
+	// All buffers are allocated once per scan line, there is no heap traffic per pixel.
+	//
+	// The results are the same as those of Median, Average, Maximum, KappaSigmaClip and MedianKappaSigmaClip (DSSTools.h),
+	// homogenization and the auto adaptive weighted average are not supported.
+	//
+	template <typename TType>
+	class MultiBitmapBatch
+	{
+	public:
+		static constexpr int BatchSize = 64;
+
+	private:
+		std::vector<TType> values;
+		std::vector<int> counts;
+		std::vector<int> nrValues; // Number of values within the kappa-sigma bounds.
+		std::vector<TType> column; // One pixel column, for the median selection.
+		std::vector<double> sum;
+		std::vector<double> sumSq;
+		std::vector<double> lowerBound;
+		std::vector<double> upperBound;
+		std::vector<TType> median;
+		int nrPixels;
+
+	public:
+		explicit MultiBitmapBatch(const size_t nFrames) :
+			values(nFrames * BatchSize),
+			counts(BatchSize),
+			nrValues(BatchSize),
+			column(nFrames),
+			sum(BatchSize),
+			sumSq(BatchSize),
+			lowerBound(BatchSize),
+			upperBound(BatchSize),
+			median(BatchSize),
+			nrPixels{ 0 }
+		{}
+
+		static bool isSupported(const MULTIBITMAPPROCESSMETHOD method, const bool homogenization)
+		{
+			if (homogenization)
+				return false;
+			return method == MBP_MEDIAN || method == MBP_AVERAGE || method == MBP_MAXIMUM || method == MBP_SIGMACLIP || method == MBP_MEDIANSIGMACLIP;
+		}
+
+		//
+		// Transposes the pixels [offset, offset + nPixels) of all scan lines into the buffer.
+		// shift32: 32 bit integer values are shifted to 16 bit (the colour code does that).
+		//
+		void load(const std::vector<void*>& scanLines, const size_t offset, const int nPixels, const bool keepZeros, const bool shift32)
+		{
+			nrPixels = std::min(nPixels, BatchSize);
+			std::fill_n(counts.begin(), nrPixels, 0);
+
+			for (const void* const p : scanLines)
+			{
+				const TType* const pValues = static_cast<const TType*>(p) + offset;
+				for (int n = 0; n < nrPixels; ++n)
+				{
+					TType value = pValues[n];
+					if (value == 0 && !keepZeros)
+						continue;
+					if constexpr (std::is_integral_v<TType> && sizeof(TType) == 4)
+					{
+						if (shift32)
+							value >>= 16;
+					}
+					values[counts[n]++ * BatchSize + n] = value;
+				}
+			}
+		}
+
+		template <typename TTypeOutput>
+		void combine(const MULTIBITMAPPROCESSMETHOD method, const double kappa, const int nrIterations, TTypeOutput* const pOut)
+		{
+			switch (method)
+			{
+			case MBP_MEDIAN: return combineMedian(pOut);
+			case MBP_AVERAGE: return combineAverage(pOut);
+			case MBP_MAXIMUM: return combineMaximum(pOut);
+			case MBP_SIGMACLIP: return combineKappaSigma(kappa, nrIterations, pOut);
+			case MBP_MEDIANSIGMACLIP: return combineMedianKappaSigma(kappa, nrIterations, pOut);
+			default: return;
+			}
+		}
+
+	private:
+		int maxCount() const
+		{
+			return *std::max_element(counts.cbegin(), counts.cbegin() + nrPixels);
+		}
+
+		// Same as Median(std::vector<T>&) but on the values of one pixel column.
+		TType columnMedian(const int n)
+		{
+			const int count = counts[n];
+			if (count == 0)
+				return 0;
+			for (int k = 0; k < count; ++k)
+				column[k] = values[k * BatchSize + n];
+			return static_cast<TType>(qMedian(column.data(), count, count / 2));
+		}
+
+		// Sum of the values in pixel-column order, like Average(): sum / count (NaN for empty columns as well).
+		void calcSums()
+		{
+			std::fill_n(sum.begin(), nrPixels, 0.0);
+			const int nrRows = maxCount();
+			for (int k = 0; k < nrRows; ++k)
+			{
+				const TType* const pRow = values.data() + k * BatchSize;
+				for (int n = 0; n < nrPixels; ++n)
+					sum[n] += k < counts[n] ? static_cast<double>(pRow[n]) : 0.0;
+			}
+		}
+
+		template <typename TTypeOutput>
+		void combineAverage(TTypeOutput* const pOut)
+		{
+			calcSums();
+			for (int n = 0; n < nrPixels; ++n)
+				pOut[n] = static_cast<TTypeOutput>(sum[n] / counts[n]);
+		}
+
+		template <typename TTypeOutput>
+		void combineMaximum(TTypeOutput* const pOut)
+		{
+			std::vector<TType>& maximum = median; // Reuse the buffer.
+			std::fill_n(maximum.begin(), nrPixels, TType{ 0 });
+			const int nrRows = maxCount();
+			for (int k = 0; k < nrRows; ++k)
+			{
+				const TType* const pRow = values.data() + k * BatchSize;
+				for (int n = 0; n < nrPixels; ++n)
+					maximum[n] = (k == 0 || pRow[n] > maximum[n]) && k < counts[n] ? pRow[n] : maximum[n];
+			}
+			for (int n = 0; n < nrPixels; ++n)
+				pOut[n] = static_cast<TTypeOutput>(maximum[n]);
+		}
+
+		template <typename TTypeOutput>
+		void combineMedian(TTypeOutput* const pOut)
+		{
+			for (int n = 0; n < nrPixels; ++n)
+				pOut[n] = static_cast<TTypeOutput>(columnMedian(n));
+		}
+
+		//
+		// Kappa-sigma clipping with bounds instead of sorting and removing values:
+		// Each iteration computes average and sigma of the values within the bounds, then narrows the bounds.
+		// A clipped value never comes back, so the values within the bounds are exactly those KappaSigmaClip keeps.
+		// If no value is clipped, the following iterations give the same result (KappaSigmaClip stops in that case).
+		// If all values are clipped, the result is 0.
+		//
+		template <typename TTypeOutput>
+		void combineKappaSigma(const double kappa, const int nrIterations, TTypeOutput* const pOut)
+		{
+			const int nrRows = maxCount();
+			std::fill_n(lowerBound.begin(), nrPixels, -std::numeric_limits<double>::infinity());
+			std::fill_n(upperBound.begin(), nrPixels, std::numeric_limits<double>::infinity());
+
+			const auto calcStats = [this, nrRows]()
+			{
+				std::fill_n(sum.begin(), nrPixels, 0.0);
+				std::fill_n(sumSq.begin(), nrPixels, 0.0);
+				std::fill_n(nrValues.begin(), nrPixels, 0);
+				for (int k = 0; k < nrRows; ++k)
+				{
+					const TType* const pRow = values.data() + k * BatchSize;
+					for (int n = 0; n < nrPixels; ++n)
+					{
+						const double value = static_cast<double>(pRow[n]);
+						const bool inRange = k < counts[n] && value >= lowerBound[n] && value <= upperBound[n];
+						sum[n] += inRange ? value : 0.0;
+						sumSq[n] += inRange ? value * value : 0.0;
+						nrValues[n] += inRange ? 1 : 0;
+					}
+				}
+			};
+
+			calcStats();
+			for (int iteration = 0; iteration < nrIterations; ++iteration)
+			{
+				for (int n = 0; n < nrPixels; ++n)
+				{
+					if (nrValues[n] == 0) // Everything clipped -> empty interval.
+					{
+						lowerBound[n] = std::numeric_limits<double>::infinity();
+						upperBound[n] = -std::numeric_limits<double>::infinity();
+						continue;
+					}
+					const double N = static_cast<double>(nrValues[n]);
+					const double average = sum[n] / N;
+					const double sigma = std::sqrt(sumSq[n] / N - std::pow(sum[n] / N, 2));
+					// New bound first: a NaN sigma (negative variance due to rounding) clips everything, like in KappaSigmaClip.
+					lowerBound[n] = std::max(average - kappa * sigma, lowerBound[n]);
+					upperBound[n] = std::min(average + kappa * sigma, upperBound[n]);
+				}
+				calcStats();
+			}
+
+			for (int n = 0; n < nrPixels; ++n)
+				pOut[n] = static_cast<TTypeOutput>(nrValues[n] != 0 ? sum[n] / nrValues[n] : 0.0);
+		}
+
+		//
+		// Median kappa-sigma: values outside average +- kappa * sigma are replaced by the median (in place).
+		//
+		template <typename TTypeOutput>
+		void combineMedianKappaSigma(const double kappa, const int nrIterations, TTypeOutput* const pOut)
+		{
+			const int nrRows = maxCount();
+
+			for (int iteration = 0; iteration < nrIterations; ++iteration)
+			{
+				for (int n = 0; n < nrPixels; ++n)
+					median[n] = columnMedian(n);
+
+				// Sigma2(): average, then the sum of the squared deviations.
+				calcSums();
+				for (int n = 0; n < nrPixels; ++n)
+					sum[n] /= counts[n];
+				std::fill_n(sumSq.begin(), nrPixels, 0.0);
+				for (int k = 0; k < nrRows; ++k)
+				{
+					const TType* const pRow = values.data() + k * BatchSize;
+					for (int n = 0; n < nrPixels; ++n)
+					{
+						const double deviation = static_cast<double>(pRow[n]) - sum[n];
+						sumSq[n] += k < counts[n] ? deviation * deviation : 0.0;
+					}
+				}
+				for (int n = 0; n < nrPixels; ++n)
+				{
+					const double sigma = counts[n] != 0 ? std::sqrt(sumSq[n] / counts[n]) : 0.0;
+					lowerBound[n] = sum[n] - kappa * sigma;
+					upperBound[n] = sum[n] + kappa * sigma;
+				}
+
+				for (int k = 0; k < nrRows; ++k)
+				{
+					TType* const pRow = values.data() + k * BatchSize;
+					for (int n = 0; n < nrPixels; ++n)
+					{
+						const double value = static_cast<double>(pRow[n]);
+						pRow[n] = value >= lowerBound[n] && value <= upperBound[n] ? pRow[n] : median[n];
+					}
+				}
+			}
+
+			combineAverage(pOut);
+		}
+	};
+}
@@ -91,6 +91,25 @@ void CMultiBitmap::InitParts()
 
 // Save the bitmap to the temporary file
 bool CMultiBitmap::AddBitmap(CMemoryBitmap* pBitmap, ProgressBase* pProgress)
+{
+	return AddBitmapRows(pBitmap, 0, pBitmap->RealHeight(), pProgress);
+}
+
+bool CMultiBitmap::AddBitmapRows(CMemoryBitmap* pBitmap, const int lFirstRow, const int lHeight, ProgressBase* pProgress)
+{
+	return AddBitmapPart(pBitmap, DSSRect{ 0, lFirstRow, pBitmap->RealWidth(), lFirstRow + pBitmap->RealHeight() }, pBitmap->RealWidth(), lHeight, false, pProgress);
+}
+
+bool CMultiBitmap::AddBitmapRect(CMemoryBitmap* pBitmap, const DSSRect& rcBitmap, const int lWidth, const int lHeight, ProgressBase* pProgress)
+{
+	return AddBitmapPart(pBitmap, rcBitmap, lWidth, lHeight, true, pProgress);
+}
+
+//
+// pBitmap holds the rectangle rcBitmap of a bitmap of lWidth x lHeight pixels. The lines of rcBitmap are written,
+// and with bAllRows the other lines of the bitmap too (empty).
+//
+bool CMultiBitmap::AddBitmapPart(CMemoryBitmap* pBitmap, const DSSRect& rcBitmap, const int lWidth, const int lHeight, const bool bAllRows, ProgressBase* pProgress)
 {
 	static std::mutex initMutex{};
 
@@ -101,22 +120,37 @@ bool CMultiBitmap::AddBitmap(CMemoryBitmap* pBitmap, ProgressBase* pProgress)
 		auto lock = std::scoped_lock{ initMutex };
 		if (m_bInitDone.load() == false)
 		{
-			m_lWidth = pBitmap->RealWidth();
-			m_lHeight = pBitmap->RealHeight();
+			m_lWidth = lWidth;
+			m_lHeight = lHeight;
 			InitParts(); // Will set m_bInitDone to true
 			m_lNrAddedBitmaps = 0;
 		}
 	}
 
+	if (rcBitmap.left < 0 || rcBitmap.top < 0 || rcBitmap.right > m_lWidth || rcBitmap.bottom > m_lHeight
+		|| rcBitmap.width() != pBitmap->RealWidth() || rcBitmap.height() != pBitmap->RealHeight())
+		return false;
+
 	// Save the bitmap to the file
-	const size_t lScanLineSize = static_cast<size_t>(pBitmap->BitPerSample()) * (pBitmap->IsMonochrome() ? 1 : 3) * m_lWidth / 8;
+	const size_t nrChannels = pBitmap->IsMonochrome() ? 1 : 3;
+	const size_t bytesPerSample = static_cast<size_t>(pBitmap->BitPerSample()) / 8;
+	const size_t lScanLineSize = bytesPerSample * nrChannels * rcBitmap.width();
+	const size_t bitmapChannelSize = lScanLineSize / nrChannels;
+	// The spans are byte ranges of the channels of the whole line.
+	const size_t channelOffset = bytesPerSample * rcBitmap.left;
 	std::vector<std::uint8_t> scanLineBuffer(lScanLineSize);
+	const int lFirstRow = bAllRows ? 0 : rcBitmap.top;
+	const int lLastRow = bAllRows ? m_lHeight - 1 : rcBitmap.bottom - 1;
 
 	if (pProgress)
-		pProgress->Start2(m_lHeight);
+		pProgress->Start2(lLastRow - lFirstRow + 1);
 
-	for (const auto& partFile : m_vFiles)
+	for (auto& partFile : m_vFiles)
 	{
+		// The lines of this part are appended in order, so a part is only written by the bands it intersects.
+		if (partFile.m_lEndRow < lFirstRow || partFile.m_lStartRow > lLastRow)
+			continue;
+
 		auto dtor = [](FILE* fp) { if (fp != nullptr) fclose(fp); };
 		std::unique_ptr<FILE, decltype(dtor)> pFile{
 #if defined(Q_OS_WIN)
@@ -131,21 +165,42 @@ bool CMultiBitmap::AddBitmap(CMemoryBitmap* pBitmap, ProgressBase* pProgress)
 
 		fseek(pFile.get(), 0, SEEK_END);
 
-		for (int j = partFile.m_lStartRow; j <= partFile.m_lEndRow; j++)
+		for (int j = std::max(partFile.m_lStartRow, lFirstRow); j <= std::min(partFile.m_lEndRow, lLastRow); j++)
 		{
-			pBitmap->GetScanLine(j, scanLineBuffer.data());
-			if (fwrite(scanLineBuffer.data(), lScanLineSize, 1, pFile.get()) != 1)
-				return false;
+			// The lines outside of rcBitmap are empty.
+			const bool bInBitmap = j >= rcBitmap.top && j < rcBitmap.bottom;
+			if (bInBitmap)
+				pBitmap->GetScanLine(j - rcBitmap.top, scanLineBuffer.data());
+
+			// The scan line holds the channels one after the other, write the non zero bytes of each
+			// (mosaics leave most of the output rectangle empty in each frame), preceded by their [begin, end) byte range.
+			for (size_t channel = 0; channel < nrChannels; channel++)
+			{
+				const std::uint8_t* const pChannel = scanLineBuffer.data() + channel * bitmapChannelSize;
+				size_t begin = 0;
+				size_t end = bInBitmap ? bitmapChannelSize : 0;
+				while (begin < end && pChannel[begin] == 0)
+					++begin;
+				while (end > begin && pChannel[end - 1] == 0)
+					--end;
+
+				const std::uint32_t span[2] = { static_cast<std::uint32_t>(end > begin ? channelOffset + begin : 0), static_cast<std::uint32_t>(end > begin ? channelOffset + end : 0) };
+				if (fwrite(span, sizeof(span), 1, pFile.get()) != 1)
+					return false;
+				if (end > begin && fwrite(pChannel + begin, end - begin, 1, pFile.get()) != 1)
+					return false;
+			}
 
 			if (pProgress)
-				pProgress->Progress2(j + 1);
+				pProgress->Progress2(j - lFirstRow + 1);
 		}
 	}
 
 	if (pProgress)
 		pProgress->End2();
 
-	m_lNrAddedBitmaps++;
+	if (lLastRow == m_lHeight - 1)
+		m_lNrAddedBitmaps++;
 
 	return true;
 }
@@ -383,11 +438,12 @@ std::shared_ptr<CMemoryBitmap> CMultiBitmap::GetResult(ProgressBase* pProgress)
 			if (!bResult)
 				break;
 
-			// Read the full bitmap in memory
-			const size_t fileSize = lScanLineSize * m_lNrAddedBitmaps * (size_t{ 1 } + partFile.m_lEndRow - partFile.m_lStartRow);
+			// Read the full bitmap in memory, the bytes that were not written are zero.
+			const size_t bufferSize = lScanLineSize * m_lNrAddedBitmaps * (size_t{ 1 } + partFile.m_lEndRow - partFile.m_lStartRow);
 
-			if (fileSize > buffer.size())
-				buffer.resize(fileSize);
+			if (bufferSize > buffer.size())
+				buffer.resize(bufferSize);
+			std::fill_n(buffer.begin(), bufferSize, std::uint8_t{ 0 });
 
 			if (std::FILE* hFile =
 #if defined(Q_OS_WIN)
@@ -397,14 +453,34 @@ std::shared_ptr<CMemoryBitmap> CMultiBitmap::GetResult(ProgressBase* pProgress)
 #endif
 				)
 			{
-				bResult = fread(buffer.data(), 1, fileSize, hFile) == fileSize;
+				// The channels are in the order of the buffer: bitmap, row, channel. Each one is its [begin, end) byte range
+				// followed by these bytes.
+				const size_t channelSize = lScanLineSize / GetNrChannels();
+				std::uint32_t span[2];
+				size_t offset = 0;
+				for (; bResult && offset < bufferSize && fread(span, sizeof(span), 1, hFile) == 1; offset += channelSize)
+				{
+					const size_t begin = span[0];
+					const size_t end = span[1];
+					if (end > channelSize)
+						bResult = false;
+					else if (end > begin)
+						bResult = fread(buffer.data() + offset + begin, 1, end - begin, hFile) == end - begin;
+				}
+				// A truncated part file must not be combined with zero filled rows.
+				if (offset != bufferSize)
+					bResult = false;
 				fclose(hFile);
 			}
 			else
 				bResult = false;
 
 			if (!bResult)
+			{
+				// No result from a part file that can't be read.
+				pBitmap.reset();
 				break;
+			}
 
 			// More than 90% of the time of GetResult() is spent in CombineTask::process().
 			// Only 7% for reading the data from files.
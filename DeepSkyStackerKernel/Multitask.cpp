@@ -48,3 +48,48 @@ void CMultitask::SetUseSimd(const bool bUseSimd)
 {
 	QSettings{}.setValue("UseSimd", bUseSimd);
 }
+
+int CMultitask::GetMaxPrefetchedFrames()
+{
+	const auto nrFramesSetting = QSettings{}.value("MaxPrefetchedFrames", uint{ 0 }).toUInt();
+	if (nrFramesSetting != 0)
+		return static_cast<int>(nrFramesSetting);
+	// Automatic: one frame per 4 processors, at least one (the former single read-ahead), at most 8.
+	return std::clamp(GetNrProcessors() / 4, 1, 8);
+}
+
+void CMultitask::SetMaxPrefetchedFrames(const int nrFrames)
+{
+	QSettings{}.setValue("MaxPrefetchedFrames", static_cast<uint>(std::max(nrFrames, 0)));
+}
+
+std::uint64_t CMultitask::GetPrefetchMemoryLimit()
+{
+	return std::uint64_t{ QSettings{}.value("PrefetchMemoryMB", uint{ 2048 }).toUInt() } * 1024 * 1024;
+}
+
+void CMultitask::SetPrefetchMemoryLimit(const std::uint64_t megaBytes)
+{
+	QSettings{}.setValue("PrefetchMemoryMB", static_cast<uint>(megaBytes));
+}
+
+std::uint64_t CMultitask::GetMasterCacheMemoryLimit()
+{
+	// About the offset, dark and flat masters of a 24 Mpixel camera (32 bit gray): what the former cache kept loaded.
+	return std::uint64_t{ QSettings{}.value("MasterCacheMemoryMB", uint{ 512 }).toUInt() } * 1024 * 1024;
+}
+
+void CMultitask::SetMasterCacheMemoryLimit(const std::uint64_t megaBytes)
+{
+	QSettings{}.setValue("MasterCacheMemoryMB", static_cast<uint>(megaBytes));
+}
+
+std::uint64_t CMultitask::GetMasterLibrarySizeLimit()
+{
+	return std::uint64_t{ QSettings{}.value("MasterLibrarySizeMB", uint{ 4096 }).toUInt() } * 1024 * 1024;
+}
+
+void CMultitask::SetMasterLibrarySizeLimit(const std::uint64_t megaBytes)
+{
+	QSettings{}.setValue("MasterLibrarySizeMB", static_cast<uint>(megaBytes));
+}
@@ -12,4 +12,15 @@ public:
 	static void	SetReducedThreadsPriority(bool bReduced);
 	static bool GetUseSimd();
 	static void SetUseSimd(const bool bUseSimd);
+	// Frame prefetching (FramePrefetcher): number of frames loaded ahead (0 = automatic) and memory ceiling for them.
+	static int GetMaxPrefetchedFrames();
+	static void SetMaxPrefetchedFrames(const int nrFrames);
+	static std::uint64_t GetPrefetchMemoryLimit();
+	static void SetPrefetchMemoryLimit(const std::uint64_t megaBytes);
+	// Memory budget of the master offset/dark/flat frames kept loaded between the stacking groups.
+	static std::uint64_t GetMasterCacheMemoryLimit();
+	static void SetMasterCacheMemoryLimit(const std::uint64_t megaBytes);
+	// Disk budget of the master library (MasterLibrary), the least recently used masters are removed beyond it.
+	static std::uint64_t GetMasterLibrarySizeLimit();
+	static void SetMasterLibrarySizeLimit(const std::uint64_t megaBytes);
 };
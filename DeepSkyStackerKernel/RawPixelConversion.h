@@ -0,0 +1,77 @@
+#pragma once
+#include "Bayer.h"
+
+//
+// Pixel conversions of the RAW loader that write directly into the bitmap.
+// They give the same result as the former way through big endian rows and the bitmap filler
+// (BitmapFillerBase::adjustColor): the values are scaled by the colour factors and limited to 65534.
+//
+namespace DSS
+{
+	namespace RawPixelConversion
+	{
+		inline constexpr float Maximum = static_cast<float>(std::numeric_limits<std::uint16_t>::max() - 1);
+
+		// Colour factors of the bitmap filler for the 2x2 Bayer cell, indexed [row & 1][column & 1].
+		using BayerFactors = std::array<std::array<float, 2>, 2>;
+
+		inline bool isRgbBayerPattern(const CFATYPE cfaType)
+		{
+			return cfaType == CFATYPE_BGGR || cfaType == CFATYPE_GRBG || cfaType == CFATYPE_GBRG || cfaType == CFATYPE_RGGB;
+		}
+
+		inline BayerFactors bayerFactors(const CFATYPE cfaType, const float redScale, const float greenScale, const float blueScale)
+		{
+			const auto colourScale = [redScale, greenScale, blueScale](const BAYERCOLOR colour) -> float
+			{
+				switch (colour)
+				{
+				case BAYER_RED: return redScale;
+				case BAYER_BLUE: return blueScale;
+				default: return greenScale;
+				}
+			};
+			return { {
+				{ colourScale(::GetBayerColor(0, 0, cfaType)), colourScale(::GetBayerColor(1, 0, cfaType)) },
+				{ colourScale(::GetBayerColor(0, 1, cfaType)), colourScale(::GetBayerColor(1, 1, cfaType)) }
+			} };
+		}
+
+		//
+		// Linear stretch of one row of Bayer raw data (in place), followed by the colour factors if rgbBayerPattern is set.
+		// colourOf(row, column) returns the index into scaleMul (LibRaw::COLOR()).
+		//
+		template <class ColourOf>
+		void stretchBayerRow(std::uint16_t* const pRow, const int row, const int width, ColourOf&& colourOf, const float(&scaleMul)[4], const BayerFactors& factors, const bool rgbBayerPattern)
+		{
+			const std::array<float, 2>& rowFactors = factors[row & 1];
+			for (int col = 0; col < width; col++)
+			{
+				const float val = scaleMul[colourOf(row, col)] * static_cast<float>(pRow[col]);
+				const std::uint16_t stretched = static_cast<std::uint16_t>(std::clamp(static_cast<int>(val), 0, 65535));
+				pRow[col] = rgbBayerPattern ? static_cast<std::uint16_t>(std::min(static_cast<float>(stretched) * rowFactors[col & 1], Maximum)) : stretched;
+			}
+		}
+
+		//
+		// One row of a full colour image: curve[] applied to the 4-channel LibRaw image starting at sourceOffset and
+		// stepping by columnStep (flipped images), scaled by the colour factors.
+		//
+		inline void convertColourRow(const std::uint16_t(*const pImage)[4], const std::uint16_t* const pCurve, int sourceOffset, const int columnStep, const int width,
+			const float(&scales)[3], std::uint16_t* const pRed, std::uint16_t* const pGreen, std::uint16_t* const pBlue)
+		{
+			const auto adjust = [](const std::uint16_t value, const float scale) -> std::uint16_t
+			{
+				return static_cast<std::uint16_t>(std::min(static_cast<float>(value) * scale, Maximum));
+			};
+
+			for (int col = 0; col < width; col++, sourceOffset += columnStep)
+			{
+				const std::uint16_t* const pPixel = pImage[sourceOffset];
+				pRed[col] = adjust(pCurve[pPixel[0]], scales[0]);
+				pGreen[col] = adjust(pCurve[pPixel[1]], scales[1]);
+				pBlue[col] = adjust(pCurve[pPixel[2]], scales[2]);
+			}
+		}
+	}
+}
@@ -13,6 +13,7 @@
 #include "FITSUtil.h"
 #include "TIFFUtil.h"
 #include "MasterFrames.h"
+#include "FramePrefetcher.h"
 
 void CRegisteredFrame::Reset()
 {
@@ -988,7 +989,6 @@ bool CRegisterEngine::RegisterLightFrames(CAllStackingTasks& tasks, const QStrin
 {
 	ZFUNCTRACE_RUNTIME();
 	using ReadReturnType = std::tuple<std::shared_ptr<CMemoryBitmap>, bool, std::unique_ptr<CLightFrameInfo>, std::unique_ptr<CBitmapInfo>>;
-	using FutureType = std::future<ReadReturnType>;
 
 	const auto ReadTask = [bForce](const FRAMEINFOVECTOR::const_pointer pBitmap, ProgressBase* pTaskProgress) -> ReadReturnType
 	{
@@ -1115,15 +1115,16 @@ bool CRegisterEngine::RegisterLightFrames(CAllStackingTasks& tasks, const QStrin
 		CMasterFrames MasterFrames;
 		MasterFrames.LoadMasters(*it, pProgress);
 
-		FRAMEINFOVECTOR::const_pointer pData = it->m_pLightTask->m_vBitmaps.data(); // m_vBitmaps is not empty!
-		FutureType future = std::async(std::launch::deferred, ReadTask, pData, pProgress);
+		// First light frame synchronously, the next ones asynchronously (without progress).
+		const FRAMEINFOVECTOR& lightFrames = it->m_pLightTask->m_vBitmaps;
+		FramePrefetcher<ReadReturnType> frames{ lightFrames.size(),
+			[&ReadTask, &lightFrames](const size_t ndx, ProgressBase* pTaskProgress) { return ReadTask(&lightFrames[ndx], pTaskProgress); },
+			[&lightFrames](const size_t ndx) { return EstimateFrameMemory(lightFrames[ndx].filePath); }, pProgress };
 
 		int numberOfRegisteredLightframes = 0;
 		for (size_t j = 0; j < it->m_pLightTask->m_vBitmaps.size() && bResult; ++j)
 		{
-			pData = (j + 1) < it->m_pLightTask->m_vBitmaps.size() ? pData + 1 : nullptr;
-			ReadReturnType data = future.get();
-			future = std::async(std::launch::async, ReadTask, pData, nullptr);
+			ReadReturnType data = frames.get(j);
 
 			if (DoRegister(std::move(data), MasterFrames, *it, numberSeenFiles, false))
 			{
@@ -9,6 +9,7 @@
 #include "PixelTransform.h"
 #include "Stars.h"
 #include "RegisterEngine.h"
+#include "Multitask.h"
 
 
 
@@ -35,40 +36,49 @@ void CRunningStackingEngine::CreatePublicBitmap()
 			m_pPublicBitmap->Init(lWidth, lHeight);
 		}
 
-		BitmapIteratorConst<std::shared_ptr<const CMemoryBitmap>> itIn{ m_pStackedBitmap };
-		BitmapIterator<std::shared_ptr<CMemoryBitmap>> itOut{ m_pPublicBitmap };
+		//
+		// Every pixel changes with the number of stacked frames, so the whole bitmap is converted, but directly on the
+		// pixel vectors and in parallel: out = min(sum / count, 255) with the multipliers of the two bitmaps.
+		//
+		const double nrStacked = static_cast<double>(m_lNrStacked);
+		const auto convertPlane = [nrStacked](const CGrayBitmapT<float>& in, const double inMultiplier, std::vector<std::uint16_t>& out, const double outMultiplier)
+		{
+			const float* const pIn = in.m_vPixels.data();
+			std::uint16_t* const pOut = out.data();
+			const int nrPixels = static_cast<int>(out.size());
 
-		for (int j = 0; j < lHeight; j++)
+#pragma omp parallel for schedule(static, 100'000) default(none) if(CMultitask::GetNrProcessors() > 1)
+			for (int n = 0; n < nrPixels; n++)
+				pOut[n] = static_cast<std::uint16_t>(std::min(static_cast<double>(pIn[n]) / inMultiplier / nrStacked, 255.0) * outMultiplier);
+		};
+
+		if (bMonochrome)
 		{
-			for (int i = 0; i < lWidth; i++)
-			{
-				if (bMonochrome)
-				{
-					const double gray = itIn.GetPixel() / m_lNrStacked;
-					itOut.SetPixel(std::min(gray, 255.0));
-				}
-				else
-				{
-					double fRed, fGreen, fBlue;
-					itIn.GetPixel(fRed, fGreen, fBlue);
-					itOut.SetPixel(std::min(fRed / m_lNrStacked, 255.0), std::min(fGreen / m_lNrStacked, 255.0), std::min(fBlue / m_lNrStacked, 255.0));
-				}
-				++itIn;
-				++itOut;
-			}
+			const auto* const pIn = dynamic_cast<const C32BitFloatGrayBitmap*>(m_pStackedBitmap.get());
+			auto* const pOut = dynamic_cast<C16BitGrayBitmap*>(m_pPublicBitmap.get());
+			ZASSERTSTATE(pIn != nullptr && pOut != nullptr);
+			convertPlane(*pIn, pIn->GetMultiplier(), pOut->m_vPixels, pOut->GetMultiplier());
+		}
+		else
+		{
+			const auto* const pIn = dynamic_cast<const C96BitFloatColorBitmap*>(m_pStackedBitmap.get());
+			auto* const pOut = dynamic_cast<C48BitColorBitmap*>(m_pPublicBitmap.get());
+			ZASSERTSTATE(pIn != nullptr && pOut != nullptr);
+			convertPlane(pIn->m_Red, pIn->GetMultiplier(), pOut->m_Red.m_vPixels, pOut->GetMultiplier());
+			convertPlane(pIn->m_Green, pIn->GetMultiplier(), pOut->m_Green.m_vPixels, pOut->GetMultiplier());
+			convertPlane(pIn->m_Blue, pIn->GetMultiplier(), pOut->m_Blue.m_vPixels, pOut->GetMultiplier());
 		}
 	}
 }
 
-
-bool CRunningStackingEngine::AddImage(CLightFrameInfo& lfi, ProgressBase* pProgress)
+bool CRunningStackingEngine::AddImage(CLightFrameInfo& lfi, ProgressBase* pProgress, std::shared_ptr<CMemoryBitmap> pLoadedBitmap)
 {
 	ZFUNCTRACE_RUNTIME();
 	bool bResult = false;
 
-	// First load the input bitmap
-	std::shared_ptr<CMemoryBitmap> pBitmap;
-	if (::LoadFrame(lfi.filePath, PICTURETYPE_LIGHTFRAME, pProgress, pBitmap))
+	// First load the input bitmap (unless we already have it)
+	std::shared_ptr<CMemoryBitmap> pBitmap{ std::move(pLoadedBitmap) };
+	if (pBitmap || ::LoadFrame(lfi.filePath, PICTURETYPE_LIGHTFRAME, pProgress, pBitmap))
 	{
 		QString strText;
 		pBitmap->RemoveHotPixels(pProgress);
@@ -91,12 +101,7 @@ bool CRunningStackingEngine::AddImage(CLightFrameInfo& lfi, ProgressBase* pProgr
 			m_BackgroundCalibration.ComputeBackgroundCalibration(pBitmap.get(), !m_lNrStacked, pProgress);
 		};
 
-		// Stack it (average)
-		CPixelTransform PixTransform(lfi.m_BilinearParameters);
-		PIXELDISPATCHVECTOR vPixels;
-
-		vPixels.reserve(16);
-
+		// Stack it (sum, the average is computed in CreatePublicBitmap).
 		QString name{ QString::fromStdU16String(lfi.filePath.filename().generic_u16string()) };
 		if (lfi.m_lNrChannels == 3)
 			strText = QCoreApplication::translate("RunningStackingEngine", "Stacking %1 bit/ch %2 light frame\n%3", "IDS_STACKRGBLIGHT").arg(lfi.m_lBitsPerChannel).arg(lfi.m_strInfos).arg(name);
@@ -104,44 +109,9 @@ bool CRunningStackingEngine::AddImage(CLightFrameInfo& lfi, ProgressBase* pProgr
 			strText = QCoreApplication::translate("RunningStackingEngine", "Stacking %1 bits gray %2 light frame\n%3", "IDS_STACKGRAYLIGHT").arg(lfi.m_lBitsPerChannel).arg(lfi.m_strInfos).arg(name);
 		
 		if (pProgress != nullptr)
-			pProgress->Start2(strText, lHeight);
+			pProgress->Start2(strText, m_pStackedBitmap->Height());
 
-		for (int j = 0; j < lHeight; j++)
-		{
-			for (int i = 0; i < lWidth; i++)
-			{
-				double fRed, fGreen, fBlue;
-
-				const QPointF ptOut = PixTransform.transform(QPointF(i, j));
-				pBitmap->GetPixel(i, j, fRed, fGreen, fBlue);
-
-				if (m_BackgroundCalibration.m_BackgroundCalibrationMode != BCM_NONE)
-					m_BackgroundCalibration.ApplyCalibration(fRed, fGreen, fBlue);
-
-				if ((fRed != 0.0 || fGreen != 0.0 || fBlue != 0.0) && 
-					DSSRect { 0, 0, lWidth, lHeight }.contains(ptOut))
-				{
-					vPixels.resize(0);
-					ComputePixelDispatch(ptOut, 1.0, vPixels);
-
-					for (const CPixelDispatch& Pixel : vPixels)
-					{
-						// For each plane adjust the values
-						if (Pixel.m_lX >= 0 && Pixel.m_lX < lWidth && Pixel.m_lY >= 0 && Pixel.m_lY < lHeight)
-						{
-							double fPreviousRed, fPreviousGreen, fPreviousBlue;
-							m_pStackedBitmap->GetPixel(Pixel.m_lX, Pixel.m_lY, fPreviousRed, fPreviousGreen, fPreviousBlue);
-							fPreviousRed += fRed * Pixel.m_fPercentage;
-							fPreviousGreen += fGreen * Pixel.m_fPercentage;
-							fPreviousBlue += fBlue * Pixel.m_fPercentage;
-							m_pStackedBitmap->SetPixel(Pixel.m_lX, Pixel.m_lY, fPreviousRed, fPreviousGreen, fPreviousBlue);
-						}
-					}
-				}
-			}
-			if (pProgress != nullptr)
-				pProgress->Progress2(j+1);
-		}
+		StackPixels(*pBitmap, CPixelTransform{ lfi.m_BilinearParameters }, m_BackgroundCalibration, *m_pStackedBitmap, pProgress);
 
 		if (pProgress != nullptr)
 			pProgress->End2();
@@ -166,6 +136,133 @@ bool CRunningStackingEngine::AddImage(CLightFrameInfo& lfi, ProgressBase* pProgr
 
 /* ------------------------------------------------------------------- */
 
+void CRunningStackingEngine::StackPixels(const CMemoryBitmap& input, const CPixelTransform& pixTransform, const CBackgroundCalibration& backgroundCalibration, CMemoryBitmap& stack, ProgressBase* pProgress)
+{
+	ZFUNCTRACE_RUNTIME();
+	const int lWidth = input.Width();
+	const int lHeight = input.Height();
+	const int outWidth = stack.Width();
+	const int outHeight = stack.Height();
+	float* pOutRed = nullptr;
+	float* pOutGreen = nullptr;
+	float* pOutBlue = nullptr;
+	double multiplier = 1.0;
+	if (auto* const pColor = dynamic_cast<C96BitFloatColorBitmap*>(&stack))
+	{
+		pOutRed = pColor->m_Red.m_vPixels.data();
+		pOutGreen = pColor->m_Green.m_vPixels.data();
+		pOutBlue = pColor->m_Blue.m_vPixels.data();
+		multiplier = pColor->GetMultiplier();
+	}
+	else if (auto* const pGray = dynamic_cast<C32BitFloatGrayBitmap*>(&stack))
+	{
+		pOutRed = pGray->m_vPixels.data(); // Gray: only the red value is used, like in CGrayBitmapT::SetPixel(i, j, r, g, b).
+		multiplier = pGray->GetMultiplier();
+	}
+	ZASSERTSTATE(pOutRed != nullptr);
+
+	const bool applyCalibration = backgroundCalibration.m_BackgroundCalibrationMode != BCM_NONE;
+	const DSSRect inputRect{ 0, 0, lWidth, lHeight };
+	const int nrProcessors = CMultitask::GetNrProcessors();
+
+	//
+	// Each input pixel is dispatched to the (up to) 4 output pixels around its transformed position.
+	// The output is split into bands of rows, each band is owned by one thread which adds all the contributions
+	// to its rows in the order of the serial loop (input row, column, dispatch). So the sum doesn't depend on the
+	// number of threads and no atomic operations are needed.
+	// A first pass records for each block of BlockWidth input pixels the range of output rows it reaches, a band
+	// only processes the input blocks that can reach it (the blocks at a band boundary are processed twice).
+	//
+	constexpr int BlockWidth = 64;
+	constexpr int BandHeight = 32;
+	const int nrBlocks = (lWidth + BlockWidth - 1) / BlockWidth;
+	const int nrBands = (outHeight + BandHeight - 1) / BandHeight;
+	std::vector<std::pair<int, int>> blockRows(static_cast<size_t>(lHeight) * nrBlocks, { std::numeric_limits<int>::max(), std::numeric_limits<int>::min() });
+
+#pragma omp parallel for schedule(static, 50) default(none) shared(pixTransform, inputRect, blockRows) if(nrProcessors > 1)
+	for (int j = 0; j < lHeight; j++)
+	{
+		for (int block = 0; block < nrBlocks; block++)
+		{
+			auto& [minRow, maxRow] = blockRows[static_cast<size_t>(j) * nrBlocks + block];
+			for (int i = block * BlockWidth; i < std::min((block + 1) * BlockWidth, lWidth); i++)
+			{
+				const QPointF ptOut = pixTransform.transform(QPointF(i, j));
+				if (inputRect.contains(ptOut))
+				{
+					const int row = static_cast<int>(std::floor(ptOut.y()));
+					minRow = std::min(minRow, row);
+					maxRow = std::max(maxRow, row + 1);
+				}
+			}
+		}
+	}
+
+	std::atomic_int nrBandsDone{ 0 };
+
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(input, pixTransform, backgroundCalibration, inputRect, blockRows, nrBandsDone, pOutRed, pOutGreen, pOutBlue, multiplier, pProgress) if(nrProcessors > 1)
+	for (int band = 0; band < nrBands; band++)
+	{
+		const int firstRow = band * BandHeight;
+		const int endRow = std::min(firstRow + BandHeight, outHeight);
+
+		for (int j = 0; j < lHeight; j++)
+		{
+			for (int block = 0; block < nrBlocks; block++)
+			{
+				const auto [minRow, maxRow] = blockRows[static_cast<size_t>(j) * nrBlocks + block];
+				if (maxRow < firstRow || minRow >= endRow)
+					continue;
+
+				for (int i = block * BlockWidth; i < std::min((block + 1) * BlockWidth, lWidth); i++)
+				{
+					const QPointF ptOut = pixTransform.transform(QPointF(i, j));
+					const int row = static_cast<int>(std::floor(ptOut.y()));
+					if (row + 1 < firstRow || row >= endRow || !inputRect.contains(ptOut))
+						continue;
+
+					double fRed, fGreen, fBlue;
+					input.GetPixel(i, j, fRed, fGreen, fBlue);
+
+					if (applyCalibration)
+						backgroundCalibration.ApplyCalibration(fRed, fGreen, fBlue);
+
+					if (fRed != 0.0 || fGreen != 0.0 || fBlue != 0.0)
+					{
+						std::array<int, 4> xcoords, ycoords;
+						const std::array<double, 4> percents = ComputeAll4PixelDispatches(ptOut, xcoords, ycoords);
+
+						for (const int n : { 0, 1, 2, 3 })
+						{
+							const int x = xcoords[n];
+							const int y = ycoords[n];
+
+							// For each plane adjust the values
+							if (percents[n] > 0.0 && x >= 0 && x < outWidth && y >= firstRow && y < endRow)
+							{
+								const size_t offset = static_cast<size_t>(outWidth) * y + x;
+								const double weight = percents[n] * multiplier;
+								pOutRed[offset] += static_cast<float>(fRed * weight);
+								if (pOutGreen != nullptr)
+								{
+									pOutGreen[offset] += static_cast<float>(fGreen * weight);
+									pOutBlue[offset] += static_cast<float>(fBlue * weight);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		const int bandsDone = ++nrBandsDone; // All the threads count, the progress is reported by the master thread.
+		if (pProgress != nullptr && omp_get_thread_num() == 0)
+			pProgress->Progress2(std::min(bandsDone * BandHeight, outHeight));
+	}
+}
+
+/* ------------------------------------------------------------------- */
+
 bool	CRunningStackingEngine::ComputeOffset(CLightFrameInfo & lfi)
 {
 	ZFUNCTRACE_RUNTIME();
@@ -4,6 +4,7 @@
 
 class CMemoryBitmap;
 class CLightFrameInfo;
+class CPixelTransform;
 class CRunningStackingEngine
 {
 private:
@@ -22,7 +23,11 @@ public:
 	~CRunningStackingEngine() = default;
 
 	bool ComputeOffset(CLightFrameInfo& lfi);
-	bool AddImage(CLightFrameInfo& lfi, ProgressBase* pProgress);
+	// pLoadedBitmap: the frame as loaded by LoadFrame() if already available (it will be modified), otherwise the file is loaded.
+	bool AddImage(CLightFrameInfo& lfi, ProgressBase* pProgress, std::shared_ptr<CMemoryBitmap> pLoadedBitmap = {});
+	// Adds the transformed (and background calibrated) pixels of the input to the float stack (C32BitFloatGrayBitmap or C96BitFloatColorBitmap).
+	// The result doesn't depend on the number of threads.
+	static void StackPixels(const CMemoryBitmap& input, const CPixelTransform& pixTransform, const CBackgroundCalibration& backgroundCalibration, CMemoryBitmap& stack, ProgressBase* pProgress);
 	std::shared_ptr<CMemoryBitmap> getStackedImage()
 	{
 		return m_pPublicBitmap;
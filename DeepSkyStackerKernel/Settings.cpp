@@ -182,3 +182,48 @@ bool	CGlobalSettings::InitFromCurrent(CTaskInfo * pTask, const fs::path& file)
 };
 
 /* ------------------------------------------------------------------- */
+
+void	CGlobalSettings::InitFromTask(CTaskInfo * pTask)
+{
+	m_sSettings.clear();
+	m_vFiles.clear();
+	if (pTask && !pTask->m_vBitmaps.empty())
+	{
+		ReadFromRegistry();
+
+		bool				bFITS = false;
+		bool				bRAW  = false;
+
+		for (const CFrameInfo& bitmap : pTask->m_vBitmaps)
+		{
+			if (!bFITS && (bitmap.m_strInfos.left(4) == "FITS"))
+				bFITS = true;
+			else if (!bRAW && (bitmap.m_strInfos.left(3) == "RAW"))
+				bRAW = true;
+		};
+
+		const CFrameInfo& lastBitmap = pTask->m_vBitmaps.back();
+		AddVariable("Bitmap.Width", lastBitmap.m_lWidth);
+		AddVariable("Bitmap.Height", lastBitmap.m_lHeight);
+		AddVariable("Bitmap.NrChannels", lastBitmap.m_lNrChannels);
+
+		if (bFITS)
+			AddFITSSettings();
+		if (bRAW)
+			AddRAWSettings();
+	};
+};
+
+/* ------------------------------------------------------------------- */
+
+QString	CGlobalSettings::GetSettingsText() const
+{
+	QString				strResult;
+
+	for (const CSetting& s : m_sSettings)
+		strResult += QString("%1=%2\n").arg(s.m_strVariable, s.m_strValue);
+
+	return strResult;
+};
+
+/* ------------------------------------------------------------------- */
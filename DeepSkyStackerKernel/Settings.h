@@ -186,6 +186,15 @@ public :
 	bool	InitFromCurrent(CTaskInfo * pTask, const fs::path&);
 	void	WriteToFile(const fs::path&);
 
+	// Settings of the task without a master file and file list (used for the keys of the master library).
+	void	InitFromTask(CTaskInfo * pTask);
+	void	AddMasterKey(const QString& variable, const QString& key)
+	{
+		AddVariable(variable, key);
+	};
+	// All the settings as "variable=value" lines (sorted by variable).
+	QString	GetSettingsText() const;
+
 	virtual void	ReadFromRegistry() {};
 
 	bool operator == (const CGlobalSettings & gs) const;
@@ -376,7 +376,7 @@ COLORREF32	CStackedBitmap::GetPixel32(int X, int Y, bool bApplySettings)
 // };
 
 //
-// Invoked from DeepStack::PartialProcess() to display the picture
+// Renders pRect (the whole picture if null) at full resolution into the QImage buffer, used by updateQImagePreview() for level 0
 //
 void StackedBitmap::updateQImage(uchar* pImageData, qsizetype bytes_per_line, DSSRect* pRect)
 {
@@ -403,6 +403,7 @@ void StackedBitmap::updateQImage(uchar* pImageData, qsizetype bytes_per_line, DS
 	const float* const pBaseBluePixel = m_bMonochrome ? nullptr : m_vBluePlane.data() + (m_lWidth * lYMin + lXMin);
 
 	const size_t bufferLen = lXMax - lXMin;
+	const bool showClipping = QSettings{}.value("ShowBlackWhiteClipping", true).toBool();
 	AvxBezierAndSaturation avxBezierAndSaturation{ bufferLen };
 
 #pragma omp parallel for default(none) shared(lYMin) firstprivate(avxBezierAndSaturation) if(CMultitask::GetNrProcessors() > 1)
@@ -416,30 +417,165 @@ void StackedBitmap::updateQImage(uchar* pImageData, qsizetype bytes_per_line, DS
 		const float* const pGreenPixel = m_bMonochrome ? nullptr : pBaseGreenPixel + m_lWidth * (j - lYMin);
 		const float* const pBluePixel = m_bMonochrome ? nullptr : pBaseBluePixel + m_lWidth * (j - lYMin);
 
-		avxBezierAndSaturation.copyData(pRedPixel, pGreenPixel, pBluePixel, bufferLen, m_bMonochrome);
-		const auto [redBuffer, greenBuffer, blueBuffer] = avxBezierAndSaturation.getBufferPtr();
+		renderRow(avxBezierAndSaturation, pRedPixel, pGreenPixel, pBluePixel, bufferLen, m_BezierAdjust, m_HistoAdjust, showClipping, pOutPixel);
+	}
+}
+
+//
+// Invoked from DeepStack::PreviewProcess() to display a quick, reduced resolution version of the picture.
+// The preview level is rendered with the same pipeline as updateQImage() and each of its pixels is replicated into the
+// 2^level * 2^level image pixels it covers, so the QImage keeps the size (and coordinates) of the full image.
+//
+void StackedBitmap::updateQImagePreview(uchar* pImageData, qsizetype bytes_per_line, const int level)
+{
+	ZFUNCTRACE_RUNTIME();
 
-		avxBezierAndSaturation.avxAdjustRGB(m_lNrBitmaps, m_HistoAdjust);
-		avxBezierAndSaturation.avxToHsl(m_BezierAdjust.curvePoints);
-		avxBezierAndSaturation.avxBezierAdjust(bufferLen);
-		avxBezierAndSaturation.avxBezierSaturation(bufferLen, static_cast<float>(m_BezierAdjust.m_fSaturationShift));
-		avxBezierAndSaturation.avxToRgb(QSettings{}.value("ShowBlackWhiteClipping", true).toBool());
+	if (level <= 0)
+		return updateQImage(pImageData, bytes_per_line);
 
-		for (size_t n = 0; n < bufferLen; ++n)
+	const PreviewLevel& preview = getPreviewLevel(level);
+	const size_t bufferLen = preview.width;
+	const bool showClipping = QSettings{}.value("ShowBlackWhiteClipping", true).toBool();
+	AvxBezierAndSaturation avxBezierAndSaturation{ bufferLen };
+	std::vector<QRgb> previewRow(bufferLen);
+
+#pragma omp parallel for default(none) shared(preview, level, pImageData, bytes_per_line) firstprivate(avxBezierAndSaturation, previewRow) if(CMultitask::GetNrProcessors() > 1)
+	for (int j = 0; j < preview.height; j++)
+	{
+		const size_t offset = static_cast<size_t>(j) * preview.width;
+		const float* const pRedPixel = preview.redPlane.data() + offset;
+		const float* const pGreenPixel = m_bMonochrome ? nullptr : preview.greenPlane.data() + offset;
+		const float* const pBluePixel = m_bMonochrome ? nullptr : preview.bluePlane.data() + offset;
+
+		renderRow(avxBezierAndSaturation, pRedPixel, pGreenPixel, pBluePixel, bufferLen, m_BezierAdjust, m_HistoAdjust, showClipping, previewRow.data());
+
+		const int yMin = j << level;
+		const int yMax = std::min(m_lHeight, (j + 1) << level);
+		for (int y = yMin; y < yMax; y++)
 		{
-			*pOutPixel++ = qRgb(
-				std::clamp(redBuffer[n], 0.0F, 255.0F),
-				std::clamp(greenBuffer[n], 0.0F, 255.0F),
-				std::clamp(blueBuffer[n], 0.0F, 255.0F));
-			/*
-			*pOutPixel++ = qRgb(
-				std::clamp(pRedPixel[n], 0.0F, 255.0F),
-				std::clamp(pGreenPixel[n], 0.0F, 255.0F),
-				std::clamp(pBluePixel[n], 0.0F, 255.0F));
-				*/
+			QRgb* pOutPixel = reinterpret_cast<QRgb*>(pImageData + (bytes_per_line * y));
+			for (int x = 0; x < m_lWidth; x++)
+				pOutPixel[x] = previewRow[x >> level];
 		}
 	}
 }
+
+//
+// Invoked from TileRenderer on its worker thread.
+//
+void StackedBitmap::renderTile(uchar* pOutData, qsizetype bytes_per_line, const DSSRect& rc, const BezierAdjust& bezierAdjust,
+	const RGBHistogramAdjust& histoAdjust, const bool showClipping) const
+{
+	const int lXMin = std::max(0, rc.left);
+	const int lYMin = std::max(0, rc.top);
+	const int lXMax = std::min(m_lWidth, rc.right);
+	const int lYMax = std::min(m_lHeight, rc.bottom);
+	if (lXMin >= lXMax || lYMin >= lYMax)
+		return;
+
+	const size_t bufferLen = lXMax - lXMin;
+	AvxBezierAndSaturation avxBezierAndSaturation{ bufferLen };
+
+#pragma omp parallel for default(none) shared(pOutData, bytes_per_line, bezierAdjust, histoAdjust, showClipping) firstprivate(avxBezierAndSaturation) if(CMultitask::GetNrProcessors() > 1)
+	for (int j = lYMin; j < lYMax; j++)
+	{
+		const size_t offset = static_cast<size_t>(m_lWidth) * j + lXMin;
+		const float* const pRedPixel = m_vRedPlane.data() + offset;
+		const float* const pGreenPixel = m_bMonochrome ? nullptr : m_vGreenPlane.data() + offset;
+		const float* const pBluePixel = m_bMonochrome ? nullptr : m_vBluePlane.data() + offset;
+		QRgb* pOutPixel = reinterpret_cast<QRgb*>(pOutData + bytes_per_line * (j - lYMin));
+
+		renderRow(avxBezierAndSaturation, pRedPixel, pGreenPixel, pBluePixel, bufferLen, bezierAdjust, histoAdjust, showClipping, pOutPixel);
+	}
+}
+
+int StackedBitmap::previewLevel(const double displayScale)
+{
+	if (displayScale <= 0.0 || displayScale >= 1.0)
+		return 0;
+	// The coarsest level that still has at least one pixel per display pixel.
+	return std::clamp(static_cast<int>(std::floor(std::log2(1.0 / displayScale))), 0, MaxPreviewLevel);
+}
+
+const StackedBitmap::PreviewLevel& StackedBitmap::getPreviewLevel(const int level)
+{
+	ZASSERTSTATE(level > 0 && level <= MaxPreviewLevel);
+
+	while (static_cast<int>(m_vPreviewLevels.size()) < level)
+	{
+		// Build the next level from the previous one (or from the full planes).
+		const bool fromPlanes = m_vPreviewLevels.empty();
+		const int srcWidth = fromPlanes ? m_lWidth : m_vPreviewLevels.back().width;
+		const int srcHeight = fromPlanes ? m_lHeight : m_vPreviewLevels.back().height;
+		const CPixelVector& srcRed = fromPlanes ? m_vRedPlane : m_vPreviewLevels.back().redPlane;
+		const CPixelVector& srcGreen = fromPlanes ? m_vGreenPlane : m_vPreviewLevels.back().greenPlane;
+		const CPixelVector& srcBlue = fromPlanes ? m_vBluePlane : m_vPreviewLevels.back().bluePlane;
+
+		PreviewLevel next{ (srcWidth + 1) / 2, (srcHeight + 1) / 2 };
+		const size_t size = static_cast<size_t>(next.width) * next.height;
+		next.redPlane.resize(size);
+		if (!m_bMonochrome)
+		{
+			next.greenPlane.resize(size);
+			next.bluePlane.resize(size);
+		}
+
+		const auto reduce = [srcWidth, srcHeight, &next](const CPixelVector& src, CPixelVector& dst, const int j)
+		{
+			const int y0 = 2 * j;
+			const int y1 = std::min(y0 + 1, srcHeight - 1);
+			for (int i = 0; i < next.width; i++)
+			{
+				const int x0 = 2 * i;
+				const int x1 = std::min(x0 + 1, srcWidth - 1);
+				dst[static_cast<size_t>(j) * next.width + i] = 0.25f * (
+					src[static_cast<size_t>(y0) * srcWidth + x0] + src[static_cast<size_t>(y0) * srcWidth + x1] +
+					src[static_cast<size_t>(y1) * srcWidth + x0] + src[static_cast<size_t>(y1) * srcWidth + x1]);
+			}
+		};
+
+#pragma omp parallel for default(none) shared(next, srcRed, srcGreen, srcBlue, reduce) if(CMultitask::GetNrProcessors() > 1)
+		for (int j = 0; j < next.height; j++)
+		{
+			reduce(srcRed, next.redPlane, j);
+			if (!m_bMonochrome)
+			{
+				reduce(srcGreen, next.greenPlane, j);
+				reduce(srcBlue, next.bluePlane, j);
+			}
+		}
+
+		// The reference to the previous level is not used anymore, so the vector may reallocate.
+		m_vPreviewLevels.push_back(std::move(next));
+	}
+
+	return m_vPreviewLevels[level - 1];
+}
+
+//
+// Applies the histogram, curve and saturation settings to a row of stacked pixels and writes them as QRgb.
+//
+void StackedBitmap::renderRow(AvxBezierAndSaturation& avxBezierAndSaturation, const float* pRedPixel, const float* pGreenPixel, const float* pBluePixel,
+	const size_t length, const BezierAdjust& bezierAdjust, const RGBHistogramAdjust& histoAdjust, const bool showClipping, QRgb* pOutPixel) const
+{
+	avxBezierAndSaturation.copyData(pRedPixel, pGreenPixel, pBluePixel, length, m_bMonochrome);
+	const auto [redBuffer, greenBuffer, blueBuffer] = avxBezierAndSaturation.getBufferPtr();
+
+	avxBezierAndSaturation.avxAdjustRGB(m_lNrBitmaps, histoAdjust);
+	avxBezierAndSaturation.avxToHsl(bezierAdjust.curvePoints);
+	avxBezierAndSaturation.avxBezierAdjust(length);
+	avxBezierAndSaturation.avxBezierSaturation(length, static_cast<float>(bezierAdjust.m_fSaturationShift));
+	avxBezierAndSaturation.avxToRgb(showClipping);
+
+	for (size_t n = 0; n < length; ++n)
+	{
+		*pOutPixel++ = qRgb(
+			std::clamp(redBuffer[n], 0.0F, 255.0F),
+			std::clamp(greenBuffer[n], 0.0F, 255.0F),
+			std::clamp(blueBuffer[n], 0.0F, 255.0F));
+	}
+}
+
 //
 // MT, 11-March-2024
 // This function is only used for creating star masks.
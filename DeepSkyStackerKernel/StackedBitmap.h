@@ -8,6 +8,7 @@
 
 namespace DSS { class ProgressBase; }
 class CMemoryBitmap;
+class AvxBezierAndSaturation;
 /* ------------------------------------------------------------------- */
 
 #pragma pack(push, HDPIXELINFO, 4)
@@ -158,11 +159,31 @@ namespace DSS
 		RGBHistogramAdjust 		m_HistoAdjust;
 		CBitmapInfo	bmpInfo;
 
+		//
+		// Reduced copies of the planes for quick previews: level n has 1/2^n of the width and height, each pixel is the
+		// average of 2x2 pixels of the level above. m_vPreviewLevels[n - 1] is level n, built when first needed.
+		//
+		struct PreviewLevel
+		{
+			int width;
+			int height;
+			CPixelVector redPlane;
+			CPixelVector greenPlane;
+			CPixelVector bluePlane;
+		};
+		std::vector<PreviewLevel> m_vPreviewLevels;
+
+	public:
+		static constexpr int MaxPreviewLevel = 5;
+
 	private:
 		bool	LoadTIFF(const fs::path& file, DSS::ProgressBase* pProgress = nullptr);
 		bool	LoadFITS(const fs::path& file, DSS::ProgressBase* pProgress = nullptr);
 
 		COLORREF	GetPixel(float fRed, float fGreen, float fBlue, bool bApplySettings);
+		const PreviewLevel& getPreviewLevel(const int level);
+		void	renderRow(AvxBezierAndSaturation& avxBezierAndSaturation, const float* pRedPixel, const float* pGreenPixel, const float* pBluePixel,
+			const size_t length, const BezierAdjust& bezierAdjust, const RGBHistogramAdjust& histoAdjust, const bool showClipping, QRgb* pOutPixel) const;
 
 	public:
 		void	ReadSpecificTags(CTIFFReader* tiffReader);
@@ -189,6 +210,7 @@ namespace DSS
 
 			m_bMonochrome = bMonochrome;
 			lSize = m_lWidth * m_lHeight;
+			m_vPreviewLevels.clear();
 			m_vRedPlane.clear();
 			m_vGreenPlane.clear();
 			m_vBluePlane.clear();
@@ -323,6 +345,14 @@ namespace DSS
 		std::shared_ptr<CMemoryBitmap> GetBitmap(DSS::ProgressBase* const pProgress = nullptr);
 
 		void	updateQImage(uchar* pImageData, qsizetype bytes_per_line, DSSRect* pRect = nullptr);
+		// Renders the whole image from preview level "level": each preview pixel fills 2^level * 2^level image pixels.
+		void	updateQImagePreview(uchar* pImageData, qsizetype bytes_per_line, const int level);
+		// The preview level with about the resolution of the display, for a display scale (display pixels per image pixel).
+		static int previewLevel(const double displayScale);
+		// Renders rc into pOutData (the top left pixel of rc at pOutData) with the given settings instead of the bitmap's own.
+		// Only reads the planes, so it can run on another thread as long as the bitmap isn't loaded or cleared meanwhile.
+		void	renderTile(uchar* pOutData, qsizetype bytes_per_line, const DSSRect& rc, const BezierAdjust& bezierAdjust,
+			const RGBHistogramAdjust& histoAdjust, const bool showClipping) const;
 
 		void Clear()
 		{
@@ -334,17 +364,18 @@ namespace DSS
 			m_vRedPlane.clear();
 			m_vGreenPlane.clear();
 			m_vBluePlane.clear();
+			m_vPreviewLevels.clear();
 			m_lTotalTime = 0;
 			m_lISOSpeed = 0;
 			m_lGain = -1;
 		};
 
-		int	GetWidth()
+		int	GetWidth() const
 		{
 			return m_lWidth;
 		};
 
-		int	GetHeight()
+		int	GetHeight() const
 		{
 			return m_lHeight;
 		};
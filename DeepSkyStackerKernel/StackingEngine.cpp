@@ -15,6 +15,7 @@
 #include "FrameInfoSupport.h"
 #include "avx.h"
 #include "avx_avg.h"
+#include "avx_warp.h"
 #include "Ztrace.h"
 #include "Workspace.h"
 #include "MultiBitmap.h"
@@ -23,6 +24,7 @@
 #include "GreyMultiBitmap.h"
 #include "AHDDemosaicing.h"
 #include "BitmapIterator.h"
+#include "FramePrefetcher.h"
 
 
 #define _USE_MATH_DEFINES
@@ -1053,6 +1055,49 @@ inline void ExpandWithPoint(int & lLeft, int & lRight, int & lTop, int & lBottom
 	lBottom = max(lBottom, static_cast<int>(pt.y()));
 };
 
+// Bounding box of the frame in the output (corners and middle of the sides transformed).
+DSSRect CStackingEngine::computeFrameRectangle(CLightFrameInfo& frame) const
+{
+	QPointF			pt1(0, 0),
+					pt2(0, frame.RenderedHeight()),
+					pt3(frame.RenderedWidth(), 0),
+					pt4(frame.RenderedWidth(), frame.RenderedHeight()),
+					pt5(0, frame.RenderedHeight()/2),
+					pt6(frame.RenderedWidth(), frame.RenderedHeight()/2),
+					pt7(frame.RenderedWidth()/2, 0),
+					pt8(frame.RenderedWidth()/2, frame.RenderedHeight());
+
+	CPixelTransform		PixTransform(frame.m_BilinearParameters);
+
+	PixTransform.SetPixelSizeMultiplier(m_lPixelSizeMultiplier);
+
+	pt1 = PixTransform.transform(pt1);
+	pt2 = PixTransform.transform(pt2);
+	pt3 = PixTransform.transform(pt3);
+	pt4 = PixTransform.transform(pt4);
+	pt5 = PixTransform.transform(pt5);
+	pt6 = PixTransform.transform(pt6);
+	pt7 = PixTransform.transform(pt7);
+	pt8 = PixTransform.transform(pt8);
+
+	int				lLeft = pt1.x(),
+					lRight = pt1.x(),
+					lTop = pt1.y(),
+					lBottom = pt1.y();
+
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt2);
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt3);
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt4);
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt5);
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt6);
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt7);
+	ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt8);
+
+	DSSRect result;
+	result.setCoords(lLeft, lTop, lRight, lBottom);
+	return result;
+}
+
 DSSRect CStackingEngine::computeLargestRectangle()
 {
 	ZFUNCTRACE_RUNTIME();
@@ -1069,46 +1114,23 @@ DSSRect CStackingEngine::computeLargestRectangle()
 	{
 		if (!m_vBitmaps[i].m_bDisabled)
 		{
-			QPointF			pt1(0, 0),
-							pt2(0, m_vBitmaps[i].RenderedHeight()),
-							pt3(m_vBitmaps[i].RenderedWidth(), 0),
-							pt4(m_vBitmaps[i].RenderedWidth(), m_vBitmaps[i].RenderedHeight()),
-							pt5(0, m_vBitmaps[i].RenderedHeight()/2),
-							pt6(m_vBitmaps[i].RenderedWidth(), m_vBitmaps[i].RenderedHeight()/2),
-							pt7(m_vBitmaps[i].RenderedWidth()/2, 0),
-							pt8(m_vBitmaps[i].RenderedWidth()/2, m_vBitmaps[i].RenderedHeight());
-
-			CPixelTransform		PixTransform(m_vBitmaps[i].m_BilinearParameters);
-
-			PixTransform.SetPixelSizeMultiplier(m_lPixelSizeMultiplier);
-
-			pt1 = PixTransform.transform(pt1);
-			pt2 = PixTransform.transform(pt2);
-			pt3 = PixTransform.transform(pt3);
-			pt4 = PixTransform.transform(pt4);
-			pt5 = PixTransform.transform(pt5);
-			pt6 = PixTransform.transform(pt6);
-			pt7 = PixTransform.transform(pt7);
-			pt8 = PixTransform.transform(pt8);
+			const DSSRect rcFrame = computeFrameRectangle(m_vBitmaps[i]);
 
 			if (bFirst)
 			{
-				lLeft = lRight = pt1.x();
-				lTop  = lBottom = pt1.y();
+				lLeft = rcFrame.left;
+				lRight = rcFrame.right;
+				lTop = rcFrame.top;
+				lBottom = rcFrame.bottom;
 				bFirst = false;
 			}
 			else
 			{
-				ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt1);
+				lLeft = std::min(lLeft, rcFrame.left);
+				lRight = std::max(lRight, rcFrame.right);
+				lTop = std::min(lTop, rcFrame.top);
+				lBottom = std::max(lBottom, rcFrame.bottom);
 			}
-
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt2);
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt3);
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt4);
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt5);
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt6);
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt7);
-			ExpandWithPoint(lLeft, lRight, lTop, lBottom, pt8);
 		};
 	};
 
@@ -1116,6 +1138,35 @@ DSSRect CStackingEngine::computeLargestRectangle()
 	return result;
 };
 
+//
+// Size of the temporary files of the light frames of a mosaic (see CMultiBitmap::AddBitmap).
+// For each line of the mosaic and each channel, a frame writes a span header (begin and end, 2 x 4 bytes) followed by
+// the samples of the line it covers. The covered part of the lines is estimated with the bounding box of the transformed
+// frame, which is wider and higher than the frame when it is rotated.
+//
+std::int64_t CStackingEngine::computeMosaicTempFileSpace(const DSSRect& rcMosaic)
+{
+	std::int64_t result = 0;
+
+	for (CLightFrameInfo& frame : m_vBitmaps)
+	{
+		if (frame.m_bDisabled)
+			continue;
+
+		const DSSRect rcFrame = computeFrameRectangle(frame);
+		const std::int64_t lWidth = std::max(0, std::min(rcFrame.right, rcMosaic.right) - std::max(rcFrame.left, rcMosaic.left));
+		const std::int64_t lHeight = std::max(0, std::min(rcFrame.bottom, rcMosaic.bottom) - std::max(rcFrame.top, rcMosaic.top));
+		// The temporary bitmap is colour for colour and CFA frames, with 32 bit samples for 32 bit frames (see CreateMasterLightMultiBitmap).
+		const std::int64_t lNrChannels = (frame.m_lNrChannels > 1 || frame.GetCFAType() != CFATYPE_NONE) ? 3 : 1;
+		const std::int64_t lSampleSize = frame.m_lBitsPerChannel > 16 ? 4 : 2;
+		constexpr std::int64_t lSpanHeaderSize = 2 * sizeof(std::uint32_t);
+
+		result += lNrChannels * (lSpanHeaderSize * rcMosaic.height() + lWidth * lHeight * lSampleSize);
+	}
+
+	return result;
+}
+
 /* ------------------------------------------------------------------- */
 
 bool CStackingEngine::computeSmallestRectangle(DSSRect & rc)
@@ -1251,100 +1302,167 @@ void CStackingEngine::ComputeBitmap()
 
 /* ------------------------------------------------------------------- */
 
-bool CStackingEngine::AdjustEntropyCoverage()
+namespace
 {
-	ZFUNCTRACE_RUNTIME();
-
-	bool bResult = false;
+	double scaleByEntropy(const double color, const double entropy)
+	{
+		return entropy == 0.0 ? color : color / entropy;
+	}
 
-	if (static_cast<bool>(m_pEntropyCoverage))
+	// Divides the pixels of an output plane by those of the entropy coverage plane (same size and layout).
+	void adjustEntropyPlane(const float* const pEntropy, float* const pOutput, const int width, const int height)
 	{
-		ZTRACE_RUNTIME("Adjust Entropy Coverage");
+#pragma omp parallel for default(none) firstprivate(pEntropy, pOutput, width, height) if(CMultitask::GetNrProcessors() > 1)
+		for (int j = 0; j < height; j++)
+		{
+			const float* const pEntropyLine = pEntropy + static_cast<size_t>(j) * width;
+			float* const pOutputLine = pOutput + static_cast<size_t>(j) * width;
+			for (int i = 0; i < width; i++)
+				pOutputLine[i] = static_cast<float>(scaleByEntropy(pOutputLine[i], pEntropyLine[i]));
+		}
+	}
+}
 
-		const bool bColor = !m_pEntropyCoverage->IsMonochrome();
+//
+// Drizzle in bands: for each line of a bitmap transformed by PixTransform, the first and last lines of the result that
+// its pixels are dispatched to (on lPixelSize x lPixelSize pixels, as ComputePixelDispatch()), with a margin of one line.
+// The transformed coordinates are those of CPixelTransform::transform(), lines outside the result are clamped so that
+// their ranges (margin included) don't reach it.
+//
+std::vector<std::pair<int, int>> CStackingEngine::DrizzleRowRanges(const CPixelTransform& PixTransform, const int width, const int height, const int lPixelSize, const int resultHeight)
+{
+	std::vector<std::pair<int, int>> vRanges(height);
+	const double fStart = static_cast<double>(lPixelSize - 1) / 2.0;
+	const double fMinY = -3.0 - fStart;
+	const double fMaxY = resultHeight + 2.0 + fStart;
+	const AvxWarp avxWarp{ PixTransform };
 
-		for (int j = 0; j < m_pEntropyCoverage->Height(); j++)
+#pragma omp parallel default(none) shared(vRanges, avxWarp) firstprivate(width, height, fStart, fMinY, fMaxY) if(CMultitask::GetNrProcessors() > 1)
+	{
+		std::vector<double> vX(width);
+		std::vector<double> vY(width);
+
+#pragma omp for schedule(dynamic, 16)
+		for (int j = 0; j < height; j++)
 		{
-			for (int i = 0; i < m_pEntropyCoverage->Width(); i++)
+			avxWarp.transformLine(j, width, vX.data(), vY.data());
+			int first = std::numeric_limits<int>::max();
+			int last = std::numeric_limits<int>::min();
+			for (int i = 0; i < width; i++)
 			{
-				const auto scaleColor = [](const double color, const double entropy) -> double
-				{
-					return entropy == 0.0 ? color : color / entropy;
-				};
-
-				if (bColor)
-				{
-					double fRed, fGreen, fBlue;
-					double fEntropyRed, fEntropyGreen, fEntropyBlue;
+				const double y = std::clamp(vY[i], fMinY, fMaxY);
+				first = std::min(first, static_cast<int>(std::floor(y - fStart)));
+				last = std::max(last, static_cast<int>(std::floor(y + fStart)) + 1);
+			}
+			vRanges[j] = { first - 1, last + 1 };
+		}
+	}
 
-					m_pEntropyCoverage->GetValue(i, j, fEntropyRed, fEntropyGreen, fEntropyBlue);
-					m_pOutput->GetValue(i, j, fRed, fGreen, fBlue);
+	return vRanges;
+}
 
-					fRed = scaleColor(fRed, fEntropyRed);
-					fGreen = scaleColor(fGreen, fEntropyGreen);
-					fBlue = scaleColor(fBlue, fEntropyBlue);
+// The lines [first, last + 1[ of the bitmap reaching the result lines [lTop, lBottom[ (an empty range if none).
+std::pair<int, int> CStackingEngine::DrizzleInputRows(const std::vector<std::pair<int, int>>& vRanges, const int lTop, const int lBottom)
+{
+	int lStartRow = static_cast<int>(vRanges.size());
+	int lEndRow = 0;
 
-					m_pOutput->SetValue(i, j, fRed, fGreen, fBlue);
-				}
-				else
-				{
-					double fGray, fEntropyGray;
-					m_pEntropyCoverage->GetValue(i, j, fEntropyGray);
-					m_pOutput->GetValue(i, j, fGray);
-					m_pOutput->SetValue(i, j, scaleColor(fGray, fEntropyGray));
-				}
-			}
+	for (int j = 0; j < static_cast<int>(vRanges.size()); j++)
+	{
+		if (vRanges[j].first < lBottom && vRanges[j].second >= lTop)
+		{
+			lStartRow = std::min(lStartRow, j);
+			lEndRow = j + 1;
 		}
-		m_pEntropyCoverage.reset();
-		bResult = true;
 	}
 
-	return bResult;
+	return lStartRow < lEndRow ? std::make_pair(lStartRow, lEndRow) : std::make_pair(0, 0);
 }
 
-/* ------------------------------------------------------------------- */
-
-bool CStackingEngine::AdjustBayerDrizzleCoverage()
+//
+// Mosaic: the rectangle of the result that the pixels of a bitmap transformed by PixTransform are dispatched to
+// (on lPixelSize x lPixelSize pixels, as ComputePixelDispatch()), with a margin of two pixels.
+// A bitmap outside of the result gets a rectangle of one pixel.
+//
+DSSRect CStackingEngine::MosaicFrameWindow(const CPixelTransform& PixTransform, const int width, const int height, const int lPixelSize, const int resultWidth, const int resultHeight)
 {
-	ZFUNCTRACE_RUNTIME();
+	if (width <= 0 || height <= 0)
+		return DSSRect{ 0, 0, 1, 1 };
 
-	if (m_vPixelTransforms.empty())
-		return false;
+	const double fStart = static_cast<double>(lPixelSize - 1) / 2.0;
+	const AvxWarp avxWarp{ PixTransform };
+	// Transformed left, right, top and bottom of each line.
+	std::vector<std::array<double, 4>> vExtents(height);
 
-	ZTRACE_RUNTIME("Adjust Bayer Drizzle Coverage");
+#pragma omp parallel default(none) shared(vExtents, avxWarp) firstprivate(width, height) if(CMultitask::GetNrProcessors() > 1)
+	{
+		std::vector<double> vX(width);
+		std::vector<double> vY(width);
 
-	std::unique_ptr<C96BitFloatColorBitmap> pCover = std::make_unique<C96BitFloatColorBitmap>();
-	pCover->Init(m_rcResult.width(), m_rcResult.height());
+#pragma omp for schedule(dynamic, 16)
+		for (int j = 0; j < height; j++)
+		{
+			avxWarp.transformLine(j, width, vX.data(), vY.data());
+			const auto [minX, maxX] = std::minmax_element(vX.cbegin(), vX.cend());
+			const auto [minY, maxY] = std::minmax_element(vY.cbegin(), vY.cend());
+			vExtents[j] = { *minX, *maxX, *minY, *maxY };
+		}
+	}
 
-	QString strText = QCoreApplication::translate("StackingEngine", "Stacking - Adjust Bayer - Compute adjustment", "IDS_STACKING_COMPUTINGADJUSTMENT");
-	if (m_pProgress != nullptr)
-		m_pProgress->Start1(strText, static_cast<int>(m_vPixelTransforms.size()), false);
+	double fLeft = std::numeric_limits<double>::max();
+	double fRight = std::numeric_limits<double>::lowest();
+	double fTop = std::numeric_limits<double>::max();
+	double fBottom = std::numeric_limits<double>::lowest();
+	for (const auto& extent : vExtents)
+	{
+		fLeft = std::min(fLeft, extent[0]);
+		fRight = std::max(fRight, extent[1]);
+		fTop = std::min(fTop, extent[2]);
+		fBottom = std::max(fBottom, extent[3]);
+	}
+
+	if (!(fLeft <= fRight && fTop <= fBottom))
+		return DSSRect{ 0, 0, 1, 1 };
+
+	// Clamped before the conversions, a transformation can send pixels far away.
+	const auto toInt = [](const double value) { return static_cast<int>(std::clamp(value, -1.0e9, 1.0e9)); };
+	const int lLeft = std::max(toInt(std::floor(fLeft - fStart)) - 2, 0);
+	const int lTop = std::max(toInt(std::floor(fTop - fStart)) - 2, 0);
+	const int lRight = std::min(toInt(std::floor(fRight + fStart)) + 3, resultWidth);
+	const int lBottom = std::min(toInt(std::floor(fBottom + fStart)) + 3, resultHeight);
+
+	return lLeft < lRight && lTop < lBottom ? DSSRect{ lLeft, lTop, lRight, lBottom } : DSSRect{ 0, 0, 1, 1 };
+}
 
-	float* const pRed = pCover->GetRedPixel(0, 0);
-	float* const pGreen = pCover->GetGreenPixel(0, 0);
-	float* const pBlue = pCover->GetBluePixel(0, 0);
-	ZASSERTSTATE((reinterpret_cast<ptrdiff_t>(pRed) & (std::atomic_ref<float>::required_alignment - 1)) == 0);
-	ZASSERTSTATE((reinterpret_cast<ptrdiff_t>(pRed + 1) & (std::atomic_ref<float>::required_alignment - 1)) == 0);
-	ZASSERTSTATE((reinterpret_cast<ptrdiff_t>(pGreen) & (std::atomic_ref<float>::required_alignment - 1)) == 0);
-	ZASSERTSTATE((reinterpret_cast<ptrdiff_t>(pBlue) & (std::atomic_ref<float>::required_alignment - 1)) == 0);
+//
+// Adds the Bayer drizzle coverage of the result transformed by PixTransform to the cover, which holds the result lines
+// lBandTop to lBandTop + cover.Height() - 1. vRowRanges are the DrizzleRowRanges() of PixTransform (pixel size 1).
+// The cover is split into blocks of lines, each block is owned by one thread which adds all the contributions to its
+// lines in the order of the serial loop, so the sums don't depend on the number of threads or on the bands.
+//
+void CStackingEngine::AddBayerDrizzleCoverage(C96BitFloatColorBitmap& cover, const CPixelTransform& PixTransform, const std::vector<std::pair<int, int>>& vRowRanges,
+	const CFATYPE cfaType, const int width, const int height, const int lBandTop, ProgressBase* const pProgress)
+{
+	constexpr int BlockHeight = 32;
+	const int nrBlocks = (cover.Height() + BlockHeight - 1) / BlockHeight;
+	float* const pRed = cover.GetRedPixel(0, 0);
+	float* const pGreen = cover.GetGreenPixel(0, 0);
+	float* const pBlue = cover.GetBluePixel(0, 0);
 
-	for (int lNrBitmaps = 1; const CPixelTransform& PixTransform : m_vPixelTransforms)
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(PixTransform, vRowRanges, cover) firstprivate(pRed, pGreen, pBlue, cfaType, width, height, lBandTop, nrBlocks, pProgress) if(CMultitask::GetNrProcessors() > 1)
+	for (int block = 0; block < nrBlocks; block++)
 	{
-		if (m_pProgress != nullptr)
-		{
-			strText = QCoreApplication::translate("StackingEngine", "Compute adjustment %1 of %2", "IDS_COMPUTINGADJUSTMENT").arg(lNrBitmaps).arg(m_vPixelTransforms.size());
-			m_pProgress->Progress1(strText, lNrBitmaps);
-			m_pProgress->Start2(QString(" "), m_rcResult.width() * m_rcResult.height());
-		}
+		const int lBlockTop = lBandTop + block * BlockHeight;
+		const int lBlockBottom = std::min(lBlockTop + BlockHeight, lBandTop + cover.Height());
+		const auto [lStartRow, lEndRow] = DrizzleInputRows(vRowRanges, lBlockTop, lBlockBottom);
 
-#pragma omp parallel for schedule(static, 250) default(none) shared(PixTransform) if(CMultitask::GetNrProcessors() > 1)
-		for (int j = 0; j < m_rcResult.height(); ++j)
+		for (int j = lStartRow; j < lEndRow; ++j)
 		{
-			for (const int i : std::views::iota(0, m_rcResult.width()))
+			for (const int i : std::views::iota(0, width))
 			{
 				const QPointF ptOut = PixTransform.transform(QPointF(i, j));
 
-				if (DSSRect{ 0, 0, m_rcResult.width(), m_rcResult.height() }.contains(ptOut))
+				if (DSSRect{ 0, 0, width, height }.contains(ptOut))
 				{
 					std::array<int, 4> xcoords, ycoords;
 					std::array<double, 4> percents = ComputeAll4PixelDispatches(ptOut, xcoords, ycoords);
@@ -1357,119 +1475,283 @@ bool CStackingEngine::AdjustBayerDrizzleCoverage()
 						// For each plane adjust the values
 						if (const float percent = static_cast<float>(percents[n]);
 							percent > 0.0f
-							&& x >= 0 && x < m_rcResult.width()
-							&& y >= 0 && y < m_rcResult.height())
+							&& x >= 0 && x < width
+							&& y >= lBlockTop && y < lBlockBottom)
 						{
-							const auto update = [offset = static_cast<size_t>(m_rcResult.width()) * y + x, percent](float* const vals)
-							{
-								std::atomic_ref{ vals[offset] } += percent;
-							};
+							const size_t offset = static_cast<size_t>(width) * (y - lBandTop) + x;
 
-							switch (GetBayerColor(i, j, m_InputCFAType))
+							switch (GetBayerColor(i, j, cfaType))
 							{
 							case BAYER_RED:   //fRedCover   += pixDispatch.m_fPercentage; break;
-								update(pRed); break;
+								pRed[offset] += percent; break;
 							case BAYER_GREEN: //fGreenCover += pixDispatch.m_fPercentage; break;
-								update(pGreen); break;
+								pGreen[offset] += percent; break;
 							case BAYER_BLUE:  //fBlueCover  += pixDispatch.m_fPercentage; break;
-								update(pBlue); break;
+								pBlue[offset] += percent; break;
 							}
 						}
 					}
 				}
 			}
-			if (m_pProgress != nullptr && omp_get_thread_num() == 0)
-				m_pProgress->Progress2(j * m_rcResult.width());
 		}
+		if (pProgress != nullptr && omp_get_thread_num() == 0)
+			pProgress->Progress2(lBlockBottom * width);
+	}
+}
 
-		if (m_pProgress != nullptr && omp_get_thread_num() == 0)
-			m_pProgress->End2();
-		++lNrBitmaps;
+bool CStackingEngine::AdjustEntropyCoverage()
+{
+	ZFUNCTRACE_RUNTIME();
+
+	bool bResult = false;
+
+	if (static_cast<bool>(m_pEntropyCoverage))
+	{
+		ZTRACE_RUNTIME("Adjust Entropy Coverage");
+
+		const bool bColor = !m_pEntropyCoverage->IsMonochrome();
+		const int width = m_pEntropyCoverage->Width();
+		const int height = m_pEntropyCoverage->Height();
+
+		auto* const pColorEntropy = dynamic_cast<C96BitFloatColorBitmap*>(m_pEntropyCoverage.get());
+		auto* const pColorOutput = dynamic_cast<C96BitFloatColorBitmap*>(m_pOutput.get());
+		auto* const pGrayEntropy = dynamic_cast<C32BitFloatGrayBitmap*>(m_pEntropyCoverage.get());
+		auto* const pGrayOutput = dynamic_cast<C32BitFloatGrayBitmap*>(m_pOutput.get());
+
+		if (pColorEntropy != nullptr && pColorOutput != nullptr && pColorOutput->Width() == width && pColorOutput->Height() == height
+			&& pColorEntropy->isTopDown() && pColorOutput->isTopDown())
+		{
+			adjustEntropyPlane(pColorEntropy->m_Red.m_vPixels.data(), pColorOutput->m_Red.m_vPixels.data(), width, height);
+			adjustEntropyPlane(pColorEntropy->m_Green.m_vPixels.data(), pColorOutput->m_Green.m_vPixels.data(), width, height);
+			adjustEntropyPlane(pColorEntropy->m_Blue.m_vPixels.data(), pColorOutput->m_Blue.m_vPixels.data(), width, height);
+		}
+		else if (pGrayEntropy != nullptr && pGrayOutput != nullptr && pGrayOutput->Width() == width && pGrayOutput->Height() == height
+			&& !pGrayEntropy->IsCFA() && !pGrayOutput->IsCFA())
+		{
+			adjustEntropyPlane(pGrayEntropy->m_vPixels.data(), pGrayOutput->m_vPixels.data(), width, height);
+		}
+		else
+		{
+#pragma omp parallel for default(none) firstprivate(width, height, bColor) if(CMultitask::GetNrProcessors() > 1)
+			for (int j = 0; j < height; j++)
+			{
+				for (int i = 0; i < width; i++)
+				{
+					if (bColor)
+					{
+						double fRed, fGreen, fBlue;
+						double fEntropyRed, fEntropyGreen, fEntropyBlue;
+
+						m_pEntropyCoverage->GetValue(i, j, fEntropyRed, fEntropyGreen, fEntropyBlue);
+						m_pOutput->GetValue(i, j, fRed, fGreen, fBlue);
+
+						fRed = scaleByEntropy(fRed, fEntropyRed);
+						fGreen = scaleByEntropy(fGreen, fEntropyGreen);
+						fBlue = scaleByEntropy(fBlue, fEntropyBlue);
+
+						m_pOutput->SetValue(i, j, fRed, fGreen, fBlue);
+					}
+					else
+					{
+						double fGray, fEntropyGray;
+						m_pEntropyCoverage->GetValue(i, j, fEntropyGray);
+						m_pOutput->GetValue(i, j, fGray);
+						m_pOutput->SetValue(i, j, scaleByEntropy(fGray, fEntropyGray));
+					}
+				}
+			}
+		}
+		m_pEntropyCoverage.reset();
+		bResult = true;
 	}
 
-	m_vPixelTransforms.clear();
+	return bResult;
+}
+
+/* ------------------------------------------------------------------- */
+
+bool CStackingEngine::AdjustBayerDrizzleCoverage()
+{
+	ZFUNCTRACE_RUNTIME();
+
+	if (m_vPixelTransforms.empty())
+		return false;
+
+	ZTRACE_RUNTIME("Adjust Bayer Drizzle Coverage");
+
+	const int width = m_rcResult.width();
+	const int height = m_rcResult.height();
+
+	// Drizzle in bands: the coverage is computed band by band, once for the maximum and once more to adjust the output.
+	const bool bBands = m_bDrizzleBands && m_lPixelSizeMultiplier > 1;
+	const int lBandHeight = bBands ? std::min(DrizzleBandHeight, height) : height;
+	const int nrBands = (height + lBandHeight - 1) / lBandHeight;
+
+	std::vector<std::vector<std::pair<int, int>>> vRowRanges;
+	for (const CPixelTransform& PixTransform : m_vPixelTransforms)
+		vRowRanges.push_back(DrizzleRowRanges(PixTransform, width, height, 1, height));
 
+	QString strText = QCoreApplication::translate("StackingEngine", "Stacking - Adjust Bayer - Compute adjustment", "IDS_STACKING_COMPUTINGADJUSTMENT");
 	if (m_pProgress != nullptr)
+		m_pProgress->Start1(strText, bBands ? nrBands : static_cast<int>(m_vPixelTransforms.size()), false);
+
+	// Coverage of the band of lines starting at lBandTop.
+	const auto computeCoverage = [this, &vRowRanges, width, height](const int lBandTop, const int lBandRows, ProgressBase* const pProgress)
 	{
-		strText = QCoreApplication::translate("StackingEngine", "Stacking - Adjust Bayer - Apply adjustment", "IDS_STACKING_APPLYINGADJUSTMENT");
-		m_pProgress->Start1(strText, 2, false);
-		strText = QCoreApplication::translate("StackingEngine", "Compute maximum adjustment", "IDS_STACKING_COMPUTEMAXADJUSTMENT");
-		m_pProgress->Start2(strText, m_rcResult.width() * m_rcResult.height());
-	}
+		std::unique_ptr<C96BitFloatColorBitmap> pCover = std::make_unique<C96BitFloatColorBitmap>();
+		pCover->Init(width, lBandRows);
+
+		for (int lNrBitmaps = 1; const CPixelTransform& PixTransform : m_vPixelTransforms)
+		{
+			if (pProgress != nullptr)
+			{
+				const QString strAdjustment = QCoreApplication::translate("StackingEngine", "Compute adjustment %1 of %2", "IDS_COMPUTINGADJUSTMENT").arg(lNrBitmaps).arg(m_vPixelTransforms.size());
+				pProgress->Progress1(strAdjustment, lNrBitmaps);
+				pProgress->Start2(QString(" "), width * height);
+			}
+
+			AddBayerDrizzleCoverage(*pCover, PixTransform, vRowRanges[lNrBitmaps - 1], m_InputCFAType, width, height, lBandTop, pProgress);
+
+			if (pProgress != nullptr)
+				pProgress->End2();
+			++lNrBitmaps;
+		}
+
+		return pCover;
+	};
 
 	//
 	// Compute the maximum coverage
 	//
-	double fMaxCoverage = 0;
-	BitmapIteratorConst<const C96BitFloatColorBitmap*> it{ pCover.get() };
-	for (int j = 0; j < m_rcResult.height(); j++)
+	const auto maxCoverage = [width](const C96BitFloatColorBitmap& cover, const int lBandTop, ProgressBase* const pProgress)
 	{
-		it.Reset(0, j);
-		for (int i = 0; i < m_rcResult.width(); i++, ++it)
+		double fMaxCoverage = 0;
+		BitmapIteratorConst<const C96BitFloatColorBitmap*> it{ &cover };
+		for (int j = 0; j < cover.Height(); j++)
 		{
-			double fRedCover, fGreenCover, fBlueCover;
+			it.Reset(0, j);
+			for (int i = 0; i < width; i++, ++it)
+			{
+				double fRedCover, fGreenCover, fBlueCover;
 
 //				pCover->GetValue(i, j, fRedCover, fGreenCover, fBlueCover);
-			it.GetPixel(fRedCover, fGreenCover, fBlueCover);
+				it.GetPixel(fRedCover, fGreenCover, fBlueCover);
+
+				fMaxCoverage = std::max(fMaxCoverage, fRedCover);
+				fMaxCoverage = std::max(fMaxCoverage, fGreenCover);
+				fMaxCoverage = std::max(fMaxCoverage, fBlueCover);
+			}
 
-			fMaxCoverage = std::max(fMaxCoverage, fRedCover);
-			fMaxCoverage = std::max(fMaxCoverage, fGreenCover);
-			fMaxCoverage = std::max(fMaxCoverage, fBlueCover);
+			if (pProgress != nullptr)
+				pProgress->Progress2((lBandTop + j) * width);
 		}
+		return fMaxCoverage;
+	};
 
-		if (m_pProgress != nullptr)
-			m_pProgress->Progress2(j * m_rcResult.width());
+	std::unique_ptr<C96BitFloatColorBitmap> pCover;
+	double fMaxCoverage = 0;
+	for (int lBandTop = 0, lNrBand = 1; lBandTop < height; lBandTop += lBandHeight, ++lNrBand)
+	{
+		pCover = computeCoverage(lBandTop, std::min(lBandHeight, height - lBandTop), bBands ? nullptr : m_pProgress);
+		if (bBands)
+		{
+			fMaxCoverage = std::max(fMaxCoverage, maxCoverage(*pCover, lBandTop, nullptr));
+			if (m_pProgress != nullptr)
+				m_pProgress->Progress1(lNrBand);
+		}
+	}
+
+	if (m_pProgress != nullptr)
+	{
+		strText = QCoreApplication::translate("StackingEngine", "Stacking - Adjust Bayer - Apply adjustment", "IDS_STACKING_APPLYINGADJUSTMENT");
+		m_pProgress->Start1(strText, 2, false);
+		strText = QCoreApplication::translate("StackingEngine", "Compute maximum adjustment", "IDS_STACKING_COMPUTEMAXADJUSTMENT");
+		m_pProgress->Start2(strText, width * height);
 	}
 
+	if (!bBands)
+		fMaxCoverage = maxCoverage(*pCover, 0, m_pProgress);
+
 	if (m_pProgress != nullptr)
 	{
 		m_pProgress->End2();
 		m_pProgress->Progress1(1);
 		strText = QCoreApplication::translate("StackingEngine", "Applying adjustment", "IDS_STACKING_APPLYADJUSTMENT");
-		m_pProgress->Start2(strText, m_rcResult.width() * m_rcResult.height());
+		m_pProgress->Start2(strText, width * height);
 	}
 
 	//
 	// Adjust the coverage of all pixels
 	//
 	BitmapIterator outIt{ m_pOutput };
-	for (int j = 0; j < m_rcResult.height(); j++)
+	for (int lBandTop = 0; lBandTop < height; lBandTop += lBandHeight)
 	{
-		it.Reset(0, j);
-		outIt.Reset(0, j);
-		for (int i = 0; i < m_rcResult.width(); i++, ++it, ++outIt)
+		// Without bands, the cover of the single band is still there.
+		if (bBands)
+			pCover = computeCoverage(lBandTop, std::min(lBandHeight, height - lBandTop), nullptr);
+
+		BitmapIteratorConst<const C96BitFloatColorBitmap*> it{ pCover.get() };
+		for (int j = 0; j < pCover->Height(); j++)
 		{
-			double fRedCover, fGreenCover, fBlueCover;
-			double fRed, fGreen, fBlue;
+			it.Reset(0, j);
+			outIt.Reset(0, lBandTop + j);
+			for (int i = 0; i < width; i++, ++it, ++outIt)
+			{
+				double fRedCover, fGreenCover, fBlueCover;
+				double fRed, fGreen, fBlue;
 
 //				pCover->GetValue(i, j, fRedCover, fGreenCover, fBlueCover);
-			it.GetPixel(fRedCover, fGreenCover, fBlueCover);
+				it.GetPixel(fRedCover, fGreenCover, fBlueCover);
 //				m_pOutput->GetValue(i, j, fRed, fGreen, fBlue);
-			outIt.GetPixel(fRed, fGreen, fBlue);
+				outIt.GetPixel(fRed, fGreen, fBlue);
 
-			if (fRedCover > 0)
-				fRed *= fMaxCoverage / fRedCover;
-			if (fGreenCover > 0)
-				fGreen *= fMaxCoverage / fGreenCover;
-			if (fBlueCover > 0)
-				fBlue *= fMaxCoverage / fBlueCover;
+				if (fRedCover > 0)
+					fRed *= fMaxCoverage / fRedCover;
+				if (fGreenCover > 0)
+					fGreen *= fMaxCoverage / fGreenCover;
+				if (fBlueCover > 0)
+					fBlue *= fMaxCoverage / fBlueCover;
 
 //				m_pOutput->SetValue(i, j, fRed, fGreen, fBlue);
-			outIt.SetPixel(fRed, fGreen, fBlue);
-		}
+				outIt.SetPixel(fRed, fGreen, fBlue);
+			}
 
-		if (m_pProgress != nullptr)
-			m_pProgress->Progress2(j * m_rcResult.width());
+			if (m_pProgress != nullptr)
+				m_pProgress->Progress2((lBandTop + j) * width);
+		}
 	}
 
 	if (m_pProgress != nullptr)
 		m_pProgress->End2();
 
+	m_vPixelTransforms.clear();
+
 	return true;
 }
 
 /* ------------------------------------------------------------------- */
 
+bool CStackingEngine::UseDrizzleBands() const
+{
+	// Entropy average and comets need the whole result of a frame (entropy coverage, comet shift and subtraction),
+	// as do the intermediate files.
+	// The mosaic frames are already stacked in the rectangle they cover.
+	return m_bDrizzleBands && m_lPixelSizeMultiplier > 1
+		&& m_pLightTask != nullptr && m_pLightTask->m_Method != MBP_ENTROPYAVERAGE
+		&& !static_cast<bool>(m_pComet) && !m_bCreateCometImage && !m_bSaveIntermediate
+		&& !UseMosaicWindows();
+}
+
+bool CStackingEngine::UseMosaicWindows() const
+{
+	// Same limits as the drizzle bands.
+	return m_bMosaic
+		&& m_pLightTask != nullptr && m_pLightTask->m_Method != MBP_ENTROPYAVERAGE
+		&& !static_cast<bool>(m_pComet) && !m_bCreateCometImage && !m_bSaveIntermediate;
+}
+
+/* ------------------------------------------------------------------- */
+
 bool CStackingEngine::SaveCalibratedAndRegisteredLightFrame(CMemoryBitmap* pBitmap) const
 {
 	ZFUNCTRACE_RUNTIME();
@@ -1725,6 +2007,9 @@ public:
 	AvxEntropy* m_pAvxEntropy;
 	int m_lPixelSizeMultiplier;
 	bool m_bColor;
+	int m_lStartRow;	// Lines of the bitmap to stack (first, last + 1)
+	int m_lEndRow;
+	DSSRect m_rcTempBitmap;	// Rectangle of the result held by the temporary bitmap (drizzle in bands, mosaic frames)
 
 public:
 	CStackTask() = delete;
@@ -1739,7 +2024,10 @@ public:
 		m_pLightTask { nullptr },
 		m_BackgroundCalibration {},
 		m_rcResult{},
-		m_pAvxEntropy { nullptr }
+		m_pAvxEntropy { nullptr },
+		m_lStartRow{ 0 },
+		m_lEndRow{ pBitmap->Height() },
+		m_rcTempBitmap{}
 	{}
 
 	void process();
@@ -1754,10 +2042,16 @@ void CStackTask::process()
 	int progress = 0;
 	std::atomic_bool runOnlyOnce{ false };
 
+	// The blocks stay aligned on multiples of lineBlockSize when only some lines are stacked.
+	const int firstRow = m_lStartRow - m_lStartRow % lineBlockSize;
+	const int lastRow = std::min(m_lEndRow, height);
+
 	AvxStacking avxStacking(0, 0, *m_pBitmap, *m_pTempBitmap, m_rcResult, *m_pAvxEntropy);
+	if (!m_rcTempBitmap.isEmpty())
+		avxStacking.setWindow(m_rcTempBitmap);
 
-#pragma omp parallel for default(none) firstprivate(avxStacking) shared(runOnlyOnce) if(nrProcessors > 1) // No "schedule" clause gives fastest result.
-	for (int row = 0; row < height; row += lineBlockSize)
+#pragma omp parallel for default(none) firstprivate(avxStacking, firstRow, lastRow) shared(runOnlyOnce) if(nrProcessors > 1) // No "schedule" clause gives fastest result.
+	for (int row = firstRow; row < lastRow; row += lineBlockSize)
 	{
 		const int endRow = std::min(row + lineBlockSize, height);
 		avxStacking.init(row, endRow);
@@ -1891,18 +2185,31 @@ std::pair<bool, T> CStackingEngine::StackLightFrame(std::shared_ptr<CMemoryBitma
 				m_pMasterLight->SetHomogenization(true);
 		}
 
-		if (static_cast<bool>(m_pMasterLight))
+		// Drizzle in bands: the temporary bitmap only holds lBandHeight lines of the result, the bands are stacked one after the other.
+		const bool bBands = UseDrizzleBands();
+		const int lBandHeight = bBands ? std::min(DrizzleBandHeight, m_rcResult.height()) : m_rcResult.height();
+		// Mosaic: the temporary bitmap only holds the rectangle of the result covered by the frame.
+		const bool bWindow = UseMosaicWindows();
+		const DSSRect rcWindow = bWindow
+			? MosaicFrameWindow(PixTransform, pBitmap->Width(), lHeight, m_lPixelSizeMultiplier, m_rcResult.width(), m_rcResult.height())
+			: DSSRect{};
+
+		const auto createTempBitmap = [this, &pBitmap](const int lNrColumns, const int lNrRows) -> std::shared_ptr<CMemoryBitmap>
 		{
-			StackTask.m_pTempBitmap = m_pMasterLight->CreateNewMemoryBitmap();
-			if (static_cast<bool>(StackTask.m_pTempBitmap))
+			std::shared_ptr<CMemoryBitmap> pTempBitmap = m_pMasterLight->CreateNewMemoryBitmap();
+			if (static_cast<bool>(pTempBitmap))
 			{
-				StackTask.m_pTempBitmap->Init(m_rcResult.width(), m_rcResult.height());
-				StackTask.m_pTempBitmap->SetISOSpeed(pBitmap->GetISOSpeed());
-				StackTask.m_pTempBitmap->SetGain(pBitmap->GetGain());
-				StackTask.m_pTempBitmap->SetExposure(pBitmap->GetExposure());
-				StackTask.m_pTempBitmap->SetNrFrames(pBitmap->GetNrFrames());
+				pTempBitmap->Init(lNrColumns, lNrRows);
+				pTempBitmap->SetISOSpeed(pBitmap->GetISOSpeed());
+				pTempBitmap->SetGain(pBitmap->GetGain());
+				pTempBitmap->SetExposure(pBitmap->GetExposure());
+				pTempBitmap->SetNrFrames(pBitmap->GetNrFrames());
 			}
-		}
+			return pTempBitmap;
+		};
+
+		if (static_cast<bool>(m_pMasterLight))
+			StackTask.m_pTempBitmap = bWindow ? createTempBitmap(rcWindow.width(), rcWindow.height()) : createTempBitmap(m_rcResult.width(), lBandHeight);
 
 		// Create output bitmap only when necessary (full 32 bits float)
 		if (m_pLightTask->m_Method == MBP_FASTAVERAGE || m_pLightTask->m_Method == MBP_ENTROPYAVERAGE || m_pLightTask->m_Method == MBP_MAXIMUM)
@@ -1923,9 +2230,6 @@ std::pair<bool, T> CStackingEngine::StackLightFrame(std::shared_ptr<CMemoryBitma
 		{
 			//int lProgress = 0;
 
-			if (m_pProgress)
-				m_pProgress->Start2(strStart2, lHeight);
-
 			AvxEntropy avxEntropy(*pBitmap, StackTask.m_EntropyWindow, m_pEntropyCoverage.get());
 
 			StackTask.m_PixTransform			= PixTransform;
@@ -1938,117 +2242,163 @@ std::pair<bool, T> CStackingEngine::StackLightFrame(std::shared_ptr<CMemoryBitma
 			StackTask.m_pEntropyCoverage		= m_pEntropyCoverage;
 			StackTask.m_pAvxEntropy				= &avxEntropy;
 
-			StackTask.process();
+			// Result lines reached by each line of the bitmap.
+			const std::vector<std::pair<int, int>> vRowRanges = bBands
+				? DrizzleRowRanges(PixTransform, pBitmap->Width(), lHeight, m_lPixelSizeMultiplier, m_rcResult.height())
+				: std::vector<std::pair<int, int>>{};
 
-			if (m_bCreateCometImage)
-			{
-				// At this point - remove the stars
-				//RemoveStars(StackTask.m_pTempBitmap, PixTransform, vStars);
-			}
-			else if (static_cast<bool>(m_pComet) && bComet)
+			bResult = true;
+			for (int lBandTop = 0; lBandTop < m_rcResult.height(); lBandTop += lBandHeight)
 			{
-				// Subtract the comet from the light frame
-				//WriteTIFF("E:\\BeforeCometSubtraction.tiff", StackTask.m_pTempBitmap, m_pProgress, nullptr);
-				//WriteTIFF("E:\\SubtractedComet.tiff", m_pComet, m_pProgress, nullptr);
-				ShiftAndSubtract(StackTask.m_pTempBitmap, m_pComet, m_pProgress, -PixTransform.m_fXCometShift, -PixTransform.m_fYCometShift);
-				//WriteTIFF("E:\\AfterCometSubtraction.tiff", StackTask.m_pTempBitmap, m_pProgress, nullptr);
-			}
+				const int lBandRows = std::min(lBandHeight, m_rcResult.height() - lBandTop);
+
+				if (lBandTop != 0)
+				{
+					// The previous temporary bitmap may still be written to the master light.
+					StackTask.m_pTempBitmap = createTempBitmap(m_rcResult.width(), lBandRows);
+					if (!static_cast<bool>(StackTask.m_pTempBitmap))
+					{
+						// Error - not enough memory
+						bResult = false;
+						break;
+					}
+				}
 
-			// First try AVX accelerated code, if not supported -> run conventional code.
-			AvxAccumulation avxAccumulation(m_rcResult, *m_pLightTask, *StackTask.m_pTempBitmap, *m_pOutput, avxEntropy);
-			const int avxResult = avxAccumulation.accumulate(m_lNrStacked);
+				if (m_pProgress)
+					m_pProgress->Start2(strStart2, lHeight);
 
-			if (m_pLightTask->m_Method == MBP_FASTAVERAGE)
-			{
-				if (avxResult != 0) // AVX code didn't run.
+				if (bBands)
+				{
+					std::tie(StackTask.m_lStartRow, StackTask.m_lEndRow) = DrizzleInputRows(vRowRanges, lBandTop, lBandTop + lBandRows);
+					StackTask.m_rcTempBitmap = DSSRect{ 0, lBandTop, m_rcResult.width(), lBandTop + lBandRows };
+				}
+				else if (bWindow)
+					StackTask.m_rcTempBitmap = rcWindow;
+
+				StackTask.process();
+
+				if (m_bCreateCometImage)
+				{
+					// At this point - remove the stars
+					//RemoveStars(StackTask.m_pTempBitmap, PixTransform, vStars);
+				}
+				else if (static_cast<bool>(m_pComet) && bComet)
+				{
+					// Subtract the comet from the light frame
+					//WriteTIFF("E:\\BeforeCometSubtraction.tiff", StackTask.m_pTempBitmap, m_pProgress, nullptr);
+					//WriteTIFF("E:\\SubtractedComet.tiff", m_pComet, m_pProgress, nullptr);
+					ShiftAndSubtract(StackTask.m_pTempBitmap, m_pComet, m_pProgress, -PixTransform.m_fXCometShift, -PixTransform.m_fYCometShift);
+					//WriteTIFF("E:\\AfterCometSubtraction.tiff", StackTask.m_pTempBitmap, m_pProgress, nullptr);
+				}
+
+				// The rectangle of the output held by the temporary bitmap.
+				const DSSRect rcTemp = bWindow ? rcWindow : DSSRect{ 0, lBandTop, m_rcResult.width(), lBandTop + lBandRows };
+
+				// First try AVX accelerated code, if not supported -> run conventional code.
+				AvxAccumulation avxAccumulation(rcTemp, *m_pLightTask, *StackTask.m_pTempBitmap, *m_pOutput, avxEntropy, bWindow);
+				const int avxResult = avxAccumulation.accumulate(m_lNrStacked);
+
+				if (m_pLightTask->m_Method == MBP_FASTAVERAGE)
 				{
-					// Use the result to average
-					for (int j = 0; j < m_rcResult.height(); j++)
+					if (avxResult != 0) // AVX code didn't run.
 					{
-						for (int i = 0; i < m_rcResult.width(); i++)
+						// Use the result to average
+						// With a window, the output pixels outside of it are averaged with 0.
+						const int lFirstRow = bWindow ? 0 : rcTemp.top;
+						const int lLastRow = bWindow ? m_rcResult.height() : rcTemp.bottom;
+						for (int j = lFirstRow; j < lLastRow; j++)
 						{
-							if (bColor)
+							for (int i = 0; i < m_rcResult.width(); i++)
 							{
-								double			fOutRed, fOutGreen, fOutBlue;
-								double			fNewRed, fNewGreen, fNewBlue;
-
-								m_pOutput->GetPixel(i, j, fOutRed, fOutGreen, fOutBlue);
-								StackTask.m_pTempBitmap->GetPixel(i, j, fNewRed, fNewGreen, fNewBlue);
-								fOutRed = (fOutRed * m_lNrStacked + fNewRed) / (double)(m_lNrStacked + 1);
-								fOutGreen = (fOutGreen * m_lNrStacked + fNewGreen) / (double)(m_lNrStacked + 1);
-								fOutBlue = (fOutBlue * m_lNrStacked + fNewBlue) / (double)(m_lNrStacked + 1);
-								m_pOutput->SetPixel(i, j, fOutRed, fOutGreen, fOutBlue);
-							}
-							else
-							{
-								double			fOutGray;
-								double			fNewGray;
-
-								m_pOutput->GetPixel(i, j, fOutGray);
-								StackTask.m_pTempBitmap->GetPixel(i, j, fNewGray);
-								fOutGray = (fOutGray * m_lNrStacked + fNewGray) / (double)(m_lNrStacked + 1);
-								m_pOutput->SetPixel(i, j, fOutGray);
+								const bool bInTemp = rcTemp.contains(QPoint{ i, j });
+								if (bColor)
+								{
+									double			fOutRed, fOutGreen, fOutBlue;
+									double			fNewRed = 0, fNewGreen = 0, fNewBlue = 0;
+
+									m_pOutput->GetPixel(i, j, fOutRed, fOutGreen, fOutBlue);
+									if (bInTemp)
+										StackTask.m_pTempBitmap->GetPixel(i - rcTemp.left, j - rcTemp.top, fNewRed, fNewGreen, fNewBlue);
+									fOutRed = (fOutRed * m_lNrStacked + fNewRed) / (double)(m_lNrStacked + 1);
+									fOutGreen = (fOutGreen * m_lNrStacked + fNewGreen) / (double)(m_lNrStacked + 1);
+									fOutBlue = (fOutBlue * m_lNrStacked + fNewBlue) / (double)(m_lNrStacked + 1);
+									m_pOutput->SetPixel(i, j, fOutRed, fOutGreen, fOutBlue);
+								}
+								else
+								{
+									double			fOutGray;
+									double			fNewGray = 0;
+
+									m_pOutput->GetPixel(i, j, fOutGray);
+									if (bInTemp)
+										StackTask.m_pTempBitmap->GetPixel(i - rcTemp.left, j - rcTemp.top, fNewGray);
+									fOutGray = (fOutGray * m_lNrStacked + fNewGray) / (double)(m_lNrStacked + 1);
+									m_pOutput->SetPixel(i, j, fOutGray);
+								};
 							};
 						};
 					};
-				};
-			}
-			else if (m_pLightTask->m_Method == MBP_MAXIMUM)
-			{
-				if (avxResult != 0)
+				}
+				else if (m_pLightTask->m_Method == MBP_MAXIMUM)
 				{
-					// Use the result to maximize
-					for (int j = 0; j < m_rcResult.height(); j++)
+					if (avxResult != 0)
 					{
-						for (int i = 0; i < m_rcResult.width(); i++)
+						// Use the result to maximize
+						for (int j = 0; j < rcTemp.height(); j++)
 						{
-							if (bColor)
-							{
-								double			fOutRed, fOutGreen, fOutBlue;
-								double			fNewRed, fNewGreen, fNewBlue;
-
-								m_pOutput->GetPixel(i, j, fOutRed, fOutGreen, fOutBlue);
-								StackTask.m_pTempBitmap->GetPixel(i, j, fNewRed, fNewGreen, fNewBlue);
-								fOutRed = max(fOutRed, fNewRed);
-								fOutGreen = max(fOutGreen, fNewGreen);
-								fOutBlue = max(fOutBlue, fNewBlue);;
-								m_pOutput->SetPixel(i, j, fOutRed, fOutGreen, fOutBlue);
-							}
-							else
+							for (int i = 0; i < rcTemp.width(); i++)
 							{
-								double			fOutGray;
-								double			fNewGray;
+								if (bColor)
+								{
+									double			fOutRed, fOutGreen, fOutBlue;
+									double			fNewRed, fNewGreen, fNewBlue;
+
+									m_pOutput->GetPixel(rcTemp.left + i, rcTemp.top + j, fOutRed, fOutGreen, fOutBlue);
+									StackTask.m_pTempBitmap->GetPixel(i, j, fNewRed, fNewGreen, fNewBlue);
+									fOutRed = max(fOutRed, fNewRed);
+									fOutGreen = max(fOutGreen, fNewGreen);
+									fOutBlue = max(fOutBlue, fNewBlue);;
+									m_pOutput->SetPixel(rcTemp.left + i, rcTemp.top + j, fOutRed, fOutGreen, fOutBlue);
+								}
+								else
+								{
+									double			fOutGray;
+									double			fNewGray;
 
-								m_pOutput->GetPixel(i, j, fOutGray);
-								StackTask.m_pTempBitmap->GetPixel(i, j, fNewGray);
-								fOutGray = max(fOutGray, fNewGray);
-								m_pOutput->SetPixel(i, j, fOutGray);
+									m_pOutput->GetPixel(rcTemp.left + i, rcTemp.top + j, fOutGray);
+									StackTask.m_pTempBitmap->GetPixel(i, j, fNewGray);
+									fOutGray = max(fOutGray, fNewGray);
+									m_pOutput->SetPixel(rcTemp.left + i, rcTemp.top + j, fOutGray);
+								};
 							};
 						};
 					};
-				};
-			}
-			else if ((m_pLightTask->m_Method != MBP_ENTROPYAVERAGE) && static_cast<bool>(m_pMasterLight) && static_cast<bool>(StackTask.m_pTempBitmap))
-			{
-				if (futureForWrite.valid())
-					futureForWrite.get();
-				const auto writeTask = [masterLight = this->m_pMasterLight](std::shared_ptr<CMemoryBitmap> tempBitmap) -> bool {
-					return masterLight->AddBitmap(tempBitmap.get(), nullptr);
-				};
-//				m_pMasterLight->AddBitmap(StackTask.m_pTempBitmap.get(), m_pProgress);
-				futureForWrite = std::async(std::launch::async, writeTask, StackTask.m_pTempBitmap);
-			}
+				}
+				else if ((m_pLightTask->m_Method != MBP_ENTROPYAVERAGE) && static_cast<bool>(m_pMasterLight) && static_cast<bool>(StackTask.m_pTempBitmap))
+				{
+					// The bands are written in order, each one when the previous one is done.
+					if (futureForWrite.valid())
+						futureForWrite.get();
+					const auto writeTask = [masterLight = this->m_pMasterLight, bWindow, rcWindow, lBandTop, lWidth = m_rcResult.width(), lHeight = m_rcResult.height()](std::shared_ptr<CMemoryBitmap> tempBitmap) -> bool {
+						return bWindow
+							? masterLight->AddBitmapRect(tempBitmap.get(), rcWindow, lWidth, lHeight, nullptr)
+							: masterLight->AddBitmapRows(tempBitmap.get(), lBandTop, lHeight, nullptr);
+					};
+//					m_pMasterLight->AddBitmap(StackTask.m_pTempBitmap.get(), m_pProgress);
+					futureForWrite = std::async(std::launch::async, writeTask, StackTask.m_pTempBitmap);
+				}
 
-			if (m_bSaveIntermediate && !m_bCreateCometImage)
-			{
-				// Save the pTempBitmap to a TIFF File
-				StackTask.m_pTempBitmap->m_ExtraInfo = pInBitmap->m_ExtraInfo;
-				StackTask.m_pTempBitmap->m_DateTime  = pInBitmap->m_DateTime;
-				SaveCalibratedAndRegisteredLightFrame(StackTask.m_pTempBitmap.get());
+				if (m_bSaveIntermediate && !m_bCreateCometImage)
+				{
+					// Save the pTempBitmap to a TIFF File
+					StackTask.m_pTempBitmap->m_ExtraInfo = pInBitmap->m_ExtraInfo;
+					StackTask.m_pTempBitmap->m_DateTime  = pInBitmap->m_DateTime;
+					SaveCalibratedAndRegisteredLightFrame(StackTask.m_pTempBitmap.get());
+				}
 			}
 
-			m_fTotalExposure += fExposure;
-			bResult = true;
+			if (bResult)
+				m_fTotalExposure += fExposure;
 		}
 		else
 		{
@@ -2079,6 +2429,7 @@ bool CStackingEngine::StackAll(CAllStackingTasks& tasks, std::shared_ptr<CMemory
 	try
 	{
 		STACKINGMODE stackingMode = tasks.getStackingMode();
+		m_bMosaic = stackingMode == SM_MOSAIC;
 
 		switch (stackingMode)
 		{
@@ -2091,12 +2442,9 @@ bool CStackingEngine::StackAll(CAllStackingTasks& tasks, std::shared_ptr<CMemory
 			m_rcResult = computeLargestRectangle();
 			std::int64_t ulNeededSpace;
 			std::int64_t ulFreeSpace;
-			DSSRect rcResult;
-
-			rcResult.setCoords(m_rcResult.left / m_lPixelSizeMultiplier, m_rcResult.top / m_lPixelSizeMultiplier,
-				m_rcResult.right / m_lPixelSizeMultiplier, m_rcResult.bottom / m_lPixelSizeMultiplier);
 
-			ulNeededSpace = tasks.computeNecessaryDiskSpace(rcResult);
+			// Only the part of the mosaic covered by each frame is written to the temporary files (see CMultiBitmap::AddBitmap).
+			ulNeededSpace = tasks.computeNecessaryDiskSpace(DSSRect{}, computeMosaicTempFileSpace(m_rcResult));
 			ulFreeSpace = tasks.AvailableDiskSpace(strDrive);
 
 			if (m_pProgress != nullptr && (ulNeededSpace > ulFreeSpace))
@@ -2221,7 +2569,10 @@ bool CStackingEngine::StackAll(CAllStackingTasks& tasks, std::shared_ptr<CMemory
 							return { {}, -1 };
 					};
 
-					auto futureForRead = std::async(std::launch::deferred, readTask, 0, m_pProgress); // Load first lightframe synchronously.
+					// First lightframe synchronously, the next ones asynchronously (without progress).
+					const auto& lightFrames = pStackingInfo->m_pLightTask->m_vBitmaps;
+					FramePrefetcher<std::pair<std::shared_ptr<CMemoryBitmap>, int>> frames{ lightFrames.size(), readTask,
+						[&lightFrames](const size_t lightTaskNdx) { return EstimateFrameMemory(lightFrames[lightTaskNdx].filePath); }, m_pProgress };
 					const auto firstBitmap = m_vBitmaps.cbegin();
 
 					using T = std::future<bool>;
@@ -2229,8 +2580,7 @@ bool CStackingEngine::StackAll(CAllStackingTasks& tasks, std::shared_ptr<CMemory
 
 					for (size_t i = 0; i < pStackingInfo->m_pLightTask->m_vBitmaps.size() && !bStop; ++i)
 					{
-						auto [pBitmap, bitmapNdx] = futureForRead.get();
-						futureForRead = std::async(std::launch::async, readTask, i + 1, nullptr); // Immediately load next lightframe asynchronously (need to set progress pointer to null).
+						auto [pBitmap, bitmapNdx] = frames.get(i);
 
 						if (bitmapNdx < 0)
 							continue;
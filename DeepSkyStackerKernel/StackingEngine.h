@@ -6,6 +6,7 @@
 #include "StackingTasks.h"
 
 class CComputeOffsetTask;
+template <typename TType> class CColorBitmapT;
 
 /* ------------------------------------------------------------------- */
 
@@ -156,9 +157,16 @@ private:
 	bool						m_bApplyFilterToCometImage;
 	CPostCalibrationSettings	m_PostCalibrationSettings;
 	bool						m_bChannelAlign;
+	bool						m_bDrizzleBands;
+	bool						m_bMosaic;
 
 	std::mutex	mutex;
 
+	// Drizzle in bands: number of lines of the result stacked at once.
+	// Only the temporary bitmap of a frame and the Bayer drizzle cover are limited to one band, the output bitmap and
+	// the master light part files hold the whole result (every frame reaches every band).
+	static constexpr int DrizzleBandHeight = 512;
+
 public:
 	CStackingEngine() :
 		m_pProgress { nullptr },
@@ -183,6 +191,8 @@ public:
 		m_bSaveIntermediateCometImages{ CAllStackingTasks::GetSaveIntermediateCometImages() },
 		m_bApplyFilterToCometImage{ CAllStackingTasks::GetApplyMedianFilterToCometImage() },
 		m_bChannelAlign{ CAllStackingTasks::GetChannelAlign() },
+		m_bDrizzleBands{ CAllStackingTasks::GetDrizzleBands() },
+		m_bMosaic{ false },
 		m_bCometInterpolating{ false }
 
 	{
@@ -209,7 +219,9 @@ private:
 	void	GetResultGain();
 	void	GetResultDateTime();
 	void	GetResultExtraInfo();
+	DSSRect	computeFrameRectangle(CLightFrameInfo& frame) const;
 	DSSRect	computeLargestRectangle();
+	std::int64_t computeMosaicTempFileSpace(const DSSRect& rcMosaic);
 	bool	computeSmallestRectangle(DSSRect & rc);
 	int	findBitmapIndex(const fs::path& file);
 	void	ComputeBitmap();
@@ -219,6 +231,8 @@ private:
 	std::pair<bool, T> StackLightFrame(std::shared_ptr<CMemoryBitmap> pBitmap, CPixelTransform& PixTransform, double fExposure, bool bComet, T futureForWrite);
 	bool	AdjustEntropyCoverage();
 	bool	AdjustBayerDrizzleCoverage();
+	bool	UseDrizzleBands() const;
+	bool	UseMosaicWindows() const;
 	bool	SaveCalibratedAndRegisteredLightFrame(CMemoryBitmap * pBitmap) const;
 	bool	SaveCalibratedLightFrame(std::shared_ptr<CMemoryBitmap> pBitmap) const;
 	bool	SaveDeltaImage(CMemoryBitmap* pBitmap) const;
@@ -267,5 +281,13 @@ public:
 
 	bool GetDefaultOutputFileName(fs::path& strFileName, const fs::path& szFileList, bool bTIFF = true);
 	void WriteDescription(CAllStackingTasks& tasks, const fs::path& outputFile);
+
+	// Drizzle in bands: the result lines reached by each line of a transformed bitmap, and the bitmap lines reaching a band.
+	static std::vector<std::pair<int, int>> DrizzleRowRanges(const CPixelTransform& PixTransform, const int width, const int height, const int lPixelSize, const int resultHeight);
+	static std::pair<int, int> DrizzleInputRows(const std::vector<std::pair<int, int>>& vRanges, const int lTop, const int lBottom);
+	static void AddBayerDrizzleCoverage(CColorBitmapT<float>& cover, const CPixelTransform& PixTransform, const std::vector<std::pair<int, int>>& vRowRanges,
+		const CFATYPE cfaType, const int width, const int height, const int lBandTop, ProgressBase* const pProgress);
+	// Mosaic: the rectangle of the result reached by a transformed bitmap.
+	static DSSRect MosaicFrameWindow(const CPixelTransform& PixTransform, const int width, const int height, const int lPixelSize, const int resultWidth, const int resultHeight);
 };
 
@@ -1,4 +1,5 @@
 #include <stdafx.h>
+#include <chrono>
 
 #include "StackingTasks.h"
 #include "DSSProgress.h"
@@ -11,6 +12,10 @@
 #include "Settings.h"
 #include "ZExcBase.h"
 #include "MemoryBitmap.h"
+#include "FramePrefetcher.h"
+#include "Multitask.h"
+#include "MasterLibrary.h"
+#include "TaskBitmapCache.h"
 
 using namespace DSS;
 
@@ -128,94 +133,157 @@ bool LoadFrame(const fs::path filePath, PICTURETYPE PictureType, ProgressBase* p
 
 /* ------------------------------------------------------------------- */
 
-class CTaskBitmapCache
+// Memory needed to load a frame: the bitmap, and for RAW files the raw data buffer of LibRaw (16 bits per pixel) during decoding.
+std::uint64_t EstimateFrameMemory(const fs::path& filePath)
 {
-public:
-	std::uint32_t m_dwOffsetTaskID;
-	std::shared_ptr<CMemoryBitmap> m_pOffsetBitmap;
-	std::uint32_t m_dwDarkTaskID;
-	std::shared_ptr<CMemoryBitmap> m_pDarkBitmap;
-	std::uint32_t m_dwDarkFlatTaskID;
-	std::shared_ptr<CMemoryBitmap> m_pDarkFlatBitmap;
-	std::uint32_t m_dwFlatTaskID;
-	std::shared_ptr<CMemoryBitmap> m_pFlatBitmap;
+	CBitmapInfo bmpInfo;
+	if (!GetPictureInfo(filePath, bmpInfo) || !bmpInfo.CanLoad())
+		return 0;
 
-public:
-	CTaskBitmapCache()
-	{
-		m_dwOffsetTaskID = 0;
-		m_dwDarkTaskID = 0;
-		m_dwDarkFlatTaskID = 0;
-		m_dwFlatTaskID = 0;
-	}
-	~CTaskBitmapCache() {};
+	const std::uint64_t nrPixels = static_cast<std::uint64_t>(bmpInfo.m_lWidth) * static_cast<std::uint64_t>(bmpInfo.m_lHeight);
+	const std::uint64_t bytesPerSample = std::max((bmpInfo.m_lBitsPerChannel + 7) / 8, 1);
+	const std::uint64_t bitmapBytes = nrPixels * std::max(bmpInfo.m_lNrChannels, 1) * bytesPerSample;
+	return bmpInfo.m_strFileType == "RAW" ? bitmapBytes + nrPixels * 2 : bitmapBytes;
+}
 
-	void ClearCache()
+/* ------------------------------------------------------------------- */
+
+namespace
+{
+	//
+	// Loads a frame of a master and subtracts the master offset and the master dark (flat) from it, if any.
+	// Used as load function of the FramePrefetcher, so several frames are loaded and calibrated concurrently while the
+	// previous ones are added to the master in order. Frames that are masters themselves are not calibrated.
+	// Subtract() is parallel (OpenMP): the subtractions of the concurrent loads run one after the other, so that they
+	// don't start a team of threads each.
+	//
+	std::pair<std::shared_ptr<CMemoryBitmap>, bool> loadMasterFrame(const fs::path& file, const PICTURETYPE type, ProgressBase* const pProgress,
+		const std::shared_ptr<CMemoryBitmap>& pMasterOffset, const std::shared_ptr<CMemoryBitmap>& pMasterDark)
 	{
-		m_dwOffsetTaskID = 0;
-		m_dwDarkTaskID = 0;
-		m_dwDarkFlatTaskID = 0;
-		m_dwFlatTaskID = 0;
-		m_pOffsetBitmap.reset();
-		m_pDarkBitmap.reset();
-		m_pDarkFlatBitmap.reset();
-		m_pFlatBitmap.reset();
+		static std::mutex subtractMutex{};
+
+		std::shared_ptr<CMemoryBitmap> pBitmap;
+		if (!::LoadFrame(file, type, pProgress, pBitmap))
+			return { pBitmap, false };
+
+		auto lock = std::unique_lock{ subtractMutex, std::defer_lock };
+		if ((static_cast<bool>(pMasterOffset) || static_cast<bool>(pMasterDark)) && !pBitmap->IsMaster())
+			lock.lock();
+
+		if (static_cast<bool>(pMasterOffset) && !pBitmap->IsMaster())
+		{
+			const QString strText = QCoreApplication::translate("StackingTasks", "Subtracting Offset Frame", "IDS_SUBSTRACTINGOFFSET");
+			ZTRACE_RUNTIME(strText.toUtf8().constData());
+			if (pProgress != nullptr)
+				pProgress->Start2(strText, 0);
+			Subtract(pBitmap, pMasterOffset, pProgress);
+		}
+
+		if (static_cast<bool>(pMasterDark) && !pBitmap->IsMaster())
+		{
+			const QString strText = QCoreApplication::translate("StackingTasks", "Subtracting Dark Frame", "IDS_SUBSTRACTINGDARK");
+			ZTRACE_RUNTIME(strText.toUtf8().constData());
+			if (pProgress != nullptr)
+				pProgress->Start2(strText, 0);
+			Subtract(pBitmap, pMasterDark, pProgress);
+		}
+
+		return { pBitmap, true };
 	}
 
-	bool GetTaskResult(const CTaskInfo* pTaskInfo, ProgressBase* pProgress, std::shared_ptr<CMemoryBitmap>& rpBitmap)
+	// Frames (and megabytes of pixels) added to a master per second, written to the trace and to the master's description.
+	class MasterThroughput
 	{
-		ZFUNCTRACE_RUNTIME();
+	private:
+		const char* const masterName;
+		const std::chrono::steady_clock::time_point start;
+		int nrFrames;
+		std::uint64_t nrBytes;
+		double seconds;
+
+	public:
+		explicit MasterThroughput(const char* const name) :
+			masterName{ name },
+			start{ std::chrono::steady_clock::now() },
+			nrFrames{ 0 },
+			nrBytes{ 0 },
+			seconds{ 1e-6 }
+		{}
+
+		void add(const CMemoryBitmap& bitmap)
+		{
+			++nrFrames;
+			nrBytes += CTaskBitmapCache::BitmapMemory(bitmap);
+		}
 
-		const auto checkFrame = [&rpBitmap, pTaskInfo, pProgress](std::uint32_t& taskId, std::shared_ptr<CMemoryBitmap>& pSrcBitmap) -> bool
+		void report()
 		{
-			if (taskId == pTaskInfo->m_dwTaskID && static_cast<bool>(pSrcBitmap))
-			{
-				rpBitmap = pSrcBitmap;
-				return true;
-			}
-			else
-			{
-				pSrcBitmap.reset();
-				if (LoadFrame(pTaskInfo->m_strOutputFile, pTaskInfo->m_TaskType, pProgress, pSrcBitmap))
-				{
-					taskId = pTaskInfo->m_dwTaskID;
-					rpBitmap = pSrcBitmap;
-					return true;
-				}
-				else
-				{
-					taskId = 0;
-					return false;
-				}
-			}
-		};
+			seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-6);
+			ZTRACE_RUNTIME("%s: %d frames added in %.2f s (%.2f frames/s, %.1f MB/s)", masterName, nrFrames, seconds,
+				nrFrames / seconds, static_cast<double>(nrBytes) / (1024.0 * 1024.0) / seconds);
+		}
 
-		bool bResult = false;
-		rpBitmap.reset();
-		if (pTaskInfo != nullptr && !pTaskInfo->m_strOutputFile.empty())
+		// Appended to the info text of the master (after report()).
+		QString text() const
 		{
-			switch (pTaskInfo->m_TaskType)
-			{
-			case PICTURETYPE_OFFSETFRAME:
-				bResult = checkFrame(this->m_dwOffsetTaskID, this->m_pOffsetBitmap);
-				break;
-			case PICTURETYPE_DARKFRAME:
-				bResult = checkFrame(this->m_dwDarkTaskID, this->m_pDarkBitmap);
-				break;
-			case PICTURETYPE_DARKFLATFRAME:
-				bResult = checkFrame(this->m_dwDarkFlatTaskID, this->m_pDarkFlatBitmap);
-				break;
-			case PICTURETYPE_FLATFRAME:
-				bResult = checkFrame(this->m_dwFlatTaskID, this->m_pFlatBitmap);
-				break;
-			}
+			return QCoreApplication::translate("StackingTasks", "%1 frames/s, %2 MB/s", "IDS_MASTERTHROUGHPUT")
+				.arg(nrFrames / seconds, 0, 'f', 2)
+				.arg(static_cast<double>(nrBytes) / (1024.0 * 1024.0) / seconds, 0, 'f', 1);
 		}
+	};
+
+	//
+	// Key of the master of the task in the master library, empty if the library is not used.
+	// The masters subtracted from the frames are identified by their own key, or by their file if they have none
+	// (e.g. a single offset frame).
+	//
+	template <class Settings>
+	QString masterLibraryKey(const QString& type, CTaskInfo* pTask, const CTaskInfo* pOffsetTask, const CTaskInfo* pDarkFlatTask)
+	{
+		if (!CAllStackingTasks::GetUseMasterLibrary() || pTask == nullptr || pTask->m_vBitmaps.size() < 2)
+			return {};
+
+		Settings settings;
+		settings.InitFromTask(pTask);
 
-		return bResult;
+		for (const auto& [variable, pMasterTask] : { std::make_pair("MasterOffset", pOffsetTask), std::make_pair("MasterDarkFlat", pDarkFlatTask) })
+		{
+			if (pMasterTask == nullptr)
+				continue;
+			const QString identity = pMasterTask->m_strLibraryKey.isEmpty() ? MasterLibrary::fileIdentity(pMasterTask->m_strOutputFile) : pMasterTask->m_strLibraryKey;
+			if (identity.isEmpty())
+				return {};
+			settings.AddMasterKey(variable, identity);
+		}
+
+		return MasterLibrary::computeKey(type, *pTask, settings);
 	}
-};
 
-static CTaskBitmapCache g_BitmapCache;
+	// Uses the master of the library if there is one for the key.
+	bool loadFromMasterLibrary(CTaskInfo* pTask, const QString& key)
+	{
+		fs::path masterFile;
+		if (key.isEmpty() || !MasterLibrary::instance().find(key, masterFile))
+			return false;
+
+		ZTRACE_RUNTIME("Using master from the library: %s", masterFile.generic_u8string().c_str());
+		pTask->m_strOutputFile = masterFile;
+		pTask->m_strLibraryKey = key;
+		pTask->m_bDone = true;
+		pTask->m_bUnmodified = true;
+		return true;
+	}
+
+	void addToMasterLibrary(CTaskInfo* pTask, const QString& key)
+	{
+		if (!key.isEmpty() && MasterLibrary::instance().add(key, pTask->m_strOutputFile))
+			pTask->m_strLibraryKey = key;
+	}
+}
+
+/* ------------------------------------------------------------------- */
+
+static CTaskBitmapCache g_BitmapCache{ ::LoadFrame, &CMultitask::GetMasterCacheMemoryLimit };
 
 /* ------------------------------------------------------------------- */
 
@@ -227,6 +295,8 @@ bool GetTaskResult(const CTaskInfo* pTaskInfo, ProgressBase* pProgress, std::sha
 void ClearTaskCache()
 {
 	g_BitmapCache.ClearCache();
+	// The masters of the run are loaded: the library may remove them again.
+	MasterLibrary::instance().endRun();
 }
 
 /* ------------------------------------------------------------------- */
@@ -295,6 +365,8 @@ bool CStackingInfo::DoOffsetTask(ProgressBase* const pProgress)
 	if (!m_pOffsetTask->m_bDone)
 	{
 		ZASSERT(m_pOffsetTask->m_TaskType == PICTURETYPE_OFFSETFRAME);
+		const QString libraryKey = masterLibraryKey<COffsetSettings>("MasterOffset", m_pOffsetTask, nullptr, nullptr);
+
 		if (m_pOffsetTask->m_vBitmaps.size() == 1)
 		{
 			m_pOffsetTask->m_strOutputFile = m_pOffsetTask->m_vBitmaps[0].filePath;
@@ -305,8 +377,9 @@ bool CStackingInfo::DoOffsetTask(ProgressBase* const pProgress)
 		{
 			m_pOffsetTask->m_bDone		 = true;
 			m_pOffsetTask->m_bUnmodified = true;
+			m_pOffsetTask->m_strLibraryKey = libraryKey;
 		}
-		else
+		else if (!loadFromMasterLibrary(m_pOffsetTask, libraryKey))
 		{
 			// Else create the master offset
 			//qDebug() << "Create Master Offset";
@@ -320,17 +393,17 @@ bool CStackingInfo::DoOffsetTask(ProgressBase* const pProgress)
 			{
 				if (bitmapNdx >= m_pOffsetTask->m_vBitmaps.size())
 					return { {}, false };
-				std::shared_ptr<CMemoryBitmap> pBitmap;
-				const bool success = ::LoadFrame(m_pOffsetTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_OFFSETFRAME, pProgress, pBitmap);
-				return { pBitmap, success };
+				return loadMasterFrame(m_pOffsetTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_OFFSETFRAME, pProgress, {}, {});
 			};
 
-			auto futureForRead = std::async(std::launch::deferred, readTask, 0, pProgress); // Load first frame synchronously.
+			// First frame synchronously, the next ones asynchronously (without progress).
+			FramePrefetcher<std::pair<std::shared_ptr<CMemoryBitmap>, bool>> frames{ m_pOffsetTask->m_vBitmaps.size(), readTask,
+				[this](const size_t bitmapNdx) { return EstimateFrameMemory(m_pOffsetTask->m_vBitmaps[bitmapNdx].filePath); }, pProgress };
+			MasterThroughput throughput{ "Master offset" };
 
 			for (size_t i = 0; i < m_pOffsetTask->m_vBitmaps.size() && bResult; i++)
 			{
-				auto [pBitmap, success] = futureForRead.get();
-				futureForRead = std::async(std::launch::async, readTask, i + 1, nullptr); // Immediately load next frame asynchronously (need to set progress pointer to null).
+				auto [pBitmap, success] = frames.get(i);
 
 				if (!success)
 					continue;
@@ -350,9 +423,11 @@ bool CStackingInfo::DoOffsetTask(ProgressBase* const pProgress)
 				//	<< pBitmap->getValue(5, 0) << pBitmap->getValue(6, 0) << pBitmap->getValue(7, 0) << pBitmap->getValue(8, 0) << pBitmap->getValue(9, 0);
 
 				m_pOffsetTask->AddToMaster(pBitmap.get(), pProgress);
+				throughput.add(*pBitmap);
 				if (pProgress)
 					bResult = !pProgress->IsCanceled();
 			}
+			throughput.report();
 
 			if (bResult)
 			{
@@ -383,7 +458,7 @@ bool CStackingInfo::DoOffsetTask(ProgressBase* const pProgress)
 					const QString strInfo{ tr("Master Offset created from %n picture(s) (%1)",
 						"IDS_MEDIANOFFSETINFO",
 						static_cast<int>(m_pOffsetTask->m_vBitmaps.size()))
-						.arg(strMethod) };
+						.arg(strMethod) + " - " + throughput.text() };
 
 					BuildMasterFileNames(m_pOffsetTask, "MasterOffset", /* bExposure */false, m_pOffsetTask->m_vBitmaps[0].filePath, strMasterOffset, strMasterOffsetInfo);
 
@@ -407,6 +482,8 @@ bool CStackingInfo::DoOffsetTask(ProgressBase* const pProgress)
 					COffsetSettings s;
 					s.InitFromCurrent(m_pOffsetTask, strMasterOffset.wstring().c_str());
 					s.WriteToFile(strMasterOffsetInfo.wstring().c_str());
+
+					addToMasterLibrary(m_pOffsetTask, libraryKey);
 				}
 			}
 		}
@@ -458,6 +535,7 @@ bool CStackingInfo::DoDarkTask(ProgressBase* const pProgress)
 	if (!m_pDarkTask->m_bDone)
 	{
 		ZASSERT(m_pDarkTask->m_TaskType == PICTURETYPE_DARKFRAME);
+		const QString libraryKey = masterLibraryKey<CDarkSettings>("MasterDark", m_pDarkTask, m_pOffsetTask, nullptr);
 
 		if (m_pDarkTask->m_vBitmaps.size() == 1)
 		{
@@ -468,8 +546,9 @@ bool CStackingInfo::DoDarkTask(ProgressBase* const pProgress)
 		{
 			m_pDarkTask->m_bDone = true;
 			m_pDarkTask->m_bUnmodified = true;
+			m_pDarkTask->m_strLibraryKey = libraryKey;
 		}
-		else
+		else if (!loadFromMasterLibrary(m_pDarkTask, libraryKey))
 		{
 			// Else create the master dark
 			//qDebug() << "Create Master Dark";
@@ -489,22 +568,23 @@ bool CStackingInfo::DoDarkTask(ProgressBase* const pProgress)
 			//	<< pMasterOffset->getValue(0, 0) << pMasterOffset->getValue(1, 0) << pMasterOffset->getValue(2, 0) << pMasterOffset->getValue(3, 0) << pMasterOffset->getValue(4, 0)
 			//	<< pMasterOffset->getValue(5, 0) << pMasterOffset->getValue(6, 0) << pMasterOffset->getValue(7, 0) << pMasterOffset->getValue(8, 0) << pMasterOffset->getValue(9, 0);
 
-			const auto readTask = [this](const size_t bitmapNdx, ProgressBase* const pProgress) -> std::pair<std::shared_ptr<CMemoryBitmap>, bool>
+			// The offset is subtracted while loading.
+			const auto readTask = [this, &pMasterOffset](const size_t bitmapNdx, ProgressBase* const pProgress) -> std::pair<std::shared_ptr<CMemoryBitmap>, bool>
 			{
 				if (bitmapNdx >= m_pDarkTask->m_vBitmaps.size())
 					return { {}, false };
-				std::shared_ptr<CMemoryBitmap> pBitmap;
-				const bool success = ::LoadFrame(m_pDarkTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_DARKFRAME, pProgress, pBitmap);
-				return { pBitmap, success };
+				return loadMasterFrame(m_pDarkTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_DARKFRAME, pProgress, pMasterOffset, {});
 			};
 
-			auto futureForRead = std::async(std::launch::deferred, readTask, 0, nullptr); // Load first frame synchronously.
+			// First frame synchronously, the next ones asynchronously (without progress).
+			FramePrefetcher<std::pair<std::shared_ptr<CMemoryBitmap>, bool>> frames{ m_pDarkTask->m_vBitmaps.size(), readTask,
+				[this](const size_t bitmapNdx) { return EstimateFrameMemory(m_pDarkTask->m_vBitmaps[bitmapNdx].filePath); }, nullptr };
+			MasterThroughput throughput{ "Master dark" };
 
 			// First Add Dark frame
 			for (size_t i = 0; i < m_pDarkTask->m_vBitmaps.size() && bResult; i++)
 			{
-				auto [pBitmap, success] = futureForRead.get();
-				futureForRead = std::async(std::launch::async, readTask, i + 1, nullptr); // Immediately load next frame asynchronously (need to set progress pointer to null).
+				auto [pBitmap, success] = frames.get(i);
 
 				if (!success)
 					continue;
@@ -518,33 +598,18 @@ bool CStackingInfo::DoDarkTask(ProgressBase* const pProgress)
 				if (!m_pDarkTask->m_pMaster)
 					m_pDarkTask->CreateEmptyMaster(pBitmap.get());
 
-				//qDebug() << "Input bitmap" << (1 + i) << "before calibration"
-				//	<< pBitmap->getValue(0, 0) << pBitmap->getValue(1, 0) << pBitmap->getValue(2, 0) << pBitmap->getValue(3, 0) << pBitmap->getValue(4, 0)
-				//	<< pBitmap->getValue(5, 0) << pBitmap->getValue(6, 0) << pBitmap->getValue(7, 0) << pBitmap->getValue(8, 0) << pBitmap->getValue(9, 0);
-
-				// Subtract the offset frame from the dark frame
-				if (static_cast<bool>(pMasterOffset) && !pBitmap->IsMaster())
-				{
-					QString strStart2;
-					if (pProgress != nullptr)
-					{
-						strText = QCoreApplication::translate("StackingTasks", "Subtracting Offset Frame", "IDS_SUBSTRACTINGOFFSET");
-						ZTRACE_RUNTIME(strText.toUtf8().constData());
-						pProgress->Start2(strText, 0);
-					}
-					Subtract(pBitmap, pMasterOffset, pProgress);
-				}
-
 				//qDebug() << "Input bitmap" << (1 + i) << "after subtracting offset"
 				//	<< pBitmap->getValue(0, 0) << pBitmap->getValue(1, 0) << pBitmap->getValue(2, 0) << pBitmap->getValue(3, 0) << pBitmap->getValue(4, 0)
 				//	<< pBitmap->getValue(5, 0) << pBitmap->getValue(6, 0) << pBitmap->getValue(7, 0) << pBitmap->getValue(8, 0) << pBitmap->getValue(9, 0);
 
 				// Add the dark frame
 				m_pDarkTask->AddToMaster(pBitmap.get(), pProgress);
+				throughput.add(*pBitmap);
 
 				if (pProgress)
 					bResult = !pProgress->IsCanceled();
 			}
+			throughput.report();
 
 			if (bResult)
 			{
@@ -575,7 +640,7 @@ bool CStackingInfo::DoDarkTask(ProgressBase* const pProgress)
 					const QString strInfo{ tr("Master Dark created from %n picture(s) (%1)",
 						"IDS_MEDIANDARKINFO",
 						static_cast<int>(m_pDarkTask->m_vBitmaps.size()))
-						.arg(strMethod) };
+						.arg(strMethod) + " - " + throughput.text() };
 
 					BuildMasterFileNames(m_pDarkTask, "MasterDark", true, m_pDarkTask->m_vBitmaps[0].filePath, strMasterDark, strMasterDarkInfo);
 
@@ -599,6 +664,8 @@ bool CStackingInfo::DoDarkTask(ProgressBase* const pProgress)
 					s.InitFromCurrent(m_pDarkTask, strMasterDark.wstring().c_str());
 					s.SetMasterOffset(m_pOffsetTask);
 					s.WriteToFile(strMasterDarkInfo.wstring().c_str());
+
+					addToMasterLibrary(m_pDarkTask, libraryKey);
 				}
 			}
 		}
@@ -653,6 +720,7 @@ bool	CStackingInfo::DoDarkFlatTask(ProgressBase* const pProgress)
 	if (!m_pDarkFlatTask->m_bDone)
 	{
 		ZASSERT(m_pDarkFlatTask->m_TaskType == PICTURETYPE_DARKFLATFRAME);
+		const QString libraryKey = masterLibraryKey<CDarkSettings>("MasterDarkFlat", m_pDarkFlatTask, m_pOffsetTask, nullptr);
 
 		if (m_pDarkFlatTask->m_vBitmaps.size() == 1)
 		{
@@ -663,8 +731,9 @@ bool	CStackingInfo::DoDarkFlatTask(ProgressBase* const pProgress)
 		{
 			m_pDarkFlatTask->m_bDone	   = true;
 			m_pDarkFlatTask->m_bUnmodified = true;
+			m_pDarkFlatTask->m_strLibraryKey = libraryKey;
 		}
-		else
+		else if (!loadFromMasterLibrary(m_pDarkFlatTask, libraryKey))
 		{
 			// Else create the master dark flat
 			//qDebug() << "Create Master Dark Flat";
@@ -684,10 +753,23 @@ bool	CStackingInfo::DoDarkFlatTask(ProgressBase* const pProgress)
 			//	<< pMasterOffset->getValue(0, 0) << pMasterOffset->getValue(1, 0) << pMasterOffset->getValue(2, 0) << pMasterOffset->getValue(3, 0) << pMasterOffset->getValue(4, 0)
 			//	<< pMasterOffset->getValue(5, 0) << pMasterOffset->getValue(6, 0) << pMasterOffset->getValue(7, 0) << pMasterOffset->getValue(8, 0) << pMasterOffset->getValue(9, 0);
 
+			// The offset is subtracted while loading.
+			const auto readTask = [this, &pMasterOffset](const size_t bitmapNdx, ProgressBase* const pProgress) -> std::pair<std::shared_ptr<CMemoryBitmap>, bool>
+			{
+				if (bitmapNdx >= m_pDarkFlatTask->m_vBitmaps.size())
+					return { {}, false };
+				return loadMasterFrame(m_pDarkFlatTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_DARKFLATFRAME, pProgress, pMasterOffset, {});
+			};
+
+			// First frame synchronously, the next ones asynchronously (without progress).
+			FramePrefetcher<std::pair<std::shared_ptr<CMemoryBitmap>, bool>> frames{ m_pDarkFlatTask->m_vBitmaps.size(), readTask,
+				[this](const size_t bitmapNdx) { return EstimateFrameMemory(m_pDarkFlatTask->m_vBitmaps[bitmapNdx].filePath); }, pProgress };
+			MasterThroughput throughput{ "Master dark flat" };
+
 			// First Add Dark flat frame
 			for (size_t i = 0; i < m_pDarkFlatTask->m_vBitmaps.size() && bResult; i++)
 			{
-				std::shared_ptr<CMemoryBitmap> pBitmap;
+				auto [pBitmap, success] = frames.get(i);
 
 				strText = QCoreApplication::translate("StackingTasks", "Adding Dark Flat frame %1 of %2", "IDS_ADDDARKFLAT").arg(static_cast<int>(1+i)).arg(m_pDarkFlatTask->m_vBitmaps.size());
 				ZTRACE_RUNTIME(strText.toUtf8().constData());
@@ -695,39 +777,24 @@ bool	CStackingInfo::DoDarkFlatTask(ProgressBase* const pProgress)
 				if (pProgress)
 					pProgress->Progress1(strText, static_cast<int>(i));
 
-				if (::LoadFrame(m_pDarkFlatTask->m_vBitmaps[i].filePath, PICTURETYPE_DARKFLATFRAME, pProgress, pBitmap))
+				if (success)
 				{
 					if (!m_pDarkFlatTask->m_pMaster)
 						m_pDarkFlatTask->CreateEmptyMaster(pBitmap.get());
 
-					// Subtract the offset frame from the dark frame
-					if (static_cast<bool>(pMasterOffset) && !pBitmap->IsMaster())
-					{
-						//qDebug() << "Input bitmap" << (1 + i) << "before calibration"
-						//	<< pBitmap->getValue(0, 0) << pBitmap->getValue(1, 0) << pBitmap->getValue(2, 0) << pBitmap->getValue(3, 0) << pBitmap->getValue(4, 0)
-						//	<< pBitmap->getValue(5, 0) << pBitmap->getValue(6, 0) << pBitmap->getValue(7, 0) << pBitmap->getValue(8, 0) << pBitmap->getValue(9, 0);
-
-						if (pProgress != nullptr)
-						{
-							strText = QCoreApplication::translate("StackingTasks", "Subtracting Offset Frame", "IDS_SUBSTRACTINGOFFSET");
-							ZTRACE_RUNTIME(strText.toUtf8().constData());
-
-							pProgress->Start2(strText, 0);
-						}
-						Subtract(pBitmap, pMasterOffset, pProgress);
-					}
-
 					//qDebug() << "Input bitmap" << (1 + i) << "after subtracting offset"
 					//	<< pBitmap->getValue(0, 0) << pBitmap->getValue(1, 0) << pBitmap->getValue(2, 0) << pBitmap->getValue(3, 0) << pBitmap->getValue(4, 0)
 					//	<< pBitmap->getValue(5, 0) << pBitmap->getValue(6, 0) << pBitmap->getValue(7, 0) << pBitmap->getValue(8, 0) << pBitmap->getValue(9, 0);
 
 					// Add the dark frame
 					m_pDarkFlatTask->AddToMaster(pBitmap.get(), pProgress);
+					throughput.add(*pBitmap);
 				}
 
 				if (pProgress)
 					bResult = !pProgress->IsCanceled();
 			}
+			throughput.report();
 
 			if (bResult)
 			{
@@ -759,7 +826,7 @@ bool	CStackingInfo::DoDarkFlatTask(ProgressBase* const pProgress)
 					const QString strInfo{ tr("Master Dark Flat created from %n picture(s) (%1)",
 						"IDS_MEDIANDARKFLATINFO",
 						static_cast<int>(m_pDarkFlatTask->m_vBitmaps.size()))
-						.arg(strMethod) };
+						.arg(strMethod) + " - " + throughput.text() };
 
 					BuildMasterFileNames(m_pDarkFlatTask, "MasterDarkFlat", true, m_pDarkFlatTask->m_vBitmaps[0].filePath, strMasterDarkFlat, strMasterDarkFlatInfo);
 					strText = QCoreApplication::translate("StackingTasks", "Saving Master Dark Flat", "IDS_SAVINGMASTERDARKFLAT");
@@ -783,6 +850,8 @@ bool	CStackingInfo::DoDarkFlatTask(ProgressBase* const pProgress)
 					s.InitFromCurrent(m_pDarkFlatTask, strMasterDarkFlat.wstring().c_str());
 					s.SetMasterOffset(m_pOffsetTask);
 					s.WriteToFile(strMasterDarkFlatInfo.wstring().c_str());
+
+					addToMasterLibrary(m_pDarkFlatTask, libraryKey);
 				};
 			};
 		};
@@ -1075,6 +1144,7 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 	if (!m_pFlatTask->m_bDone)
 	{
 		ZASSERT(m_pFlatTask->m_TaskType == PICTURETYPE_FLATFRAME);
+		const QString libraryKey = masterLibraryKey<CFlatSettings>("MasterFlat", m_pFlatTask, m_pOffsetTask, m_pDarkFlatTask);
 
 		if (m_pFlatTask->m_vBitmaps.size() == 1)
 		{
@@ -1085,8 +1155,9 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 		{
 			m_pFlatTask->m_bDone = true;
 			m_pFlatTask->m_bUnmodified = true;
+			m_pFlatTask->m_strLibraryKey = libraryKey;
 		}
-		else
+		else if (!loadFromMasterLibrary(m_pFlatTask, libraryKey))
 		{
 			// Else create the master flat
 			qDebug() << "Creating Master Flat";
@@ -1124,21 +1195,22 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 				}
 			}
 
-			const auto readTask = [this](const size_t bitmapNdx, ProgressBase* const pProgress) -> std::pair<std::shared_ptr<CMemoryBitmap>, bool>
+			// The offset and the dark flat are subtracted while loading.
+			const auto readTask = [this, &pMasterOffset, &pMasterDarkFlat](const size_t bitmapNdx, ProgressBase* const pProgress) -> std::pair<std::shared_ptr<CMemoryBitmap>, bool>
 			{
 				if (bitmapNdx >= m_pFlatTask->m_vBitmaps.size())
 					return { {}, false };
-				std::shared_ptr<CMemoryBitmap> pBitmap;
-				const bool success = ::LoadFrame(m_pFlatTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_FLATFRAME, pProgress, pBitmap);
-				return { pBitmap, success };
+				return loadMasterFrame(m_pFlatTask->m_vBitmaps[bitmapNdx].filePath, PICTURETYPE_FLATFRAME, pProgress, pMasterOffset, pMasterDarkFlat);
 			};
 
-			auto futureForRead = std::async(std::launch::deferred, readTask, 0, pProgress); // First frame synchronously.
+			// First frame synchronously, the next ones asynchronously (without progress).
+			FramePrefetcher<std::pair<std::shared_ptr<CMemoryBitmap>, bool>> frames{ m_pFlatTask->m_vBitmaps.size(), readTask,
+				[this](const size_t bitmapNdx) { return EstimateFrameMemory(m_pFlatTask->m_vBitmaps[bitmapNdx].filePath); }, pProgress };
+			MasterThroughput throughput{ "Master flat" };
 
 			for (size_t i = 0; i < m_pFlatTask->m_vBitmaps.size() && bResult; i++)
 			{
-				auto [pBitmap, success] = futureForRead.get();
-				futureForRead = std::async(std::launch::async, readTask, i + 1, nullptr); // Other frames asynchronously.
+				auto [pBitmap, success] = frames.get(i);
 
 				if (!success)
 					continue;
@@ -1152,33 +1224,6 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 				if (!m_pFlatTask->m_pMaster)
 					m_pFlatTask->CreateEmptyMaster(pBitmap.get());
 
-				if (static_cast<bool>(pBitmap) && pBitmap->IsMonochrome()) { // getValue() only implemented for grey bitmaps
-					qDebug() << "Input bitmap" << (1 + i) << "before calibration"
-						<< pBitmap->getValue(0, 0) << pBitmap->getValue(1, 0) << pBitmap->getValue(2, 0) << pBitmap->getValue(3, 0) << pBitmap->getValue(4, 0)
-						<< pBitmap->getValue(5, 0) << pBitmap->getValue(6, 0) << pBitmap->getValue(7, 0) << pBitmap->getValue(8, 0) << pBitmap->getValue(9, 0);
-				}
-
-				// Subtract the offset frame from the dark frame
-				if (static_cast<bool>(pMasterOffset) && !pBitmap->IsMaster())
-				{
-					strText = QCoreApplication::translate("StackingTasks", "Subtracting Offset Frame", "IDS_SUBSTRACTINGOFFSET");
-					ZTRACE_RUNTIME(strText.toUtf8().constData());
-
-					if (pProgress != nullptr)
-						pProgress->Start2(strText, 0);
-					Subtract(pBitmap, pMasterOffset, pProgress);
-				}
-
-				if (static_cast<bool>(pMasterDarkFlat) && !pBitmap->IsMaster())
-				{
-					strText = QCoreApplication::translate("StackingTasks", "Subtracting Dark Frame", "IDS_SUBSTRACTINGDARK");
-					ZTRACE_RUNTIME(strText.toUtf8().constData());
-
-					if (pProgress != nullptr)
-						pProgress->Start2(strText, 0);
-					Subtract(pBitmap, pMasterDarkFlat, pProgress);
-				}
-
 				if (static_cast<bool>(pBitmap) && pBitmap->IsMonochrome()) { // getValue() only implemented for grey bitmaps
 					qDebug() << "Input bitmap" << (1 + i) << "after master subtraction"
 						<< pBitmap->getValue(0, 0) << pBitmap->getValue(1, 0) << pBitmap->getValue(2, 0) << pBitmap->getValue(3, 0) << pBitmap->getValue(4, 0)
@@ -1205,10 +1250,12 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 
 				// Add the flat frame
 				m_pFlatTask->AddToMaster(pBitmap.get(), pProgress);
+				throughput.add(*pBitmap);
 
 				if (pProgress != nullptr)
 					bResult = !pProgress->IsCanceled();
 			}
+			throughput.report();
 
 			if (bResult)
 			{
@@ -1243,7 +1290,7 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 					const QString strInfo{ tr("Master Flat created from %n picture(s) (%1)",
 						"IDS_MEDIANFLATINFO",
 						static_cast<int>(m_pFlatTask->m_vBitmaps.size()))
-						.arg(strMethod) };
+						.arg(strMethod) + " - " + throughput.text() };
 
 					BuildMasterFileNames(m_pFlatTask, "MasterFlat", false, m_pFlatTask->m_vBitmaps[0].filePath, strMasterFlat, strMasterFlatInfo);
 					strText = QCoreApplication::translate("StackingTasks", "Saving Master Flat", "IDS_SAVINGMASTERFLAT");
@@ -1267,6 +1314,8 @@ bool CStackingInfo::DoFlatTask(ProgressBase* const pProgress)
 					s.SetMasterOffset(m_pOffsetTask);
 					s.SetMasterDarkFlat(m_pDarkFlatTask);
 					s.WriteToFile(strMasterFlatInfo.wstring().c_str());
+
+					addToMasterLibrary(m_pFlatTask, libraryKey);
 				}
 			}
 		}
@@ -1924,7 +1973,7 @@ bool CAllStackingTasks::checkReadOnlyStatus(QStringList & folders)
 
 /* ------------------------------------------------------------------- */
 
-std::int64_t	CAllStackingTasks::computeNecessaryDiskSpace(const DSSRect& rcOutput)
+std::int64_t	CAllStackingTasks::computeNecessaryDiskSpace(const DSSRect& rcOutput, const std::int64_t mosaicLightSpace)
 {
 	std::int64_t				ulResult = 0;
 	std::int64_t				ulLightSpace = 0,
@@ -1966,7 +2015,13 @@ std::int64_t	CAllStackingTasks::computeNecessaryDiskSpace(const DSSRect& rcOutpu
 			if ((m_vStacks[i].m_pLightTask->m_Method != MBP_FASTAVERAGE) &&
 				(m_vStacks[i].m_pLightTask->m_Method != MBP_MAXIMUM) &&
 				(m_vStacks[i].m_pLightTask->m_Method != MBP_ENTROPYAVERAGE))
-				ulLightSpace += ulLSpace * m_vStacks[i].m_pLightTask->m_vBitmaps.size() * ulPixelSize;
+			{
+				// The light frames of all the stacks are added to the same mosaic.
+				if (mosaicLightSpace >= 0)
+					ulLightSpace = mosaicLightSpace;
+				else
+					ulLightSpace += ulLSpace * m_vStacks[i].m_pLightTask->m_vBitmaps.size() * ulPixelSize;
+			}
 
 			if (m_vStacks[i].m_pLightTask->m_Method == MBP_FASTAVERAGE)
 				m_vStacks[i].m_pLightTask->m_Method = MBP_AVERAGE;
@@ -2226,6 +2281,24 @@ int	CAllStackingTasks::GetPixelSizeMultiplier()
 
 /* ------------------------------------------------------------------- */
 
+bool	CAllStackingTasks::GetDrizzleBands()
+{
+	Workspace			workspace;
+
+	return workspace.value("Stacking/DrizzleBands", false).toBool();
+};
+
+/* ------------------------------------------------------------------- */
+
+bool	CAllStackingTasks::GetUseMasterLibrary()
+{
+	Workspace			workspace;
+
+	return workspace.value("Stacking/UseMasterLibrary", false).toBool();
+};
+
+/* ------------------------------------------------------------------- */
+
 bool	CAllStackingTasks::GetChannelAlign()
 {
 	Workspace			workspace;
@@ -2387,6 +2460,7 @@ void CAllStackingTasks::SetOutputSettings(const COutputSettings & os)
 void CAllStackingTasks::ClearCache()
 {
 	g_BitmapCache.ClearCache();
+	MasterLibrary::instance().endRun();
 };
 
 /* ------------------------------------------------------------------- */
@@ -12,6 +12,7 @@ class CFrameInfo;
 /* ------------------------------------------------------------------- */
 
 bool LoadFrame(const fs::path filePath, PICTURETYPE PictureType, DSS::ProgressBase * pProgress, std::shared_ptr<CMemoryBitmap>& rpBitmap);
+std::uint64_t EstimateFrameMemory(const fs::path& filePath);
 bool AreExposureEquals(double fExposure1, double fExposure2);
 
 /* ------------------------------------------------------------------- */
@@ -359,7 +360,8 @@ public:
 	bool DoDarkFlatTasks(DSS::ProgressBase* pProgress);
 	bool DoAllPreTasks(DSS::ProgressBase* pProgress);
 
-	std::int64_t computeNecessaryDiskSpace(const DSSRect& rcOutput);
+	// A mosaicLightSpace >= 0 replaces the estimate of the temporary files of the light frames (mosaic mode).
+	std::int64_t computeNecessaryDiskSpace(const DSSRect& rcOutput, const std::int64_t mosaicLightSpace = -1);
 	std::int64_t computeNecessaryDiskSpace();
 	std::int64_t AvailableDiskSpace(fs::path& strDrive);
 
@@ -388,6 +390,8 @@ public:
 	static	void	ClearCache();
 	static std::uint16_t GetAlignmentMethod();
 	static  int	GetPixelSizeMultiplier();
+	static  bool	GetDrizzleBands();
+	static  bool	GetUseMasterLibrary();
 	static  bool	GetChannelAlign();
 	static  bool	GetSaveIntermediateCometImages();
 	static  bool	GetApplyMedianFilterToCometImage();
@@ -3,6 +3,32 @@
 #include "DSSProgress.h"
 #include "RegisterEngine.h"
 #include "GrayBitmap.h"
+#include "Multitask.h"
+
+namespace
+{
+	//
+	// The mask is drawn in square tiles, each star is drawn in all the tiles its box overlaps.
+	// A pixel gets the maximum of the stars covering it, so the tiles and the stars can be processed in any order.
+	//
+	constexpr int StarMaskTileSize = 256;
+
+	//
+	// All the shape functions only depend on the distance divided by the radius. They are tabulated once with
+	// StarMaskLutSteps entries per radius (so the kinks at 1 and 3 radius are exact entries) and linearly interpolated.
+	// The star boxes extend 3 radius on each side, the largest distance is 3 * sqrt(2) radius.
+	//
+	constexpr int StarMaskLutSteps = 256;
+	constexpr int StarMaskLutSize = 5 * StarMaskLutSteps + 2;
+
+	struct StarMaskStar
+	{
+		double xStart, yStart;		// Coordinates of the first pixel of the box, as the distances are computed from them
+		double xCenter, yCenter;
+		double radius;
+		int left, top, right, bottom;	// Pixels of the box (inclusive)
+	};
+}
 
 namespace DSS
 {
@@ -18,62 +44,123 @@ namespace DSS
 		LightFrame.SetProgress(pProgress);
 		LightFrame.RegisterPicture(pBitmap, -1); // -1 means, we do NOT register a series of frames.
 
-		const STARVECTOR vStars = LightFrame.GetStars();
+		return drawStarMask(LightFrame.GetStars(), pBitmap->Width(), pBitmap->Height(), pProgress);
+	}
 
-		// Draw the stars
+	std::shared_ptr<CMemoryBitmap> StarMaskEngine::drawStarMask(const std::vector<CStar>& vStars, const int width, const int height, ProgressBase* pProgress)
+	{
 		std::shared_ptr<C16BitGrayBitmap> pOutBitmap = std::make_shared<C16BitGrayBitmap>();
 		std::unique_ptr<StarMaskFunction> pStarMaskFunction = GetShapeFunction();
 		if (static_cast<bool>(pOutBitmap))
 		{
-			pOutBitmap->Init(pBitmap->Width(), pBitmap->Height());
-			const double fWidth = pBitmap->Width();
-			const double fHeight = pBitmap->Height();
+			pOutBitmap->Init(width, height);
+			const double fWidth = width;
+			const double fHeight = height;
 
-			if (pProgress != nullptr)
-			{
-				const QString strText(QCoreApplication::translate("StarMask", "Creating Star Mask...", "IDS_CREATINGSTARMASK"));
-				pProgress->Start2(strText, static_cast<int>(vStars.size()));
-			}
+			// Mask value (0 to 255) for the distances 0, 1/StarMaskLutSteps, ... radius.
+			std::vector<double> vLut(StarMaskLutSize);
+			pStarMaskFunction->SetRadius(1.0);
+			for (int n = 0; n < StarMaskLutSize; n++)
+				vLut[n] = max(0.0, min(pStarMaskFunction->Compute(static_cast<double>(n) / StarMaskLutSteps) * 255.0, 255.0));
 
-			for (size_t k = 0; k < vStars.size(); k++)
+			std::vector<StarMaskStar> vMaskStars;
+			vMaskStars.reserve(vStars.size());
+			for (const CStar& star : vStars)
 			{
-				double fRadius = vStars[k].m_fMeanRadius * (2.35 / 1.5);
-				const double fXCenter = vStars[k].m_fX;
-				const double fYCenter = vStars[k].m_fY;
+				double fRadius = star.m_fMeanRadius * (2.35 / 1.5);
+				const double fXCenter = star.m_fX;
+				const double fYCenter = star.m_fY;
 
 				if (2 * fRadius >= m_fMinSize && 2 * fRadius <= m_fMaxSize)
 				{
-					//double		fFactor1 = 1.0/exp(-0.5);
-					//double		fFactor2 = 2*fRadius*fRadius;
-
 					fRadius *= m_fPercentIncrease;
 					if (m_fPixelIncrease)
 						fRadius += m_fPixelIncrease;
 
-					pStarMaskFunction->SetRadius(fRadius);
-					for (double i = max(0.0, fXCenter - 3 * fRadius); i <= min(fXCenter + 3 * fRadius, fWidth - 1); i++)
+					// A null radius has no valid value (0/0) and never changed the mask.
+					if (fRadius <= 0)
+						continue;
+
+					const double xStart = max(0.0, fXCenter - 3 * fRadius);
+					const double yStart = max(0.0, fYCenter - 3 * fRadius);
+					const double xEnd = min(fXCenter + 3 * fRadius, fWidth - 1);
+					const double yEnd = min(fYCenter + 3 * fRadius, fHeight - 1);
+
+					if (xEnd >= xStart && yEnd >= yStart)
 					{
-						for (double j = max(0.0, fYCenter - 3 * fRadius); j <= min(fYCenter + 3 * fRadius, fHeight - 1); j++)
-						{
-							// Compute the distance to the center
-							double		fDistance;
-							double		fXDistance = fabs(i - fXCenter);
-							double		fYDistance = fabs(j - fYCenter);
-							double		fPixelValue;
-							double		fOldPixelValue;
+						StarMaskStar& maskStar = vMaskStars.emplace_back();
+						maskStar.xStart = xStart;
+						maskStar.yStart = yStart;
+						maskStar.xCenter = fXCenter;
+						maskStar.yCenter = fYCenter;
+						maskStar.radius = fRadius;
+						maskStar.left = static_cast<int>(xStart + 0.5);
+						maskStar.top = static_cast<int>(yStart + 0.5);
+						maskStar.right = min(width - 1, maskStar.left + static_cast<int>(xEnd - xStart));
+						maskStar.bottom = min(height - 1, maskStar.top + static_cast<int>(yEnd - yStart));
+					}
+				}
+			}
 
-							fDistance = sqrt(fXDistance * fXDistance + fYDistance * fYDistance);
+			// Bin the stars into the tiles overlapped by their box.
+			const int nrTilesX = (width + StarMaskTileSize - 1) / StarMaskTileSize;
+			const int nrTilesY = (height + StarMaskTileSize - 1) / StarMaskTileSize;
+			const int nrTiles = nrTilesX * nrTilesY;
+			std::vector<std::vector<int>> vTileStars(nrTiles);
 
-							fPixelValue = pStarMaskFunction->Compute(fDistance);
+			for (int k = 0; k < static_cast<int>(vMaskStars.size()); k++)
+			{
+				const StarMaskStar& maskStar = vMaskStars[k];
+				for (int tileY = maskStar.top / StarMaskTileSize; tileY <= maskStar.bottom / StarMaskTileSize; tileY++)
+					for (int tileX = maskStar.left / StarMaskTileSize; tileX <= maskStar.right / StarMaskTileSize; tileX++)
+						vTileStars[tileY * nrTilesX + tileX].push_back(k);
+			}
 
-							pOutBitmap->GetPixel(i + 0.5, j + 0.5, fOldPixelValue);
-							fPixelValue = max(fOldPixelValue, max(0.0, min(fPixelValue * 255.0, 255.0)));
-							pOutBitmap->SetPixel(i + 0.5, j + 0.5, fPixelValue);
+			if (pProgress != nullptr)
+			{
+				const QString strText(QCoreApplication::translate("StarMask", "Creating Star Mask...", "IDS_CREATINGSTARMASK"));
+				pProgress->Start2(strText, nrTiles);
+			}
+
+			std::uint16_t* const pOutPixels = pOutBitmap->m_vPixels.data();
+			std::atomic_int loopCtr = 0;
+
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(vMaskStars, vTileStars, vLut, loopCtr) firstprivate(pOutPixels, nrTiles, nrTilesX, width, height, pProgress) if(CMultitask::GetNrProcessors() > 1)
+			for (int tile = 0; tile < nrTiles; tile++)
+			{
+				const int tileLeft = (tile % nrTilesX) * StarMaskTileSize;
+				const int tileTop = (tile / nrTilesX) * StarMaskTileSize;
+				const int tileRight = min(width, tileLeft + StarMaskTileSize) - 1;
+				const int tileBottom = min(height, tileTop + StarMaskTileSize) - 1;
+
+				for (const int k : vTileStars[tile])
+				{
+					const StarMaskStar& maskStar = vMaskStars[k];
+					const double lutScale = StarMaskLutSteps / maskStar.radius;
+					const int left = max(maskStar.left, tileLeft);
+					const int right = min(maskStar.right, tileRight);
+
+					for (int y = max(maskStar.top, tileTop); y <= min(maskStar.bottom, tileBottom); y++)
+					{
+						const double fYDistance = maskStar.yStart + (y - maskStar.top) - maskStar.yCenter;
+						std::uint16_t* const pLine = pOutPixels + static_cast<size_t>(y) * width;
+
+						for (int x = left; x <= right; x++)
+						{
+							const double fXDistance = maskStar.xStart + (x - maskStar.left) - maskStar.xCenter;
+							const double fLutPosition = min(sqrt(fXDistance * fXDistance + fYDistance * fYDistance) * lutScale, static_cast<double>(StarMaskLutSize - 1));
+							const int n = min(static_cast<int>(fLutPosition), StarMaskLutSize - 2);
+							const double fPixelValue = vLut[n] + (vLut[n + 1] - vLut[n]) * (fLutPosition - n);
+
+							// Same scale and truncation as C16BitGrayBitmap::SetPixel().
+							pLine[x] = max(pLine[x], static_cast<std::uint16_t>(fPixelValue * 256.0));
 						}
 					}
 				}
-				if (pProgress != nullptr)
-					pProgress->Progress2(static_cast<int>(k + 1));
+
+				++loopCtr;
+				if (pProgress != nullptr && omp_get_thread_num() == 0)
+					pProgress->Progress2(loopCtr);
 			}
 			if (pProgress != nullptr)
 				pProgress->End2();
@@ -81,4 +168,4 @@ namespace DSS
 
 		return pOutBitmap;
 	}
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 class CMemoryBitmap;
+class CStar;
 
 /* ------------------------------------------------------------------- */
 namespace DSS
@@ -239,7 +240,14 @@ namespace DSS
 			m_bRemoveHotPixels = bHotPixels;
 		}
 
+		void	SetStarShape(STARMASKSTYLE starShape)
+		{
+			m_StarShape = starShape;
+		}
+
 		//	bool CreateStarMask(CMemoryBitmap* pBitmap, CMemoryBitmap ** ppBitmap, ProgressBase * pProgress = nullptr);
 		std::shared_ptr<CMemoryBitmap> createStarMask(CMemoryBitmap* pBitmap, DSS::ProgressBase* pProgress = nullptr);
+		// Draws the mask of the stars detected by createStarMask() in a width x height 16 bit gray bitmap.
+		std::shared_ptr<CMemoryBitmap> drawStarMask(const std::vector<CStar>& vStars, const int width, const int height, DSS::ProgressBase* pProgress = nullptr);
 	};
 }
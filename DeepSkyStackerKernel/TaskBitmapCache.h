@@ -0,0 +1,115 @@
+#pragma once
+#include <list>
+#include "TaskInfo.h"
+#include "MemoryBitmap.h"
+
+//
+// The master offset, dark, dark flat and flat frames loaded for the stacking groups, most recently used first.
+// A master is found by its task ID and its file. The masters that no longer fit in the memory budget are dropped,
+// except the last one used.
+//
+class CTaskBitmapCache
+{
+public:
+	using LoadFunction = std::function<bool(const fs::path&, PICTURETYPE, ProgressBase*, std::shared_ptr<CMemoryBitmap>&)>;
+	using LimitFunction = std::function<std::uint64_t()>;
+
+private:
+	struct CacheEntry
+	{
+		std::uint32_t dwTaskID;
+		fs::path file;
+		std::shared_ptr<CMemoryBitmap> pBitmap;
+		std::uint64_t size;
+	};
+
+	const LoadFunction loadFrame;
+	const LimitFunction memoryLimit;
+	std::list<CacheEntry> m_Entries;
+	std::uint64_t m_TotalSize;
+
+	void Trim(const std::uint64_t limit)
+	{
+		while (m_Entries.size() > 1 && m_TotalSize > limit)
+		{
+			ZTRACE_RUNTIME("Master cache: dropping %s", m_Entries.back().file.generic_u8string().c_str());
+			m_TotalSize -= m_Entries.back().size;
+			m_Entries.pop_back();
+		}
+	}
+
+public:
+	// The memory budget is read at each load (it is a setting).
+	CTaskBitmapCache(LoadFunction loader, LimitFunction memoryBudget) :
+		loadFrame{ std::move(loader) },
+		memoryLimit{ std::move(memoryBudget) },
+		m_TotalSize{ 0 }
+	{}
+	~CTaskBitmapCache() {};
+
+	// Memory of the pixels of a bitmap.
+	static std::uint64_t BitmapMemory(const CMemoryBitmap& bitmap)
+	{
+		const std::uint64_t nrPixels = static_cast<std::uint64_t>(bitmap.RealWidth()) * static_cast<std::uint64_t>(bitmap.RealHeight());
+		return nrPixels * (bitmap.IsMonochrome() ? 1 : 3) * (bitmap.BitPerSample() / 8);
+	}
+
+	void ClearCache()
+	{
+		m_Entries.clear();
+		m_TotalSize = 0;
+	}
+
+	size_t GetNrMasters() const
+	{
+		return m_Entries.size();
+	}
+
+	std::uint64_t GetTotalSize() const
+	{
+		return m_TotalSize;
+	}
+
+	bool GetTaskResult(const CTaskInfo* pTaskInfo, ProgressBase* pProgress, std::shared_ptr<CMemoryBitmap>& rpBitmap)
+	{
+		ZFUNCTRACE_RUNTIME();
+
+		rpBitmap.reset();
+		if (pTaskInfo == nullptr || pTaskInfo->m_strOutputFile.empty())
+			return false;
+
+		switch (pTaskInfo->m_TaskType)
+		{
+		case PICTURETYPE_OFFSETFRAME:
+		case PICTURETYPE_DARKFRAME:
+		case PICTURETYPE_DARKFLATFRAME:
+		case PICTURETYPE_FLATFRAME:
+			break;
+		default:
+			return false;
+		}
+
+		const auto it = std::find_if(m_Entries.begin(), m_Entries.end(), [pTaskInfo](const CacheEntry& entry)
+			{
+				return entry.dwTaskID == pTaskInfo->m_dwTaskID && entry.file == pTaskInfo->m_strOutputFile;
+			});
+		if (it != m_Entries.end())
+		{
+			m_Entries.splice(m_Entries.begin(), m_Entries, it);
+			rpBitmap = it->pBitmap;
+			return true;
+		}
+
+		std::shared_ptr<CMemoryBitmap> pBitmap;
+		if (!loadFrame(pTaskInfo->m_strOutputFile, pTaskInfo->m_TaskType, pProgress, pBitmap))
+			return false;
+
+		const std::uint64_t size = BitmapMemory(*pBitmap);
+		m_Entries.push_front(CacheEntry{ pTaskInfo->m_dwTaskID, pTaskInfo->m_strOutputFile, pBitmap, size });
+		m_TotalSize += size;
+		Trim(memoryLimit());
+
+		rpBitmap = std::move(pBitmap);
+		return true;
+	}
+};
@@ -21,6 +21,7 @@ public:
 	bool m_bUnmodified{ false };
 	bool m_bDone{ false };
 	fs::path m_strOutputFile{};
+	QString m_strLibraryKey{};		// Key of the master in the master library (empty if not known)
 	FRAMEINFOVECTOR m_vBitmaps{};
 	MULTIBITMAPPROCESSMETHOD m_Method{ MBP_MEDIAN };
 	double m_fKappa{ 2.0 };
@@ -0,0 +1,176 @@
+#include "stdafx.h"
+#include "TileRenderer.h"
+#include "StackedBitmap.h"
+#include "Ztrace.h"
+
+namespace DSS
+{
+	TileRenderer::TileRenderer() :
+		stopping{ false },
+		rendering{ false },
+		pBitmap{ nullptr },
+		showClipping{ true },
+		generation{ 0 },
+		totalTiles{ 0 },
+		collectedTiles{ 0 }
+	{
+		worker = std::thread{ &TileRenderer::run, this };
+	}
+
+	TileRenderer::~TileRenderer()
+	{
+		{
+			std::lock_guard lock{ mutex };
+			stopping = true;
+			queued.clear();
+		}
+		workerSignal.notify_all();
+		worker.join();
+	}
+
+	void TileRenderer::start(const StackedBitmap& bitmap, const DSSRect& area, const DSSRect& visible, const BezierAdjust& bezier,
+		const RGBHistogramAdjust& histogram, const bool markClipping)
+	{
+		ZFUNCTRACE_RUNTIME();
+		cancel();
+
+		const int width = bitmap.GetWidth();
+		const int height = bitmap.GetHeight();
+
+		DSSRect rc{ std::max(0, area.left), std::max(0, area.top), std::min(width, area.right), std::min(height, area.bottom) };
+		if (rc.left >= rc.right || rc.top >= rc.bottom)
+			rc = DSSRect{ 0, 0, width, height };
+
+		std::vector<DSSRect> tiles;
+		for (int top = rc.top; top < rc.bottom; top += TileSize)
+			for (int left = rc.left; left < rc.right; left += TileSize)
+				tiles.emplace_back(left, top, std::min(left + TileSize, rc.right), std::min(top + TileSize, rc.bottom));
+
+		//
+		// The tiles overlapping the visible part of the image first, each group ordered by the distance of the tile
+		// centre from the centre of the visible part.
+		//
+		const double centreX = (visible.isEmpty() ? (rc.left + rc.right) : (visible.left + visible.right)) / 2.0;
+		const double centreY = (visible.isEmpty() ? (rc.top + rc.bottom) : (visible.top + visible.bottom)) / 2.0;
+		const auto isVisible = [&visible](const DSSRect& tile)
+		{
+			return visible.isEmpty() || (tile.left < visible.right && tile.right > visible.left && tile.top < visible.bottom && tile.bottom > visible.top);
+		};
+		const auto distance = [centreX, centreY](const DSSRect& tile)
+		{
+			const double dx = (tile.left + tile.right) / 2.0 - centreX;
+			const double dy = (tile.top + tile.bottom) / 2.0 - centreY;
+			return dx * dx + dy * dy;
+		};
+		std::ranges::sort(tiles, [&isVisible, &distance](const DSSRect& lhs, const DSSRect& rhs)
+		{
+			const bool lhsVisible = isVisible(lhs);
+			const bool rhsVisible = isVisible(rhs);
+			return lhsVisible != rhsVisible ? lhsVisible : distance(lhs) < distance(rhs);
+		});
+
+		{
+			std::lock_guard lock{ mutex };
+			pBitmap = &bitmap;
+			bezierAdjust = bezier;
+			histoAdjust = histogram;
+			showClipping = markClipping;
+			queued.assign(tiles.cbegin(), tiles.cend());
+			totalTiles = tiles.size();
+			collectedTiles = 0;
+		}
+		workerSignal.notify_all();
+	}
+
+	void TileRenderer::cancel()
+	{
+		std::unique_lock lock{ mutex };
+		++generation;
+		queued.clear();
+		for (Tile& tile : finished)
+			freeBuffers.push_back(std::move(tile.pixels));
+		finished.clear();
+		totalTiles = 0;
+		collectedTiles = 0;
+		workerSignal.notify_all();
+		idleSignal.wait(lock, [this] { return !rendering; });
+		pBitmap = nullptr;
+	}
+
+	bool TileRenderer::collect(uchar* pImageData, const qsizetype bytesPerLine)
+	{
+		std::vector<Tile> tiles;
+		{
+			std::lock_guard lock{ mutex };
+			tiles.swap(finished);
+		}
+		if (tiles.empty())
+			return false;
+
+		for (Tile& tile : tiles)
+		{
+			const size_t tileWidth = tile.rect.width();
+			for (int y = tile.rect.top; y < tile.rect.bottom; y++)
+			{
+				const QRgb* pSource = tile.pixels.data() + tileWidth * (y - tile.rect.top);
+				std::copy_n(pSource, tileWidth, reinterpret_cast<QRgb*>(pImageData + bytesPerLine * y) + tile.rect.left);
+			}
+		}
+
+		{
+			std::lock_guard lock{ mutex };
+			collectedTiles += tiles.size();
+			for (Tile& tile : tiles)
+				freeBuffers.push_back(std::move(tile.pixels));
+		}
+		workerSignal.notify_all();
+		return true;
+	}
+
+	int TileRenderer::percentComplete()
+	{
+		std::lock_guard lock{ mutex };
+		return totalTiles == 0 ? 100 : static_cast<int>((100 * collectedTiles) / totalTiles);
+	}
+
+	void TileRenderer::run()
+	{
+		std::unique_lock lock{ mutex };
+		while (true)
+		{
+			// Wait for a tile to render and a free buffer (at most MaxTiles tiles wait to be collected).
+			workerSignal.wait(lock, [this]
+			{
+				return stopping || (!queued.empty() && finished.size() < MaxTiles);
+			});
+			if (stopping)
+				break;
+
+			Tile tile{ queued.front(), {} };
+			queued.pop_front();
+			if (!freeBuffers.empty())
+			{
+				tile.pixels = std::move(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+			tile.pixels.resize(static_cast<size_t>(TileSize) * TileSize);
+
+			const std::uint64_t tileGeneration = generation;
+			const StackedBitmap* const pSource = pBitmap;
+			rendering = true;
+			lock.unlock();
+
+			// The settings and the bitmap only change in start() and cancel(), which wait for this tile to be done.
+			pSource->renderTile(reinterpret_cast<uchar*>(tile.pixels.data()), tile.rect.width() * sizeof(QRgb), tile.rect,
+				bezierAdjust, histoAdjust, showClipping);
+
+			lock.lock();
+			rendering = false;
+			if (tileGeneration == generation)
+				finished.push_back(std::move(tile));
+			else
+				freeBuffers.push_back(std::move(tile.pixels));
+			idleSignal.notify_all();
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <thread>
+#include <condition_variable>
+#include "dssrect.h"
+#include "BezierAdjust.h"
+#include "histogram.h"
+
+namespace DSS
+{
+	class StackedBitmap;
+
+	//
+	// Renders a StackedBitmap with the processing settings in fixed size tiles on a background thread, so that the
+	// processing tab stays responsive while a large image is (re)rendered.
+	//
+	// start() queues the tiles of an area, those in the visible part of the image first (nearest to its centre first).
+	// The worker renders them (each tile with all the OpenMP threads) into a fixed number of tile buffers, the GUI thread
+	// copies the finished tiles into the displayed image with collect(), which frees the buffers again.
+	//
+	// Each start() or cancel() increments the generation: tiles of an older generation are not started anymore, and if
+	// one was being rendered it is dropped instead of being handed to collect().
+	// cancel() also waits for the worker to be idle, it must be called before the bitmap is loaded, cleared or destroyed.
+	//
+	class TileRenderer final
+	{
+	public:
+		static constexpr int TileSize = 256;
+		static constexpr size_t MaxTiles = 16;		// Number of tile buffers
+
+	private:
+		struct Tile
+		{
+			DSSRect rect;
+			std::vector<QRgb> pixels;
+		};
+
+		std::mutex mutex;
+		std::condition_variable workerSignal;	// Work queued, a buffer freed or stop requested
+		std::condition_variable idleSignal;		// The worker finished a tile
+		std::thread worker;
+		bool stopping;
+		bool rendering;
+
+		const StackedBitmap* pBitmap;
+		BezierAdjust bezierAdjust;
+		RGBHistogramAdjust histoAdjust;
+		bool showClipping;
+
+		std::uint64_t generation;
+		std::deque<DSSRect> queued;
+		std::vector<Tile> finished;
+		std::vector<std::vector<QRgb>> freeBuffers;
+		size_t totalTiles;
+		size_t collectedTiles;
+
+	public:
+		TileRenderer();
+		~TileRenderer();
+
+		TileRenderer(const TileRenderer&) = delete;
+		TileRenderer& operator=(const TileRenderer&) = delete;
+
+		//
+		// Cancels any previous rendering and queues the tiles of area (the whole bitmap when empty or outside it).
+		//
+		void start(const StackedBitmap& bitmap, const DSSRect& area, const DSSRect& visible, const BezierAdjust& bezier,
+			const RGBHistogramAdjust& histogram, const bool markClipping);
+		void cancel();
+
+		//
+		// Copies the finished tiles into the image (of the bitmap's size) - returns false if there were none.
+		//
+		bool collect(uchar* pImageData, const qsizetype bytesPerLine);
+
+		int percentComplete();
+
+	private:
+		void run();
+	};
+}
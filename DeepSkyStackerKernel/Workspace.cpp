@@ -164,6 +164,8 @@ void	WorkspaceSettings::InitToDefault(WORKSPACESETTINGVECTOR & vSettings)
 	vSettings.push_back(WorkspaceSetting("Stacking/LockCorners", true));
 
 	vSettings.push_back(WorkspaceSetting("Stacking/PixelSizeMultiplier", (uint)1));
+	vSettings.push_back(WorkspaceSetting("Stacking/DrizzleBands", false));
+	vSettings.push_back(WorkspaceSetting("Stacking/UseMasterLibrary", false));
 
 	vSettings.push_back(WorkspaceSetting("Stacking/AlignChannels", false));
 
@@ -15,6 +15,7 @@ AvxStacking::AvxStacking(const int lStart, const int lEnd, const CMemoryBitmap&
 	lineStart{ lStart }, lineEnd{ lEnd }, colEnd{ inputbm.Width() },
 	width{ colEnd }, height{ lineEnd - lineStart },
 	resultWidth{ resultRect.width() }, resultHeight{ resultRect.height() },
+	windowLeft{ 0 }, windowTop{ 0 }, windowWidth{ resultRect.width() }, windowHeight{ resultRect.height() },
 	vectorsPerLine{ AvxSupport::numberOfAvxVectors<float, VectorElementType>(width) },
 	xCoordinates(width >= 0 && height >= 0 ? vectorsPerLine * height : 0),
 	yCoordinates(width >= 0 && height >= 0 ? vectorsPerLine * height : 0),
@@ -25,7 +26,8 @@ AvxStacking::AvxStacking(const int lStart, const int lEnd, const CMemoryBitmap&
 	tempBitmap{ tempbm },
 	avxCfa{ static_cast<size_t>(lStart), static_cast<size_t>(lEnd), inputbm },
 	entropyData{ entrdat },
-	avx2Enabled{ AvxSimdCheck::checkSimdAvailability() }
+	avx2Enabled{ AvxSimdCheck::checkSimdAvailability() },
+	avx512Enabled{ AvxSimdCheck::checkAvx512Availability() }
 {
 	if (width < 0 || height < 0)
 		throw std::invalid_argument("End index smaller than start index for line or column of AvxStacking");
@@ -62,6 +64,14 @@ void AvxStacking::resizeColorVectors(const size_t nrVectors)
 	}
 }
 
+void AvxStacking::setWindow(const DSSRect& window)
+{
+	windowLeft = window.left;
+	windowTop = window.top;
+	windowWidth = window.width();
+	windowHeight = window.height();
+}
+
 int AvxStacking::stack(const CPixelTransform& pixelTransformDef, const CTaskInfo& taskInfo, const CBackgroundCalibration& backgroundCalibrationDef, std::shared_ptr<CMemoryBitmap> outputBitmap, const int pixelSizeMultiplier)
 {
 	static_assert(sizeof(unsigned int) == sizeof(std::uint32_t));
@@ -94,6 +104,9 @@ int Avx256Stacking::doStack(const CPixelTransform& pixelTransformDef, const CTas
 {
 	if (pixelSizeMultiplier != 1 || pixelTransformDef.m_lPixelSizeMultiplier != 1)
 		return 1;
+	// The entropy coverage is the size of the result.
+	if (taskInfo.m_Method == MBP_ENTROPYAVERAGE && (stackData.windowWidth != stackData.resultWidth || stackData.windowHeight != stackData.resultHeight))
+		return 1;
 
 	// Check input bitmap.
 	const AvxSupport avxInputSupport{ stackData.inputBitmap };
@@ -107,7 +120,7 @@ int Avx256Stacking::doStack(const CPixelTransform& pixelTransformDef, const CTas
 
 	if (avxInputSupport.isMonochromeCfaBitmapOfType<T>() && stackData.avxCfa.interpolate(stackData.lineStart, stackData.lineEnd, pixelSizeMultiplier) != 0)
 		return 1;
-	if (pixelTransform(pixelTransformDef) != 0)
+	if (SimdSelector<Avx512Stacking, Avx256Stacking>(&stackData, [&pixelTransformDef](auto&& o) { return o.pixelTransform(pixelTransformDef); }) != 0)
 		return 1;
 	if (backgroundCalibration<T>(backgroundCalibrationDef) != 0)
 		return 1;
@@ -635,6 +648,11 @@ int Avx256Stacking::pixelPartitioning()
 
 	const __m256i resultWidthVec = _mm256_set1_epi32(stackData.resultWidth);
 	const __m256i resultHeightVec = _mm256_set1_epi32(stackData.resultHeight);
+	// The temp bitmap holds the window of the result.
+	const __m256i windowLeftVec = _mm256_set1_epi32(stackData.windowLeft);
+	const __m256i windowTopVec = _mm256_set1_epi32(stackData.windowTop);
+	const __m256i windowWidthVec = _mm256_set1_epi32(stackData.windowWidth);
+	const __m256i windowHeightVec = _mm256_set1_epi32(stackData.windowHeight);
 
 	const __m256i outWidthVec = _mm256_set1_epi32(outWidth);
 	const auto getColorPointer = [this](const auto& colorPixels, const size_t row) -> const float*
@@ -810,10 +828,13 @@ int Avx256Stacking::pixelPartitioning()
 				resultRectCheck(yii, resultHeightVec, ycoord) // y-coord check against height
 			);
 
-			const __m256i columnMask1 = getColumnOrRowMask(xii, resultWidthVec);
-			const __m256i columnMask2 = getColumnOrRowMask(_mm256_sub_epi32(xii, allOnes), resultWidthVec);
-			__m256i rowMask = getColumnOrRowMask(yii, resultHeightVec);
-			__m256i outIndex = _mm256_add_epi32(_mm256_mullo_epi32(outWidthVec, yii), xii);
+			// Coordinates in the window.
+			const __m256i xwi = _mm256_sub_epi32(xii, windowLeftVec);
+			const __m256i ywi = _mm256_sub_epi32(yii, windowTopVec);
+			const __m256i columnMask1 = getColumnOrRowMask(xwi, windowWidthVec);
+			const __m256i columnMask2 = getColumnOrRowMask(_mm256_sub_epi32(xwi, allOnes), windowWidthVec);
+			__m256i rowMask = getColumnOrRowMask(ywi, windowHeightVec);
+			__m256i outIndex = _mm256_add_epi32(_mm256_mullo_epi32(outWidthVec, ywi), xwi);
 
 			// Check if two adjacent indices are equal: Subtract the x-coordinates horizontally and check if any of the results equals zero. If so -> adjacent x-coordinates are equal.
 			// (a & b) == 0 -> ZF=1, (~a & b) == 0 -> CF=1; testc: return CF; testz: return ZF; testnzc: IF (ZF == 0 && CF == 0) return 1;
@@ -841,7 +862,7 @@ int Avx256Stacking::pixelPartitioning()
 			// 4.Fraction at (xtruncated+1, ytruncated+1)
 			fraction1 = _mm256_mul_ps(xfrac1, yfractional);
 			fraction2 = _mm256_mul_ps(xfractional, yfractional);
-			rowMask = getColumnOrRowMask(_mm256_sub_epi32(yii, allOnes), resultHeightVec);
+			rowMask = getColumnOrRowMask(_mm256_sub_epi32(ywi, allOnes), windowHeightVec);
 			rowMask = _mm256_and_si256(_mm256_and_si256(rowMask, resultRectMask), loopIndexMask);
 			mask1 = _mm256_and_si256(columnMask1, rowMask);
 			mask2 = _mm256_and_si256(columnMask2, rowMask);
@@ -1033,6 +1054,184 @@ inline void Avx256Stacking::getAvxEntropy(__m256& redEntropy, __m256& greenEntro
 }
 
 
+// ****************
+// AVX-512 Stacking
+// ****************
+
+int Avx512Stacking::pixelTransform(const CPixelTransform& pixelTransformDef)
+{
+	if (!stackData.avx512Enabled)
+		return 1;
+
+	constexpr int PixelsPerVector = 16; // 16 floats in __m512 vectors.
+	const CBilinearParameters& bilinearParams = pixelTransformDef.m_BilinearParameters;
+
+	// Number of vectors with 16 pixels each to process. The coordinate vectors are made of __m512 elements, so they are large enough.
+	const size_t nrVectors = AvxSupport::numberOfAvxVectors<float, __m512>(stackData.width);
+	const float fxShift = static_cast<float>(pixelTransformDef.m_fXShift + (pixelTransformDef.m_bUseCometShift ? pixelTransformDef.m_fXCometShift : 0.0));
+	const float fyShift = static_cast<float>(pixelTransformDef.m_fYShift + (pixelTransformDef.m_bUseCometShift ? pixelTransformDef.m_fYCometShift : 0.0));
+	const __m512 fxShiftVec = _mm512_set1_ps(fxShift);
+	const __m512 fyShiftVec = _mm512_set1_ps(fyShift);
+	const __m512i firstIndices = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	// Superfast version if no transformation required: indices = coordinates.
+	if (bilinearParams.Type == TT_BILINEAR && (
+		bilinearParams.fXWidth == 1.0f && bilinearParams.fYWidth == 1.0f &&
+		bilinearParams.a1 == 1.0f && bilinearParams.b2 == 1.0f &&
+		bilinearParams.a0 == 0.0f && bilinearParams.a2 == 0.0f && bilinearParams.a3 == 0.0f &&
+		bilinearParams.b0 == 0.0f && bilinearParams.b1 == 0.0f && bilinearParams.b3 == 0.0f
+		))
+	{
+		for (int row = 0; row < stackData.height; ++row)
+		{
+			const __m512 yLine = _mm512_set1_ps(static_cast<float>(stackData.lineStart + row) + fyShift);
+			float* pXLine = stackData.row(stackData.xCoordinates, row);
+			float* pYLine = stackData.row(stackData.yCoordinates, row);
+			__m512i xline = firstIndices;
+
+			for (size_t counter = 0; counter < nrVectors; ++counter, pXLine += PixelsPerVector, pYLine += PixelsPerVector)
+			{
+				_mm512_store_ps(pXLine, _mm512_add_ps(_mm512_cvtepi32_ps(xline), fxShiftVec));
+				_mm512_store_ps(pYLine, yLine);
+				xline = _mm512_add_epi32(xline, _mm512_set1_epi32(PixelsPerVector));
+			}
+		}
+		return 0;
+	}
+
+	const auto coefficient = [](const auto value) { return _mm512_set1_ps(static_cast<float>(value)); };
+	const __m512 xWidth = coefficient(bilinearParams.fXWidth);
+	const __m512 yWidth = coefficient(bilinearParams.fYWidth);
+
+	// Same order of the fused multiply-adds as in the AVX-256 version, so that both give identical results.
+	const auto linearTransform = [](const __m512 c0, const __m512 c1, const __m512 c2, const __m512 c3, const __m512 x, const __m512 y, const __m512 xy) -> __m512
+	{
+		return _mm512_fmadd_ps(c3, xy, _mm512_fmadd_ps(c2, y, _mm512_fmadd_ps(c1, x, c0))); // (((c0 + c1*x) + c2*y) + c3*x*y)
+	};
+	const auto squaredTransform = [](const __m512 c4, const __m512 c5, const __m512 c6, const __m512 c7, const __m512 c8,
+		const __m512 linearPart, const __m512 x2, const __m512 y2, const __m512 x2y, const __m512 xy2, const __m512 x2y2) -> __m512
+	{
+		return _mm512_fmadd_ps(c8, x2y2, _mm512_fmadd_ps(c7, xy2, _mm512_fmadd_ps(c6, x2y, _mm512_fmadd_ps(c5, y2, _mm512_fmadd_ps(c4, x2, linearPart))))); // (((((l + c4*x2) + c5*y2) + c6*x2y) + c7*xy2) + c8*x2y2)
+	};
+
+	// Loops over all rows, transform(x, y) returns the transformed (x, y) of 16 pixels.
+	const auto transformRows = [this, nrVectors, firstIndices, xWidth, yWidth, fxShiftVec, fyShiftVec, &bilinearParams](const auto& transform) -> void
+	{
+		for (int row = 0; row < stackData.height; ++row)
+		{
+			const __m512 vy = _mm512_set1_ps(static_cast<float>(stackData.lineStart + row) / static_cast<float>(bilinearParams.fYWidth));
+			float* pXLine = stackData.row(stackData.xCoordinates, row);
+			float* pYLine = stackData.row(stackData.yCoordinates, row);
+			__m512i xline = firstIndices;
+
+			for (size_t counter = 0; counter < nrVectors; ++counter, pXLine += PixelsPerVector, pYLine += PixelsPerVector)
+			{
+				const __m512 vx = _mm512_div_ps(_mm512_cvtepi32_ps(xline), xWidth);
+				xline = _mm512_add_epi32(xline, _mm512_set1_epi32(PixelsPerVector));
+
+				const auto [xr, yr] = transform(vx, vy);
+
+				_mm512_store_ps(pXLine, _mm512_fmadd_ps(xr, xWidth, fxShiftVec)); // xr * fxWidth + fxShift
+				_mm512_store_ps(pYLine, _mm512_fmadd_ps(yr, yWidth, fyShiftVec)); // yr * fyWidth + fyShift
+			}
+		}
+	};
+
+	const __m512 a0 = coefficient(bilinearParams.a0);
+	const __m512 a1 = coefficient(bilinearParams.a1);
+	const __m512 a2 = coefficient(bilinearParams.a2);
+	const __m512 a3 = coefficient(bilinearParams.a3);
+	const __m512 b0 = coefficient(bilinearParams.b0);
+	const __m512 b1 = coefficient(bilinearParams.b1);
+	const __m512 b2 = coefficient(bilinearParams.b2);
+	const __m512 b3 = coefficient(bilinearParams.b3);
+
+	if (bilinearParams.Type == TT_BILINEAR)
+	{
+		transformRows([&](const __m512 vx, const __m512 vy) -> std::pair<__m512, __m512>
+		{
+			const __m512 xy = _mm512_mul_ps(vx, vy);
+			return { linearTransform(a0, a1, a2, a3, vx, vy, xy), linearTransform(b0, b1, b2, b3, vx, vy, xy) };
+		});
+		return 0;
+	}
+
+	const __m512 a4 = coefficient(bilinearParams.a4);
+	const __m512 a5 = coefficient(bilinearParams.a5);
+	const __m512 a6 = coefficient(bilinearParams.a6);
+	const __m512 a7 = coefficient(bilinearParams.a7);
+	const __m512 a8 = coefficient(bilinearParams.a8);
+	const __m512 b4 = coefficient(bilinearParams.b4);
+	const __m512 b5 = coefficient(bilinearParams.b5);
+	const __m512 b6 = coefficient(bilinearParams.b6);
+	const __m512 b7 = coefficient(bilinearParams.b7);
+	const __m512 b8 = coefficient(bilinearParams.b8);
+
+	const auto squaredPart = [&](const __m512 vx, const __m512 vy) -> std::pair<__m512, __m512>
+	{
+		const __m512 xy = _mm512_mul_ps(vx, vy);
+		const __m512 x2 = _mm512_mul_ps(vx, vx);
+		const __m512 y2 = _mm512_mul_ps(vy, vy);
+		const __m512 x2y = _mm512_mul_ps(x2, vy);
+		const __m512 xy2 = _mm512_mul_ps(vx, y2);
+		const __m512 x2y2 = _mm512_mul_ps(x2, y2);
+		return {
+			squaredTransform(a4, a5, a6, a7, a8, linearTransform(a0, a1, a2, a3, vx, vy, xy), x2, y2, x2y, xy2, x2y2),
+			squaredTransform(b4, b5, b6, b7, b8, linearTransform(b0, b1, b2, b3, vx, vy, xy), x2, y2, x2y, xy2, x2y2)
+		};
+	};
+
+	if (bilinearParams.Type == TT_BISQUARED)
+	{
+		transformRows(squaredPart);
+		return 0;
+	}
+
+	if (bilinearParams.Type == TT_BICUBIC)
+	{
+		const __m512 a9 = coefficient(bilinearParams.a9);
+		const __m512 a10 = coefficient(bilinearParams.a10);
+		const __m512 a11 = coefficient(bilinearParams.a11);
+		const __m512 a12 = coefficient(bilinearParams.a12);
+		const __m512 a13 = coefficient(bilinearParams.a13);
+		const __m512 a14 = coefficient(bilinearParams.a14);
+		const __m512 a15 = coefficient(bilinearParams.a15);
+		const __m512 b9 = coefficient(bilinearParams.b9);
+		const __m512 b10 = coefficient(bilinearParams.b10);
+		const __m512 b11 = coefficient(bilinearParams.b11);
+		const __m512 b12 = coefficient(bilinearParams.b12);
+		const __m512 b13 = coefficient(bilinearParams.b13);
+		const __m512 b14 = coefficient(bilinearParams.b14);
+		const __m512 b15 = coefficient(bilinearParams.b15);
+
+		// 32 zmm registers are enough to do the squared and the cubic part in one pass (the AVX-256 version needs two).
+		transformRows([&](const __m512 vx, const __m512 vy) -> std::pair<__m512, __m512>
+		{
+			const auto [rsx, rsy] = squaredPart(vx, vy);
+
+			const __m512 x2 = _mm512_mul_ps(vx, vx);
+			const __m512 y2 = _mm512_mul_ps(vy, vy);
+			const __m512 x3 = _mm512_mul_ps(x2, vx);
+			const __m512 y3 = _mm512_mul_ps(y2, vy);
+			const __m512 x3y = _mm512_mul_ps(x3, vy);
+			const __m512 xy3 = _mm512_mul_ps(vx, y3);
+			const __m512 x3y2 = _mm512_mul_ps(x3, y2);
+			const __m512 x2y3 = _mm512_mul_ps(x2, y3);
+			const __m512 x3y3 = _mm512_mul_ps(x3, y3);
+
+			// (((((squarePart + a9*x3) + a10*y3) + a11*x3y) + a12*xy3) + a13*x3y2) + a14*x2y3) + a15*x3y3)
+			return {
+				_mm512_fmadd_ps(a15, x3y3, _mm512_fmadd_ps(a14, x2y3, _mm512_fmadd_ps(a13, x3y2, _mm512_fmadd_ps(a12, xy3, _mm512_fmadd_ps(a11, x3y, _mm512_fmadd_ps(a10, y3, _mm512_fmadd_ps(a9, x3, rsx))))))),
+				_mm512_fmadd_ps(b15, x3y3, _mm512_fmadd_ps(b14, x2y3, _mm512_fmadd_ps(b13, x3y2, _mm512_fmadd_ps(b12, xy3, _mm512_fmadd_ps(b11, x3y, _mm512_fmadd_ps(b10, y3, _mm512_fmadd_ps(b9, x3, rsy)))))))
+			};
+		});
+		return 0;
+	}
+
+	return 1;
+}
+
+
 // ****************
 // Non-AVX Stacking
 // ****************
@@ -1044,20 +1243,28 @@ int NonAvxStacking::stack(const CPixelTransform& pixelTransformDef, const CTaskI
 	vPixels.reserve(16);
 
 	const bool isColor = AvxSupport{ this->stackData.entropyData.inputBitmap }.isColorBitmapOrCfa();
+	const bool isEntropy = taskInfo.m_Method == MBP_ENTROPYAVERAGE;
+
+	// Entropy weights of the current line.
+	std::vector<double> redEntropies(isEntropy ? width : 0);
+	std::vector<double> greenEntropies(isEntropy ? width : 0);
+	std::vector<double> blueEntropies(isEntropy ? width : 0);
 
 	for (int j = this->stackData.lineStart; j < this->stackData.lineEnd; ++j)
 	{
+		if (isEntropy)
+			this->stackData.entropyData.entropyInfo.GetRowEntropies(0, j, width, redEntropies.data(), greenEntropies.data(), blueEntropies.data());
+
 		for (int i = 0; i < width; ++i)
 		{
 			const QPointF ptOut = pixelTransformDef.transform(QPointF(i, j));
 
 			COLORREF16 crColor;
-			double fRedEntropy = 1.0, fGreenEntropy = 1.0, fBlueEntropy = 1.0;
+			const double fRedEntropy = isEntropy ? redEntropies[i] : 1.0;
+			const double fGreenEntropy = isEntropy ? greenEntropies[i] : 1.0;
+			const double fBlueEntropy = isEntropy ? blueEntropies[i] : 1.0;
 
-			if (taskInfo.m_Method == MBP_ENTROPYAVERAGE)
-				this->stackData.entropyData.entropyInfo.GetPixel(i, j, fRedEntropy, fGreenEntropy, fBlueEntropy, crColor);
-			else
-				this->stackData.inputBitmap.GetPixel16(i, j, crColor);
+			this->stackData.inputBitmap.GetPixel16(i, j, crColor);
 
 			float Red = crColor.red;
 			float Green = crColor.green;
@@ -1074,10 +1281,13 @@ int NonAvxStacking::stack(const CPixelTransform& pixelTransformDef, const CTaskI
 				for (CPixelDispatch& Pixel : vPixels)
 				{
 					// For each plane adjust the values
-					if (Pixel.m_lX >= 0 && Pixel.m_lX < this->stackData.resultWidth && Pixel.m_lY >= 0 && Pixel.m_lY < this->stackData.resultHeight)
+					// Only the pixels of the window are in the temp bitmap.
+					const int x = Pixel.m_lX - this->stackData.windowLeft;
+					const int y = Pixel.m_lY - this->stackData.windowTop;
+					if (x >= 0 && x < this->stackData.windowWidth && y >= 0 && y < this->stackData.windowHeight)
 					{
 						// Special case for entropy average
-						if (taskInfo.m_Method == MBP_ENTROPYAVERAGE)
+						if (isEntropy)
 						{
 							if (isColor)
 							{
@@ -1111,14 +1321,14 @@ int NonAvxStacking::stack(const CPixelTransform& pixelTransformDef, const CTaskI
 
 						double fPreviousRed, fPreviousGreen, fPreviousBlue;
 
-						this->stackData.tempBitmap.GetPixel(Pixel.m_lX, Pixel.m_lY, fPreviousRed, fPreviousGreen, fPreviousBlue);
+						this->stackData.tempBitmap.GetPixel(x, y, fPreviousRed, fPreviousGreen, fPreviousBlue);
 						fPreviousRed += static_cast<double>(Red) / 256.0 * Pixel.m_fPercentage;
 						fPreviousGreen += static_cast<double>(Green) / 256.0 * Pixel.m_fPercentage;
 						fPreviousBlue += static_cast<double>(Blue) / 256.0 * Pixel.m_fPercentage;
 						fPreviousRed = std::min(fPreviousRed, 255.0);
 						fPreviousGreen = std::min(fPreviousGreen, 255.0);
 						fPreviousBlue = std::min(fPreviousBlue, 255.0);
-						this->stackData.tempBitmap.SetPixel(Pixel.m_lX, Pixel.m_lY, fPreviousRed, fPreviousGreen, fPreviousBlue);
+						this->stackData.tempBitmap.SetPixel(x, y, fPreviousRed, fPreviousGreen, fPreviousBlue);
 					}
 				}
 			}
@@ -4,12 +4,14 @@
 #include <immintrin.h>
 
 class AvxEntropy;
+class DSSRect;
 class CPixelTransform;
 class CTaskInfo;
 class CBackgroundCalibration;
 class AvxStacking
 {
 private:
+	friend class Avx512Stacking;
 	friend class Avx256Stacking;
 	friend class NonAvxStacking;
 
@@ -19,6 +21,7 @@ private:
 	int lineStart, lineEnd, colEnd;
 	int width, height;
 	int resultWidth, resultHeight;
+	int windowLeft, windowTop, windowWidth, windowHeight;
 	size_t vectorsPerLine;
 	VectorType xCoordinates;
 	VectorType yCoordinates;
@@ -30,6 +33,7 @@ private:
 	AvxCfaProcessing avxCfa;
 	AvxEntropy& entropyData;
 	bool avx2Enabled;
+	bool avx512Enabled;
 public:
 	AvxStacking() = delete;
 	AvxStacking(const int lStart, const int lEnd, const CMemoryBitmap& inputbm, CMemoryBitmap& tempbm, const class DSSRect& resultRect, AvxEntropy& entrdat);
@@ -38,6 +42,8 @@ public:
 	AvxStacking& operator=(const AvxStacking&) = delete;
 
 	void init(const int lStart, const int lEnd);
+	// The temp bitmap only holds the rectangle window of the result (drizzle in bands, mosaic frames).
+	void setWindow(const DSSRect& window);
 
 	int stack(const CPixelTransform& pixelTransformDef, const CTaskInfo& taskInfo, const CBackgroundCalibration& backgroundCalibrationDef, std::shared_ptr<CMemoryBitmap> outputBitmap, const int pixelSizeMultiplier);
 private:
@@ -81,6 +87,20 @@ private:
 	void getAvxEntropy(__m256& redEntropy, __m256& greenEntropy, __m256& blueEntropy, const __m256i xIndex, const int row);
 };
 
+// AVX-512 versions of the compute bound steps of Avx256Stacking (currently the pixel transformation).
+// The remaining steps are limited by memory bandwidth and gathers, they run with the AVX-256 code.
+class Avx512Stacking : public SimdFactory<Avx512Stacking>
+{
+private:
+	friend class Avx256Stacking;
+	friend class SimdFactory<Avx512Stacking>;
+
+	AvxStacking& stackData;
+	Avx512Stacking(AvxStacking& sd) : stackData{ sd } {}
+
+	int pixelTransform(const CPixelTransform& pixelTransformDef);
+};
+
 class NonAvxStacking : public SimdFactory<NonAvxStacking>
 {
 private:
@@ -0,0 +1,639 @@
+#include "stdafx.h"
+#include <immintrin.h>
+#include "avx_ahd.h"
+#include "avx_support.h"
+#include "Bayer.h"
+
+namespace
+{
+	constexpr ptrdiff_t WS = AvxAhd::WindowSize;
+	constexpr float MaxPixel = 255.0f * 256.0f; // As ClampPixel()
+	// Left, right, above, below
+	constexpr ptrdiff_t Neighbours[4] = { -1, 1, -WS, WS };
+
+	std::uint16_t toPixel(const float value)
+	{
+		return static_cast<std::uint16_t>(std::clamp(value, 0.0f, MaxPixel));
+	}
+
+	float median(const float v1, const float v2, const float v3)
+	{
+		return std::clamp(v3, std::min(v1, v2), std::max(v1, v2));
+	}
+
+	// Green at a red or blue pixel v0 from its neighbours g1 and g3 (green) and v4 and v2 (same colour as v0).
+	float greenFromNeighbours(const float g1, const float g3, const float v0, const float v4, const float v2)
+	{
+		const float low = std::min(g1, g3);
+		const float high = std::max(g1, g3);
+		float green = (g1 + v0 + g3) / 2.0f - (v4 + v2) / 4.0f;
+		if (green > high || green < low)
+			green = std::abs(v0 - v4) < std::abs(v0 - v2) ? g1 + (v0 - v4) / 2.0f : g3 + (v0 - v2) / 2.0f;
+		return std::clamp(green, low, high);
+	}
+
+	// -------------------------------
+	// AVX helpers (8 pixels per call)
+	// -------------------------------
+
+	inline __m256 loadPixels(const std::uint16_t* const p)
+	{
+		return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+	}
+
+	inline void storePixels(std::uint16_t* const p, const __m256i values)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1)));
+	}
+
+	// Values must be integers or clamped with clampPixels(), the fraction is truncated like the conversion of a double to std::uint16_t.
+	inline void storePixels(std::uint16_t* const p, const __m256 values)
+	{
+		storePixels(p, _mm256_cvttps_epi32(values));
+	}
+
+	inline __m256 clampPixels(const __m256 values)
+	{
+		return _mm256_min_ps(_mm256_max_ps(values, _mm256_setzero_ps()), _mm256_set1_ps(MaxPixel));
+	}
+
+	inline __m256 median(const __m256 v1, const __m256 v2, const __m256 v3)
+	{
+		return _mm256_min_ps(_mm256_max_ps(v3, _mm256_min_ps(v1, v2)), _mm256_max_ps(v1, v2));
+	}
+
+	inline __m256 absolute(const __m256 values)
+	{
+		return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), values);
+	}
+
+	inline __m256 greenFromNeighbours(const __m256 g1, const __m256 g3, const __m256 v0, const __m256 v4, const __m256 v2)
+	{
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 low = _mm256_min_ps(g1, g3);
+		const __m256 high = _mm256_max_ps(g1, g3);
+		const __m256 green = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(g1, v0), g3), half), _mm256_mul_ps(_mm256_add_ps(v4, v2), _mm256_set1_ps(0.25f)));
+		const __m256 d4 = _mm256_sub_ps(v0, v4);
+		const __m256 d2 = _mm256_sub_ps(v0, v2);
+		const __m256 alternative = _mm256_blendv_ps(
+			_mm256_add_ps(g3, _mm256_mul_ps(d2, half)),
+			_mm256_add_ps(g1, _mm256_mul_ps(d4, half)),
+			_mm256_cmp_ps(absolute(d4), absolute(d2), _CMP_LT_OQ)
+		);
+		const __m256 outside = _mm256_or_ps(_mm256_cmp_ps(green, high, _CMP_GT_OQ), _mm256_cmp_ps(green, low, _CMP_LT_OQ));
+		return _mm256_min_ps(_mm256_max_ps(_mm256_blendv_ps(green, alternative, outside), low), high);
+	}
+
+	// Lanes 0, 2, 4, 6 or lanes 1, 3, 5, 7 set.
+	inline __m256 alternateLanes(const bool evenLanes)
+	{
+		return evenLanes
+			? _mm256_castsi256_ps(_mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0))
+			: _mm256_castsi256_ps(_mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+	}
+
+	// [first, first + 8 * number of vectors) with all vectors inside [first, last).
+	inline std::pair<int, int> vectorRange(const int first, const int last)
+	{
+		return { first, first + (std::max(0, last - first) / 8) * 8 };
+	}
+
+	// XYZ coefficients scaled from 0..65536 to the LUT index range.
+	constexpr float LabScale = 65535.0f / 65536.0f;
+	constexpr float XRed = 0.433953f * LabScale, XGreen = 0.376219f * LabScale, XBlue = 0.189828f * LabScale;
+	constexpr float YRed = 0.212671f * LabScale, YGreen = 0.715160f * LabScale, YBlue = 0.072169f * LabScale;
+	constexpr float ZRed = 0.017758f * LabScale, ZGreen = 0.109477f * LabScale, ZBlue = 0.872766f * LabScale;
+}
+
+AvxAhd::AvxAhd() :
+	hRed(WindowArea, 0), hGreen(WindowArea, 0), hBlue(WindowArea, 0),
+	vRed(WindowArea, 0), vGreen(WindowArea, 0), vBlue(WindowArea, 0),
+	hL(WindowArea, 0.0f), ha(WindowArea, 0.0f), hb(WindowArea, 0.0f),
+	vL(WindowArea, 0.0f), va(WindowArea, 0.0f), vb(WindowArea, 0.0f),
+	hHomo(WindowArea, 0), vHomo(WindowArea, 0),
+	avxReady{ AvxSimdCheck::checkSimdAvailability() },
+	pGrayBitmap{ nullptr },
+	pGray{ nullptr },
+	x{ 0 }, y{ 0 },
+	width{ 0 }, height{ 0 },
+	cols{ 0 }, rows{ 0 },
+	cfaType{ CFATYPE_NONE },
+	firstLineBlue{ false }
+{}
+
+int AvxAhd::processWindow(const CGrayBitmapT<std::uint16_t>& grayBitmap, CColorBitmapT<std::uint16_t>& colorBitmap, const int xOrigin, const int yOrigin)
+{
+	this->pGrayBitmap = &grayBitmap;
+	this->x = xOrigin;
+	this->y = yOrigin;
+	this->width = grayBitmap.Width();
+	this->height = grayBitmap.Height();
+	this->cols = std::min(WindowSize, width - x);
+	this->rows = std::min(WindowSize, height - y);
+	this->pGray = grayBitmap.GetGrayPixel(x, y);
+	this->cfaType = grayBitmap.GetCFAType();
+	this->firstLineBlue = IsBayerBlueLine(y, cfaType, grayBitmap.yOffset());
+
+	return SimdSelector<Avx256Ahd, NonAvxAhd>(this, [&colorBitmap](auto&& o) { return o.processWindow(colorBitmap); });
+}
+
+const std::vector<float>& AvxAhd::labLut()
+{
+	static const std::vector<float> lut = []()
+	{
+		std::vector<float> values;
+		values.reserve(0x10000);
+		for (int i = 0; i < 0x10000; i++)
+		{
+			constexpr float exponent = float{ 1.0 / 3.0 };
+			constexpr float addend = float{ 16.0 / 116.0 };
+
+			const float r = static_cast<float>(i) / 65535.0f;
+			values.push_back(r > 0.008856f ? std::pow(r, exponent) : 7.787f * r + addend);
+		}
+		return values;
+	}();
+	return lut;
+}
+
+void AvxAhd::rgbToLab(const float red, const float green, const float blue, float& L, float& a, float& b)
+{
+	const std::vector<float>& lut = labLut();
+	const auto f = [&lut](const float value) { return lut[std::min(static_cast<int>(value), 0xffff)]; };
+
+	const float X = f(XRed * red + XGreen * green + XBlue * blue);
+	const float Y = f(YRed * red + YGreen * green + YBlue * blue);
+	const float Z = f(ZRed * red + ZGreen * green + ZBlue * blue);
+
+	L = 116.0f * Y - 16.0f;
+	a = 500.0f * (X - Y);
+	b = 200.0f * (Y - Z);
+}
+
+void AvxAhd::interpolateGreen(const int col, const int row)
+{
+	const int wx = x + col;
+	const int wy = y + row;
+	const std::uint16_t* const p = pGray + row * static_cast<ptrdiff_t>(width) + col;
+	const size_t n = index(col, row);
+	const auto value = [p](const bool inside, const ptrdiff_t offset) { return inside ? static_cast<float>(p[offset]) : 0.0f; };
+
+	switch (pGrayBitmap->GetBayerColor(wx, wy))
+	{
+	case BAYER_BLUE:
+	case BAYER_RED:
+	{
+		const float v0 = p[0];
+		const ptrdiff_t w = width;
+		hGreen[n] = toPixel(greenFromNeighbours(value(wx > 0, -1), value(wx < width - 1, 1), v0, value(wx > 1, -2), value(wx < width - 2, 2)));
+		vGreen[n] = toPixel(greenFromNeighbours(value(wy > 0, -w), value(wy < height - 1, w), v0, value(wy > 1, -2 * w), value(wy < height - 2, 2 * w)));
+		break;
+	}
+	case BAYER_GREEN:
+		hGreen[n] = vGreen[n] = toPixel(p[0]);
+		break;
+	default:
+		hGreen[n] = vGreen[n] = 0;
+		break;
+	}
+}
+
+void AvxAhd::interpolateRedBlue(const int col, const int row, const bool blueLine)
+{
+	const int wx = x + col;
+	const int wy = y + row;
+	const ptrdiff_t w = width;
+	const std::uint16_t* const p = pGray + row * w + col;
+	const size_t n = index(col, row);
+	const std::uint16_t* const pH = hGreen.data() + n;
+	const std::uint16_t* const pV = vGreen.data() + n;
+	const auto value = [](const bool inside, const std::uint16_t* const pPixel, const ptrdiff_t offset) { return inside ? static_cast<float>(pPixel[offset]) : 0.0f; };
+
+	// The colour of the line, and the other one.
+	std::uint16_t& lineH = blueLine ? hBlue[n] : hRed[n];
+	std::uint16_t& lineV = blueLine ? vBlue[n] : vRed[n];
+	std::uint16_t& otherH = blueLine ? hRed[n] : hBlue[n];
+	std::uint16_t& otherV = blueLine ? vRed[n] : vBlue[n];
+
+	switch (pGrayBitmap->GetBayerColor(wx, wy))
+	{
+	case BAYER_BLUE:
+	case BAYER_RED:
+	{
+		//  v0  G  v1
+		//  G  [v] G
+		//  v2  G  v3
+		lineH = lineV = p[0];
+
+		const float v = value(wx > 0 && wy > 0, p, -1 - w) + value(wx < width - 1 && wy > 0, p, 1 - w)
+			+ value(wx > 0 && wy < height - 1, p, -1 + w) + value(wx < width - 1 && wy < height - 1, p, 1 + w);
+		const auto interpolate = [&value, col, row, v](const std::uint16_t* const pGreen)
+		{
+			const float g = value(col > 0 && row > 0, pGreen, -1 - WS) + value(col < WS - 1 && row > 0, pGreen, 1 - WS)
+				+ value(col > 0 && row < WS - 1, pGreen, -1 + WS) + value(col < WS - 1 && row < WS - 1, pGreen, 1 + WS);
+			return pGreen[0] + (v - g) / 4.0f;
+		};
+		otherH = toPixel(interpolate(pH));
+		otherV = toPixel(interpolate(pV));
+		break;
+	}
+	case BAYER_GREEN:
+	{
+		const float g = p[0];
+
+		// Horizontally: v1 [v] v2
+		float v1 = value(wx > 0, p, -1);
+		float v2 = value(wx < width - 1, p, 1);
+		if (v1 == v2)
+			lineH = lineV = toPixel(v1);
+		else
+		{
+			lineV = toPixel(g + (v1 + v2 - value(col > 0, pV, -1) - value(col < WS - 1, pV, 1)) / 2.0f);
+			lineH = toPixel(median(v1, v2, (v1 + v2) / 2.0f + (2.0f * g - value(col > 0, pH, -1) - value(col < WS - 1, pH, 1)) / 4.0f));
+		}
+
+		// Vertically
+		v1 = value(wy > 0, p, -w);
+		v2 = value(wy < height - 1, p, w);
+		if (v1 == v2)
+			otherH = otherV = toPixel(v1);
+		else
+		{
+			otherH = toPixel(g + (v1 + v2 - value(row > 0, pH, -WS) - value(row < WS - 1, pH, WS)) / 2.0f);
+			otherV = toPixel(median(v1, v2, (v1 + v2) / 2.0f + (2.0f * g - value(row > 0, pV, -WS) - value(row < WS - 1, pV, WS)) / 4.0f));
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void AvxAhd::convertToLab(const size_t n)
+{
+	rgbToLab(hRed[n], hGreen[n], hBlue[n], hL[n], ha[n], hb[n]);
+	rgbToLab(vRed[n], vGreen[n], vBlue[n], vL[n], va[n], vb[n]);
+}
+
+void AvxAhd::buildHomogeneity(const size_t n)
+{
+	const float* const pHL = hL.data() + n;
+	const float* const pHa = ha.data() + n;
+	const float* const pHb = hb.data() + n;
+	const float* const pVL = vL.data() + n;
+	const float* const pVa = va.data() + n;
+	const float* const pVb = vb.data() + n;
+
+	float lDiffH[4], lDiffV[4], abDiffH[4], abDiffV[4];
+	for (int i = 0; i < 4; i++)
+	{
+		lDiffH[i] = std::abs(*pHL - pHL[Neighbours[i]]);
+		lDiffV[i] = std::abs(*pVL - pVL[Neighbours[i]]);
+		const float aDiffH = *pHa - pHa[Neighbours[i]];
+		const float bDiffH = *pHb - pHb[Neighbours[i]];
+		abDiffH[i] = aDiffH * aDiffH + bDiffH * bDiffH;
+		const float aDiffV = *pVa - pVa[Neighbours[i]];
+		const float bDiffV = *pVb - pVb[Neighbours[i]];
+		abDiffV[i] = aDiffV * aDiffV + bDiffV * bDiffV;
+	}
+
+	// The horizontal interpolation is judged by its left and right neighbours, the vertical by those above and below.
+	const float lEpsilon = std::min(std::max(lDiffH[0], lDiffH[1]), std::max(lDiffV[2], lDiffV[3]));
+	const float abEpsilon = std::min(std::max(abDiffH[0], abDiffH[1]), std::max(abDiffV[2], abDiffV[3]));
+
+	std::uint8_t homoH = 0;
+	std::uint8_t homoV = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (lDiffH[i] <= lEpsilon && abDiffH[i] <= abEpsilon)
+			++homoH;
+		if (lDiffV[i] <= lEpsilon && abDiffV[i] <= abEpsilon)
+			++homoV;
+	}
+	hHomo[n] = homoH;
+	vHomo[n] = homoV;
+}
+
+void AvxAhd::combine(const int col, const int row, std::uint16_t* const pRedLine, std::uint16_t* const pGreenLine, std::uint16_t* const pBlueLine) const
+{
+	const size_t n = index(col, row);
+	const auto homogeneity = [n](const std::vector<std::uint8_t>& homo)
+	{
+		const std::uint8_t* const p = homo.data() + n;
+		return p[-WS - 1] + p[-WS] + p[-WS + 1] + p[-1] + p[0] + p[1] + p[WS - 1] + p[WS] + p[WS + 1];
+	};
+	const int hmH = homogeneity(hHomo);
+	const int hmV = homogeneity(vHomo);
+
+	if (hmV > hmH)
+	{
+		pRedLine[col] = vRed[n];
+		pGreenLine[col] = vGreen[n];
+		pBlueLine[col] = vBlue[n];
+	}
+	else if (hmV < hmH)
+	{
+		pRedLine[col] = hRed[n];
+		pGreenLine[col] = hGreen[n];
+		pBlueLine[col] = hBlue[n];
+	}
+	else
+	{
+		pRedLine[col] = (vRed[n] + hRed[n]) / 2;
+		pGreenLine[col] = (vGreen[n] + hGreen[n]) / 2;
+		pBlueLine[col] = (vBlue[n] + hBlue[n]) / 2;
+	}
+}
+
+// ----------
+// AVX
+// ----------
+
+int Avx256Ahd::processWindow(CColorBitmapT<std::uint16_t>& colorBitmap)
+{
+	// The vectorised interpolation needs the alternating green pixels of a Bayer matrix.
+	if (!ahdData.avxReady || ahdData.cfaType == CFATYPE_NONE || IsCYMGType(ahdData.cfaType))
+		return 1;
+
+	interpolateGreen();
+	interpolateRedBlue();
+	convertToLab();
+	buildHomogeneity();
+	combine(colorBitmap);
+
+	return AvxSupport::zeroUpper(0);
+}
+
+void Avx256Ahd::interpolateGreen()
+{
+	AvxAhd& d = ahdData;
+	const ptrdiff_t w = d.width;
+
+	for (int row = 0; row < d.rows; ++row)
+	{
+		const int wy = d.y + row;
+		// Vectors where all pixels have 2 neighbours in each direction inside the bitmap, the other pixels one by one.
+		const int colStart = std::min(std::max(0, 2 - d.x), d.cols);
+		const auto [first, last] = (wy >= 2 && wy < d.height - 2) ? vectorRange(colStart, std::min(d.cols, d.width - 2 - d.x)) : vectorRange(colStart, colStart);
+
+		for (int col = 0; col < first; ++col)
+			d.interpolateGreen(col, row);
+
+		const __m256 greenMask = alternateLanes(d.pGrayBitmap->GetBayerColor(d.x + first, wy) == BAYER_GREEN);
+		for (int col = first; col < last; col += 8)
+		{
+			const std::uint16_t* const p = d.pGray + row * w + col;
+			const size_t n = AvxAhd::index(col, row);
+			const __m256 v0 = loadPixels(p);
+			const __m256 hGreen = greenFromNeighbours(loadPixels(p - 1), loadPixels(p + 1), v0, loadPixels(p - 2), loadPixels(p + 2));
+			const __m256 vGreen = greenFromNeighbours(loadPixels(p - w), loadPixels(p + w), v0, loadPixels(p - 2 * w), loadPixels(p + 2 * w));
+			storePixels(d.hGreen.data() + n, clampPixels(_mm256_blendv_ps(hGreen, v0, greenMask)));
+			storePixels(d.vGreen.data() + n, clampPixels(_mm256_blendv_ps(vGreen, v0, greenMask)));
+		}
+
+		for (int col = last; col < d.cols; ++col)
+			d.interpolateGreen(col, row);
+	}
+}
+
+void Avx256Ahd::interpolateRedBlue()
+{
+	AvxAhd& d = ahdData;
+	const ptrdiff_t w = d.width;
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+
+	for (int row = 0; row < d.rows; ++row)
+	{
+		const int wy = d.y + row;
+		const bool blueLine = d.isBlueLine(row);
+		// Vectors where all pixels have their neighbours inside the bitmap and the window.
+		const int colStart = std::min(1, d.cols);
+		const bool vectorRow = wy >= 1 && wy < d.height - 1 && row >= 1 && row < WS - 1;
+		const auto [first, last] = vectorRow ? vectorRange(colStart, std::min({ d.cols, d.width - 1 - d.x, AvxAhd::WindowSize - 1 })) : vectorRange(colStart, colStart);
+
+		for (int col = 0; col < first; ++col)
+			d.interpolateRedBlue(col, row, blueLine);
+
+		std::uint16_t* const pLineH = blueLine ? d.hBlue.data() : d.hRed.data();
+		std::uint16_t* const pLineV = blueLine ? d.vBlue.data() : d.vRed.data();
+		std::uint16_t* const pOtherH = blueLine ? d.hRed.data() : d.hBlue.data();
+		std::uint16_t* const pOtherV = blueLine ? d.vRed.data() : d.vBlue.data();
+		const __m256 greenMask = alternateLanes(d.pGrayBitmap->GetBayerColor(d.x + first, wy) == BAYER_GREEN);
+
+		for (int col = first; col < last; col += 8)
+		{
+			const std::uint16_t* const p = d.pGray + row * w + col;
+			const size_t n = AvxAhd::index(col, row);
+			const std::uint16_t* const pH = d.hGreen.data() + n;
+			const std::uint16_t* const pV = d.vGreen.data() + n;
+			const __m256 gray = loadPixels(p);
+
+			// Red and blue pixels: the other colour from the diagonal neighbours.
+			const __m256 diagonal = _mm256_add_ps(_mm256_add_ps(loadPixels(p - 1 - w), loadPixels(p + 1 - w)), _mm256_add_ps(loadPixels(p - 1 + w), loadPixels(p + 1 + w)));
+			const auto fromDiagonal = [diagonal, quarter](const std::uint16_t* const pGreen)
+			{
+				const __m256 green = _mm256_add_ps(_mm256_add_ps(loadPixels(pGreen - 1 - WS), loadPixels(pGreen + 1 - WS)), _mm256_add_ps(loadPixels(pGreen - 1 + WS), loadPixels(pGreen + 1 + WS)));
+				return _mm256_add_ps(loadPixels(pGreen), _mm256_mul_ps(_mm256_sub_ps(diagonal, green), quarter));
+			};
+
+			// Green pixels: the colour of the line from the left and right neighbours, the other colour from those above and below.
+			const auto fromNeighbours = [gray, half, quarter](const __m256 v1, const __m256 v2, const __m256 g1, const __m256 g2, const __m256 m1, const __m256 m2)
+			{
+				const __m256 sum = _mm256_add_ps(v1, v2);
+				const __m256 direct = _mm256_blendv_ps(
+					_mm256_add_ps(gray, _mm256_mul_ps(_mm256_sub_ps(sum, _mm256_add_ps(g1, g2)), half)),
+					v1,
+					_mm256_cmp_ps(v1, v2, _CMP_EQ_OQ)
+				);
+				const __m256 averaged = median(v1, v2, _mm256_add_ps(_mm256_mul_ps(sum, half), _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(gray, gray), _mm256_add_ps(m1, m2)), quarter)));
+				return std::make_pair(direct, averaged);
+			};
+			const __m256 left = loadPixels(p - 1);
+			const __m256 right = loadPixels(p + 1);
+			const auto [lineV, lineH] = fromNeighbours(left, right, loadPixels(pV - 1), loadPixels(pV + 1), loadPixels(pH - 1), loadPixels(pH + 1));
+			const __m256 up = loadPixels(p - w);
+			const __m256 down = loadPixels(p + w);
+			const auto [otherH, otherV] = fromNeighbours(up, down, loadPixels(pH - WS), loadPixels(pH + WS), loadPixels(pV - WS), loadPixels(pV + WS));
+
+			// The raw values of the red and blue pixels are not clamped.
+			storePixels(pLineH + n, _mm256_blendv_ps(gray, clampPixels(lineH), greenMask));
+			storePixels(pLineV + n, _mm256_blendv_ps(gray, clampPixels(lineV), greenMask));
+			storePixels(pOtherH + n, clampPixels(_mm256_blendv_ps(fromDiagonal(pH), otherH, greenMask)));
+			storePixels(pOtherV + n, clampPixels(_mm256_blendv_ps(fromDiagonal(pV), otherV, greenMask)));
+		}
+
+		for (int col = last; col < d.cols; ++col)
+			d.interpolateRedBlue(col, row, blueLine);
+	}
+}
+
+void Avx256Ahd::convertToLab()
+{
+	AvxAhd& d = ahdData;
+	const float* const pLut = AvxAhd::labLut().data();
+
+	const auto f = [pLut](const __m256 red, const __m256 green, const __m256 blue, const float cRed, const float cGreen, const float cBlue)
+	{
+		const __m256 value = _mm256_fmadd_ps(_mm256_set1_ps(cRed), red, _mm256_fmadd_ps(_mm256_set1_ps(cGreen), green, _mm256_mul_ps(_mm256_set1_ps(cBlue), blue)));
+		return _mm256_i32gather_ps(pLut, _mm256_min_epi32(_mm256_cvttps_epi32(value), _mm256_set1_epi32(0xffff)), 4);
+	};
+	const auto toLab = [&f](const std::uint16_t* const pRed, const std::uint16_t* const pGreen, const std::uint16_t* const pBlue, float* const pL, float* const pa, float* const pb)
+	{
+		const __m256 red = loadPixels(pRed);
+		const __m256 green = loadPixels(pGreen);
+		const __m256 blue = loadPixels(pBlue);
+		const __m256 X = f(red, green, blue, XRed, XGreen, XBlue);
+		const __m256 Y = f(red, green, blue, YRed, YGreen, YBlue);
+		const __m256 Z = f(red, green, blue, ZRed, ZGreen, ZBlue);
+		_mm256_storeu_ps(pL, _mm256_fmsub_ps(_mm256_set1_ps(116.0f), Y, _mm256_set1_ps(16.0f)));
+		_mm256_storeu_ps(pa, _mm256_mul_ps(_mm256_set1_ps(500.0f), _mm256_sub_ps(X, Y)));
+		_mm256_storeu_ps(pb, _mm256_mul_ps(_mm256_set1_ps(200.0f), _mm256_sub_ps(Y, Z)));
+	};
+
+	for (int row = 0; row < d.rows; ++row)
+	{
+		const auto [first, last] = vectorRange(0, d.cols);
+		for (int col = first; col < last; col += 8)
+		{
+			const size_t n = AvxAhd::index(col, row);
+			toLab(&d.hRed[n], &d.hGreen[n], &d.hBlue[n], &d.hL[n], &d.ha[n], &d.hb[n]);
+			toLab(&d.vRed[n], &d.vGreen[n], &d.vBlue[n], &d.vL[n], &d.va[n], &d.vb[n]);
+		}
+		for (int col = last; col < d.cols; ++col)
+			d.convertToLab(AvxAhd::index(col, row));
+	}
+}
+
+void Avx256Ahd::buildHomogeneity()
+{
+	AvxAhd& d = ahdData;
+
+	const auto differences = [](const float* const pL, const float* const pa, const float* const pb, __m256 (&lDiff)[4], __m256 (&abDiff)[4])
+	{
+		const __m256 L = _mm256_loadu_ps(pL);
+		const __m256 a = _mm256_loadu_ps(pa);
+		const __m256 b = _mm256_loadu_ps(pb);
+		for (int i = 0; i < 4; i++)
+		{
+			lDiff[i] = absolute(_mm256_sub_ps(L, _mm256_loadu_ps(pL + Neighbours[i])));
+			const __m256 aDiff = _mm256_sub_ps(a, _mm256_loadu_ps(pa + Neighbours[i]));
+			const __m256 bDiff = _mm256_sub_ps(b, _mm256_loadu_ps(pb + Neighbours[i]));
+			abDiff[i] = _mm256_add_ps(_mm256_mul_ps(aDiff, aDiff), _mm256_mul_ps(bDiff, bDiff));
+		}
+	};
+	const auto count = [](const __m256 (&lDiff)[4], const __m256 (&abDiff)[4], const __m256 lEpsilon, const __m256 abEpsilon, std::uint8_t* const pHomo)
+	{
+		__m256i homo = _mm256_setzero_si256();
+		for (int i = 0; i < 4; i++)
+		{
+			const __m256 homogeneous = _mm256_and_ps(_mm256_cmp_ps(lDiff[i], lEpsilon, _CMP_LE_OQ), _mm256_cmp_ps(abDiff[i], abEpsilon, _CMP_LE_OQ));
+			homo = _mm256_sub_epi32(homo, _mm256_castps_si256(homogeneous)); // Mask is -1
+		}
+		const __m128i homo16 = _mm_packus_epi32(_mm256_castsi256_si128(homo), _mm256_extracti128_si256(homo, 1));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pHomo), _mm_packus_epi16(homo16, homo16));
+	};
+
+	for (int row = 1; row < d.rows && row < WS - 1; ++row)
+	{
+		const auto [first, last] = vectorRange(0, d.cols);
+		for (int col = first; col < last; col += 8)
+		{
+			const size_t n = AvxAhd::index(col, row);
+			__m256 lDiffH[4], lDiffV[4], abDiffH[4], abDiffV[4];
+			differences(&d.hL[n], &d.ha[n], &d.hb[n], lDiffH, abDiffH);
+			differences(&d.vL[n], &d.va[n], &d.vb[n], lDiffV, abDiffV);
+
+			const __m256 lEpsilon = _mm256_min_ps(_mm256_max_ps(lDiffH[0], lDiffH[1]), _mm256_max_ps(lDiffV[2], lDiffV[3]));
+			const __m256 abEpsilon = _mm256_min_ps(_mm256_max_ps(abDiffH[0], abDiffH[1]), _mm256_max_ps(abDiffV[2], abDiffV[3]));
+			count(lDiffH, abDiffH, lEpsilon, abEpsilon, &d.hHomo[n]);
+			count(lDiffV, abDiffV, lEpsilon, abEpsilon, &d.vHomo[n]);
+		}
+		for (int col = last; col < d.cols; ++col)
+			d.buildHomogeneity(AvxAhd::index(col, row));
+	}
+}
+
+void Avx256Ahd::combine(CColorBitmapT<std::uint16_t>& colorBitmap)
+{
+	AvxAhd& d = ahdData;
+
+	const auto homogeneity = [](const std::uint8_t* const p)
+	{
+		const auto load = [p](const ptrdiff_t offset) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + offset))); };
+		const __m256i above = _mm256_add_epi32(_mm256_add_epi32(load(-WS - 1), load(-WS)), load(-WS + 1));
+		const __m256i line = _mm256_add_epi32(_mm256_add_epi32(load(-1), load(0)), load(1));
+		const __m256i below = _mm256_add_epi32(_mm256_add_epi32(load(WS - 1), load(WS)), load(WS + 1));
+		return _mm256_add_epi32(_mm256_add_epi32(above, line), below);
+	};
+	const auto loadInt = [](const std::uint16_t* const p) { return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); };
+
+	for (int row = 1; d.y + row < d.height - 1 && row < WS - 1; ++row)
+	{
+		std::uint16_t* const pRedLine = colorBitmap.GetRedPixel(d.x, d.y + row);
+		std::uint16_t* const pGreenLine = colorBitmap.GetGreenPixel(d.x, d.y + row);
+		std::uint16_t* const pBlueLine = colorBitmap.GetBluePixel(d.x, d.y + row);
+
+		const auto [first, last] = vectorRange(1, std::min(d.width - 1 - d.x, AvxAhd::WindowSize - 1));
+		for (int col = first; col < last; col += 8)
+		{
+			const size_t n = AvxAhd::index(col, row);
+			const __m256i hmH = homogeneity(&d.hHomo[n]);
+			const __m256i hmV = homogeneity(&d.vHomo[n]);
+			const __m256i useV = _mm256_cmpgt_epi32(hmV, hmH);
+			const __m256i useH = _mm256_cmpgt_epi32(hmH, hmV);
+
+			const auto select = [n, &loadInt, useV, useH](const std::vector<std::uint16_t>& h, const std::vector<std::uint16_t>& v, std::uint16_t* const pOut)
+			{
+				const __m256i hValues = loadInt(&h[n]);
+				const __m256i vValues = loadInt(&v[n]);
+				const __m256i average = _mm256_srli_epi32(_mm256_add_epi32(hValues, vValues), 1);
+				storePixels(pOut, _mm256_blendv_epi8(_mm256_blendv_epi8(average, vValues, useV), hValues, useH));
+			};
+			select(d.hRed, d.vRed, pRedLine + col);
+			select(d.hGreen, d.vGreen, pGreenLine + col);
+			select(d.hBlue, d.vBlue, pBlueLine + col);
+		}
+		for (int col = last; d.x + col < d.width - 1 && col < WS - 1; ++col)
+			d.combine(col, row, pRedLine, pGreenLine, pBlueLine);
+	}
+}
+
+// ----------
+// Non-AVX
+// ----------
+
+int NonAvxAhd::processWindow(CColorBitmapT<std::uint16_t>& colorBitmap)
+{
+	AvxAhd& d = ahdData;
+
+	for (int row = 0; row < d.rows; ++row)
+		for (int col = 0; col < d.cols; ++col)
+			d.interpolateGreen(col, row);
+
+	for (int row = 0; row < d.rows; ++row)
+	{
+		const bool blueLine = d.isBlueLine(row);
+		for (int col = 0; col < d.cols; ++col)
+			d.interpolateRedBlue(col, row, blueLine);
+	}
+
+	for (int row = 0; row < d.rows; ++row)
+		for (int col = 0; col < d.cols; ++col)
+			d.convertToLab(AvxAhd::index(col, row));
+
+	for (int row = 1; row < d.rows && row < WS - 1; ++row)
+		for (int col = 0; col < d.cols; ++col)
+			d.buildHomogeneity(AvxAhd::index(col, row));
+
+	for (int row = 1; d.y + row < d.height - 1 && row < WS - 1; ++row)
+	{
+		std::uint16_t* const pRedLine = colorBitmap.GetRedPixel(d.x, d.y + row);
+		std::uint16_t* const pGreenLine = colorBitmap.GetGreenPixel(d.x, d.y + row);
+		std::uint16_t* const pBlueLine = colorBitmap.GetBluePixel(d.x, d.y + row);
+		for (int col = 1; d.x + col < d.width - 1 && col < WS - 1; ++col)
+			d.combine(col, row, pRedLine, pGreenLine, pBlueLine);
+	}
+
+	return 0;
+}
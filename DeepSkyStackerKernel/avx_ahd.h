@@ -0,0 +1,112 @@
+#pragma once
+#include "avx_simd_factory.h"
+#include "cfa.h"
+
+template <typename T> class CGrayBitmapT;
+template <typename T> class CColorBitmapT;
+
+//
+// Window buffers and kernels of the AHD demosaicing (AHDDemosaicing.cpp). Each thread uses its own object.
+//
+// A window of WindowSize x WindowSize pixels is processed in 5 steps:
+// green interpolated horizontally (H) and vertically (V), then red and blue, conversion of both interpolations to CIELab,
+// the homogeneity maps, and finally each output pixel is taken from the more homogeneous interpolation.
+//
+// All steps work on float values with the scale of the input (0..65535). The interpolations only add, halve and quarter
+// integers, so they are exact and give the same pixels as the former double code (input / 65536.0).
+// The Lab conversion is done in float: X, Y and Z can round to the neighbouring entry of the Lab LUT, so L differs by
+// at most 0.015, a by 0.12 and b by 0.05 from a conversion in double. Where this changes a homogeneity decision, the
+// output pixel is the H or V interpolation (or their average) instead of the other one.
+//
+class AvxAhd
+{
+public:
+	static constexpr int WindowSize = 256;
+	static constexpr size_t WindowArea = static_cast<size_t>(WindowSize) * WindowSize;
+private:
+	friend class Avx256Ahd;
+	friend class NonAvxAhd;
+
+	std::vector<std::uint16_t> hRed, hGreen, hBlue;
+	std::vector<std::uint16_t> vRed, vGreen, vBlue;
+	std::vector<float> hL, ha, hb;
+	std::vector<float> vL, va, vb;
+	std::vector<std::uint8_t> hHomo, vHomo;
+	bool avxReady;
+
+	// The current window
+	const CGrayBitmapT<std::uint16_t>* pGrayBitmap;
+	const std::uint16_t* pGray;		// Gray pixel at the window origin
+	int x, y;
+	int width, height;				// Of the bitmap
+	int cols, rows;					// Of the window (smaller at the right and bottom edges of the bitmap)
+	CFATYPE cfaType;
+	bool firstLineBlue;
+
+public:
+	AvxAhd();
+	// Copies get their own buffers (OpenMP firstprivate).
+	AvxAhd(const AvxAhd&) : AvxAhd{} {}
+	AvxAhd(AvxAhd&&) = delete;
+	AvxAhd& operator=(const AvxAhd&) = delete;
+
+	//
+	// Demosaics the window with origin (x, y) into the color bitmap. The border pixels of the window (and those of the
+	// bitmap) are not set.
+	//
+	int processWindow(const CGrayBitmapT<std::uint16_t>& grayBitmap, CColorBitmapT<std::uint16_t>& colorBitmap, const int xOrigin, const int yOrigin);
+
+	// Lab conversion of one pixel as done by the kernels (for unit tests).
+	static void rgbToLab(const float red, const float green, const float blue, float& L, float& a, float& b);
+
+private:
+	static const std::vector<float>& labLut();
+
+	static constexpr size_t index(const int col, const int row) { return static_cast<size_t>(row) * WindowSize + col; }
+	bool isBlueLine(const int row) const { return firstLineBlue != ((row & 1) != 0); }
+
+	// One pixel of each step, used by the NonAvxAhd and for the pixels at the edges by the vectorised versions.
+	void interpolateGreen(const int col, const int row);
+	void interpolateRedBlue(const int col, const int row, const bool blueLine);
+	void convertToLab(const size_t n);
+	void buildHomogeneity(const size_t n);
+	// The pointers are at column x of the output line.
+	void combine(const int col, const int row, std::uint16_t* const pRedLine, std::uint16_t* const pGreenLine, std::uint16_t* const pBlueLine) const;
+};
+
+
+class Avx256Ahd : public SimdFactory<Avx256Ahd>
+{
+private:
+	friend class AvxAhd;
+	friend class SimdFactory<Avx256Ahd>;
+
+	AvxAhd& ahdData;
+	Avx256Ahd(AvxAhd& d) : ahdData{ d } {}
+public:
+	Avx256Ahd(const Avx256Ahd&) = delete;
+	Avx256Ahd& operator=(const Avx256Ahd&) = delete;
+private:
+	int processWindow(CColorBitmapT<std::uint16_t>& colorBitmap);
+	void interpolateGreen();
+	void interpolateRedBlue();
+	void convertToLab();
+	void buildHomogeneity();
+	void combine(CColorBitmapT<std::uint16_t>& colorBitmap);
+};
+
+
+class NonAvxAhd : public SimdFactory<NonAvxAhd>
+{
+private:
+	friend class AvxAhd;
+	friend class SimdFactory<NonAvxAhd>;
+
+	AvxAhd& ahdData;
+	NonAvxAhd(AvxAhd& d) : ahdData{ d } {}
+public:
+	NonAvxAhd(const NonAvxAhd&) = delete;
+	NonAvxAhd& operator=(const NonAvxAhd&) = delete;
+private:
+	int processWindow(CColorBitmapT<std::uint16_t>& colorBitmap);
+};
@@ -6,14 +6,117 @@
 #include "TaskInfo.h"
 #include "Ztrace.h"
 
-AvxAccumulation::AvxAccumulation(const DSSRect& resultRect, const CTaskInfo& tInfo, CMemoryBitmap& tempbm, CMemoryBitmap& outbm, AvxEntropy& entroinfo) noexcept :
+AvxAccumulation::AvxAccumulation(const DSSRect& resultRect, const CTaskInfo& tInfo, CMemoryBitmap& tempbm, CMemoryBitmap& outbm, AvxEntropy& entroinfo, const bool avgOutside) noexcept :
 	resultWidth{ resultRect.width() }, resultHeight{ resultRect.height() },
+	outputLeft{ resultRect.left }, outputTop{ resultRect.top },
+	averageOutside{ avgOutside },
 	tempBitmap{ tempbm },
 	outputBitmap{ outbm },
 	taskInfo{ tInfo },
 	avxEntropy{ entroinfo }
 {}
 
+namespace
+{
+	template <class T>
+	inline float convertToFloat(const T value) noexcept
+	{
+		if constexpr (std::is_same_v<T, std::uint32_t>)
+			return static_cast<float>(value >> 16);
+		else
+			return static_cast<float>(value);
+	}
+
+	//
+	// The kernels process 16 consecutive pixels. The operations (and for the AVX kernels also the order of the fused multiply-adds) are the same
+	// in all kernels, so AVX-512 and AVX-256 give identical results. The generic kernel does not fuse multiply and add (no FMA instructions
+	// on the CPUs it is made for), so its results can differ in the last bit.
+	//
+	struct GenericAccumulationKernel
+	{
+		template <class T_IN>
+		static void average(const T_IN* const pIn, float* const pOut, const float nrStacked, const float nrStacked1) noexcept
+		{
+			for (size_t n = 0; n < 16; ++n)
+				pOut[n] = (pOut[n] * nrStacked + convertToFloat(pIn[n])) / nrStacked1; // (oldColor * nrStacked + newColor) / (nrStacked + 1)
+		}
+		template <class T_IN>
+		static void maximum(const T_IN* const pIn, float* const pOut) noexcept
+		{
+			for (size_t n = 0; n < 16; ++n)
+				pOut[n] = std::max(pOut[n], convertToFloat(pIn[n]));
+		}
+		template <class T_IN>
+		static void entropyAverage(const T_IN* const pIn, float* const pOut, const float* const pEntropyLayer, float* const pEntropyCoverage) noexcept
+		{
+			for (size_t n = 0; n < 16; ++n)
+			{
+				pEntropyCoverage[n] += pEntropyLayer[n]; // EntropyCoverage += Entropy
+				pOut[n] += convertToFloat(pIn[n]) * pEntropyLayer[n]; // OutputBitmap += Color * Entropy
+			}
+		}
+	};
+
+	struct Avx256AccumulationKernel
+	{
+		template <class T_IN>
+		static void average(const T_IN* const pIn, float* const pOut, const float nrStacked, const float nrStacked1) noexcept
+		{
+			const auto [newColorLo8, newColorHi8] = AvxSupport::read16PackedSingle(pIn);
+			const auto [oldColorLo8, oldColorHi8] = AvxSupport::read16PackedSingle(pOut);
+			const __m256 n = _mm256_set1_ps(nrStacked);
+			const __m256 n1 = _mm256_set1_ps(nrStacked1);
+			_mm256_storeu_ps(pOut,     _mm256_div_ps(_mm256_fmadd_ps(oldColorLo8, n, newColorLo8), n1)); // (oldColor * nrStacked + newColor) / (nrStacked + 1)
+			_mm256_storeu_ps(pOut + 8, _mm256_div_ps(_mm256_fmadd_ps(oldColorHi8, n, newColorHi8), n1));
+		}
+		template <class T_IN>
+		static void maximum(const T_IN* const pIn, float* const pOut) noexcept
+		{
+			const auto [newColorLo8, newColorHi8] = AvxSupport::read16PackedSingle(pIn);
+			const auto [oldColorLo8, oldColorHi8] = AvxSupport::read16PackedSingle(pOut);
+			_mm256_storeu_ps(pOut,     _mm256_max_ps(oldColorLo8, newColorLo8));
+			_mm256_storeu_ps(pOut + 8, _mm256_max_ps(oldColorHi8, newColorHi8));
+		}
+		template <class T_IN>
+		static void entropyAverage(const T_IN* const pIn, float* const pOut, const float* const pEntropyLayer, float* const pEntropyCoverage) noexcept
+		{
+			const auto [newColorLo8, newColorHi8] = AvxSupport::read16PackedSingle(pIn);
+			const auto [oldColorLo8, oldColorHi8] = AvxSupport::read16PackedSingle(pOut);
+			const auto [newEntropyLo8, newEntropyHi8] = AvxSupport::read16PackedSingle(pEntropyLayer);
+			const auto [oldEntropyLo8, oldEntropyHi8] = AvxSupport::read16PackedSingle(pEntropyCoverage);
+
+			_mm256_storeu_ps(pEntropyCoverage, _mm256_add_ps(oldEntropyLo8, newEntropyLo8)); // EntropyCoverage += Entropy
+			_mm256_storeu_ps(pEntropyCoverage + 8, _mm256_add_ps(oldEntropyHi8, newEntropyHi8));
+			_mm256_storeu_ps(pOut, _mm256_fmadd_ps(newColorLo8, newEntropyLo8, oldColorLo8)); // OutputBitmap += Color * Entropy
+			_mm256_storeu_ps(pOut + 8, _mm256_fmadd_ps(newColorHi8, newEntropyHi8, oldColorHi8));
+		}
+	};
+
+	struct Avx512AccumulationKernel
+	{
+		template <class T_IN>
+		static void average(const T_IN* const pIn, float* const pOut, const float nrStacked, const float nrStacked1) noexcept
+		{
+			const __m512 newColor = AvxSupport::read16PackedSingleAvx512(pIn);
+			const __m512 oldColor = _mm512_loadu_ps(pOut);
+			_mm512_storeu_ps(pOut, _mm512_div_ps(_mm512_fmadd_ps(oldColor, _mm512_set1_ps(nrStacked), newColor), _mm512_set1_ps(nrStacked1)));
+		}
+		template <class T_IN>
+		static void maximum(const T_IN* const pIn, float* const pOut) noexcept
+		{
+			_mm512_storeu_ps(pOut, _mm512_max_ps(_mm512_loadu_ps(pOut), AvxSupport::read16PackedSingleAvx512(pIn)));
+		}
+		template <class T_IN>
+		static void entropyAverage(const T_IN* const pIn, float* const pOut, const float* const pEntropyLayer, float* const pEntropyCoverage) noexcept
+		{
+			const __m512 newColor = AvxSupport::read16PackedSingleAvx512(pIn);
+			const __m512 newEntropy = _mm512_loadu_ps(pEntropyLayer);
+			_mm512_storeu_ps(pEntropyCoverage, _mm512_add_ps(_mm512_loadu_ps(pEntropyCoverage), newEntropy));
+			_mm512_storeu_ps(pOut, _mm512_fmadd_ps(newColor, newEntropy, _mm512_loadu_ps(pOut)));
+		}
+	};
+}
+
 // *********************************************************************************************
 // Sept. 2020: Only works for output bitmaps of type float (which is currently always the case).
 // There is a static type check below.
@@ -21,20 +124,29 @@ AvxAccumulation::AvxAccumulation(const DSSRect& resultRect, const CTaskInfo& tIn
 
 int AvxAccumulation::accumulate(const int nrStackedBitmaps)
 {
-	if (!AvxSimdCheck::checkSimdAvailability())
-		return 1;
+	if (AvxSimdCheck::checkAvx512Availability() && accumulateWithKernel<Avx512AccumulationKernel>(nrStackedBitmaps) == 0)
+		return AvxSupport::zeroUpper(0);
+	if (AvxSimdCheck::checkSimdAvailability() && accumulateWithKernel<Avx256AccumulationKernel>(nrStackedBitmaps) == 0)
+		return AvxSupport::zeroUpper(0);
 
-	int rval = 1;
-	if (doAccumulate<std::uint16_t, float>(nrStackedBitmaps) == 0
-		|| doAccumulate<std::uint32_t, float>(nrStackedBitmaps) == 0
-		|| doAccumulate<float, float>(nrStackedBitmaps) == 0)
+	// CPU without AVX2, or the user has disabled SIMD vectorisation.
+	// Note: No zeroUpper() here, VZEROUPPER is an AVX instruction.
+	return accumulateWithKernel<GenericAccumulationKernel>(nrStackedBitmaps);
+}
+
+template <class Kernel>
+int AvxAccumulation::accumulateWithKernel(const int nrStackedBitmaps)
+{
+	if (doAccumulate<Kernel, std::uint16_t, float>(nrStackedBitmaps) == 0
+		|| doAccumulate<Kernel, std::uint32_t, float>(nrStackedBitmaps) == 0
+		|| doAccumulate<Kernel, float, float>(nrStackedBitmaps) == 0)
 	{
-		rval = 0;
+		return 0;
 	}
-	return AvxSupport::zeroUpper(rval);
+	return 1;
 }
 
-template <class T_IN, class T_OUT>
+template <class Kernel, class T_IN, class T_OUT>
 int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 {
 	// Output bitmap is always float
@@ -52,19 +164,51 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 
 	constexpr size_t vectorLen = 16;
 	const int nrVectors = resultWidth / vectorLen;
+	const int outputWidth = outputBitmap.Width();
+	const int outputHeight = outputBitmap.Height();
+	if (outputLeft < 0 || outputTop < 0 || outputLeft + resultWidth > outputWidth || outputTop + resultHeight > outputHeight)
+		return 1;
+	const bool isWholeOutput = resultWidth == outputWidth && resultHeight == outputHeight;
+	// Offset in the output bitmap of the line row of the temp bitmap.
+	const auto outputOffset = [this, outputWidth](const int row) -> size_t
+	{
+		return static_cast<size_t>(outputTop + row) * outputWidth + outputLeft;
+	};
 
 	if (taskInfo.m_Method == MBP_FASTAVERAGE)
 	{
-		const __m256 nrStacked = _mm256_set1_ps(static_cast<float>(nrStackedBitmaps));
-		const __m256 nrStacked1 = _mm256_set1_ps(static_cast<float>(nrStackedBitmaps + 1));
+		const float nrStacked = static_cast<float>(nrStackedBitmaps);
+		const float nrStacked1 = static_cast<float>(nrStackedBitmaps + 1);
 
-		const auto accumulate = [&nrStacked, &nrStacked1](const T_IN* pIn, T_OUT* pOut) -> void
+		const auto accumulate = [nrStacked, nrStacked1](const T_IN* pIn, T_OUT* pOut) -> void
 		{
-			const auto [newColorLo8, newColorHi8] = AvxSupport::read16PackedSingle(pIn);
-			const auto [oldColorLo8, oldColorHi8] = AvxSupport::read16PackedSingle(pOut);
-			// If T_OUT != float, then we need to change these lines (below too).
-			_mm256_storeu_ps(pOut,     _mm256_div_ps(_mm256_fmadd_ps(oldColorLo8, nrStacked, newColorLo8), nrStacked1)); // (oldColor * nrStacked + newColor) / (nrStacked + 1)
-			_mm256_storeu_ps(pOut + 8, _mm256_div_ps(_mm256_fmadd_ps(oldColorHi8, nrStacked, newColorHi8), nrStacked1));
+			Kernel::average(pIn, pOut, nrStacked, nrStacked1);
+		};
+		const auto accumulateScalar = [nrStacked, nrStacked1](const T_IN* pIn, T_OUT* pOut) -> void
+		{
+			*pOut = (*pOut * nrStacked + convertToFloat(*pIn)) / nrStacked1;
+		};
+		// The output pixels that the temp bitmap doesn't hold: (oldColor * nrStacked + 0) / (nrStacked + 1), as the kernels with a new color of 0.
+		const auto accumulateOutside = [this, outputWidth, outputHeight, nrStacked, nrStacked1](T_OUT* const pOut) -> void
+		{
+			if (!averageOutside)
+				return;
+			const auto average = [nrStacked, nrStacked1](T_OUT* const pLine, const int begin, const int end)
+			{
+				for (int n = begin; n < end; ++n)
+					pLine[n] = pLine[n] * nrStacked / nrStacked1;
+			};
+			for (int row = 0; row < outputHeight; ++row)
+			{
+				T_OUT* const pLine = pOut + static_cast<size_t>(row) * outputWidth;
+				if (row < outputTop || row >= outputTop + resultHeight)
+					average(pLine, 0, outputWidth);
+				else
+				{
+					average(pLine, 0, outputLeft);
+					average(pLine, outputLeft + resultWidth, outputWidth);
+				}
+			}
 		};
 
 		if (avxTempBitmap.isColorBitmap())
@@ -73,10 +217,10 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 			auto *const pOutput = dynamic_cast<CColorBitmapT<T_OUT>*>(&outputBitmap);
 			if (pOutput == nullptr)
 				return 1;
-			T_OUT *pOutRed{ &*pOutput->m_Red.m_vPixels.begin() }, *pOutGreen{ &*pOutput->m_Green.m_vPixels.begin() }, *pOutBlue{ &*pOutput->m_Blue.m_vPixels.begin() };
 
 			for (int row = 0; row < resultHeight; ++row)
 			{
+				T_OUT *pOutRed{ pOutput->m_Red.m_vPixels.data() + outputOffset(row) }, *pOutGreen{ pOutput->m_Green.m_vPixels.data() + outputOffset(row) }, *pOutBlue{ pOutput->m_Blue.m_vPixels.data() + outputOffset(row) };
 				for (int counter = 0; counter < nrVectors; ++counter, pRed += vectorLen, pGreen += vectorLen, pBlue += vectorLen, pOutRed += vectorLen, pOutGreen += vectorLen, pOutBlue += vectorLen)
 				{
 					accumulate(pRed, pOutRed);
@@ -86,20 +230,14 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 				// Rest of line
 				for (int n = nrVectors * vectorLen; n < resultWidth; ++n, ++pRed, ++pGreen, ++pBlue, ++pOutRed, ++pOutGreen, ++pOutBlue)
 				{
-					if constexpr (std::is_same_v<T_IN, std::uint32_t>)
-					{
-						*pOutRed = (*pOutRed * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pRed >> 16)) / static_cast<float>(nrStackedBitmaps + 1);
-						*pOutGreen = (*pOutGreen * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pGreen >> 16)) / static_cast<float>(nrStackedBitmaps + 1);
-						*pOutBlue = (*pOutBlue * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pBlue >> 16)) / static_cast<float>(nrStackedBitmaps + 1);
-					}
-					else
-					{
-						*pOutRed = (*pOutRed * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pRed)) / static_cast<float>(nrStackedBitmaps + 1);
-						*pOutGreen = (*pOutGreen * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pGreen)) / static_cast<float>(nrStackedBitmaps + 1);
-						*pOutBlue = (*pOutBlue * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pBlue)) / static_cast<float>(nrStackedBitmaps + 1);
-					}
+					accumulateScalar(pRed, pOutRed);
+					accumulateScalar(pGreen, pOutGreen);
+					accumulateScalar(pBlue, pOutBlue);
 				}
 			}
+			accumulateOutside(pOutput->m_Red.m_vPixels.data());
+			accumulateOutside(pOutput->m_Green.m_vPixels.data());
+			accumulateOutside(pOutput->m_Blue.m_vPixels.data());
 			return 0;
 		}
 		if (avxTempBitmap.isMonochromeBitmap())
@@ -108,19 +246,17 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 			auto *const pOutput = dynamic_cast<CGrayBitmapT<T_OUT>*>(&outputBitmap);
 			if (pOutput == nullptr)
 				return 1;
-			T_OUT* pOut{ &*pOutput->m_vPixels.begin() };
 
 			for (int row = 0; row < resultHeight; ++row)
 			{
+				T_OUT* pOut{ pOutput->m_vPixels.data() + outputOffset(row) };
 				for (int counter = 0; counter < nrVectors; ++counter, pGray += vectorLen, pOut += vectorLen)
 					accumulate(pGray, pOut);
 				// Rest of line
 				for (int n = nrVectors * vectorLen; n < resultWidth; ++n, ++pGray, ++pOut)
-					if constexpr (std::is_same_v<T_IN, std::uint32_t>)
-						*pOut = (*pOut * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pGray >> 16)) / static_cast<float>(nrStackedBitmaps + 1);
-					else
-						*pOut = (*pOut * static_cast<float>(nrStackedBitmaps) + static_cast<float>(*pGray)) / static_cast<float>(nrStackedBitmaps + 1);
+					accumulateScalar(pGray, pOut);
 			}
+			accumulateOutside(pOutput->m_vPixels.data());
 			return 0;
 		}
 		return 1;
@@ -129,10 +265,11 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 	{
 		const auto maximum = [](const T_IN* pIn, T_OUT* pOut) -> void
 		{
-			const auto [newColorLo8, newColorHi8] = AvxSupport::read16PackedSingle(pIn);
-			const auto [oldColorLo8, oldColorHi8] = AvxSupport::read16PackedSingle(pOut);
-			_mm256_storeu_ps(pOut,     _mm256_max_ps(oldColorLo8, newColorLo8));
-			_mm256_storeu_ps(pOut + 8, _mm256_max_ps(oldColorHi8, newColorHi8));
+			Kernel::maximum(pIn, pOut);
+		};
+		const auto maximumScalar = [](const T_IN* pIn, T_OUT* pOut) -> void
+		{
+			*pOut = std::max(*pOut, convertToFloat(*pIn));
 		};
 
 		if (avxTempBitmap.isColorBitmap())
@@ -141,10 +278,11 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 			auto* const pOutput = dynamic_cast<CColorBitmapT<T_OUT>*>(&outputBitmap);
 			if (pOutput == nullptr)
 				return 1;
-			T_OUT *pOutRed{ &*pOutput->m_Red.m_vPixels.begin() }, *pOutGreen{ &*pOutput->m_Green.m_vPixels.begin() }, *pOutBlue{ &*pOutput->m_Blue.m_vPixels.begin() };
 
+			// The maximum with 0 leaves the output pixels outside of the temp bitmap.
 			for (int row = 0; row < resultHeight; ++row)
 			{
+				T_OUT *pOutRed{ pOutput->m_Red.m_vPixels.data() + outputOffset(row) }, *pOutGreen{ pOutput->m_Green.m_vPixels.data() + outputOffset(row) }, *pOutBlue{ pOutput->m_Blue.m_vPixels.data() + outputOffset(row) };
 				for (int counter = 0; counter < nrVectors; ++counter, pRed += vectorLen, pGreen += vectorLen, pBlue += vectorLen, pOutRed += vectorLen, pOutGreen += vectorLen, pOutBlue += vectorLen)
 				{
 					maximum(pRed, pOutRed);
@@ -154,18 +292,9 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 				// Rest of line
 				for (int n = nrVectors * vectorLen; n < resultWidth; ++n, ++pRed, ++pGreen, ++pBlue, ++pOutRed, ++pOutGreen, ++pOutBlue)
 				{
-					if constexpr (std::is_same_v<T_IN, std::uint32_t>)
-					{
-						*pOutRed = std::max(*pOutRed, static_cast<float>(*pRed >> 16));
-						*pOutGreen = std::max(*pOutGreen, static_cast<float>(*pGreen >> 16));
-						*pOutBlue = std::max(*pOutBlue, static_cast<float>(*pBlue >> 16));
-					}
-					else
-					{
-						*pOutRed = std::max(*pOutRed, static_cast<float>(*pRed));
-						*pOutGreen = std::max(*pOutGreen, static_cast<float>(*pGreen));
-						*pOutBlue = std::max(*pOutBlue, static_cast<float>(*pBlue));
-					}
+					maximumScalar(pRed, pOutRed);
+					maximumScalar(pGreen, pOutGreen);
+					maximumScalar(pBlue, pOutBlue);
 				}
 			}
 			return 0;
@@ -176,18 +305,15 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 			auto *const pOutput = dynamic_cast<CGrayBitmapT<T_OUT>*>(&outputBitmap);
 			if (pOutput == nullptr)
 				return 1;
-			T_OUT* pOut{ &*pOutput->m_vPixels.begin() };
 
 			for (int row = 0; row < resultHeight; ++row)
 			{
+				T_OUT* pOut{ pOutput->m_vPixels.data() + outputOffset(row) };
 				for (int counter = 0; counter < nrVectors; ++counter, pGray += vectorLen, pOut += vectorLen)
 					maximum(pGray, pOut);
 				// Rest of line
 				for (int n = nrVectors * vectorLen; n < resultWidth; ++n, ++pGray, ++pOut)
-					if constexpr (std::is_same_v<T_IN, std::uint32_t>)
-						*pOut = std::max(*pOut, static_cast<float>(*pGray >> 16));
-					else
-						*pOut = std::max(*pOut, static_cast<float>(*pGray));
+					maximumScalar(pGray, pOut);
 			}
 			return 0;
 		}
@@ -195,7 +321,10 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 	}
 	else if (taskInfo.m_Method == MBP_ENTROPYAVERAGE)
 	{
-		if (avxEntropy.pEntropyCoverage == nullptr)
+		if (avxEntropy.pEntropyCoverage == nullptr || !isWholeOutput)
+			return 1;
+		// The entropy layers are only calculated by the AVX stacking code.
+		if (avxEntropy.redEntropyLayer.empty())
 			return 1;
 		AvxSupport avxEntropyCoverageBitmap{ *avxEntropy.pEntropyCoverage };
 		if (!avxEntropyCoverageBitmap.bitmapHasCorrectType<float>())
@@ -203,15 +332,12 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 
 		const auto average = [](const T_IN* pIn, T_OUT* pOut, const float* pEntropyLayer, float* pEntropyCoverage) -> void
 		{
-			const auto [newColorLo8, newColorHi8] = AvxSupport::read16PackedSingle(pIn);
-			const auto [oldColorLo8, oldColorHi8] = AvxSupport::read16PackedSingle(pOut);
-			const auto [newEntropyLo8, newEntropyHi8] = AvxSupport::read16PackedSingle(pEntropyLayer);
-			const auto [oldEntropyLo8, oldEntropyHi8] = AvxSupport::read16PackedSingle(pEntropyCoverage);
-
-			_mm256_storeu_ps(pEntropyCoverage, _mm256_add_ps(oldEntropyLo8, newEntropyLo8)); // EntropyCoverage += Entropy
-			_mm256_storeu_ps(pEntropyCoverage + 8, _mm256_add_ps(oldEntropyHi8, newEntropyHi8));
-			_mm256_storeu_ps(pOut, _mm256_fmadd_ps(newColorLo8, newEntropyLo8, oldColorLo8)); // OutputBitmap += Color * Entropy
-			_mm256_storeu_ps(pOut + 8, _mm256_fmadd_ps(newColorHi8, newEntropyHi8, oldColorHi8));
+			Kernel::entropyAverage(pIn, pOut, pEntropyLayer, pEntropyCoverage);
+		};
+		const auto averageScalar = [](const T_IN* pIn, T_OUT* pOut, const float* pEntropyLayer, float* pEntropyCoverage) -> void
+		{
+			*pEntropyCoverage += *pEntropyLayer; // EntropyCoverage += Entropy
+			*pOut += convertToFloat(*pIn) * *pEntropyLayer; // OutputBitmap += Color * Entropy
 		};
 
 		if (avxTempBitmap.isColorBitmap())
@@ -243,21 +369,9 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 				for (int n = nrVectors * vectorLen; n < resultWidth; ++n, ++pRed, ++pGreen, ++pBlue, ++pOutRed, ++pOutGreen, ++pOutBlue,
 					++pEntropyRed, ++pEntropyGreen, ++pEntropyBlue, ++pEntropyCovRed, ++pEntropyCovGreen, ++pEntropyCovBlue)
 				{
-					*pEntropyCovRed += *pEntropyRed; // EntropyCoverage += Entropy
-					*pEntropyCovGreen += *pEntropyGreen;
-					*pEntropyCovBlue += *pEntropyBlue;
-					if constexpr (std::is_same_v<T_IN, std::uint32_t>)
-					{
-						*pOutRed += static_cast<float>(*pRed >> 16) * *pEntropyRed; // OutputBitmap += Color * Entropy
-						*pOutGreen += static_cast<float>(*pGreen >> 16) * *pEntropyGreen;
-						*pOutBlue += static_cast<float>(*pBlue >> 16) * *pEntropyBlue;
-					}
-					else
-					{
-						*pOutRed += static_cast<float>(*pRed) * *pEntropyRed; // OutputBitmap += Color * Entropy
-						*pOutGreen += static_cast<float>(*pGreen) * *pEntropyGreen;
-						*pOutBlue += static_cast<float>(*pBlue) * *pEntropyBlue;
-					}
+					averageScalar(pRed, pOutRed, pEntropyRed, pEntropyCovRed);
+					averageScalar(pGreen, pOutGreen, pEntropyGreen, pEntropyCovGreen);
+					averageScalar(pBlue, pOutBlue, pEntropyBlue, pEntropyCovBlue);
 				}
 			}
 			return 0;
@@ -279,13 +393,7 @@ int AvxAccumulation::doAccumulate(const int nrStackedBitmaps)
 					average(pGray, pOut, pEntropy, pEntropyCov);
 				// Rest of line
 				for (int n = nrVectors * vectorLen; n < resultWidth; ++n, ++pGray, ++pOut, ++pEntropy, ++pEntropyCov)
-				{
-					*pEntropyCov += *pEntropy;
-					if constexpr (std::is_same_v<T_IN, std::uint32_t>)
-						*pOut += static_cast<float>(*pGray >> 16) * *pEntropy;
-					else
-						*pOut += static_cast<float>(*pGray) * *pEntropy;
-				}
+					averageScalar(pGray, pOut, pEntropy, pEntropyCov);
 			}
 			return 0;
 		}
@@ -11,19 +11,25 @@ class AvxEntropy;
 class AvxAccumulation
 {
 	int resultWidth, resultHeight;
+	int outputLeft, outputTop;
+	bool averageOutside;
 	CMemoryBitmap& tempBitmap;
 	CMemoryBitmap& outputBitmap;
 	const CTaskInfo& taskInfo;
 	AvxEntropy& avxEntropy;
 public:
 	AvxAccumulation() = delete;
-	AvxAccumulation(const DSSRect& resultRect, const CTaskInfo& tInfo, CMemoryBitmap& tempbm, CMemoryBitmap& outbm, AvxEntropy& entroinfo) noexcept;
+	// The temp bitmap holds the rectangle resultRect of the output bitmap (drizzle in bands, mosaic frames). With avgOutside, the average
+	// of the output pixels outside of resultRect is also updated, with a new value of 0 (pixels not reached by the frame).
+	AvxAccumulation(const DSSRect& resultRect, const CTaskInfo& tInfo, CMemoryBitmap& tempbm, CMemoryBitmap& outbm, AvxEntropy& entroinfo, const bool avgOutside = false) noexcept;
 	AvxAccumulation(const AvxAccumulation&) = delete;
 	AvxAccumulation(AvxAccumulation&&) = delete;
 	AvxAccumulation& operator=(const AvxAccumulation&) = delete;
 
 	int accumulate(const int nrStackedBitmaps);
 private:
-	template <class T_IN, class T_OUT>
+	template <class Kernel>
+	int accumulateWithKernel(const int nrStackedBitmaps);
+	template <class Kernel, class T_IN, class T_OUT>
 	int doAccumulate(const int nrStackedBitmaps);
 };
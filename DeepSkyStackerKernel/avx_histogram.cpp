@@ -8,6 +8,7 @@
 
 AvxHistogram::AvxHistogram(const CMemoryBitmap& inputbm) :
 	avxReady{ AvxSimdCheck::checkSimdAvailability() },
+	avx512Ready{ AvxSimdCheck::checkAvx512Availability() },
 	redHisto(HistogramSize(), 0),
 	greenHisto(HistogramSize(), 0),
 	blueHisto(HistogramSize(), 0),
@@ -19,7 +20,7 @@ AvxHistogram::AvxHistogram(const CMemoryBitmap& inputbm) :
 
 int AvxHistogram::calcHistogram(const size_t lineStart, const size_t lineEnd, const double multiplier)
 {
-	return SimdSelector<Avx256Histogram, NonAvxHistogram>(this, [&](auto&& o) { return o.calcHistogram(lineStart, lineEnd, multiplier); });
+	return SimdSelector<Avx512Histogram, Avx256Histogram, GenericHistogram, NonAvxHistogram>(this, [&](auto&& o) { return o.calcHistogram(lineStart, lineEnd, multiplier); });
 }
 
 int AvxHistogram::mergeHistograms(HistogramVectorType& red, HistogramVectorType& green, HistogramVectorType& blue)
@@ -243,6 +244,193 @@ void Avx256Histogram::calcHistoOfVectorEpi32(const __m256i colorVec, T& histogra
 template void Avx256Histogram::calcHistoOfVectorEpi32(const __m256i colorVec, std::vector<int>& histogram);
 
 
+// *****************
+// AVX-512 Histogram
+// *****************
+
+int Avx512Histogram::calcHistogram(const size_t lineStart, const size_t lineEnd, const double)
+{
+	if (!this->histoData.avx512Ready)
+		return 1;
+
+	if (doCalcHistogram<std::uint16_t>(lineStart, lineEnd) == 0)
+		return AvxSupport::zeroUpper(0);
+	if (doCalcHistogram<std::uint32_t>(lineStart, lineEnd) == 0)
+		return AvxSupport::zeroUpper(0);
+	if (doCalcHistogram<float>(lineStart, lineEnd) == 0)
+		return AvxSupport::zeroUpper(0);
+	if (doCalcHistogram<double>(lineStart, lineEnd) == 0)
+		return AvxSupport::zeroUpper(0);
+
+	return AvxSupport::zeroUpper(1);
+}
+
+template <class T>
+int Avx512Histogram::doCalcHistogram(const size_t lineStart, const size_t lineEnd)
+{
+	// Check input bitmap.
+	const AvxSupport avxInputSupport{ histoData.inputBitmap };
+	if (!avxInputSupport.isColorBitmapOfType<T>() && !avxInputSupport.isMonochromeBitmapOfType<T>()) // Monochrome includes CFA
+		return 1;
+
+	constexpr size_t vectorLen = 16;
+	const size_t width = histoData.inputBitmap.Width();
+	const size_t nrVectors = width / vectorLen;
+
+	// Same limits as the AVX-256 version.
+	if (width < 256 || histoData.inputBitmap.Height() < 32)
+		return 1;
+
+	const bool isCFA = avxInputSupport.isMonochromeCfaBitmapOfType<T>();
+
+	// Color bitmap (incl. CFA)
+	if (avxInputSupport.isColorBitmapOfType<T>() || isCFA)
+	{
+		if constexpr (std::is_same<T, double>::value) // color-double not supported.
+			return 1;
+		else
+		{
+			if (isCFA)
+			{
+				histoData.avxCfa.init(lineStart, lineEnd);
+				histoData.avxCfa.interpolate(lineStart, lineEnd, 1);
+			}
+
+			for (size_t row = lineStart, lineNdx = 0; row < lineEnd; ++row, ++lineNdx)
+			{
+				const T* pRedPixels = isCFA ? histoData.avxCfa.redCfaLine<T>(lineNdx) : &avxInputSupport.redPixels<T>().at(row * width);
+				const T* pGreenPixels = isCFA ? histoData.avxCfa.greenCfaLine<T>(lineNdx) : &avxInputSupport.greenPixels<T>().at(row * width);
+				const T* pBluePixels = isCFA ? histoData.avxCfa.blueCfaLine<T>(lineNdx) : &avxInputSupport.bluePixels<T>().at(row * width);
+
+				for (size_t counter = 0; counter < nrVectors; ++counter, pRedPixels += vectorLen, pGreenPixels += vectorLen, pBluePixels += vectorLen)
+				{
+					calcHistoOfVectorEpi32(AvxSupport::read16PackedIntAvx512(pRedPixels), histoData.redHisto);
+					calcHistoOfVectorEpi32(AvxSupport::read16PackedIntAvx512(pGreenPixels), histoData.greenHisto);
+					calcHistoOfVectorEpi32(AvxSupport::read16PackedIntAvx512(pBluePixels), histoData.blueHisto);
+				}
+				for (size_t n = nrVectors * vectorLen; n < width; ++n, ++pRedPixels, ++pGreenPixels, ++pBluePixels)
+				{
+					Avx256Histogram::addToHisto(histoData.redHisto, *pRedPixels);
+					Avx256Histogram::addToHisto(histoData.greenHisto, *pGreenPixels);
+					Avx256Histogram::addToHisto(histoData.blueHisto, *pBluePixels);
+				}
+			}
+			return 0;
+		}
+	}
+
+	// Gray input bitmaps of type double use a fix scaling factor of 256 (see AVX-256 version).
+	if (avxInputSupport.isMonochromeBitmapOfType<T>())
+	{
+		for (size_t row = lineStart; row < lineEnd; ++row)
+		{
+			const T* pGrayPixels = &avxInputSupport.grayPixels<T>().at(row * width);
+			for (size_t counter = 0; counter < nrVectors; ++counter, pGrayPixels += vectorLen)
+			{
+				if constexpr (std::is_same<T, double>::value)
+					calcHistoOfVectorEpi32(AvxSupport::read16PackedIntAvx512(pGrayPixels, _mm512_set1_pd(256.0)), histoData.redHisto);
+				else
+					calcHistoOfVectorEpi32(AvxSupport::read16PackedIntAvx512(pGrayPixels), histoData.redHisto);
+			}
+			for (size_t n = nrVectors * vectorLen; n < width; ++n, ++pGrayPixels)
+			{
+				Avx256Histogram::addToHisto(histoData.redHisto, *pGrayPixels);
+			}
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
+void Avx512Histogram::calcHistoOfVectorEpi32(const __m512i colorVec, std::vector<int>& histogram)
+{
+	// Bit j of element i is set, if element j (j < i) has the same value as element i.
+	const __m512i conflicts = _mm512_conflict_epi32(colorVec);
+
+	// Population count of the conflict bits (AVX512-VPOPCNTDQ is not available on all AVX-512 CPUs).
+	__m512i bitCount = _mm512_sub_epi32(conflicts, _mm512_and_si512(_mm512_srli_epi32(conflicts, 1), _mm512_set1_epi32(0x55555555)));
+	bitCount = _mm512_add_epi32(_mm512_and_si512(bitCount, _mm512_set1_epi32(0x33333333)), _mm512_and_si512(_mm512_srli_epi32(bitCount, 2), _mm512_set1_epi32(0x33333333)));
+	bitCount = _mm512_and_si512(_mm512_add_epi32(bitCount, _mm512_srli_epi32(bitCount, 4)), _mm512_set1_epi32(0x0f0f0f0f));
+	bitCount = _mm512_srli_epi32(_mm512_mullo_epi32(bitCount, _mm512_set1_epi32(0x01010101)), 24);
+
+	// Element i: number of equal values in the elements 0..i. The last one of a group of equal values has the total number.
+	const __m512i nrEqualColors = _mm512_add_epi32(bitCount, _mm512_set1_epi32(1));
+	// Elements that are equal to an element at a higher position must not be written.
+	const __mmask16 notLastOfGroup = static_cast<__mmask16>(_mm512_reduce_or_epi32(conflicts));
+
+	const __m512i sourceHisto = _mm512_i32gather_epi32(colorVec, histogram.data(), 4);
+	_mm512_mask_i32scatter_epi32(histogram.data(), static_cast<__mmask16>(~notLastOfGroup), colorVec, _mm512_add_epi32(sourceHisto, nrEqualColors), 4);
+}
+
+
+// *****************
+// Generic Histogram
+// *****************
+
+int GenericHistogram::calcHistogram(const size_t lineStart, const size_t lineEnd, const double multiplier)
+{
+	// The typed code (like the AVX code) does not scale the values.
+	if (multiplier != 1.0)
+		return 1;
+
+	if (doCalcHistogram<std::uint16_t>(lineStart, lineEnd) == 0)
+		return 0;
+	if (doCalcHistogram<std::uint32_t>(lineStart, lineEnd) == 0)
+		return 0;
+	if (doCalcHistogram<float>(lineStart, lineEnd) == 0)
+		return 0;
+	if (doCalcHistogram<double>(lineStart, lineEnd) == 0)
+		return 0;
+
+	return 1;
+}
+
+template <class T>
+int GenericHistogram::doCalcHistogram(const size_t lineStart, const size_t lineEnd)
+{
+	const AvxSupport avxInputSupport{ histoData.inputBitmap };
+	if (!avxInputSupport.isColorBitmapOfType<T>() && !avxInputSupport.isMonochromeBitmapOfType<T>())
+		return 1;
+	// CFA bitmaps need the interpolation.
+	if (avxInputSupport.isMonochromeCfaBitmapOfType<T>())
+		return 1;
+
+	const size_t width = histoData.inputBitmap.Width();
+
+	const auto addLine = [width](const T* pPixels, AvxHistogram::HistogramVectorType& histogram) -> void
+	{
+		for (size_t n = 0; n < width; ++n)
+			Avx256Histogram::addToHisto(histogram, pPixels[n]);
+	};
+
+	if (avxInputSupport.isColorBitmapOfType<T>())
+	{
+		if constexpr (std::is_same<T, double>::value) // color-double not supported.
+			return 1;
+		else
+		{
+			for (size_t row = lineStart; row < lineEnd; ++row)
+			{
+				addLine(&avxInputSupport.redPixels<T>().at(row * width), histoData.redHisto);
+				addLine(&avxInputSupport.greenPixels<T>().at(row * width), histoData.greenHisto);
+				addLine(&avxInputSupport.bluePixels<T>().at(row * width), histoData.blueHisto);
+			}
+			return 0;
+		}
+	}
+
+	if (avxInputSupport.isMonochromeBitmapOfType<T>())
+	{
+		for (size_t row = lineStart; row < lineEnd; ++row)
+			addLine(&avxInputSupport.grayPixels<T>().at(row * width), histoData.redHisto);
+		return 0;
+	}
+
+	return 1;
+}
+
+
 // *****************
 // Non-AVX Histogram
 // *****************
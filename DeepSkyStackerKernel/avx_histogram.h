@@ -8,10 +8,13 @@ class AvxHistogram
 public:
 	typedef std::vector<int> HistogramVectorType;
 private:
+	friend class Avx512Histogram;
 	friend class Avx256Histogram;
+	friend class GenericHistogram;
 	friend class NonAvxHistogram;
 
 	bool avxReady;
+	bool avx512Ready;
 	HistogramVectorType redHisto;
 	HistogramVectorType greenHisto;
 	HistogramVectorType blueHisto;
@@ -64,6 +67,42 @@ public:
 };
 
 
+class Avx512Histogram : public SimdFactory<Avx512Histogram>
+{
+private:
+	friend class AvxHistogram;
+	friend class SimdFactory<Avx512Histogram>;
+
+	AvxHistogram& histoData;
+	Avx512Histogram(AvxHistogram& hd) : histoData{ hd } {}
+
+	int calcHistogram(const size_t lineStart, const size_t lineEnd, const double);
+
+	template <class T>
+	int doCalcHistogram(const size_t lineStart, const size_t lineEnd);
+public:
+	// Conflict detection with VPCONFLICTD, then one gather and one masked scatter for 16 values.
+	static void calcHistoOfVectorEpi32(const __m512i colorVec, std::vector<int>& histogram);
+};
+
+// Portable version of the typed AVX code for CPUs without AVX2 (plain loops over the pixel vectors, no virtual GetPixel() calls).
+// Gives the same histogram as Avx256Histogram. CFA bitmaps (need interpolation) and multipliers != 1 are left to the NonAvxHistogram.
+class GenericHistogram : public SimdFactory<GenericHistogram>
+{
+private:
+	friend class AvxHistogram;
+	friend class SimdFactory<GenericHistogram>;
+
+	AvxHistogram& histoData;
+	GenericHistogram(AvxHistogram& hd) : histoData{ hd } {}
+
+	int calcHistogram(const size_t lineStart, const size_t lineEnd, const double multiplier);
+
+	template <class T>
+	int doCalcHistogram(const size_t lineStart, const size_t lineEnd);
+};
+
+
 class NonAvxHistogram : public SimdFactory<NonAvxHistogram>
 {
 private:
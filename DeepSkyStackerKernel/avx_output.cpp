@@ -10,7 +10,8 @@
 AvxOutputComposition::AvxOutputComposition(CMultiBitmap& mBitmap, CMemoryBitmap& outputbm) :
 	inputBitmap{ mBitmap },
 	outputBitmap{ outputbm },
-	avxReady{ true }
+	avxReady{ true },
+	avx512Ready{ false }
 {
 	if (!AvxSimdCheck::checkSimdAvailability())
 		avxReady = false;
@@ -20,6 +21,8 @@ AvxOutputComposition::AvxOutputComposition(CMultiBitmap& mBitmap, CMemoryBitmap&
 	// Output must be float values
 	if (AvxSupport{outputBitmap}.bitmapHasCorrectType<float>() == false)
 		avxReady = false;
+	// The kappa-sigma and the auto adaptive loops have AVX-512 versions.
+	avx512Ready = avxReady && AvxSimdCheck::checkAvx512Availability();
 }
 
 template <class INPUTTYPE, class OUTPUTTYPE>
@@ -231,12 +234,71 @@ int AvxOutputComposition::doProcessMedianKappaSigma(const int line, std::vector<
 
 	// ************* Loops *************
 
+	// AVX-512 version of the kappa-sigma clipping of 16 pixels. Same operations as the AVX-256 code below (with 1 instead of 2 vectors),
+	// so the results are identical.
+	const auto kappaSigmaAvx512 = [&lineAddresses, &parameters, nrLightframes, initialUpperBound](float* pOut, const size_t pixelOffset) -> void
+	{
+		const __m512 kappa512 = _mm512_set1_ps(static_cast<float>(std::get<0>(parameters)));
+		__m512 lowerBound = _mm512_setzero_ps();
+		__m512 upperBound = _mm512_set1_ps(initialUpperBound());
+		__m512 my = _mm512_setzero_ps();
+
+		for (int iteration = 0; iteration < std::get<1>(parameters); ++iteration)
+		{
+			__m512 sum = _mm512_setzero_ps();
+			__m512 N = _mm512_setzero_ps();
+			__m512d sumSqLo = _mm512_setzero_pd();
+			__m512d sumSqHi = _mm512_setzero_pd();
+
+			for (int lightFrame = 0; lightFrame < nrLightframes; ++lightFrame)
+			{
+				const T* const pColor = static_cast<T*>(lineAddresses[lightFrame]) + pixelOffset;
+				const __m512 colorValue = AvxSupport::read16PackedSingleAvx512(pColor);
+				const __mmask16 outOfRange = _mm512_cmp_ps_mask(colorValue, lowerBound, _CMP_LT_OQ) | _mm512_cmp_ps_mask(colorValue, upperBound, _CMP_GT_OQ);
+				const __m512 value = _mm512_maskz_mov_ps(static_cast<__mmask16>(~outOfRange), colorValue); // Set to zero where value is outside my +- kappa * sigma.
+				N = _mm512_mask_add_ps(N, _mm512_cmp_ps_mask(value, _mm512_setzero_ps(), _CMP_NEQ_OQ), N, _mm512_set1_ps(1.0f)); // if (value != 0) ++N;
+
+				sum = _mm512_add_ps(sum, value);
+				const __m512d valueLo = _mm512_cvtps_pd(_mm512_castps512_ps256(value));
+				const __m512d valueHi = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(value), 1)));
+				sumSqLo = _mm512_fmadd_pd(valueLo, valueLo, sumSqLo);
+				sumSqHi = _mm512_fmadd_pd(valueHi, valueHi, sumSqHi);
+			}
+			const __mmask16 hasValues = _mm512_cmp_ps_mask(N, _mm512_setzero_ps(), _CMP_NEQ_UQ);
+			my = _mm512_maskz_div_ps(hasValues, sum, N); // 0 where N==0.
+
+			// Sigma^2 = sumSquared / N - my^2 = 1/N * (sumSquared - sum^2 / N)
+			const __m512d Nlo = _mm512_cvtps_pd(_mm512_castps512_ps256(N));
+			const __m512d Nhi = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(N), 1)));
+			const __m512d sumLo = _mm512_cvtps_pd(_mm512_castps512_ps256(sum));
+			const __m512d sumHi = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sum), 1)));
+			const __m256 sigmaSqNLo = _mm512_cvtpd_ps(_mm512_sub_pd(sumSqLo, _mm512_div_pd(_mm512_mul_pd(sumLo, sumLo), Nlo)));
+			const __m256 sigmaSqNHi = _mm512_cvtpd_ps(_mm512_sub_pd(sumSqHi, _mm512_div_pd(_mm512_mul_pd(sumHi, sumHi), Nhi)));
+			const __m512 sigmaSqN = _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(sigmaSqNLo)), _mm256_castps_pd(sigmaSqNHi), 1));
+			const __m512 sigma = _mm512_sqrt_ps(_mm512_div_ps(sigmaSqN, N));
+
+			// Update lower and upper bound with new my +- kappa * sigma
+			upperBound = _mm512_maskz_mov_ps(hasValues, _mm512_fmadd_ps(sigma, kappa512, my)); // Set 0 where N==0.
+			lowerBound = _mm512_mask_mov_ps(_mm512_set1_ps(1.0f), hasValues, _mm512_fnmadd_ps(sigma, kappa512, my)); // Set 1 where N==0.
+		}
+		_mm512_storeu_ps(pOut, my);
+	};
+
 	const auto kappaSigmaLoop = [&](float* pOut, const int colorOffset) -> void
 	{
 		const size_t outputWidth = outputBitmap.Width();
 
 		for (int counter = 0; counter < nrVectors; ++counter, pOut += 16)
 		{
+			if constexpr (Method == KappaSigma)
+			{
+				if (avx512Ready)
+				{
+					kappaSigmaAvx512(pOut + static_cast<size_t>(line) * outputWidth, counter * size_t{ 16 } + colorOffset);
+					continue;
+				}
+			}
+
 			__m256 lowerBound1{ _mm256_setzero_ps() };
 			__m256 lowerBound2{ _mm256_setzero_ps() };
 			__m256 upperBound1{ _mm256_set1_ps(initialUpperBound()) };
@@ -442,11 +504,57 @@ int AvxOutputComposition::doProcessAutoAdaptiveWeightedAverage(const int line, s
 	const __m256 N = _mm256_set1_ps(static_cast<float>(lineAddresses.size()));
 	const size_t outputWidth = outputBitmap.Width();
 
-	const auto autoAdaptLoop = [line, &lineAddresses, nIterations, width, nrVectors, N, outputWidth](float* pOut, const int colorOffset) -> void
+	// AVX-512 version for 16 pixels, same operations as the AVX-256 code (identical results).
+	const auto autoAdaptAvx512 = [&lineAddresses, nIterations](float* pOut, const size_t pixelOffset) -> void
+	{
+		const __m512 N512 = _mm512_set1_ps(static_cast<float>(lineAddresses.size()));
+		__m512 my = _mm512_setzero_ps();
+
+		// Calculate initial (unweighted) mean.
+		for (auto frameAddress : lineAddresses)
+			my = _mm512_add_ps(my, AvxSupport::read16PackedSingleAvx512(static_cast<T*>(frameAddress) + pixelOffset));
+		my = _mm512_div_ps(my, N512); // N != 0 guaranteed
+
+		for (int iteration = 0; iteration < nIterations; ++iteration)
+		{
+			// Calculate sigma^2 related to my of last iteration.
+			__m512 S = _mm512_setzero_ps();
+			for (auto frameAddress : lineAddresses)
+			{
+				const __m512 d = _mm512_sub_ps(AvxSupport::read16PackedSingleAvx512(static_cast<T*>(frameAddress) + pixelOffset), my);
+				S = _mm512_fmadd_ps(d, d, S); // Sum of (x-my)^2
+			}
+			const __m512 sigmaSq = _mm512_div_ps(S, N512); // sigma^2 = sum(x-my)^2 / N
+
+			// Calculate new my using current sigma^2.
+			__m512 W = _mm512_setzero_ps();
+			S = _mm512_setzero_ps();
+			for (auto frameAddress : lineAddresses)
+			{
+				const __m512 color = AvxSupport::read16PackedSingleAvx512(static_cast<T*>(frameAddress) + pixelOffset);
+				const __m512 d = _mm512_sub_ps(color, my); // x-my
+				const __m512 denominator = _mm512_fmadd_ps(d, d, sigmaSq); // sigma^2 + (x-my)^2
+				const __mmask16 denominatorIsZero = _mm512_cmp_ps_mask(denominator, _mm512_setzero_ps(), _CMP_EQ_OQ);
+				const __m512 weight = _mm512_mask_mov_ps(_mm512_div_ps(sigmaSq, denominator), denominatorIsZero, _mm512_set1_ps(1.0f)); // Set weight to 1 when sigma==0.
+				W = _mm512_add_ps(W, weight); // W = sum(weights)
+				S = _mm512_fmadd_ps(color, weight, S); // S = sum(x * weight)
+			}
+			my = _mm512_div_ps(S, W); // W == 0 (sum of weights) cannot happen.
+		}
+		_mm512_storeu_ps(pOut, my);
+	};
+
+	const auto autoAdaptLoop = [line, &lineAddresses, nIterations, width, nrVectors, N, outputWidth, avx512 = this->avx512Ready, &autoAdaptAvx512](float* pOut, const int colorOffset) -> void
 	{
 		// Loop over the pixels of the row, process 16 at a time.
 		for (int counter = 0; counter < nrVectors; ++counter, pOut += 16)
 		{
+			if (avx512)
+			{
+				autoAdaptAvx512(pOut + static_cast<size_t>(line) * outputWidth, counter * size_t{ 16 } + colorOffset);
+				continue;
+			}
+
 			__m256 my1 = _mm256_setzero_ps();
 			__m256 my2 = _mm256_setzero_ps();
 
@@ -9,6 +9,7 @@ private:
 	CMultiBitmap& inputBitmap;
 	CMemoryBitmap& outputBitmap;
 	bool avxReady;
+	bool avx512Ready;
 public:
 	AvxOutputComposition() = delete;
 	AvxOutputComposition(CMultiBitmap& mBitmap, CMemoryBitmap& outputbm);
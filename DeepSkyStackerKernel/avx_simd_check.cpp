@@ -2,79 +2,135 @@
 #include <immintrin.h>
 #include "avx_simd_check.h"
 #include "Multitask.h"
+#include <atomic>
 #if defined (Q_OS_LINUX)
 #include <cpuid.h>
 #endif
 
 
-bool AvxSimdCheck::checkAvx2CpuSupport()
+namespace
 {
+	AvxSimdCheck::SimdLevel detectCpuSimdLevel()
+	{
 #if defined(Q_OS_WIN) 
-	SYSTEM_INFO info;
-	GetNativeSystemInfo(&info);
-	if (info.wProcessorArchitecture != PROCESSOR_ARCHITECTURE_AMD64) // AVX instructions can only be supported on x64 CPUs. 
-		return false;
+		SYSTEM_INFO info;
+		GetNativeSystemInfo(&info);
+		if (info.wProcessorArchitecture != PROCESSOR_ARCHITECTURE_AMD64) // AVX instructions can only be supported on x64 CPUs. 
+			return AvxSimdCheck::SimdLevel::Generic;
 
-	int cpuid[4] = { -1 };
+		int cpuid[4] = { -1 };
 
-	__cpuidex(cpuid, 1, 0);
-	const bool FMAsupported = ((cpuid[2] & (1 << 12)) != 0);
-	const bool POPCNTsupported = ((cpuid[2] & (1 << 23)) != 0);
-	const bool XSAVEsupported = ((cpuid[2] & (1 << 26)) != 0);
-	const bool OSXSAVEsupported = ((cpuid[2] & (1 << 27)) != 0);
+		__cpuidex(cpuid, 1, 0);
+		const unsigned int ecx1 = static_cast<unsigned int>(cpuid[2]);
 
-	__cpuidex(cpuid, 7, 0);
-	const bool AVX2supported = ((cpuid[1] & (1 << 5)) != 0);
-	//const bool BMI1supported = ((cpuid[1] & (1 << 3) != 0); 
-	//const bool BMI2supported = ((cpuid[1] & (1 << 8)) != 0); 
+		__cpuidex(cpuid, 7, 0);
+		const unsigned int ebx7 = static_cast<unsigned int>(cpuid[1]);
+#else 
+		if (__get_cpuid_max(0, nullptr) < 7)
+			return AvxSimdCheck::SimdLevel::Generic;
+		unsigned int eax = 0;
+		unsigned int ebx = 0;
+		unsigned int ecx = 0;
+		unsigned int edx = 0;
+
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+			return AvxSimdCheck::SimdLevel::Generic;
+		const unsigned int ecx1 = ecx;
+
+		eax = ebx = ecx = edx = 0;
+		if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0)
+			return AvxSimdCheck::SimdLevel::Generic;
+		const unsigned int ebx7 = ebx;
+#endif 
+		const bool FMAsupported = ((ecx1 & (1 << 12)) != 0);
+		const bool POPCNTsupported = ((ecx1 & (1 << 23)) != 0);
+		const bool XSAVEsupported = ((ecx1 & (1 << 26)) != 0);
+		const bool OSXSAVEsupported = ((ecx1 & (1 << 27)) != 0);
+
+		const bool AVX2supported = ((ebx7 & (1 << 5)) != 0);
+		//const bool BMI1supported = ((ebx7 & (1 << 3) != 0); 
+		//const bool BMI2supported = ((ebx7 & (1 << 8)) != 0); 
+		const bool AVX512Fsupported = ((ebx7 & (1u << 16)) != 0);
+		const bool AVX512DQsupported = ((ebx7 & (1u << 17)) != 0);
+		const bool AVX512CDsupported = ((ebx7 & (1u << 28)) != 0);
+		const bool AVX512BWsupported = ((ebx7 & (1u << 30)) != 0);
+		const bool AVX512VLsupported = ((ebx7 & (1u << 31)) != 0);
+
+		const bool RequiredCpuFlags = FMAsupported && POPCNTsupported && XSAVEsupported && OSXSAVEsupported && AVX2supported;
+		if (!RequiredCpuFlags)
+			return AvxSimdCheck::SimdLevel::Generic;
+
+		// OS supports AVX (YMM registers) - Note: XGETBV may only be executed on CPUs with XSAVE flag set. 
+		const auto xcr0 = _xgetbv(0);
+		const bool AVXenabledOS = (xcr0 & 6) == 6; // 6 = SSE (0x2) + YMM (0x4) 
+		if (!AVXenabledOS)
+			return AvxSimdCheck::SimdLevel::Generic;
+
+		// OS saves the AVX-512 state: 0xe6 = SSE (0x2) + YMM (0x4) + opmask (0x20) + upper halves of ZMM0-15 (0x40) + ZMM16-31 (0x80) 
+		const bool AVX512enabledOS = (xcr0 & 0xe6) == 0xe6;
+		const bool AVX512supported = AVX512Fsupported && AVX512DQsupported && AVX512CDsupported && AVX512BWsupported && AVX512VLsupported;
+
+		return (AVX512supported && AVX512enabledOS) ? AvxSimdCheck::SimdLevel::Avx512 : AvxSimdCheck::SimdLevel::Avx2;
+	}
 
-	const bool RequiredCpuFlags = FMAsupported && POPCNTsupported && XSAVEsupported && OSXSAVEsupported && AVX2supported;
+	std::atomic<AvxSimdCheck::SimdLevel> simdLevelLimit{ AvxSimdCheck::SimdLevel::Avx512 };
+}
 
-	// OS supports AVX (YMM registers) - Note: XGETBV may only be executed on CPUs with XSAVE flag set. 
-	const bool AVXenabledOS = RequiredCpuFlags ? ((_xgetbv(0) & 6) == 6) : false; // 6 = SSE (0x2) + YMM (0x4) 
+AvxSimdCheck::SimdLevel AvxSimdCheck::cpuSimdLevel()
+{
+	// CPUID is expensive (it serialises the pipeline), so run it once only.
+	static const SimdLevel cpuLevel = detectCpuSimdLevel();
+	return cpuLevel;
+}
 
-	// Additionally set flush to zero and denormals to zero - Note: (S)GETCSR are SSE instructions, so supported by all x64 CPUs. 
-	_mm_setcsr(_mm_getcsr() | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+AvxSimdCheck::SimdLevel AvxSimdCheck::simdLevel()
+{
+	// If user has disabled SIMD vectorisation (settings dialog) -> only the generic code.
+	if (!CMultitask::GetUseSimd())
+		return SimdLevel::Generic;
+	return std::min(cpuSimdLevel(), simdLevelLimit.load(std::memory_order_relaxed));
+}
 
-	return (RequiredCpuFlags && AVXenabledOS);
-#else 
-	if (__get_cpuid_max(0, nullptr) < 7)
-		return false;
-	unsigned int eax = 0;
-	unsigned int ebx = 0;
-	unsigned int ecx = 0;
-	unsigned int edx = 0;
-
-	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
-		return false;
-	const bool FMAsupported = ((ecx & (1 << 12)) != 0);
-	const bool POPCNTsupported = ((ecx & (1 << 23)) != 0);
-	const bool XSAVEsupported = ((ecx & (1 << 26)) != 0);
-	const bool OSXSAVEsupported = ((ecx & (1 << 27)) != 0);
-
-	eax = ebx = ecx = edx = 0;
-	if (__get_cpuid(7, &eax, &ebx, &ecx, &edx) == 0)
-		return false;
-	const bool AVX2supported = ((ebx & (1 << 5)) != 0);
-	//const bool BMI1supported = ((ebx & (1 << 3) != 0); 
-	//const bool BMI2supported = ((ebx & (1 << 8)) != 0); 
-
-	const bool RequiredCpuFlags = FMAsupported && POPCNTsupported && XSAVEsupported && OSXSAVEsupported && AVX2supported;
-
-	// OS supports AVX (YMM registers) - Note: XGETBV may only be executed on CPUs with XSAVE flag set. 
-	const bool AVXenabledOS = RequiredCpuFlags ? ((_xgetbv(0) & 6) == 6) : false; // 6 = SSE (0x2) + YMM (0x4) 
+void AvxSimdCheck::limitSimdLevel(const SimdLevel maxLevel)
+{
+	simdLevelLimit.store(maxLevel, std::memory_order_relaxed);
+}
+
+const char* AvxSimdCheck::simdLevelName(const SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::Avx512: return "AVX-512";
+	case SimdLevel::Avx2: return "AVX2";
+	default: return "Generic";
+	}
+}
+
+bool AvxSimdCheck::checkAvx2CpuSupport()
+{
+	const bool supported = cpuSimdLevel() >= SimdLevel::Avx2;
 
 	// Additionally set flush to zero and denormals to zero - Note: (S)GETCSR are SSE instructions, so supported by all x64 CPUs. 
-	_mm_setcsr(_mm_getcsr() | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+	// This is a per-thread setting, so it must not be cached together with the CPU level.
+	if (supported)
+		_mm_setcsr(_mm_getcsr() | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
 
-	return (RequiredCpuFlags && AVXenabledOS);
-#endif 
-};
+	return supported;
+}
+
+bool AvxSimdCheck::checkAvx512CpuSupport()
+{
+	return checkAvx2CpuSupport() && cpuSimdLevel() >= SimdLevel::Avx512;
+}
 
 bool AvxSimdCheck::checkSimdAvailability()
 {
-	// If user has disabled SIMD vectorisation (settings dialog) -> return false;
-	return CMultitask::GetUseSimd() && checkAvx2CpuSupport();
+	return checkAvx2CpuSupport() && simdLevel() >= SimdLevel::Avx2;
+}
+
+bool AvxSimdCheck::checkAvx512Availability()
+{
+	return checkAvx2CpuSupport() && simdLevel() >= SimdLevel::Avx512;
 }
 
 void AvxSimdCheck::reportCpuType()
@@ -163,4 +219,8 @@ void AvxSimdCheck::reportCpuType()
 	// 
 	std::cerr << "CPU Type: " << brand << std::endl;
 	ZTRACE_RUNTIME("CPU type: %s", brand);
+
+	const char* const simdName = simdLevelName(cpuSimdLevel());
+	std::cerr << "SIMD level: " << simdName << std::endl;
+	ZTRACE_RUNTIME("SIMD level: %s", simdName);
 }
@@ -3,7 +3,26 @@
 class AvxSimdCheck
 {
 public:
+	// Vector instruction set levels in ascending order, each level includes all lower ones.
+	enum class SimdLevel : int
+	{
+		Generic = 0,	// Portable C++ loops, vectorised by the compiler with the baseline instruction set (SSE2 on x64, NEON on ARM64).
+		Avx2 = 1,		// AVX2 + FMA3
+		Avx512 = 2		// AVX-512 F + CD + BW + DQ + VL
+	};
+
 	static bool checkAvx2CpuSupport();
+	static bool checkAvx512CpuSupport();
 	static bool checkSimdAvailability();
+	static bool checkAvx512Availability();
+
+	// Highest level supported by CPU and OS. Determined once (CPUID), then cached.
+	static SimdLevel cpuSimdLevel();
+	// Level to be used by the kernels: min(cpuSimdLevel, limit), or Generic if the user has disabled SIMD vectorisation.
+	static SimdLevel simdLevel();
+	// Restricts the level used by the kernels (unit tests and benchmarks run the same code with all levels).
+	static void limitSimdLevel(const SimdLevel maxLevel);
+	static const char* simdLevelName(const SimdLevel level);
+
 	static void reportCpuType();
 };
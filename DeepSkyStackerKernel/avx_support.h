@@ -272,6 +272,40 @@ public:
 		};
 	}
 
+	// AVX-512: Read 16 color values from T* and return 16 packed single (same conversions as read16PackedSingle).
+	inline static __m512 read16PackedSingleAvx512(const std::uint16_t* const pColor) noexcept
+	{
+		return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)pColor)));
+	}
+	inline static __m512 read16PackedSingleAvx512(const std::uint32_t* const pColor) noexcept
+	{
+		return _mm512_cvtepi32_ps(_mm512_srli_epi32(_mm512_loadu_si512(pColor), 16)); // Shift 16 bits right while shifting in zeros.
+	}
+	inline static __m512 read16PackedSingleAvx512(const float* const pColor) noexcept
+	{
+		return _mm512_loadu_ps(pColor);
+	}
+
+	// AVX-512: Read 16 color values from T* and return 16 packed int (same conversions as read16PackedInt).
+	inline static __m512i read16PackedIntAvx512(const std::uint16_t* const pColor) noexcept
+	{
+		return _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)pColor));
+	}
+	inline static __m512i read16PackedIntAvx512(const std::uint32_t* const pColor) noexcept
+	{
+		return _mm512_srli_epi32(_mm512_loadu_si512(pColor), 16);
+	}
+	inline static __m512i read16PackedIntAvx512(const float* const pColor) noexcept
+	{
+		return _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_loadu_ps(pColor)), _mm512_set1_epi32(0x0000ffff));
+	}
+	inline static __m512i read16PackedIntAvx512(const double* const pColor, const __m512d scalingFactor) noexcept
+	{
+		const __m256i lo = _mm512_cvttpd_epi32(_mm512_mul_pd(_mm512_loadu_pd(pColor), scalingFactor));
+		const __m256i hi = _mm512_cvttpd_epi32(_mm512_mul_pd(_mm512_loadu_pd(pColor + 8), scalingFactor));
+		return _mm512_min_epi32(_mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1), _mm512_set1_epi32(0x0000ffff));
+	}
+
 	// Accumulate packed single newColor to T* oldColor
 	inline static __m256 accumulateColorValues(const __m256i outNdx, const __m256 colorValue, const __m256 fraction, const __m256i mask, const std::uint16_t* const pOutputBitmap, const bool fastload) noexcept
 	{
@@ -0,0 +1,267 @@
+#include "stdafx.h"
+#include <immintrin.h>
+#include "avx_warp.h"
+#include "avx_simd_check.h"
+#include "avx_support.h"
+#include "PixelTransform.h"
+#include "GrayBitmap.h"
+#include "DSSProgress.h"
+#include "Multitask.h"
+
+namespace
+{
+	// Coefficients a0..a15 or b0..b15 of CBilinearParameters.
+	using Coefficients = std::array<double, 16>;
+
+	Coefficients xCoefficients(const CBilinearParameters& p)
+	{
+		return { p.a0, p.a1, p.a2, p.a3, p.a4, p.a5, p.a6, p.a7, p.a8, p.a9, p.a10, p.a11, p.a12, p.a13, p.a14, p.a15 };
+	}
+	Coefficients yCoefficients(const CBilinearParameters& p)
+	{
+		return { p.b0, p.b1, p.b2, p.b3, p.b4, p.b5, p.b6, p.b7, p.b8, p.b9, p.b10, p.b11, p.b12, p.b13, p.b14, p.b15 };
+	}
+
+	//
+	// The polynomial of CBilinearParameters::transform() for 4 values of X on the same line (Y).
+	// The terms are added in the same order and with the same products, so the result is identical.
+	//
+	__m256d polynomial(const Coefficients& c, const TRANSFORMATIONTYPE type, const __m256d X, const double Y)
+	{
+		const auto coef = [&c](const size_t n) { return _mm256_set1_pd(c[n]); };
+		const __m256d vY = _mm256_set1_pd(Y);
+
+		// a0 + a1 * X + a2 * Y + a3 * X * Y
+		__m256d result = _mm256_add_pd(coef(0), _mm256_mul_pd(coef(1), X));
+		result = _mm256_add_pd(result, _mm256_set1_pd(c[2] * Y));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(3), X), vY));
+
+		if (type != TT_BISQUARED && type != TT_BICUBIC)
+			return result;
+
+		const __m256d X2 = _mm256_mul_pd(X, X);
+		const double Y2 = Y * Y;
+		const __m256d vY2 = _mm256_set1_pd(Y2);
+
+		// + a4 * X2 + a5 * Y2 + a6 * X2 * Y + a7 * X * Y2 + a8 * X2 * Y2
+		result = _mm256_add_pd(result, _mm256_mul_pd(coef(4), X2));
+		result = _mm256_add_pd(result, _mm256_set1_pd(c[5] * Y2));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(6), X2), vY));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(7), X), vY2));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(8), X2), vY2));
+
+		if (type != TT_BICUBIC)
+			return result;
+
+		const __m256d X3 = _mm256_mul_pd(X2, X);
+		const double Y3 = Y * Y * Y;
+		const __m256d vY3 = _mm256_set1_pd(Y3);
+
+		// + a9 * X3 + a10 * Y3 + a11 * X3 * Y + a12 * X * Y3 + a13 * X3 * Y2 + a14 * X2 * Y3 + a15 * X3 * Y3
+		result = _mm256_add_pd(result, _mm256_mul_pd(coef(9), X3));
+		result = _mm256_add_pd(result, _mm256_set1_pd(c[10] * Y3));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(11), X3), vY));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(12), X), vY3));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(13), X3), vY2));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(14), X2), vY3));
+		result = _mm256_add_pd(result, _mm256_mul_pd(_mm256_mul_pd(coef(15), X3), vY3));
+
+		return result;
+	}
+
+	// As CGrayBitmapT<T>::SetPixel()
+	template <class T>
+	constexpr double clampValue()
+	{
+		return static_cast<double>(std::numeric_limits<T>::max());
+	}
+
+	bool isInside(const double x, const double y, const int width, const int height)
+	{
+		// As DSSRect{ 0, 0, width, height }.contains(QPointF{ x, y })
+		return x >= 0 && x <= static_cast<double>(width) - 1 && y >= 0 && y <= static_cast<double>(height) - 1;
+	}
+}
+
+AvxWarp::AvxWarp(const CPixelTransform& transform) :
+	pixelTransform{ transform },
+	avxReady{ AvxSimdCheck::checkSimdAvailability() }
+{}
+
+void AvxWarp::transformLine(const int y, const int width, double* const pX, double* const pY) const
+{
+	SimdSelector<Avx256Warp, NonAvxWarp>(this, [&](auto&& o) { return o.transformLine(y, width, pX, pY); });
+}
+
+int AvxWarp::warp(const CMemoryBitmap& inputBitmap, CMemoryBitmap& outputBitmap, DSS::ProgressBase* pProgress)
+{
+	const auto tryType = [&]<class T>() -> int
+	{
+		const auto* pInput = dynamic_cast<const CGrayBitmapT<T>*>(&inputBitmap);
+		auto* pOutput = dynamic_cast<CGrayBitmapT<T>*>(&outputBitmap);
+		if (pInput == nullptr || pOutput == nullptr || pInput->Width() != pOutput->Width() || pInput->Height() != pOutput->Height())
+			return 1;
+		return doWarp(*pInput, *pOutput, pProgress);
+	};
+
+	if (tryType.operator()<std::uint16_t>() == 0)
+		return 0;
+	return tryType.operator()<float>();
+}
+
+template <class T>
+int AvxWarp::doWarp(const CGrayBitmapT<T>& inputBitmap, CGrayBitmapT<T>& outputBitmap, DSS::ProgressBase* pProgress)
+{
+	const int width = inputBitmap.Width();
+	const int height = inputBitmap.Height();
+	const double multiplier = inputBitmap.GetMultiplier();
+	const T* const pInput = inputBitmap.m_vPixels.data();
+	T* const pOutput = outputBitmap.m_vPixels.data();
+
+	// First and last output lines reached by each input line (none: first > last).
+	std::vector<int> firstLines(height, std::numeric_limits<int>::max());
+	std::vector<int> lastLines(height, std::numeric_limits<int>::min());
+
+#pragma omp parallel default(none) shared(firstLines, lastLines) firstprivate(width, height, pInput) if(CMultitask::GetNrProcessors() > 1)
+	{
+		std::vector<double> xCoordinates(width);
+		std::vector<double> yCoordinates(width);
+
+#pragma omp for schedule(dynamic, 16)
+		for (int row = 0; row < height; row++)
+		{
+			transformLine(row, width, xCoordinates.data(), yCoordinates.data());
+			const T* const pLine = pInput + static_cast<size_t>(row) * width;
+			for (int col = 0; col < width; col++)
+			{
+				if (pLine[col] != 0 && isInside(xCoordinates[col], yCoordinates[col], width, height))
+				{
+					const int line = static_cast<int>(floor(yCoordinates[col]));
+					firstLines[row] = std::min(firstLines[row], line);
+					lastLines[row] = std::max(lastLines[row], line + 1);
+				}
+			}
+		}
+	}
+
+	const int nrBands = (height + BandHeight - 1) / BandHeight;
+	std::atomic_int loopCtr = 0;
+
+#pragma omp parallel default(none) shared(firstLines, lastLines, loopCtr) firstprivate(width, height, multiplier, pInput, pOutput, nrBands, pProgress) if(CMultitask::GetNrProcessors() > 1)
+	{
+		std::vector<double> xCoordinates(width);
+		std::vector<double> yCoordinates(width);
+		PIXELDISPATCHVECTOR vPixels;
+		vPixels.reserve(4);
+
+#pragma omp for schedule(dynamic, 1)
+		for (int band = 0; band < nrBands; band++)
+		{
+			const int top = band * BandHeight;
+			const int bottom = std::min(height, top + BandHeight) - 1;
+
+			for (int row = 0; row < height; row++)
+			{
+				if (firstLines[row] > bottom || lastLines[row] < top)
+					continue;
+
+				transformLine(row, width, xCoordinates.data(), yCoordinates.data());
+				const T* const pLine = pInput + static_cast<size_t>(row) * width;
+
+				for (int col = 0; col < width; col++)
+				{
+					const double fGray = static_cast<double>(pLine[col]) / multiplier;
+					if (fGray == 0 || !isInside(xCoordinates[col], yCoordinates[col], width, height))
+						continue;
+
+					vPixels.clear();
+					ComputePixelDispatch(QPointF{ xCoordinates[col], yCoordinates[col] }, vPixels);
+
+					for (const CPixelDispatch& pixel : vPixels)
+					{
+						if (pixel.m_lX >= 0 && pixel.m_lX < width && pixel.m_lY >= top && pixel.m_lY <= bottom)
+						{
+							T& output = pOutput[static_cast<size_t>(pixel.m_lY) * width + pixel.m_lX];
+							const double fPreviousGray = static_cast<double>(output) / multiplier;
+							output = static_cast<T>(std::clamp((fPreviousGray + fGray * pixel.m_fPercentage) * multiplier, 0.0, clampValue<T>()));
+						}
+					}
+				}
+			}
+
+			++loopCtr;
+			if (pProgress != nullptr && omp_get_thread_num() == 0)
+				pProgress->Progress2(std::min(height, loopCtr * BandHeight));
+		}
+	}
+
+	return 0;
+}
+
+// ----------------------------------
+// AVX
+// ----------------------------------
+
+int Avx256Warp::transformLine(const int y, const int width, double* const pX, double* const pY) const
+{
+	if (!warpData.avxReady)
+		return 1;
+
+	const CPixelTransform& pixelTransform = warpData.pixelTransform;
+	const CBilinearParameters& params = pixelTransform.m_BilinearParameters;
+	const Coefficients a = xCoefficients(params);
+	const Coefficients b = yCoefficients(params);
+
+	// As CPixelTransform::transform(): polynomial, scaled by the widths and the pixel size, then shifted.
+	const double Y = static_cast<double>(y) / params.fYWidth;
+	const __m256d xWidth = _mm256_set1_pd(params.fXWidth);
+	const __m256d yWidth = _mm256_set1_pd(params.fYWidth);
+	const __m256d pixelSize = _mm256_set1_pd(static_cast<double>(pixelTransform.m_lPixelSizeMultiplier));
+	const __m256d xShift = _mm256_set1_pd(pixelTransform.m_fXShift);
+	const __m256d yShift = _mm256_set1_pd(pixelTransform.m_fYShift);
+	const __m256d xCometShift = _mm256_set1_pd(pixelTransform.m_fXCometShift);
+	const __m256d yCometShift = _mm256_set1_pd(pixelTransform.m_fYCometShift);
+
+	const int nrVectors = width / 4;
+	__m256d x = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+
+	for (int n = 0; n < nrVectors; n++, x = _mm256_add_pd(x, _mm256_set1_pd(4.0)))
+	{
+		const __m256d X = _mm256_div_pd(x, xWidth);
+		__m256d xOut = _mm256_mul_pd(polynomial(a, params.Type, X, Y), xWidth);
+		__m256d yOut = _mm256_mul_pd(polynomial(b, params.Type, X, Y), yWidth);
+		xOut = _mm256_add_pd(_mm256_mul_pd(xOut, pixelSize), xShift);
+		yOut = _mm256_add_pd(_mm256_mul_pd(yOut, pixelSize), yShift);
+		if (pixelTransform.m_bUseCometShift)
+		{
+			xOut = _mm256_add_pd(xOut, xCometShift);
+			yOut = _mm256_add_pd(yOut, yCometShift);
+		}
+		_mm256_storeu_pd(pX + n * 4, xOut);
+		_mm256_storeu_pd(pY + n * 4, yOut);
+	}
+
+	for (int col = nrVectors * 4; col < width; col++)
+	{
+		const QPointF pt = pixelTransform.transform(QPointF(col, y));
+		pX[col] = pt.x();
+		pY[col] = pt.y();
+	}
+
+	return AvxSupport::zeroUpper(0);
+}
+
+// ----------------------------------
+// Non-AVX
+// ----------------------------------
+
+int NonAvxWarp::transformLine(const int y, const int width, double* const pX, double* const pY) const
+{
+	for (int col = 0; col < width; col++)
+	{
+		const QPointF pt = warpData.pixelTransform.transform(QPointF(col, y));
+		pX[col] = pt.x();
+		pY[col] = pt.y();
+	}
+	return 0;
+}
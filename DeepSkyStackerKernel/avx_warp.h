@@ -0,0 +1,79 @@
+#pragma once
+#include "avx_simd_factory.h"
+
+class CMemoryBitmap;
+class CPixelTransform;
+template <typename T> class CGrayBitmapT;
+namespace DSS { class ProgressBase; }
+
+//
+// Forward warp of one plane (a gray bitmap or one channel of a colour bitmap), as done by the channel alignment.
+// Every input pixel is moved to PixelTransform.transform(x, y) and added to the (up to) 4 output pixels around this
+// point with the weights of ComputePixelDispatch(). Input pixels that are 0 or transformed outside the bitmap are skipped.
+//
+// The output is processed in bands of lines in parallel. Each band scans the input lines reaching it from top to bottom,
+// so every output pixel accumulates its contributions in the same order (and with the same rounding of its type) as a
+// serial scan of the input with GetPixel()/SetPixel().
+// The transformed coordinates of a line are computed with AVX in double, with the operations of CBilinearParameters::transform().
+//
+class AvxWarp
+{
+private:
+	friend class Avx256Warp;
+	friend class NonAvxWarp;
+
+	const CPixelTransform& pixelTransform;
+	bool avxReady;
+
+public:
+	static constexpr int BandHeight = 128;
+
+	explicit AvxWarp(const CPixelTransform& transform);
+	AvxWarp(const AvxWarp&) = delete;
+	AvxWarp& operator=(const AvxWarp&) = delete;
+
+	//
+	// Input and output must be gray bitmaps of the same type (std::uint16_t or float) and size, the output is accumulated.
+	// Returns 1 for other bitmap types (nothing done).
+	//
+	int warp(const CMemoryBitmap& inputBitmap, CMemoryBitmap& outputBitmap, DSS::ProgressBase* pProgress);
+
+	// Transformed coordinates of the pixels (0..width-1, y).
+	void transformLine(const int y, const int width, double* const pX, double* const pY) const;
+
+private:
+	template <class T>
+	int doWarp(const CGrayBitmapT<T>& inputBitmap, CGrayBitmapT<T>& outputBitmap, DSS::ProgressBase* pProgress);
+};
+
+
+class Avx256Warp : public SimdFactory<Avx256Warp>
+{
+private:
+	friend class AvxWarp;
+	friend class SimdFactory<Avx256Warp>;
+
+	const AvxWarp& warpData;
+	Avx256Warp(const AvxWarp& d) : warpData{ d } {}
+public:
+	Avx256Warp(const Avx256Warp&) = delete;
+	Avx256Warp& operator=(const Avx256Warp&) = delete;
+private:
+	int transformLine(const int y, const int width, double* const pX, double* const pY) const;
+};
+
+
+class NonAvxWarp : public SimdFactory<NonAvxWarp>
+{
+private:
+	friend class AvxWarp;
+	friend class SimdFactory<NonAvxWarp>;
+
+	const AvxWarp& warpData;
+	NonAvxWarp(const AvxWarp& d) : warpData{ d } {}
+public:
+	NonAvxWarp(const NonAvxWarp&) = delete;
+	NonAvxWarp& operator=(const NonAvxWarp&) = delete;
+private:
+	int transformLine(const int y, const int width, double* const pX, double* const pY) const;
+};
@@ -587,6 +587,38 @@ namespace DSS
 			};
 		};
 
+		//
+		// Adds counts of values binned with the step of this histogram, with the sum, sum of squares, minimum and maximum
+		// of these values. Used to merge the partial histograms built by several threads.
+		//
+		void	AddBins(const std::vector<std::uint32_t>& counts, const double valuesSum, const double valuesSumOfSquares, const double minValue, const double maxValue)
+		{
+			const size_t size = std::min(counts.size(), values.size());
+			int added = 0;
+
+			for (size_t i = 0; i < size; i++)
+			{
+				if (counts[i] != 0)
+				{
+					values[i] += counts[i];
+					added += counts[i];
+					intMax = max(intMax, values[i]);
+				};
+			};
+
+			if (added != 0)
+			{
+				valueCount += added;
+				sum += valuesSum;
+				sumOfSquares += valuesSumOfSquares;
+				maximum = max(maximum, maxValue);
+				if (minimum < 0)
+					minimum = minValue;
+				else
+					minimum = min(minimum, minValue);
+			};
+		};
+
 		void	AddValues(const Histogram& Histogram)
 		{
 			for (int i = 0; i < Histogram.values.size(); i++)
@@ -616,6 +648,11 @@ namespace DSS
 			return (double)lIndice * step;
 		};
 
+		double	GetStep() const
+		{
+			return step;
+		};
+
 		double	GetAverage()
 		{
 			double		fResult = 0;
@@ -1355,13 +1355,13 @@ void DeepSkyStackerLive::fileRegistered(std::shared_ptr<CLightFrameInfo> lfi)
 	chartTab->addScoreFWHMStars(name, lfi->m_fOverallQuality, lfi->m_fFWHM, lfi->m_vStars.size(), lfi->m_SkyBackground.m_fLight * 100.0);
 }
 
-void DeepSkyStackerLive::addToStackingQueue(std::shared_ptr<CLightFrameInfo> lfi)
+void DeepSkyStackerLive::addToStackingQueue(std::shared_ptr<CLightFrameInfo> lfi, std::shared_ptr<CMemoryBitmap> pBitmap)
 {
 	//
 	// Add the file to the stacking work queue 
 	//
 	if (nullptr != fileStacker)
-		fileStacker->addFile(lfi);
+		fileStacker->addFile(lfi, std::move(pBitmap));
 	updateStatusMessage();
 
 }
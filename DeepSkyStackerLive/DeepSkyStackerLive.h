@@ -127,7 +127,7 @@ protected slots:
 	void setImageOffsets(QString name, double dx, double dy, double angle);
 	void setImageFootprint(QPointF p1, QPointF p2, QPointF p3, QPointF p4);
 	void showStackedImage(std::shared_ptr<LoadedImage> li, int count, double exposure);
-	void addToStackingQueue(std::shared_ptr<CLightFrameInfo> p);
+	void addToStackingQueue(std::shared_ptr<CLightFrameInfo> p, std::shared_ptr<CMemoryBitmap> pBitmap);
 
 private:
 	bool initialised;
@@ -40,6 +40,7 @@
 #include "fileregistrar.h"
 #include "progresslive.h"
 #include "BitmapExt.h"
+#include "MemoryBitmap.h"
 #include "BitmapInfo.h"
 #include "RegisterEngine.h"
 #include "LiveSettings.h"
@@ -156,6 +157,7 @@ namespace DSS
 			pProgress->Start2(strText, 0);
 			CAllDepthBitmap				adb;
 			adb.SetDontUseAHD(true);
+			adb.SetKeepLoadedBitmap(true);
 
 			result = LoadPicture(file, adb, pProgress);
 			pProgress->End2();
@@ -168,6 +170,15 @@ namespace DSS
 
 				emit fileLoaded(loadedImage, file);
 
+				//
+				// The stacker needs the frame as loaded (CFA images before their conversion to colour), so it doesn't
+				// have to load the file again. Registration (hot pixel removal) and the stacker modify the bitmap, so
+				// if the loaded bitmap is the one that is registered and displayed, the stacker gets its own copy.
+				//
+				std::shared_ptr<CMemoryBitmap> pStackingBitmap{ adb.m_pLoadedBitmap };
+				if (pStackingBitmap == adb.m_pBitmap)
+					pStackingBitmap = adb.m_pBitmap->Clone();
+
 				std::shared_ptr<CLightFrameInfo>  lfi {std::make_shared<CLightFrameInfo>()};
 				// Now register the image
 
@@ -205,7 +216,7 @@ namespace DSS
 				{
 					// Check against stacking conditions before adding it to
 					// the stack list
-					emit addToStackingQueue(lfi);
+					emit addToStackingQueue(lfi, pStackingBitmap);
 				}
 				else
 				{
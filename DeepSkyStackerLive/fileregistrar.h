@@ -57,7 +57,7 @@ namespace DSS
 		void addImageToList(fs::path file);
 		void fileLoaded(std::shared_ptr<LoadedImage> image, const fs::path fileName);
 		void fileRegistered(std::shared_ptr<CLightFrameInfo> lfi);
-		void addToStackingQueue(std::shared_ptr<CLightFrameInfo> lfi);
+		void addToStackingQueue(std::shared_ptr<CLightFrameInfo> lfi, std::shared_ptr<CMemoryBitmap> pBitmap);
 		void fileNotStackable(fs::path file);
 		void setImageInfo(QString name, STACKIMAGEINFO info);
 		void handleWarning(QString text);
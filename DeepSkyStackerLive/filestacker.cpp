@@ -46,6 +46,14 @@
 #include "TIFFUtil.h"
 #include "dssliveenums.h"
 
+namespace
+{
+	std::uint64_t bitmapBytes(const CMemoryBitmap& bitmap)
+	{
+		return static_cast<std::uint64_t>(bitmap.Width()) * bitmap.Height() * (bitmap.BitPerSample() / 8) * (bitmap.IsMonochrome() ? 1 : 3);
+	}
+}
+
 namespace DSS
 {
 	FileStacker::FileStacker(QObject* parent, ProgressLive* progress) :
@@ -54,6 +62,7 @@ namespace DSS
 		pProgress{ progress },
 		liveSettings{ DSSLive::instance()->liveSettings.get() },
 		referenceFrameIsSet {false},
+		decodedBytes{ 0 },
 		unsavedImageCount{ 0 }
 	{
 		ZTRACE_RUNTIME("File stacker active");
@@ -76,6 +85,8 @@ namespace DSS
 			// Clear the work queue
 			if (!pending.empty())
 				pending.clear();
+			decodedFrames.clear();
+			decodedBytes = 0;
 
 			// Add a null entry to the work queue to show we're done
 			// and wake up the run() mf
@@ -111,10 +122,26 @@ namespace DSS
 		}
 	}
 
-	void FileStacker::addFile(std::shared_ptr<CLightFrameInfo>& lfi)
+	void FileStacker::addFile(std::shared_ptr<CLightFrameInfo>& lfi, std::shared_ptr<CMemoryBitmap> pBitmap)
 	{
 		QMutexLocker lock(&mutex);
 		pending.emplace_back(lfi);
+		if (pBitmap)
+		{
+			//
+			// Keep the decoded bitmap if there is room for it, otherwise the frame will be loaded again when it is stacked.
+			// One bitmap is always kept.
+			//
+			const std::uint64_t bytes = bitmapBytes(*pBitmap);
+			const size_t maxFrames = static_cast<size_t>(std::max(CMultitask::GetMaxPrefetchedFrames(), 1));
+			if (decodedFrames.empty() || (decodedFrames.size() < maxFrames && decodedBytes + bytes <= CMultitask::GetPrefetchMemoryLimit()))
+			{
+				decodedFrames.emplace(lfi.get(), std::move(pBitmap));
+				decodedBytes += bytes;
+			}
+			else
+				ZTRACE_RUNTIME("Decoded frame not kept, it will be loaded again for stacking");
+		}
 		if (stackingEnabled)
 		{
 			condvar.wakeOne();
@@ -132,6 +159,24 @@ namespace DSS
 	{
 		QMutexLocker lock(&mutex);
 		pending.clear();
+		decodedFrames.clear();
+		decodedBytes = 0;
+	}
+
+	//
+	// Removes the decoded bitmap of a frame from the buffer, mutex must be locked.
+	// Returns an empty pointer if there is none, the frame must then be loaded from disk.
+	//
+	std::shared_ptr<CMemoryBitmap> FileStacker::takeDecodedFrame(const CLightFrameInfo* pLfi)
+	{
+		std::shared_ptr<CMemoryBitmap> pBitmap;
+		if (const auto it = decodedFrames.find(pLfi); it != decodedFrames.end())
+		{
+			pBitmap = std::move(it->second);
+			decodedFrames.erase(it);
+			decodedBytes -= bitmapBytes(*pBitmap);
+		}
+		return pBitmap;
 	}
 
 	void FileStacker::clearStackedImage()
@@ -159,6 +204,7 @@ namespace DSS
 			else
 			{
 				std::shared_ptr<CLightFrameInfo> lfi;
+				std::shared_ptr<CMemoryBitmap> pBitmap;
 				bool bestFrameFound{ false };
 				{
 					QMutexLocker lock(&mutex);
@@ -181,8 +227,14 @@ namespace DSS
 						bestFrameFound = true;
 						lfi = *bestit;
 						pending.erase(bestit);
+						pBitmap = takeDecodedFrame(lfi.get());
+					}
+					else
+					{
+						pending.clear();
+						decodedFrames.clear();
+						decodedBytes = 0;
 					}
-					else pending.clear();
 				}
 
 				if (bestFrameFound)
@@ -192,7 +244,7 @@ namespace DSS
 					stackingEngine.ComputeOffset(*lfi);
 					emit setImageOffsets(name, 0, 0, 0);
 
-					stackingEngine.AddImage(*lfi, pProgress);
+					stackingEngine.AddImage(*lfi, pProgress, std::move(pBitmap));
 					emit fileStacked(lfi);
 					referenceFrameIsSet = true;
 					//
@@ -214,11 +266,13 @@ namespace DSS
 			QString					warning;
 
 			std::shared_ptr<CLightFrameInfo> pInfo;
+			std::shared_ptr<CMemoryBitmap> pBitmap;
 
 			{
 				QMutexLocker lock(&mutex);
 				pInfo = pending.front();
 				pending.pop_front();
+				pBitmap = takeDecodedFrame(pInfo.get());
 			}
 
 			CLightFrameInfo	lfi{ *pInfo };
@@ -243,7 +297,7 @@ namespace DSS
 
 				if (isImageStackable(lfi.filePath, dX, dY, angle, strError))
 				{
-					stackingEngine.AddImage(lfi, pProgress);
+					stackingEngine.AddImage(lfi, pProgress, std::move(pBitmap));
 					emit fileStacked(pInfo);
 
 					QPointF		pt1, pt2, pt3, pt4;
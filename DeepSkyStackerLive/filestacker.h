@@ -70,7 +70,7 @@ namespace DSS
 		~FileStacker();
 		size_t registeredImageCount();
 
-		void addFile(std::shared_ptr<CLightFrameInfo>& lfi);
+		void addFile(std::shared_ptr<CLightFrameInfo>& lfi, std::shared_ptr<CMemoryBitmap> pBitmap = {});
 		inline void enableStacking(bool enable = true)
 		{
 			stackingEnabled = enable;
@@ -93,11 +93,19 @@ namespace DSS
 		QMutex mutex;
 		QMutex stacking;
 		std::deque<std::shared_ptr<CLightFrameInfo>> pending;
+		//
+		// Bitmaps of pending frames as decoded by the registrar, so they needn't be loaded again.
+		// Limited in number and memory like the frame prefetching; frames without a bitmap here are loaded from disk.
+		// Protected by mutex.
+		//
+		std::unordered_map<const CLightFrameInfo*, std::shared_ptr<CMemoryBitmap>> decodedFrames;
+		std::uint64_t decodedBytes;
 		bool referenceFrameIsSet;
 		CRunningStackingEngine stackingEngine;
 		std::uint32_t unsavedImageCount;
 
 		void stackNextImage();
+		std::shared_ptr<CMemoryBitmap> takeDecodedFrame(const CLightFrameInfo* pLfi);
 		bool isImageStackable(const fs::path& file, double fdX, double fdY, double fAngle, QString& error);
 		bool imageWarning(const fs::path& file, double fdX, double fdY, double fAngle, QString& warning);
 		void emitStackedImage(const fs::path& file);
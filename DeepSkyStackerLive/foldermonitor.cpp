@@ -39,6 +39,11 @@
 #include <atomic>
 #include <Ztrace.h>
 #include "foldermonitor.h"
+#if defined(Q_OS_LINUX)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 namespace DSS
 {
@@ -75,49 +80,201 @@ namespace DSS
 		ZFUNCTRACE_RUNTIME();
 		emit existingFiles(existing_);		// Tell the boss about existing files
 
-		while (!stopped)
-		{
-			// Wait for "delay" seconds
-			QThread::sleep(delay);
+		if (!runNotified())
+			runPolling();
+	}
 
-			auto it = paths_.begin();
-			while (it != paths_.end())
+	//
+	// Compare the folder with the known files: report erased, new and modified files.
+	//
+	void FolderMonitor::scanFolder()
+	{
+		auto it = paths_.begin();
+		while (it != paths_.end())
+		{
+			if (!fs::exists(it->first)) 
 			{
-				if (!fs::exists(it->first)) 
-				{
-					emit fileErased(it->first);
-					it = paths_.erase(it);
-				}
-				else
-				{
-					it++;
-				}
+				emit fileErased(it->first);
+				it = paths_.erase(it);
 			}
-
-			// Check if a file was created or modified
-			for (auto& file : fs::directory_iterator(folderToWatch))
+			else
 			{
-				auto current_file_last_write_time = fs::last_write_time(file);
+				it++;
+			}
+		}
+
+		// Check if a file was created or modified
+		for (auto& file : fs::directory_iterator(folderToWatch))
+		{
+			auto current_file_last_write_time = fs::last_write_time(file);
 
-				if (!paths_.contains(file))
+			if (!paths_.contains(file))
+			{
+				// File creation
+				paths_[file] = current_file_last_write_time;
+				emit fileCreated(file);
+				// File modification
+			}
+			else
+			{
+				// File modification
+				if (paths_[file] != current_file_last_write_time)
 				{
-					// File creation
 					paths_[file] = current_file_last_write_time;
-					emit fileCreated(file);
-					// File modification
+					emit fileChanged(file);
 				}
-				else
+			}
+		}
+	}
+
+	void FolderMonitor::runPolling()
+	{
+		ZTRACE_RUNTIME("Polling folder every %lu seconds", delay);
+		while (!stopped)
+		{
+			// Wait for "delay" seconds
+			QThread::sleep(delay);
+			scanFolder();
+		}
+	}
+
+	//
+	// A file has been completely written (or has not changed for settleTime): report it as new or modified.
+	//
+	void FolderMonitor::fileWritten(const fs::path& file)
+	{
+		writing_.erase(file);
+
+		std::error_code ec;
+		if (!fs::is_regular_file(file, ec))
+			return;
+		const auto lastWriteTime = fs::last_write_time(file, ec);
+		if (ec)
+			return;
+
+		const auto it = paths_.find(file);
+		if (it == paths_.end())
+		{
+			paths_[file] = lastWriteTime;
+			emit fileCreated(file);
+		}
+		else if (it->second != lastWriteTime)
+		{
+			it->second = lastWriteTime;
+			emit fileChanged(file);
+		}
+	}
+
+	void FolderMonitor::fileRemoved(const fs::path& file)
+	{
+		writing_.erase(file);
+		if (paths_.erase(file) != 0)
+			emit fileErased(file);
+	}
+
+#if defined(Q_OS_LINUX)
+	//
+	// Wait for inotify events instead of scanning the folder every few seconds.
+	// New files are reported as soon as the writer closes them (or moves them into the folder).
+	// Returns false if notifications are not available (or stop working), the caller then polls the folder.
+	//
+	bool FolderMonitor::runNotified()
+	{
+		const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0)
+		{
+			ZTRACE_RUNTIME("inotify_init1 failed (errno %d)", errno);
+			return false;
+		}
+		const fs::path folder{ folderToWatch };
+		const int wd = inotify_add_watch(fd, folder.c_str(),
+			IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF);
+		if (wd < 0)
+		{
+			ZTRACE_RUNTIME("inotify_add_watch failed for %s (errno %d)", folder.generic_u8string().c_str(), errno);
+			close(fd);
+			return false;
+		}
+
+		ZTRACE_RUNTIME("Watching folder %s with inotify", folder.generic_u8string().c_str());
+		//
+		// Files which were created between the constructor and now.
+		//
+		scanFolder();
+
+		alignas(inotify_event) char buffer[64 * 1024];
+		bool watching{ true };
+		while (!stopped && watching)
+		{
+			pollfd pfd{ fd, POLLIN, 0 };
+			const int ready = poll(&pfd, 1, 250); // Check "stopped" at least 4 times a second.
+			if (ready < 0 && errno != EINTR)
+				break;
+
+			if (ready > 0)
+			{
+				for (;;)
 				{
-					// File modification
-					if (paths_[file] != current_file_last_write_time)
+					const ssize_t length = read(fd, buffer, sizeof(buffer));
+					if (length <= 0)
+						break;
+
+					for (const char* p = buffer; p < buffer + length; )
 					{
-						paths_[file] = current_file_last_write_time;
-						emit fileChanged(file);
+						const inotify_event* const event = reinterpret_cast<const inotify_event*>(p);
+						p += sizeof(inotify_event) + event->len;
+
+						if ((event->mask & IN_Q_OVERFLOW) != 0)
+						{
+							// Events were lost: compare the folder with what we know.
+							ZTRACE_RUNTIME("inotify queue overflow, rescanning folder");
+							scanFolder();
+							continue;
+						}
+						if ((event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) != 0)
+						{
+							watching = false;
+							continue;
+						}
+						if (event->len == 0 || (event->mask & IN_ISDIR) != 0)
+							continue;
+
+						const fs::path file{ folder / event->name };
+						if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+							fileRemoved(file);
+						else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0)
+							fileWritten(file);
+						else if ((event->mask & (IN_CREATE | IN_MODIFY)) != 0)
+							writing_[file] = chr::steady_clock::now();
 					}
 				}
 			}
+
+			//
+			// Report the files that are still open for writing, but have not changed for a while.
+			//
+			const auto now = chr::steady_clock::now();
+			std::vector<fs::path> settled;
+			for (const auto& [file, lastEvent] : writing_)
+				if (now - lastEvent >= settleTime)
+					settled.push_back(file);
+			for (const auto& file : settled)
+				fileWritten(file);
 		}
+
+		close(fd);
+		if (stopped)
+			return true;
+
+		ZTRACE_RUNTIME("inotify watch ended, falling back to polling");
+		return false;
+	}
+#else
+	bool FolderMonitor::runNotified()
+	{
+		return false;
 	}
+#endif
 
 	void FolderMonitor::stop()
 	{
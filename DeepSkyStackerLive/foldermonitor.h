@@ -62,11 +62,24 @@ namespace DSS
 		void stop();
 
 	private:
+		//
+		// With change notifications a file is normally reported when the writer closes it.
+		// Files that are written to but not closed are reported once they have not changed for this time.
+		//
+		static constexpr chr::milliseconds settleTime{ 2000 };
+
 		volatile bool stopped;
 		unsigned long delay;
 		std::u16string folderToWatch;
 		std::unordered_map<fs::path, fs::file_time_type> paths_;
 		std::vector<fs::path> existing_;
+		std::unordered_map<fs::path, chr::steady_clock::time_point> writing_;
+
+		void scanFolder();
+		void runPolling();
+		bool runNotified();
+		void fileWritten(const fs::path& file);
+		void fileRemoved(const fs::path& file);
 
 	signals:
 		void existingFiles(const std::vector<fs::path>&);
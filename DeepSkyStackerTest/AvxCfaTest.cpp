@@ -256,11 +256,6 @@ TEST_CASE("AVX CFA", "[AVX][CFA]")
 bool CMultitask::GetUseSimd() { return true; }
 int CMultitask::GetNrCurrentOmpThreads() { return 1; } // Placeholder!!!
 
-void CMultiBitmap::removeTempFiles() {}
-void CMultiBitmap::SetBitmapModel(const CMemoryBitmap*) {}
-bool CMultiBitmap::AddBitmap(CMemoryBitmap*, ProgressBase*) { return true; }
-std::shared_ptr<CMemoryBitmap> CMultiBitmap::GetResult(ProgressBase*) { return std::shared_ptr<CMemoryBitmap>{}; }
-
 //void CYMGToRGB(double, double, double, double, double&, double&, double&) {}
 std::shared_ptr<CMemoryBitmap> CreateBitmap(const CBitmapCharacteristics&) { return std::shared_ptr<CMemoryBitmap>{}; }
 // std::shared_ptr<CMemoryBitmap> CGrayMedianFilterEngineT<unsigned short>::GetFilteredImage(int, class ProgressBase*) const { return std::shared_ptr<CMemoryBitmap>{}; }
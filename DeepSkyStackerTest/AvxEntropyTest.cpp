@@ -4,6 +4,9 @@
 #include "ColorBitmap.h"
 #include "Multitask.h"
 #include "AvxEntropyTest.h"
+#include "TestMultitask.h"
+#include "avx_simd_check.h"
+#include "GrayBitmap.h"
 
 std::tuple<float, float> calcEntropy(const std::vector<int>& incidences)
 {
@@ -249,7 +252,199 @@ TEST_CASE("AVX Entropy", "[AVX][Entropy]")
 	}
 }
 
-int CMultitask::GetNrProcessors(bool) { return 1; }
+namespace
+{
+	// Resets the level limit, even if a REQUIRE fails.
+	struct SimdLevelGuard
+	{
+		~SimdLevelGuard() { AvxSimdCheck::limitSimdLevel(AvxSimdCheck::SimdLevel::Avx512); }
+	};
+
+	// The square entropies as CEntropyInfo::ComputeEntropies() computed them from GetPixel16() before the typed pixel access.
+	std::array<std::vector<float>, 3> getPixel16Entropies(const CMemoryBitmap& bitmap, const int windowSize)
+	{
+		const int squareSize = 2 * windowSize + 1;
+		const int nrSquaresX = (bitmap.Width() + squareSize - 1) / squareSize;
+		const int nrSquaresY = (bitmap.Height() + squareSize - 1) / squareSize;
+		std::array<std::vector<float>, 3> entropies;
+		for (auto& channelEntropies : entropies)
+			channelEntropies.resize(static_cast<size_t>(nrSquaresX) * nrSquaresY);
+
+		for (int i = 0; i < nrSquaresX; i++)
+			for (int j = 0; j < nrSquaresY; j++)
+			{
+				const int lMinX = i * squareSize;
+				const int lMaxX = std::min((i + 1) * squareSize - 1, bitmap.Width() - 1);
+				const int lMinY = j * squareSize;
+				const int lMaxY = std::min((j + 1) * squareSize - 1, bitmap.Height() - 1);
+
+				std::vector<std::uint16_t> vRedHisto(65536), vGreenHisto(65536), vBlueHisto(65536);
+				COLORREF16 crColor;
+				for (int x = lMinX; x <= lMaxX; x++)
+					for (int y = lMinY; y <= lMaxY; y++)
+					{
+						bitmap.GetPixel16(x, y, crColor);
+						vRedHisto[crColor.red]++;
+						vGreenHisto[crColor.green]++;
+						vBlueHisto[crColor.blue]++;
+					}
+
+				const double lNrPixels = static_cast<double>(lMaxX - lMinX + 1) * static_cast<double>(lMaxY - lMinY + 1);
+				double fRedEntropy = 0.0, fGreenEntropy = 0.0, fBlueEntropy = 0.0;
+				for (int x = lMinX; x <= lMaxX; x++)
+					for (int y = lMinY; y <= lMaxY; y++)
+					{
+						bitmap.GetPixel16(x, y, crColor);
+						const double qRed = static_cast<double>(vRedHisto[crColor.red]) / lNrPixels;
+						const double qGreen = static_cast<double>(vGreenHisto[crColor.green]) / lNrPixels;
+						const double qBlue = static_cast<double>(vBlueHisto[crColor.blue]) / lNrPixels;
+						fRedEntropy += -qRed * log(qRed) / log(2.0);
+						fGreenEntropy += -qGreen * log(qGreen) / log(2.0);
+						fBlueEntropy += -qBlue * log(qBlue) / log(2.0);
+					}
+
+				entropies[0][i + j * nrSquaresX] = static_cast<float>(fRedEntropy);
+				entropies[1][i + j * nrSquaresX] = static_cast<float>(fGreenEntropy);
+				entropies[2][i + j * nrSquaresX] = static_cast<float>(fBlueEntropy);
+			}
+		return entropies;
+	}
+
+	void checkGetPixel16Entropies(const std::shared_ptr<CMemoryBitmap>& pBitmap, const int windowSize)
+	{
+		CEntropyInfo entropyInfo;
+		{
+			NrProcessorsGuard guard{ 4 };
+			entropyInfo.Init(pBitmap, windowSize, nullptr);
+		}
+		const auto [red, green, blue] = getPixel16Entropies(*pBitmap, windowSize);
+		const size_t nrSquares = static_cast<size_t>(entropyInfo.nrSquaresX()) * entropyInfo.nrSquaresY();
+		REQUIRE(nrSquares == red.size());
+		REQUIRE(std::equal(red.cbegin(), red.cend(), entropyInfo.redEntropyData()));
+		REQUIRE(std::equal(green.cbegin(), green.cend(), entropyInfo.greenEntropyData()));
+		REQUIRE(std::equal(blue.cbegin(), blue.cend(), entropyInfo.blueEntropyData()));
+	}
+
+	// Values with repetitions in the squares, so that the entropies are not all the same.
+	std::uint16_t testValue(const int n, const int channel)
+	{
+		return static_cast<std::uint16_t>(((n * 7919 + channel * 104729) % 1013) * 61);
+	}
+}
+
+TEST_CASE("Entropy row weights", "[Entropy]")
+{
+	// The typed pixel access and the row entropies are in the generic (non AVX) path.
+	SimdLevelGuard simdGuard;
+	AvxSimdCheck::limitSimdLevel(AvxSimdCheck::SimdLevel::Generic);
+
+	SECTION("Row entropies are the entropies of GetPixel")
+	{
+		constexpr int W = 67;
+		constexpr int H = 45;
+		std::shared_ptr<CMemoryBitmap> pBitmap = std::make_shared<CGrayBitmapT<std::uint16_t>>();
+		REQUIRE(pBitmap->Init(W, H) == true);
+
+		TestEntropyInfo entropyInfo;
+		entropyInfo.Init(pBitmap, 10, nullptr);
+
+		std::vector<double> redEntropies(W), greenEntropies(W), blueEntropies(W);
+		for (int y = 0; y < H; ++y)
+		{
+			entropyInfo.GetRowEntropies(0, y, W, redEntropies.data(), greenEntropies.data(), blueEntropies.data());
+			for (int x = 0; x < W; ++x)
+			{
+				double fRed, fGreen, fBlue;
+				COLORREF16 crColor;
+				entropyInfo.GetPixel(x, y, fRed, fGreen, fBlue, crColor);
+				REQUIRE(redEntropies[x] == fRed);
+				REQUIRE(greenEntropies[x] == fGreen);
+				REQUIRE(blueEntropies[x] == fBlue);
+			}
+		}
+	}
+
+	SECTION("Square entropies of a typed gray bitmap equal those of its color copy")
+	{
+		constexpr int windowSize = 10;
+		constexpr int W = 100;
+		constexpr int H = 50;
+		std::shared_ptr<CMemoryBitmap> pGrayBitmap = std::make_shared<CGrayBitmapT<float>>();
+		std::shared_ptr<CMemoryBitmap> pColorBitmap = std::make_shared<CColorBitmapT<float>>();
+		REQUIRE(pGrayBitmap->Init(W, H) == true);
+		REQUIRE(pColorBitmap->Init(W, H) == true);
+
+		auto* pGray = dynamic_cast<CGrayBitmapT<float>*>(pGrayBitmap.get());
+		auto* pColor = dynamic_cast<CColorBitmapT<float>*>(pColorBitmap.get());
+		for (int n = 0; n < W * H; ++n)
+		{
+			const float value = static_cast<float>((n * 7919) % 1013) * 11.5f;
+			pGray->m_vPixels[n] = pColor->m_Red.m_vPixels[n] = pColor->m_Green.m_vPixels[n] = pColor->m_Blue.m_vPixels[n] = value;
+		}
+
+		CEntropyInfo grayEntropy;
+		grayEntropy.Init(pGrayBitmap, windowSize, nullptr);
+		CEntropyInfo colorEntropy;
+		colorEntropy.Init(pColorBitmap, windowSize, nullptr);
+
+		const size_t nrSquares = static_cast<size_t>(grayEntropy.nrSquaresX()) * grayEntropy.nrSquaresY();
+		REQUIRE(nrSquares == static_cast<size_t>(colorEntropy.nrSquaresX()) * colorEntropy.nrSquaresY());
+		REQUIRE(memcmp(grayEntropy.redEntropyData(), colorEntropy.redEntropyData(), nrSquares * sizeof(float)) == 0);
+		REQUIRE(memcmp(grayEntropy.greenEntropyData(), colorEntropy.greenEntropyData(), nrSquares * sizeof(float)) == 0);
+		REQUIRE(memcmp(grayEntropy.blueEntropyData(), colorEntropy.blueEntropyData(), nrSquares * sizeof(float)) == 0);
+	}
+
+	SECTION("Square entropies are those of GetPixel16()")
+	{
+		constexpr int windowSize = 10;
+		constexpr int W = 67; // Partial squares at the right and at the bottom.
+		constexpr int H = 45;
+
+		SECTION("16 bit gray")
+		{
+			auto pGray = std::make_shared<CGrayBitmapT<std::uint16_t>>();
+			REQUIRE(pGray->Init(W, H) == true);
+			for (int n = 0; n < W * H; ++n)
+				pGray->m_vPixels[n] = testValue(n, 0);
+			checkGetPixel16Entropies(pGray, windowSize);
+		}
+
+		SECTION("16 bit CFA gray")
+		{
+			auto pGray = std::make_shared<CGrayBitmapT<std::uint16_t>>();
+			REQUIRE(pGray->Init(W, H) == true);
+			pGray->SetCFA(true);
+			pGray->UseBilinear(true);
+			pGray->SetCFAType(CFATYPE_RGGB);
+			for (int n = 0; n < W * H; ++n)
+				pGray->m_vPixels[n] = testValue(n, 0);
+			checkGetPixel16Entropies(pGray, windowSize);
+		}
+
+		SECTION("16 bit colour")
+		{
+			auto pColor = std::make_shared<CColorBitmapT<std::uint16_t>>();
+			REQUIRE(pColor->Init(W, H) == true);
+			for (int n = 0; n < W * H; ++n)
+			{
+				pColor->m_Red.m_vPixels[n] = testValue(n, 0);
+				pColor->m_Green.m_vPixels[n] = testValue(n, 1);
+				pColor->m_Blue.m_vPixels[n] = testValue(n, 2);
+			}
+			checkGetPixel16Entropies(pColor, windowSize);
+		}
+	}
+}
+
+int testNrProcessors = 1;
+int CMultitask::GetNrProcessors(bool) { return testNrProcessors; }
+// The prefetchers of the kernel read these settings, the test program uses the defaults without QSettings.
+int CMultitask::GetMaxPrefetchedFrames() { return 1; }
+std::uint64_t CMultitask::GetPrefetchMemoryLimit() { return std::uint64_t{ 2048 } * 1024 * 1024; }
+// The cache of the master frames reads this setting, the tests build their own caches with a memory budget.
+std::uint64_t CMultitask::GetMasterCacheMemoryLimit() { return std::uint64_t{ 512 } * 1024 * 1024; }
+// The tests build their own master libraries with a size budget.
+std::uint64_t CMultitask::GetMasterLibrarySizeLimit() { return std::uint64_t{ 4096 } * 1024 * 1024; }
 
  void TestEntropyInfo::InitSquareEntropies()
  {
@@ -296,6 +296,46 @@ TEST_CASE("AVX Histogram", "[AVX][Histogram]")
 		REQUIRE(memcmp(blueHisto.data(), expected.data(), 65536 * sizeof(int)) == 0);
 	}
 }
+
+TEST_CASE("Histogram bins", "[Histogram]")
+{
+	SECTION("Merged bins give the same histogram as the single values")
+	{
+		const std::vector<double> values{ 0.5, 1.0, 7.25, 7.5, 100.0, 254.9, 255.0, 3.0, 7.3 };
+		DSS::Histogram expected;
+		DSS::Histogram merged;
+		expected.SetSize(255.0, 1000);
+		merged.SetSize(255.0, 1000);
+
+		// Two "threads", each with its own bins.
+		for (size_t part = 0; part < 2; part++)
+		{
+			std::vector<std::uint32_t> counts(merged.GetNrValues(), 0);
+			double sum = 0, sumOfSquares = 0, minimum = -1, maximum = 0;
+			for (size_t i = part; i < values.size(); i += 2)
+			{
+				const double value = values[i];
+				expected.AddValue(value);
+				++counts[static_cast<int>(value / merged.GetStep())];
+				sum += value;
+				sumOfSquares += value * value;
+				maximum = std::max(maximum, value);
+				minimum = minimum < 0 ? value : std::min(minimum, value);
+			}
+			merged.AddBins(counts, sum, sumOfSquares, minimum, maximum);
+		}
+
+		for (int i = 0; i < expected.GetNrValues(); i++)
+			REQUIRE(merged.GetValue(i) == expected.GetValue(i));
+		REQUIRE(merged.GetMaximumNrValues() == expected.GetMaximumNrValues());
+		REQUIRE(merged.GetMin() == expected.GetMin());
+		REQUIRE(merged.GetMax() == expected.GetMax());
+		REQUIRE(merged.GetAverage() == Approx(expected.GetAverage()));
+		REQUIRE(merged.GetStdDeviation() == Approx(expected.GetStdDeviation()));
+		REQUIRE(merged.GetMedian() == expected.GetMedian());
+	}
+}
+
 // 
 // namespace DSS { class ProgressBase; }
 // void CGrayBitmapT<float>::RemoveHotPixels(DSS::ProgressBase*) {}
@@ -490,6 +490,60 @@ TEST_CASE("AVX Stacking, Entropy", "[AVX][Stacking][Entropy]")
 	}
 }
 
+TEST_CASE("AVX Stacking, drizzle in bands", "[AVX][Stacking][Drizzle]")
+{
+	SECTION("Bands give the same pixels as the whole result")
+	{
+		constexpr int W = 61;
+		constexpr int H = 47;
+		constexpr int PixelSize = 2;
+		constexpr int RW = W * PixelSize;
+		constexpr int RH = H * PixelSize;
+		constexpr int BandHeight = 30;
+		typedef float T;
+
+		DSSRect rect(0, 0, RW, RH); // left, top, right, bottom
+
+		std::shared_ptr<CMemoryBitmap> pBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pBitmap->Init(W, H) == true);
+		auto* pGray = dynamic_cast<CGrayBitmapT<T>*>(pBitmap.get());
+		for (int i = 0; i < W * H; ++i)
+			pGray->m_vPixels[i] = static_cast<T>(i % 997);
+
+		std::shared_ptr<CMemoryBitmap> pTempBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pTempBitmap->Init(RW, RH) == true);
+
+		CEntropyInfo entropyInfo;
+		entropyInfo.Init(pBitmap, 10, nullptr);
+		AvxEntropy avxEntropy(*pBitmap, entropyInfo, nullptr);
+
+		CPixelTransform pixTransform;
+		pixTransform.SetShift(3.3, -5.7);
+		pixTransform.SetPixelSizeMultiplier(PixelSize);
+		CTaskInfo taskInfo;
+		CBackgroundCalibration backgroundCalib;
+		backgroundCalib.SetMode(BCM_NONE, BCI_LINEAR, RBCM_MAXIMUM);
+
+		AvxStacking avxStacking(0, H, *pBitmap, *pTempBitmap, rect, avxEntropy);
+		REQUIRE(avxStacking.stack(pixTransform, taskInfo, backgroundCalib, std::shared_ptr<CMemoryBitmap>{}, PixelSize) == 0);
+		const auto* pFull = dynamic_cast<CGrayBitmapT<T>*>(pTempBitmap.get());
+
+		for (int top = 0; top < RH; top += BandHeight)
+		{
+			const int rows = std::min(BandHeight, RH - top);
+			std::shared_ptr<CMemoryBitmap> pBandBitmap = std::make_shared<CGrayBitmapT<T>>();
+			REQUIRE(pBandBitmap->Init(RW, rows) == true);
+
+			AvxStacking bandStacking(0, H, *pBitmap, *pBandBitmap, rect, avxEntropy);
+			bandStacking.setWindow(DSSRect(0, top, RW, top + rows));
+			REQUIRE(bandStacking.stack(pixTransform, taskInfo, backgroundCalib, std::shared_ptr<CMemoryBitmap>{}, PixelSize) == 0);
+
+			const auto* pBand = dynamic_cast<CGrayBitmapT<T>*>(pBandBitmap.get());
+			REQUIRE(memcmp(pBand->m_vPixels.data(), pFull->m_vPixels.data() + static_cast<size_t>(top) * RW, static_cast<size_t>(rows) * RW * sizeof(T)) == 0);
+		}
+	}
+}
+
 CBackgroundCalibration::CBackgroundCalibration() :
 	m_bInitOk{ false },
 	m_fMultiplier{ 1.0 },
@@ -0,0 +1,372 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "DeBloom.h"
+#include "GrayBitmap.h"
+#include "DSSTools.h"
+#include "TestMultitask.h"
+
+namespace
+{
+	constexpr int Width = 160;
+	constexpr int Height = 120;
+
+	//
+	// Background noise and 40 saturated vertical streaks with gaussian borders. The streaks are dense enough to touch
+	// each other: with these seeds some bloomed stars share the pixels of their one pixel expansion and are deBloomed
+	// in the same group. The values only come from the engine (the std distributions differ between libraries).
+	//
+	std::shared_ptr<C16BitGrayBitmap> makeBloomedImage(const unsigned seed)
+	{
+		std::mt19937 generator{ seed };
+		const auto draw = [&generator](const int first, const int last)
+		{
+			return first + static_cast<int>(generator() % static_cast<unsigned>(last - first + 1));
+		};
+
+		auto pBitmap = std::make_shared<C16BitGrayBitmap>();
+		pBitmap->Init(Width, Height);
+		for (auto& value : pBitmap->m_vPixels)
+			value = static_cast<std::uint16_t>(draw(2700, 3300));
+
+		for (int star = 0; star < 40; star++)
+		{
+			const int centerX = draw(3, Width - 4);
+			const int top = draw(3, Height - 4);
+			const int halfWidth = draw(0, 3);
+			const int bottom = std::min(Height - 1, top + draw(3, 30));
+			const double sigma = draw(3, 15) / 10.0;
+			for (int j = std::max(0, top - 8); j < std::min(Height, bottom + 9); j++)
+				for (int i = std::max(0, centerX - halfWidth - 8); i < std::min(Width, centerX + halfWidth + 9); i++)
+				{
+					const double dy = j < top ? top - j : (j > bottom ? j - bottom : 0);
+					const double dx = std::max(0, std::abs(i - centerX) - halfWidth);
+					const double value = 65535.0 * std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+					std::uint16_t& pixel = pBitmap->m_vPixels[static_cast<size_t>(j) * Width + i];
+					pixel = static_cast<std::uint16_t>(std::clamp(pixel + value, 0.0, 65535.0));
+				}
+		}
+		return pBitmap;
+	}
+
+	std::vector<std::uint16_t> deBloom(const C16BitGrayBitmap& image)
+	{
+		const std::unique_ptr<CMemoryBitmap> pBitmap = image.Clone();
+		CDeBloom deBloom;
+		deBloom.CreateBloomMask(pBitmap.get(), nullptr);
+		deBloom.DeBloomImage(pBitmap.get(), nullptr);
+		return dynamic_cast<const C16BitGrayBitmap&>(*pBitmap).m_vPixels;
+	}
+
+	bool isBloomedValue(const double fValue)
+	{
+		return fValue > 200.0;
+	}
+
+	bool isBloomedBorderValue(const double fValue)
+	{
+		return (fValue < 150.0) && (fValue > 0.0);
+	}
+
+	double distance(const double x1, const double y1, const double x2, const double y2)
+	{
+		return sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+	}
+
+	//
+	// The former deBlooming, serial and over the virtual GetPixel()/SetPixel() of the bitmap and of the mask.
+	// Only the star centres come from the current code: they are computed before any pixel is written.
+	//
+	class FormerDeBloom : public CDeBloom
+	{
+	private:
+		static double interpolatePixelValue(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask, const QPointF pt)
+		{
+			const int x0 = floor(pt.x() - 0.5), x1 = 1 + x0;
+			const int y0 = floor(pt.y() - 0.5), y1 = 1 + y0;
+			const int width = pBitmap->Width();
+			const int height = pBitmap->Height();
+
+			const double fd00 = distance(x0 + 0.5, y0 + 0.5, pt.x(), pt.y());
+			const double fd10 = distance(x0 + 1.5, y0 + 0.5, pt.x(), pt.y());
+			const double fd01 = distance(x0 + 0.5, y0 + 1.5, pt.x(), pt.y());
+			const double fd11 = distance(x0 + 1.5, y0 + 1.5, pt.x(), pt.y());
+			double fv00 = -1.0, fv10 = -1.0, fv01 = -1.0, fv11 = -1.0;
+			double fMask = -1.0;
+
+			const auto read = [pBitmap, pMask, width, height, &fMask](const int x, const int y, double& fValue)
+			{
+				if (x >= 0 && x < (width - 1) && y >= 0 && y < (height - 1))
+				{
+					pMask->GetPixel(x, y, fMask);
+					if (!isBloomedValue(fMask))
+						pBitmap->GetPixel(x, y, fValue);
+				}
+			};
+			read(x0, y0, fv00);
+			read(x0, y1, fv01);
+			read(x1, y0, fv10);
+			read(x1, y1, fv11);
+
+			double fWeight = 0, fSum = 0;
+			for (const auto [fv, fd] : { std::pair{ fv00, fd00 }, std::pair{ fv10, fd10 }, std::pair{ fv01, fd01 }, std::pair{ fv11, fd11 } })
+			{
+				if (fv >= 0)
+				{
+					fWeight += 1.5 - fd;
+					fSum += (1.5 - fd) * fv;
+				}
+			}
+
+			// Always called with bNoBloom: bloomed neighbours don't invalidate the value.
+			return fWeight == 0 ? -1.0 : fSum / fWeight;
+		}
+
+		double computeValue(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask, const int x, const int y, bool& bDone) const
+		{
+			double fResult = 255.0;
+			double fSum = 0, fWeight = 0;
+			bDone = false;
+
+			for (int i = std::max(0, x - 5); i <= std::min(m_lWidth - 1, x + 5); i++)
+			{
+				for (int j = std::max(0, y - 3); j <= std::min(m_lHeight - 1, y + 3); j++)
+				{
+					double fValue, fMask;
+					pMask->GetPixel(i, j, fMask);
+					if (!isBloomedValue(fMask) && !isBloomedBorderValue(fMask))
+					{
+						const double fDistance = 1.0 / (1.0 + (double)fabs((double)i - x) + (j - y) * (j - y));
+						pBitmap->GetPixel(i, j, fValue);
+						fSum += fValue * fDistance;
+						fWeight += fDistance;
+					}
+				}
+			}
+
+			if (fWeight)
+			{
+				fResult = fSum / fWeight;
+				bDone = true;
+			}
+			return fResult;
+		}
+
+		void addStar(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask, const CBloomedStar& bs) const
+		{
+			for (const QPoint& point : bs.m_vBloomed)
+			{
+				double fMask;
+				pMask->GetPixel(point.x(), point.y(), fMask);
+				if (!isBloomedValue(fMask))
+					continue;
+
+				const QPointF pt(point.x() + 0.5, point.y() + 0.5);
+				const double fDistance = distance(pt.x(), pt.y(), bs.m_ptStar.x(), bs.m_ptStar.y());
+				const double fValue3 = interpolatePixelValue(pBitmap, pMask, QPointF(bs.m_ptStar.x() - fDistance, bs.m_ptStar.y()));
+				const double fValue4 = interpolatePixelValue(pBitmap, pMask, QPointF(bs.m_ptStar.x() + fDistance, bs.m_ptStar.y()));
+
+				double fAverage = -1.0;
+				if (fValue3 > 0 && fValue4 > 0)
+					fAverage = std::min(fValue3, fValue4);
+				else if (fValue3 > 0)
+					fAverage = fValue3;
+				else if (fValue4 > 0)
+					fAverage = fValue4;
+
+				double fBloomValue = 0.0;
+				double fBloomWeight = 0.0;
+				for (const CBloomInfo& bloom : bs.m_vBlooms)
+				{
+					const double fBloomDistance = distance(pt.x(), pt.y(), bloom.m_ptRef.x(), bloom.m_ptRef.y());
+					fBloomWeight += 1.0 / (fBloomDistance + 1.0);
+
+					const double fFactor1 = 2.0 * pow(bloom.m_fRadius, 2);
+					fBloomValue += (m_fBackground + exp(-(fDistance * fDistance) / fFactor1) * bloom.m_fBloom) / (fBloomDistance + 1.0);
+				}
+				if (fBloomWeight)
+					fBloomValue /= fBloomWeight;
+
+				double fBaseValue;
+				pBitmap->GetPixel(point.x(), point.y(), fBaseValue);
+
+				double fValue = fBaseValue;
+				if (fAverage > 0 && fBloomValue > 0)
+					fBloomValue = std::min(fAverage, fBloomValue);
+				if (fBloomValue)
+					fValue = std::max(fBaseValue, fBloomValue);
+
+				pBitmap->SetPixel(point.x(), point.y(), std::min(255.0, fValue));
+			}
+		}
+
+		void smoothMaskBorders(CMemoryBitmap* pBitmap, C8BitGrayBitmap* pMask) const
+		{
+			std::vector<double> vValues(8);
+
+			for (int i = 1; i < m_lWidth - 1; i++)
+			{
+				for (int j = 1; j < m_lHeight - 1; j++)
+				{
+					double fMask;
+					pMask->GetPixel(i, j, fMask);
+					if (isBloomedBorderValue(fMask))
+					{
+						pBitmap->GetPixel(i - 1, j - 1, vValues[0]);
+						pBitmap->GetPixel(i - 0, j - 1, vValues[1]);
+						pBitmap->GetPixel(i + 1, j - 1, vValues[2]);
+						pBitmap->GetPixel(i - 1, j - 0, vValues[3]);
+						pBitmap->GetPixel(i + 1, j - 0, vValues[4]);
+						pBitmap->GetPixel(i - 1, j + 1, vValues[5]);
+						pBitmap->GetPixel(i - 0, j + 1, vValues[6]);
+						pBitmap->GetPixel(i + 1, j + 1, vValues[7]);
+						pBitmap->SetPixel(i, j, Median(vValues));
+					}
+				}
+			}
+		}
+
+	public:
+		void deBloomImage(CMemoryBitmap* pBitmap)
+		{
+			REQUIRE(static_cast<bool>(m_pMask));
+			C8BitGrayBitmap* pMask = m_pMask.get();
+			m_fBackground = ComputeBackgroundValue(pBitmap);
+
+			{
+				const CDeBloomPixels pixels{ pBitmap, pMask };
+				std::vector<double> vYCenters;
+				for (CBloomedStar& bs : m_vBloomedStars)
+					ComputeStarCenter(pixels, bs, vYCenters);
+			}
+
+			std::vector<QPoint> vUnprocessed;
+			std::vector<QPoint> vProcessed;
+
+			for (int i = 0; i < m_lWidth; i++)
+			{
+				for (int j = 0; j < m_lHeight; j++)
+				{
+					double fMask;
+					pMask->GetPixel(i, j, fMask);
+					if (isBloomedValue(fMask))
+					{
+						bool bDone;
+						const double fValue = computeValue(pBitmap, pMask, i, j, bDone);
+						if (bDone)
+						{
+							pBitmap->SetPixel(i, j, fValue);
+							vProcessed.emplace_back(i, j);
+						}
+						else
+							vUnprocessed.emplace_back(i, j);
+					}
+				}
+			}
+
+			size_t nrUnprocessed = 0;
+			if (!vUnprocessed.empty())
+			{
+				std::vector<QPoint> vNewlyProcessed = vProcessed;
+
+				while (!vUnprocessed.empty() && vUnprocessed.size() != nrUnprocessed)
+				{
+					for (const QPoint& point : vNewlyProcessed)
+						pMask->SetPixel(point.x(), point.y(), 190.0);
+					vNewlyProcessed.clear();
+
+					nrUnprocessed = vUnprocessed.size();
+					const std::vector<QPoint> vToProcess = std::move(vUnprocessed);
+					vUnprocessed.clear();
+
+					for (const QPoint& point : vToProcess)
+					{
+						bool bDone;
+						const double fValue = computeValue(pBitmap, pMask, point.x(), point.y(), bDone);
+						if (bDone)
+						{
+							pBitmap->SetPixel(point.x(), point.y(), fValue);
+							vProcessed.push_back(point);
+							vNewlyProcessed.push_back(point);
+						}
+						else
+							vUnprocessed.push_back(point);
+					}
+				}
+
+				for (const QPoint& point : vProcessed)
+					pMask->SetPixel(point.x(), point.y(), 255.0);
+			}
+
+			for (const CBloomedStar& bs : m_vBloomedStars)
+				addStar(pBitmap, pMask, bs);
+
+			smoothMaskBorders(pBitmap, pMask);
+		}
+	};
+
+	std::vector<std::uint16_t> formerDeBloom(const C16BitGrayBitmap& image)
+	{
+		const std::unique_ptr<CMemoryBitmap> pBitmap = image.Clone();
+		FormerDeBloom deBloom;
+		deBloom.CreateBloomMask(pBitmap.get(), nullptr);
+		deBloom.deBloomImage(pBitmap.get());
+		return dynamic_cast<const C16BitGrayBitmap&>(*pBitmap).m_vPixels;
+	}
+}
+
+TEST_CASE("DeBloom", "[DeBloom]")
+{
+	SECTION("The parallel deBlooming gives the serial result")
+	{
+		const int nrThreads = omp_get_max_threads();
+		for (const unsigned seed : { 1, 2, 3, 8, 19 })
+		{
+			CAPTURE(seed);
+			const auto pImage = makeBloomedImage(seed);
+
+			const std::vector<std::uint16_t> serial = deBloom(*pImage);
+			REQUIRE(serial != pImage->m_vPixels);
+
+			// The star centres, the passes of ComputeValues() and the groups of AddStar() run in parallel.
+			std::vector<std::uint16_t> parallel;
+			{
+				NrProcessorsGuard guard{ 4 };
+				omp_set_num_threads(std::max(4, nrThreads));
+				parallel = deBloom(*pImage);
+				omp_set_num_threads(nrThreads);
+			}
+			REQUIRE(parallel == serial);
+		}
+	}
+
+	SECTION("The typed pixel access gives the result of the former GetPixel()/SetPixel() code")
+	{
+		for (const unsigned seed : { 1, 2, 3, 8, 19 })
+		{
+			CAPTURE(seed);
+			const auto pImage = makeBloomedImage(seed);
+			const std::vector<std::uint16_t> former = formerDeBloom(*pImage);
+			REQUIRE(former != pImage->m_vPixels);
+			REQUIRE(deBloom(*pImage) == former);
+		}
+	}
+
+	SECTION("The mask values are limited to 8 bits")
+	{
+		C16BitGrayBitmap bitmap;
+		bitmap.Init(4, 1);
+		C8BitGrayBitmap mask;
+		mask.Init(4, 1);
+		CDeBloomPixels pixels{ &bitmap, &mask };
+
+		pixels.SetMask(0, 0, 300.0);
+		pixels.SetMask(1, 0, -20.0);
+		pixels.SetMask(2, 0, 140.7);
+		pixels.SetMask(3, 0, 255.0);
+		REQUIRE(pixels.GetMask(0, 0) == 255.0);
+		REQUIRE(pixels.GetMask(1, 0) == 0.0);
+		REQUIRE(pixels.GetMask(2, 0) == 140.0);
+		REQUIRE(pixels.GetMask(3, 0) == 255.0);
+	}
+}
@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include <numbers>
+#include "catch.h"
+#include "StackingEngine.h"
+#include "PixelTransform.h"
+#include "ColorBitmap.h"
+#include "TestMultitask.h"
+
+namespace
+{
+	constexpr int Width = 83; // Several bands of 30 and 17 lines, with partial ones.
+	constexpr int Height = 71;
+
+	CPixelTransform makeTransform(const double dx, const double dy, const double degrees, const bool bisquared, const int multiplier)
+	{
+		const double angle = degrees * std::numbers::pi / 180.0;
+		CBilinearParameters parameters;
+		parameters.a0 = dx;
+		parameters.a1 = std::cos(angle);
+		parameters.a2 = -std::sin(angle);
+		parameters.b0 = dy;
+		parameters.b1 = std::sin(angle);
+		parameters.b2 = std::cos(angle);
+		if (bisquared)
+		{
+			parameters.Type = TT_BISQUARED;
+			parameters.a4 = 2e-4;
+			parameters.b5 = -3e-4;
+		}
+		CPixelTransform transform{ parameters };
+		transform.SetPixelSizeMultiplier(multiplier);
+		return transform;
+	}
+
+	// Small shift, rotation across several bands and a bisquared transform.
+	std::array<CPixelTransform, 3> makeTransforms(const int multiplier)
+	{
+		return {
+			makeTransform(0.37, -1.6, 0.0, false, multiplier),
+			makeTransform(-2.25, 3.5, 4.0, false, multiplier),
+			makeTransform(1.1, 0.6, -2.5, true, multiplier)
+		};
+	}
+
+	// The result lines [first, last] that the pixels of each bitmap line are dispatched to (first > last if none).
+	std::vector<std::pair<int, int>> dispatchedRows(const CPixelTransform& transform, const int lPixelSize, const int resultHeight)
+	{
+		std::vector<std::pair<int, int>> vRows(Height, { std::numeric_limits<int>::max(), std::numeric_limits<int>::min() });
+		PIXELDISPATCHVECTOR vPixels;
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				vPixels.resize(0);
+				ComputePixelDispatch(transform.transform(QPointF(i, j)), lPixelSize, vPixels);
+				for (const CPixelDispatch& pixel : vPixels)
+					if (pixel.m_lY >= 0 && pixel.m_lY < resultHeight)
+					{
+						vRows[j].first = std::min(vRows[j].first, pixel.m_lY);
+						vRows[j].second = std::max(vRows[j].second, pixel.m_lY);
+					}
+			}
+		return vRows;
+	}
+
+	// The former loop of the Bayer drizzle coverage, serial.
+	void serialBayerDrizzleCoverage(C96BitFloatColorBitmap& cover, const CPixelTransform& transform, const CFATYPE cfaType)
+	{
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				const QPointF ptOut = transform.transform(QPointF(i, j));
+				if (!DSSRect{ 0, 0, Width, Height }.contains(ptOut))
+					continue;
+
+				std::array<int, 4> xcoords, ycoords;
+				const std::array<double, 4> percents = ComputeAll4PixelDispatches(ptOut, xcoords, ycoords);
+				for (const int n : { 0, 1, 2, 3 })
+				{
+					const float percent = static_cast<float>(percents[n]);
+					if (percent > 0.0f && xcoords[n] >= 0 && xcoords[n] < Width && ycoords[n] >= 0 && ycoords[n] < Height)
+					{
+						switch (GetBayerColor(i, j, cfaType))
+						{
+						case BAYER_RED: *cover.GetRedPixel(xcoords[n], ycoords[n]) += percent; break;
+						case BAYER_GREEN: *cover.GetGreenPixel(xcoords[n], ycoords[n]) += percent; break;
+						case BAYER_BLUE: *cover.GetBluePixel(xcoords[n], ycoords[n]) += percent; break;
+						}
+					}
+				}
+			}
+	}
+
+	bool equalRows(const std::vector<float>& band, const std::vector<float>& full, const int top)
+	{
+		return std::equal(band.cbegin(), band.cend(), full.cbegin() + static_cast<size_t>(top) * Width);
+	}
+}
+
+TEST_CASE("Drizzle in bands, lines of the bitmap reaching each band", "[Stacking][Drizzle]")
+{
+	const int multiplier = GENERATE(1, 2, 3);
+	const int resultHeight = Height * multiplier;
+	CAPTURE(multiplier);
+
+	SECTION("The ranges hold the dispatched lines with a margin")
+	{
+		for (const CPixelTransform& transform : makeTransforms(multiplier))
+		{
+			const std::vector<std::pair<int, int>> vRanges = CStackingEngine::DrizzleRowRanges(transform, Width, Height, multiplier, resultHeight);
+			const std::vector<std::pair<int, int>> vRows = dispatchedRows(transform, multiplier, resultHeight);
+			REQUIRE(vRanges.size() == Height);
+
+			int nrDispatched = 0;
+			for (int j = 0; j < Height; j++)
+			{
+				CAPTURE(j);
+				if (vRows[j].first > vRows[j].second)
+					continue;
+				++nrDispatched;
+				REQUIRE(vRanges[j].first <= vRows[j].first - 1);
+				REQUIRE(vRanges[j].second >= vRows[j].second + 1);
+				// Inside of the result, not more than the footprint of the pixels and the margins.
+				if (vRows[j].first > 0 && vRows[j].second < resultHeight - 1)
+					REQUIRE(vRanges[j].second - vRanges[j].first <= vRows[j].second - vRows[j].first + 3);
+			}
+			REQUIRE(nrDispatched > Height / 2);
+		}
+	}
+
+	SECTION("Each band gets all the lines that reach it")
+	{
+		for (const CPixelTransform& transform : makeTransforms(multiplier))
+		{
+			const std::vector<std::pair<int, int>> vRanges = CStackingEngine::DrizzleRowRanges(transform, Width, Height, multiplier, resultHeight);
+			const std::vector<std::pair<int, int>> vRows = dispatchedRows(transform, multiplier, resultHeight);
+
+			for (const int bandHeight : { 17, 30, resultHeight })
+				for (int top = 0; top < resultHeight; top += bandHeight)
+				{
+					const int bottom = std::min(top + bandHeight, resultHeight);
+					const auto [startRow, endRow] = CStackingEngine::DrizzleInputRows(vRanges, top, bottom);
+					CAPTURE(bandHeight, top, startRow, endRow);
+					REQUIRE(startRow >= 0);
+					REQUIRE(endRow <= Height);
+					for (int j = 0; j < Height; j++)
+						if (vRows[j].first < bottom && vRows[j].second >= top)
+						{
+							CAPTURE(j);
+							REQUIRE(j >= startRow);
+							REQUIRE(j < endRow);
+						}
+				}
+		}
+	}
+
+	SECTION("The lines outside of the result are clamped")
+	{
+		for (const double dy : { -1000.0, 1000.0 })
+		{
+			const CPixelTransform transform = makeTransform(0.0, dy, 0.0, false, multiplier);
+			const std::vector<std::pair<int, int>> vRanges = CStackingEngine::DrizzleRowRanges(transform, Width, Height, multiplier, resultHeight);
+			CAPTURE(dy);
+
+			// All the lines are clamped to the same range, just outside of the result.
+			REQUIRE(std::ranges::all_of(vRanges, [&vRanges](const auto& range) { return range == vRanges.front(); }));
+			if (dy < 0)
+			{
+				REQUIRE(vRanges.front().second < 0);
+				REQUIRE(vRanges.front().first >= -2 - 2 * multiplier);
+			}
+			else
+			{
+				REQUIRE(vRanges.front().first >= resultHeight);
+				REQUIRE(vRanges.front().second <= resultHeight + 2 + 2 * multiplier);
+			}
+			REQUIRE(CStackingEngine::DrizzleInputRows(vRanges, 0, resultHeight) == std::make_pair(0, 0));
+		}
+	}
+}
+
+TEST_CASE("Drizzle in bands, Bayer drizzle coverage", "[Stacking][Drizzle]")
+{
+	const CFATYPE cfaType = GENERATE(CFATYPE_RGGB, CFATYPE_GBRG);
+	CAPTURE(static_cast<int>(cfaType));
+
+	for (const CPixelTransform& transform : makeTransforms(1))
+	{
+		const std::vector<std::pair<int, int>> vRanges = CStackingEngine::DrizzleRowRanges(transform, Width, Height, 1, Height);
+
+		C96BitFloatColorBitmap expected;
+		expected.Init(Width, Height);
+		serialBayerDrizzleCoverage(expected, transform, cfaType);
+
+		// Each line of the cover is owned by one thread: same sums in the same order as the serial loop.
+		C96BitFloatColorBitmap cover;
+		cover.Init(Width, Height);
+		{
+			const int nrThreads = omp_get_max_threads();
+			NrProcessorsGuard guard{ 4 };
+			omp_set_num_threads(std::max(4, nrThreads));
+			CStackingEngine::AddBayerDrizzleCoverage(cover, transform, vRanges, cfaType, Width, Height, 0, nullptr);
+			omp_set_num_threads(nrThreads);
+		}
+		REQUIRE(cover.m_Red.m_vPixels == expected.m_Red.m_vPixels);
+		REQUIRE(cover.m_Green.m_vPixels == expected.m_Green.m_vPixels);
+		REQUIRE(cover.m_Blue.m_vPixels == expected.m_Blue.m_vPixels);
+
+		// The bands of the cover are the lines of the whole cover.
+		for (const int bandHeight : { 17, 30 })
+			for (int top = 0; top < Height; top += bandHeight)
+			{
+				const int rows = std::min(bandHeight, Height - top);
+				C96BitFloatColorBitmap band;
+				band.Init(Width, rows);
+				CStackingEngine::AddBayerDrizzleCoverage(band, transform, vRanges, cfaType, Width, Height, top, nullptr);
+				CAPTURE(bandHeight, top);
+				REQUIRE(equalRows(band.m_Red.m_vPixels, expected.m_Red.m_vPixels, top));
+				REQUIRE(equalRows(band.m_Green.m_vPixels, expected.m_Green.m_vPixels, top));
+				REQUIRE(equalRows(band.m_Blue.m_vPixels, expected.m_Blue.m_vPixels, top));
+			}
+	}
+}
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "FlatFrame.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+
+//
+// CFlatFrame::ApplyFlat works directly on the pixel vectors of gray and colour bitmaps.
+// The result must be the same as that of the per-pixel loop with GetPixel, CFlatNormalization::Normalize and SetPixel.
+//
+namespace
+{
+	template <class TBitmap>
+	std::shared_ptr<TBitmap> cloneBitmap(const TBitmap& bitmap)
+	{
+		return std::shared_ptr<TBitmap>{ static_cast<TBitmap*>(bitmap.Clone().release()) };
+	}
+
+	// Fills a plane with random values within [minimum, maximum] of the range [0, 256[ of GetPixel.
+	template <class T>
+	void fillPlane(std::vector<T>& pixels, const double multiplier, const double minimum, const double maximum, const std::uint32_t seed)
+	{
+		std::mt19937 engine{ seed };
+		std::uniform_real_distribution<double> distribution{ minimum, maximum };
+		for (T& pixel : pixels)
+			pixel = static_cast<T>(distribution(engine) * multiplier);
+	}
+
+	template <class T>
+	std::shared_ptr<CGrayBitmapT<T>> makeGray(const int width, const int height, const double minimum, const double maximum, const std::uint32_t seed)
+	{
+		auto pBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pBitmap->Init(width, height) == true);
+		fillPlane(pBitmap->m_vPixels, pBitmap->GetMultiplier(), minimum, maximum, seed);
+		return pBitmap;
+	}
+
+	template <class T>
+	std::shared_ptr<CColorBitmapT<T>> makeColor(const int width, const int height, const double minimum, const double maximum, const std::uint32_t seed)
+	{
+		auto pBitmap = std::make_shared<CColorBitmapT<T>>();
+		REQUIRE(pBitmap->Init(width, height) == true);
+		fillPlane(pBitmap->m_Red.m_vPixels, pBitmap->GetMultiplier(), minimum, maximum, seed);
+		fillPlane(pBitmap->m_Green.m_vPixels, pBitmap->GetMultiplier(), minimum, maximum, seed + 1);
+		fillPlane(pBitmap->m_Blue.m_vPixels, pBitmap->GetMultiplier(), minimum, maximum, seed + 2);
+		return pBitmap;
+	}
+
+	// The generic loop of CFlatFrame::ApplyFlat.
+	void applyFlatPerPixel(CMemoryBitmap& target, CFlatFrame& flatFrame)
+	{
+		const CMemoryBitmap& flat = *flatFrame.m_pFlatFrame;
+		CFlatNormalization& normalization = flatFrame.m_FlatNormalization;
+		const bool bUseCFA = flatFrame.IsCFA();
+
+		for (int j = 0; j < target.RealHeight(); j++)
+			for (int i = 0; i < target.RealWidth(); i++)
+			{
+				if (normalization.UseGray())
+				{
+					double fSrcGray = 0.0;
+					double fTgtGray = 0.0;
+					target.GetPixel(i, j, fTgtGray);
+					flat.GetPixel(i, j, fSrcGray);
+					if (bUseCFA)
+						normalization.Normalize(fTgtGray, fSrcGray, flat.GetBayerColor(i, j));
+					else
+						normalization.Normalize(fTgtGray, fSrcGray);
+					target.SetPixel(i, j, fTgtGray);
+				}
+				else
+				{
+					double fSrcRed, fSrcGreen, fSrcBlue;
+					double fTgtRed, fTgtGreen, fTgtBlue;
+					target.GetPixel(i, j, fTgtRed, fTgtGreen, fTgtBlue);
+					flat.GetPixel(i, j, fSrcRed, fSrcGreen, fSrcBlue);
+					normalization.Normalize(fTgtRed, fTgtGreen, fTgtBlue, fSrcRed, fSrcGreen, fSrcBlue);
+					target.SetPixel(i, j, fTgtRed, fTgtGreen, fTgtBlue);
+				}
+			}
+	}
+
+	// Applies the flat to a copy of the target with ApplyFlat() and with the per-pixel loop, returns both copies.
+	template <class TBitmap>
+	std::pair<std::shared_ptr<TBitmap>, std::shared_ptr<TBitmap>> applyBothWays(const TBitmap& target, CFlatFrame& flatFrame)
+	{
+		flatFrame.ComputeFlatNormalization();
+		auto pFast = cloneBitmap(target);
+		auto pReference = cloneBitmap(target);
+		REQUIRE(flatFrame.ApplyFlat(pFast) == true);
+		applyFlatPerPixel(*pReference, flatFrame);
+		return { pFast, pReference };
+	}
+
+	constexpr int W = 97; // Odd width and height: the last column and row have the colour of the first.
+	constexpr int H = 61;
+}
+
+TEST_CASE("Flat frame pixel loop equals the generic loop", "[FlatFrame]")
+{
+	SECTION("Gray int16 target, int16 flat")
+	{
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = makeGray<std::uint16_t>(W, H, 0.0, 250.0, 1); // Includes flat values < 1 (clamped to 1).
+		const auto pTarget = makeGray<std::uint16_t>(W, H, 0.0, 255.0, 2);
+		const auto [pFast, pReference] = applyBothWays(*pTarget, flatFrame);
+		REQUIRE(pFast->m_vPixels == pReference->m_vPixels);
+	}
+
+	SECTION("Gray float target, int16 flat")
+	{
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = makeGray<std::uint16_t>(W, H, 50.0, 200.0, 3);
+		const auto pTarget = makeGray<float>(W, H, 0.0, 255.0, 4);
+		const auto [pFast, pReference] = applyBothWays(*pTarget, flatFrame);
+		REQUIRE(pFast->m_vPixels == pReference->m_vPixels);
+	}
+
+	SECTION("Gray int32 target, float flat, values clipped at 255")
+	{
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = makeGray<float>(W, H, 10.0, 100.0, 5);
+		const auto pTarget = makeGray<std::uint32_t>(W, H, 100.0, 255.0, 6);
+		const auto [pFast, pReference] = applyBothWays(*pTarget, flatFrame);
+		REQUIRE(pFast->m_vPixels == pReference->m_vPixels);
+	}
+
+	SECTION("CFA gray int16, one mean per Bayer colour")
+	{
+		for (const CFATYPE cfaType : { CFATYPE_RGGB, CFATYPE_BGGR, CFATYPE_GRBG, CFATYPE_GBRG })
+		{
+			auto pFlat = makeGray<std::uint16_t>(W, H, 50.0, 200.0, 7);
+			pFlat->SetCFAType(cfaType);
+			pFlat->UseBilinear(true);
+			// Different levels per colour, so that a wrong Bayer colour gives a wrong mean.
+			for (int j = 0; j < H; j++)
+				for (int i = 0; i < W; i++)
+					pFlat->m_vPixels[static_cast<size_t>(j) * W + i] /= static_cast<std::uint16_t>(pFlat->GetBayerColor(i, j));
+
+			CFlatFrame flatFrame;
+			flatFrame.m_pFlatFrame = pFlat;
+			auto pTarget = makeGray<std::uint16_t>(W, H, 0.0, 255.0, 8);
+			pTarget->SetCFAType(cfaType);
+			pTarget->UseBilinear(true);
+
+			const auto [pFast, pReference] = applyBothWays(*pTarget, flatFrame);
+			REQUIRE(flatFrame.IsCFA() == true);
+			REQUIRE(pFast->m_vPixels == pReference->m_vPixels);
+		}
+	}
+
+	SECTION("CFA target with super pixels is processed as a raw Bayer image")
+	{
+		auto pFlat = makeGray<std::uint16_t>(W, H, 50.0, 200.0, 9);
+		pFlat->SetCFAType(CFATYPE_RGGB);
+		pFlat->UseBilinear(true);
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = pFlat;
+
+		auto pTarget = makeGray<std::uint16_t>(W, H, 0.0, 255.0, 10);
+		pTarget->SetCFAType(CFATYPE_RGGB);
+		pTarget->UseBilinear(true);
+		const auto pReference = cloneBitmap(*pTarget);
+		pTarget->UseSuperPixels(true);
+
+		flatFrame.ComputeFlatNormalization();
+		REQUIRE(flatFrame.ApplyFlat(pTarget) == true);
+		applyFlatPerPixel(*pReference, flatFrame);
+		REQUIRE(pTarget->GetCFATransformation() == CFAT_SUPERPIXEL);
+		REQUIRE(pTarget->m_vPixels == pReference->m_vPixels);
+	}
+
+	SECTION("Colour int16 target, int16 flat")
+	{
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = makeColor<std::uint16_t>(W, H, 0.0, 250.0, 11);
+		const auto pTarget = makeColor<std::uint16_t>(W, H, 0.0, 255.0, 12);
+		const auto [pFast, pReference] = applyBothWays(*pTarget, flatFrame);
+		REQUIRE(pFast->m_Red.m_vPixels == pReference->m_Red.m_vPixels);
+		REQUIRE(pFast->m_Green.m_vPixels == pReference->m_Green.m_vPixels);
+		REQUIRE(pFast->m_Blue.m_vPixels == pReference->m_Blue.m_vPixels);
+	}
+
+	SECTION("Colour float target, int8 flat")
+	{
+		CFlatFrame flatFrame;
+		flatFrame.m_pFlatFrame = makeColor<std::uint8_t>(W, H, 20.0, 250.0, 13);
+		const auto pTarget = makeColor<float>(W, H, 0.0, 255.0, 14);
+		const auto [pFast, pReference] = applyBothWays(*pTarget, flatFrame);
+		REQUIRE(pFast->m_Red.m_vPixels == pReference->m_Red.m_vPixels);
+		REQUIRE(pFast->m_Green.m_vPixels == pReference->m_Green.m_vPixels);
+		REQUIRE(pFast->m_Blue.m_vPixels == pReference->m_Blue.m_vPixels);
+	}
+}
@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include <future>
+#include <functional>
+#include <atomic>
+#include "catch.h"
+#include "FramePrefetcher.h"
+
+namespace
+{
+	//
+	// Loads nrFrames frames (the result is the frame index) and checks after each get() that not more than maxAhead
+	// frames beyond the current one have been started.
+	//
+	bool prefetchesInOrderWithin(const size_t nrFrames, const size_t maxFrames, const std::uint64_t frameBytes, const std::uint64_t memoryLimit, const size_t maxAhead)
+	{
+		std::atomic<size_t> nrStarted{ 0 };
+		std::vector<std::atomic<int>> nrLoads(nrFrames);
+		const auto load = [&nrStarted, &nrLoads](const size_t index, DSS::ProgressBase*) -> size_t
+		{
+			++nrStarted;
+			++nrLoads[index];
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			return index;
+		};
+
+		DSS::FramePrefetcher<size_t> frames{ nrFrames, load, [frameBytes](const size_t) { return frameBytes; }, nullptr, maxFrames, memoryLimit };
+		for (size_t i = 0; i < nrFrames; ++i)
+		{
+			if (frames.get(i) != i)
+				return false;
+			if (nrStarted > i + 1 + maxAhead)
+				return false;
+		}
+		return std::all_of(nrLoads.cbegin(), nrLoads.cend(), [](const std::atomic<int>& n) { return n == 1; });
+	}
+}
+
+TEST_CASE("FramePrefetcher", "[Prefetch]")
+{
+	SECTION("Frames in order, limited by the number of frames")
+	{
+		REQUIRE(prefetchesInOrderWithin(1, 4, 0, 0, 0));
+		REQUIRE(prefetchesInOrderWithin(20, 1, 0, 0, 1));
+		REQUIRE(prefetchesInOrderWithin(20, 4, 0, 0, 4));
+	}
+
+	SECTION("Limited by the memory ceiling")
+	{
+		REQUIRE(prefetchesInOrderWithin(20, 8, 100, 250, 2));
+		// One frame is always loaded ahead, even if it is bigger than the limit.
+		REQUIRE(prefetchesInOrderWithin(20, 8, 100, 50, 1));
+	}
+
+	SECTION("Exceptions of the loader are passed to get()")
+	{
+		const auto load = [](const size_t index, DSS::ProgressBase*) -> int
+		{
+			if (index == 2)
+				throw std::runtime_error("Cannot load frame");
+			return static_cast<int>(index);
+		};
+		DSS::FramePrefetcher<int> frames{ 4, load, {}, nullptr, 2, 0 };
+		REQUIRE(frames.get(0) == 0);
+		REQUIRE(frames.get(1) == 1);
+		REQUIRE_THROWS(frames.get(2));
+		REQUIRE(frames.get(3) == 3);
+	}
+}
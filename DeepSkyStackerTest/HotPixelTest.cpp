@@ -0,0 +1,230 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "DarkFrame.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+#include "TestMultitask.h"
+
+namespace
+{
+	constexpr int Width = 37;
+	constexpr int Height = 29;
+	// Bad column appended after the sorted hot pixels, as FindBadVerticalLines() does.
+	constexpr int BadColumn = 3;
+	constexpr int BadColumnTop = 4;
+	constexpr int BadColumnBottom = 24;
+	// Centre of a block of 5 x 5 hot pixels: no valid neighbour with a radius of 1 or 2.
+	constexpr int BlockX = 20;
+	constexpr int BlockY = 14;
+
+	class TestDarkFrame : public CDarkFrame
+	{
+	public:
+		TestDarkFrame(std::shared_ptr<CMemoryBitmap> pMaster, const HOTPIXELVECTOR& vHotPixels) :
+			CDarkFrame{ pMaster }
+		{
+			m_vHotPixels = vHotPixels;
+		}
+
+		bool interpolateIndexed(CMemoryBitmap& bitmap)
+		{
+			return InterpolateIndexedHotPixels(&bitmap);
+		}
+
+		void interpolateListed(CMemoryBitmap& bitmap)
+		{
+			InterpolateListedHotPixels(&bitmap);
+		}
+	};
+
+	bool sameHotPixel(const CHotPixel& lhs, const CHotPixel& rhs)
+	{
+		return !(lhs < rhs) && !(rhs < lhs);
+	}
+
+	// Random hot pixels, pixels on the borders and a block of 5 x 5 hot pixels, sorted as FindHotPixels() does.
+	HOTPIXELVECTOR detectedHotPixels()
+	{
+		HOTPIXELVECTOR vHotPixels;
+		std::mt19937 generator{ 7 };
+		std::uniform_int_distribution<int> xDistribution{ 0, Width - 1 };
+		std::uniform_int_distribution<int> yDistribution{ 0, Height - 1 };
+		for (int n = 0; n < 60; n++)
+		{
+			const int x = xDistribution(generator);
+			const int y = yDistribution(generator);
+			vHotPixels.emplace_back(x, y);
+		}
+
+		for (const auto [x, y] : { std::pair{ 0, 0 }, std::pair{ Width - 1, 0 }, std::pair{ 0, Height - 1 }, std::pair{ Width - 1, Height - 1 },
+			std::pair{ 0, 10 }, std::pair{ Width - 1, 7 }, std::pair{ 12, 0 }, std::pair{ 17, Height - 1 } })
+			vHotPixels.emplace_back(x, y);
+
+		for (int x = BlockX - 2; x <= BlockX + 2; x++)
+			for (int y = BlockY - 2; y <= BlockY + 2; y++)
+				vHotPixels.emplace_back(x, y);
+
+		std::sort(vHotPixels.begin(), vHotPixels.end());
+		vHotPixels.erase(std::unique(vHotPixels.begin(), vHotPixels.end(), sameHotPixel), vHotPixels.end());
+		return vHotPixels;
+	}
+
+	HOTPIXELVECTOR withBadColumn(HOTPIXELVECTOR vHotPixels, const bool sorted)
+	{
+		for (int y = BadColumnTop; y <= BadColumnBottom; y++)
+			vHotPixels.emplace_back(BadColumn, y);
+		if (sorted)
+		{
+			std::sort(vHotPixels.begin(), vHotPixels.end());
+			vHotPixels.erase(std::unique(vHotPixels.begin(), vHotPixels.end(), sameHotPixel), vHotPixels.end());
+		}
+		return vHotPixels;
+	}
+
+	template <class Bitmap>
+	std::shared_ptr<Bitmap> makeBitmap(const bool cfa)
+	{
+		auto pBitmap = std::make_shared<Bitmap>();
+		pBitmap->Init(Width, Height);
+		if constexpr (std::is_base_of_v<CCFABitmapInfo, Bitmap>)
+		{
+			if (cfa)
+			{
+				pBitmap->SetCFAType(CFATYPE_RGGB);
+				pBitmap->UseBilinear(true);
+			}
+		}
+		return pBitmap;
+	}
+
+	template <class T>
+	std::vector<std::vector<T>> planes(const CGrayBitmapT<T>& bitmap)
+	{
+		return { bitmap.m_vPixels };
+	}
+
+	template <class T>
+	std::vector<std::vector<T>> planes(const CColorBitmapT<T>& bitmap)
+	{
+		return { bitmap.m_Red.m_vPixels, bitmap.m_Green.m_vPixels, bitmap.m_Blue.m_vPixels };
+	}
+
+	template <class Bitmap>
+	std::shared_ptr<Bitmap> makeFrame(const bool cfa)
+	{
+		auto pBitmap = makeBitmap<Bitmap>(cfa);
+		std::mt19937 generator{ 11 };
+		std::uniform_int_distribution<int> distribution{ 0, 65535 };
+		const auto fill = [&generator, &distribution](auto& vPixels)
+		{
+			for (auto& pixel : vPixels)
+				pixel = static_cast<std::remove_reference_t<decltype(pixel)>>(distribution(generator));
+		};
+		if constexpr (requires { pBitmap->m_vPixels; })
+			fill(pBitmap->m_vPixels);
+		else
+		{
+			fill(pBitmap->m_Red.m_vPixels);
+			fill(pBitmap->m_Green.m_vPixels);
+			fill(pBitmap->m_Blue.m_vPixels);
+		}
+		return pBitmap;
+	}
+
+	//
+	// Interpolates the hot pixels of the same frame with the index and one at a time with GetPixel() and SetPixel().
+	//
+	template <class Bitmap>
+	void checkHotPixels(const bool cfa)
+	{
+		const int radius = cfa ? 2 : 1;
+		const HOTPIXELVECTOR vDetected = withBadColumn(detectedHotPixels(), false);
+		const HOTPIXELVECTOR vSorted = withBadColumn(detectedHotPixels(), true);
+		const std::shared_ptr<Bitmap> pMaster = makeBitmap<Bitmap>(cfa);
+		const auto original = planes(*makeFrame<Bitmap>(cfa));
+
+		const std::shared_ptr<Bitmap> pIndexed = makeFrame<Bitmap>(cfa);
+		{
+			const int nrThreads = omp_get_max_threads();
+			NrProcessorsGuard guard{ 4 };
+			omp_set_num_threads(std::max(4, nrThreads));
+			TestDarkFrame darkFrame{ pMaster, vDetected };
+			REQUIRE(darkFrame.interpolateIndexed(*pIndexed));
+			omp_set_num_threads(nrThreads);
+		}
+		const auto indexed = planes(*pIndexed);
+
+		// The pixels that are not hot are left, the hot pixel without neighbours is 0.
+		for (size_t plane = 0; plane < indexed.size(); plane++)
+			for (int y = 0; y < Height; y++)
+				for (int x = 0; x < Width; x++)
+				{
+					const size_t offset = static_cast<size_t>(y) * Width + x;
+					CAPTURE(plane, x, y);
+					if (!std::binary_search(vSorted.cbegin(), vSorted.cend(), CHotPixel{ x, y }))
+						REQUIRE(indexed[plane][offset] == original[plane][offset]);
+				}
+		for (const auto& vPixels : indexed)
+			REQUIRE(vPixels[static_cast<size_t>(BlockY) * Width + BlockX] == 0);
+
+		SECTION("Same result as one hot pixel at a time with the sorted hot pixels")
+		{
+			const std::shared_ptr<Bitmap> pListed = makeFrame<Bitmap>(cfa);
+			TestDarkFrame darkFrame{ pMaster, vSorted };
+			darkFrame.interpolateListed(*pListed);
+			REQUIRE(planes(*pListed) == indexed);
+		}
+
+		SECTION("With the bad column after the sorted hot pixels, only the hot pixels next to it differ")
+		{
+			// The binary search of one hot pixel at a time can miss the bad column, the index always excludes it.
+			const std::shared_ptr<Bitmap> pListed = makeFrame<Bitmap>(cfa);
+			TestDarkFrame darkFrame{ pMaster, vDetected };
+			darkFrame.interpolateListed(*pListed);
+			const auto listed = planes(*pListed);
+
+			for (size_t plane = 0; plane < indexed.size(); plane++)
+				for (int y = 0; y < Height; y++)
+					for (int x = 0; x < Width; x++)
+					{
+						const size_t offset = static_cast<size_t>(y) * Width + x;
+						if (listed[plane][offset] == indexed[plane][offset])
+							continue;
+						CAPTURE(plane, x, y);
+						REQUIRE(std::binary_search(vSorted.cbegin(), vSorted.cend(), CHotPixel{ x, y }));
+						REQUIRE(std::abs(x - BadColumn) <= radius);
+						REQUIRE(y >= BadColumnTop - radius);
+						REQUIRE(y <= BadColumnBottom + radius);
+					}
+		}
+	}
+}
+
+TEST_CASE("Hot pixels interpolated with the index", "[HotPixels]")
+{
+	SECTION("Gray 16 bit")
+	{
+		checkHotPixels<C16BitGrayBitmap>(false);
+	}
+
+	SECTION("Gray float")
+	{
+		checkHotPixels<C32BitFloatGrayBitmap>(false);
+	}
+
+	SECTION("Gray CFA")
+	{
+		checkHotPixels<C16BitGrayBitmap>(true);
+	}
+
+	SECTION("Colour 16 bit")
+	{
+		checkHotPixels<C48BitColorBitmap>(false);
+	}
+
+	SECTION("Colour float")
+	{
+		checkHotPixels<C96BitFloatColorBitmap>(false);
+	}
+}
@@ -0,0 +1,250 @@
+#include "stdafx.h"
+#include <fstream>
+#include <functional>
+#include "catch.h"
+#include "MasterLibrary.h"
+#include "TaskInfo.h"
+#include "Settings.h"
+
+using namespace DSS;
+
+namespace
+{
+	constexpr std::uint64_t MasterSize = 100;
+
+	// A temporary folder, removed with its content.
+	class TestFolder
+	{
+	public:
+		const fs::path path{ fs::temp_directory_path() / "DSSMasterLibraryTest" };
+
+		TestFolder()
+		{
+			fs::remove_all(path);
+			fs::create_directories(path);
+		}
+		~TestFolder()
+		{
+			std::error_code ec;
+			fs::remove_all(path, ec);
+		}
+
+		fs::path write(const std::string& name, const size_t size = MasterSize) const
+		{
+			const fs::path file = path / name;
+			std::ofstream stream{ file, std::ios::binary | std::ios::trunc };
+			stream << std::string(size, 'x');
+			return file;
+		}
+	};
+
+	CTaskInfo makeTask(const std::vector<fs::path>& vFiles)
+	{
+		CTaskInfo task;
+		task.m_TaskType = PICTURETYPE_DARKFRAME;
+		task.m_Method = MBP_SIGMACLIP;
+		task.m_fKappa = 2.0;
+		task.m_lNrIterations = 5;
+		for (const fs::path& file : vFiles)
+		{
+			CFrameInfo frame;
+			frame.filePath = file;
+			task.m_vBitmaps.push_back(frame);
+		}
+		return task;
+	}
+
+	bool found(MasterLibrary& library, const QString& key)
+	{
+		fs::path file;
+		return library.find(key, file);
+	}
+}
+
+TEST_CASE("Master library keys", "[MasterLibrary]")
+{
+	const TestFolder folder;
+	const fs::path first = folder.write("first.fit");
+	const fs::path second = folder.write("second.fit");
+	const fs::path third = folder.write("third.fit");
+	const CTaskInfo task = makeTask({ first, second, third });
+	const CGlobalSettings settings;
+	const QString key = MasterLibrary::computeKey("Dark", task, settings);
+	REQUIRE_FALSE(key.isEmpty());
+	REQUIRE(MasterLibrary::computeKey("Dark", task, settings) == key);
+
+	SECTION("The order of the frames doesn't change the key")
+	{
+		REQUIRE(MasterLibrary::computeKey("Dark", makeTask({ third, first, second }), settings) == key);
+		REQUIRE(MasterLibrary::computeKey("Dark", makeTask({ second, third, first }), settings) == key);
+	}
+
+	SECTION("The key changes with the frames")
+	{
+		REQUIRE(MasterLibrary::computeKey("Dark", makeTask({ first, second }), settings) != key);
+
+		// Same modification time, other size.
+		const auto modified = fs::last_write_time(second);
+		folder.write("second.fit", MasterSize + 1);
+		fs::last_write_time(second, modified);
+		const QString resizedKey = MasterLibrary::computeKey("Dark", task, settings);
+		REQUIRE_FALSE(resizedKey.isEmpty());
+		REQUIRE(resizedKey != key);
+
+		fs::last_write_time(third, fs::last_write_time(third) + std::chrono::hours{ 1 });
+		const QString touchedKey = MasterLibrary::computeKey("Dark", task, settings);
+		REQUIRE_FALSE(touchedKey.isEmpty());
+		REQUIRE(touchedKey != resizedKey);
+		REQUIRE(touchedKey != key);
+	}
+
+	SECTION("The key changes with the type, the method and the settings")
+	{
+		REQUIRE(MasterLibrary::computeKey("Flat", task, settings) != key);
+
+		CTaskInfo changedTask = makeTask({ first, second, third });
+		changedTask.m_Method = MBP_MEDIAN;
+		REQUIRE(MasterLibrary::computeKey("Dark", changedTask, settings) != key);
+
+		changedTask = makeTask({ first, second, third });
+		changedTask.m_fKappa = 2.5;
+		REQUIRE(MasterLibrary::computeKey("Dark", changedTask, settings) != key);
+
+		changedTask = makeTask({ first, second, third });
+		changedTask.m_lNrIterations = 6;
+		REQUIRE(MasterLibrary::computeKey("Dark", changedTask, settings) != key);
+
+		CGlobalSettings changedSettings;
+		changedSettings.AddMasterKey("Raw.RawDDP/Brightness", "1.1");
+		REQUIRE(MasterLibrary::computeKey("Dark", task, changedSettings) != key);
+	}
+
+	SECTION("The key changes with the master offset")
+	{
+		CGlobalSettings offsetSettings;
+		offsetSettings.AddMasterKey("MasterOffset", "0123456789abcdef");
+		const QString offsetKey = MasterLibrary::computeKey("Dark", task, offsetSettings);
+		REQUIRE(offsetKey != key);
+
+		CGlobalSettings otherOffsetSettings;
+		otherOffsetSettings.AddMasterKey("MasterOffset", "fedcba9876543210");
+		REQUIRE(MasterLibrary::computeKey("Dark", task, otherOffsetSettings) != offsetKey);
+		REQUIRE(MasterLibrary::computeKey("Dark", task, otherOffsetSettings) != key);
+	}
+
+	SECTION("No key if a frame is missing")
+	{
+		fs::remove(second);
+		REQUIRE(MasterLibrary::computeKey("Dark", task, settings).isEmpty());
+	}
+}
+
+TEST_CASE("Master library", "[MasterLibrary]")
+{
+	const TestFolder folder;
+	const fs::path libraryFolder = folder.path / "Library";
+	std::uint64_t sizeLimit = 10 * MasterSize;
+	MasterLibrary library{ libraryFolder, [&sizeLimit]() { return sizeLimit; } };
+
+	const fs::path master = folder.write("master.tif");
+	REQUIRE_FALSE(found(library, "a"));
+	REQUIRE(library.add("a", master));
+
+	SECTION("An added master is found")
+	{
+		fs::path file;
+		REQUIRE(library.find("a", file));
+		REQUIRE(file.parent_path() == libraryFolder);
+		REQUIRE(fs::file_size(file) == MasterSize);
+		REQUIRE_FALSE(found(library, "b"));
+	}
+
+	SECTION("The index is read again")
+	{
+		REQUIRE(library.add("b", folder.write("other.tif", 2 * MasterSize)));
+		REQUIRE(fs::exists(libraryFolder / "MasterLibrary.idx"));
+
+		MasterLibrary reloaded{ libraryFolder, [&sizeLimit]() { return sizeLimit; } };
+		fs::path file;
+		REQUIRE(reloaded.find("a", file));
+		REQUIRE(fs::file_size(file) == MasterSize);
+		REQUIRE(reloaded.find("b", file));
+		REQUIRE(fs::file_size(file) == 2 * MasterSize);
+		REQUIRE_FALSE(found(reloaded, "c"));
+	}
+
+	SECTION("A master changed outside of the library is dropped")
+	{
+		fs::path file;
+		REQUIRE(library.find("a", file));
+		{
+			std::ofstream stream{ file, std::ios::binary | std::ios::app };
+			stream << 'y';
+		}
+		REQUIRE_FALSE(found(library, "a"));
+
+		MasterLibrary reloaded{ libraryFolder, [&sizeLimit]() { return sizeLimit; } };
+		REQUIRE_FALSE(found(reloaded, "a"));
+	}
+
+	SECTION("A master removed outside of the library is dropped")
+	{
+		fs::path file;
+		REQUIRE(library.find("a", file));
+		fs::remove(file);
+		REQUIRE_FALSE(found(library, "a"));
+
+		// Adding the master again replaces the entry.
+		REQUIRE(library.add("a", master));
+		MasterLibrary reloaded{ libraryFolder, [&sizeLimit]() { return sizeLimit; } };
+		REQUIRE(found(reloaded, "a"));
+	}
+
+	SECTION("The least recently used masters are removed beyond the size budget")
+	{
+		sizeLimit = 5 * MasterSize / 2;
+		REQUIRE(library.add("b", master));
+		// Using a makes b the least recently used master: it is removed for c at the end of the run.
+		REQUIRE(found(library, "a"));
+		REQUIRE(library.add("c", master));
+		REQUIRE(fs::exists(libraryFolder / "b.tif"));
+		library.endRun();
+
+		REQUIRE_FALSE(found(library, "b"));
+		REQUIRE_FALSE(fs::exists(libraryFolder / "b.tif"));
+		REQUIRE(found(library, "a"));
+		REQUIRE(found(library, "c"));
+
+		MasterLibrary reloaded{ libraryFolder, [&sizeLimit]() { return sizeLimit; } };
+		REQUIRE_FALSE(found(reloaded, "b"));
+		REQUIRE(found(reloaded, "c"));
+		REQUIRE(found(reloaded, "a"));
+
+		// Now a was used last: c is removed for d.
+		REQUIRE(reloaded.add("d", master));
+		REQUIRE(found(reloaded, "c"));
+		reloaded.endRun();
+		REQUIRE_FALSE(found(reloaded, "c"));
+		REQUIRE(found(reloaded, "a"));
+		REQUIRE(found(reloaded, "d"));
+	}
+
+	SECTION("A master found during the run is kept over the size budget until the end of the run")
+	{
+		sizeLimit = MasterSize / 2;
+		library.endRun();
+		fs::path file;
+		REQUIRE(library.find("a", file));
+		// The task that found a may not have loaded it yet.
+		REQUIRE(library.add("b", master));
+		REQUIRE(fs::exists(file));
+		REQUIRE(found(library, "a"));
+		REQUIRE(found(library, "b"));
+
+		// The last master added is kept over the size budget.
+		library.endRun();
+		REQUIRE_FALSE(found(library, "a"));
+		REQUIRE_FALSE(fs::exists(libraryFolder / "a.tif"));
+		REQUIRE(found(library, "b"));
+	}
+}
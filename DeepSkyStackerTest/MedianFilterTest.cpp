@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "GrayBitmap.h"
+#include "MedianFilterEngine.h"
+#include "ConstantTimeMedian.h"
+#include "DSSTools.h"
+
+namespace
+{
+	std::shared_ptr<C16BitGrayBitmap> makeRandomBitmap(const int width, const int height, const int range, const std::uint32_t seed)
+	{
+		auto pBitmap = std::make_shared<C16BitGrayBitmap>();
+		REQUIRE(pBitmap->Init(width, height) == true);
+		std::mt19937 engine{ seed };
+		for (auto& pixel : pBitmap->m_vPixels)
+			pixel = static_cast<std::uint16_t>(engine() % range);
+		return pBitmap;
+	}
+
+	// The per-pixel median filter (as in CInternalMedianFilterEngineT::processNonAvx) as reference.
+	std::vector<std::uint16_t> referenceMedian(const C16BitGrayBitmap& bitmap, const int filterSize, const CFATYPE cfaType)
+	{
+		const int width = bitmap.RealWidth();
+		const int height = bitmap.RealHeight();
+		std::vector<std::uint16_t> result(bitmap.m_vPixels.size());
+		std::vector<std::uint16_t> values;
+
+		for (int row = 0; row < height; ++row)
+			for (int col = 0; col < width; ++col)
+			{
+				values.clear();
+				for (int k = std::max(0, row - filterSize); k <= std::min(row + filterSize, height - 1); ++k)
+					for (int l = std::max(0, col - filterSize); l <= std::min(col + filterSize, width - 1); ++l)
+						if (cfaType == CFATYPE_NONE || GetBayerColor(l, k, cfaType) == GetBayerColor(col, row, cfaType))
+							values.push_back(bitmap.m_vPixels[static_cast<size_t>(k) * width + l]);
+				result[static_cast<size_t>(row) * width + col] = static_cast<std::uint16_t>(Median(values));
+			}
+		return result;
+	}
+}
+
+TEST_CASE("Median filter 16 bit", "[MedianFilter]")
+{
+	SECTION("Monochrome: per-pixel (size < 4) and constant time filter (size >= 4) equal the per-pixel median")
+	{
+		const auto pBitmap = makeRandomBitmap(150, 71, 65536, 1);
+		for (const int filterSize : { 1, 2, 3, 4, 5, 7 })
+		{
+			CGrayMedianFilterEngineT<std::uint16_t> engine;
+			engine.SetInputBitmap(pBitmap.get());
+			const auto pFiltered = std::dynamic_pointer_cast<C16BitGrayBitmap>(engine.GetFilteredImage(filterSize, nullptr));
+			REQUIRE(static_cast<bool>(pFiltered));
+			REQUIRE(pFiltered->m_vPixels == referenceMedian(*pBitmap, filterSize, CFATYPE_NONE));
+		}
+	}
+
+	SECTION("CFA: only pixels of the same colour are used")
+	{
+		for (const CFATYPE cfaType : { CFATYPE_RGGB, CFATYPE_GBRG })
+		{
+			const auto pBitmap = makeRandomBitmap(133, 64, 4000, 2);
+			pBitmap->SetCFAType(cfaType);
+			// 2: per-pixel median, 3: constant time filter.
+			for (const int filterSize : { 2, 3 })
+			{
+				CGrayMedianFilterEngineT<std::uint16_t> engine;
+				engine.SetInputBitmap(pBitmap.get());
+				const auto pFiltered = std::dynamic_pointer_cast<C16BitGrayBitmap>(engine.GetFilteredImage(filterSize, nullptr));
+				REQUIRE(static_cast<bool>(pFiltered));
+				// The engine doubles the filter size of CFA images.
+				REQUIRE(pFiltered->m_vPixels == referenceMedian(*pBitmap, 2 * filterSize, cfaType));
+			}
+		}
+	}
+
+	SECTION("Masked pixels are ignored")
+	{
+		constexpr int W = 90;
+		constexpr int H = 40;
+		constexpr int Radius = 3;
+		const auto pBitmap = makeRandomBitmap(W, H, 65536, 3);
+		std::vector<std::uint8_t> mask(W * H);
+		std::mt19937 engine{ 4 };
+		for (auto& m : mask)
+			m = engine() % 4 != 0 ? 1 : 0;
+
+		std::vector<double> medians(W * H, -1.0);
+		DSS::ConstantTimeMedianFilter filter{ pBitmap->m_vPixels.data(), mask.data(), W, H, Radius, CFATYPE_NONE };
+		filter.process(0, W, [&medians](const int col, const int row, const std::uint16_t lower, const std::uint16_t upper, const int count)
+		{
+			medians[row * W + col] = count == 0 ? 0.0 : (lower + upper) / 2.0;
+		});
+
+		std::vector<double> values;
+		for (int row = 0; row < H; ++row)
+			for (int col = 0; col < W; ++col)
+			{
+				values.clear();
+				for (int k = std::max(0, row - Radius); k <= std::min(row + Radius, H - 1); ++k)
+					for (int l = std::max(0, col - Radius); l <= std::min(col + Radius, W - 1); ++l)
+						if (mask[k * W + l] != 0)
+							values.push_back(pBitmap->m_vPixels[k * W + l]);
+				REQUIRE(medians[row * W + col] == Median(values));
+			}
+	}
+}
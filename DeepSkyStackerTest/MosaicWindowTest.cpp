@@ -0,0 +1,268 @@
+#include "stdafx.h"
+#include <random>
+#include <numbers>
+#include "catch.h"
+#include "StackingEngine.h"
+#include "PixelTransform.h"
+#include "BackgroundCalibration.h"
+#include "EntropyInfo.h"
+#include "TaskInfo.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+#include "avx.h"
+#include "avx_avg.h"
+
+namespace
+{
+	constexpr int Width = 83;
+	constexpr int Height = 71;
+
+	CPixelTransform makeTransform(const double dx, const double dy, const double degrees, const int multiplier)
+	{
+		const double angle = degrees * std::numbers::pi / 180.0;
+		CBilinearParameters parameters;
+		parameters.a0 = dx;
+		parameters.a1 = std::cos(angle);
+		parameters.a2 = -std::sin(angle);
+		parameters.b0 = dy;
+		parameters.b1 = std::sin(angle);
+		parameters.b2 = std::cos(angle);
+		CPixelTransform transform{ parameters };
+		transform.SetPixelSizeMultiplier(multiplier);
+		return transform;
+	}
+
+	// Frames of a mosaic twice the size of a frame: inside of it, rotated, and partly outside of it.
+	std::array<CPixelTransform, 3> makeTransforms(const int multiplier)
+	{
+		return {
+			makeTransform(40.3, 30.6, 0.0, multiplier),
+			makeTransform(60.25, 20.5, 7.0, multiplier),
+			makeTransform(-20.7, 100.2, -3.0, multiplier)
+		};
+	}
+
+	// The rectangle of the result that the pixels of the bitmap are dispatched to.
+	DSSRect dispatchedRectangle(const CPixelTransform& transform, const int lPixelSize, const int resultWidth, const int resultHeight)
+	{
+		int left = resultWidth, top = resultHeight, right = 0, bottom = 0;
+		PIXELDISPATCHVECTOR vPixels;
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				vPixels.resize(0);
+				ComputePixelDispatch(transform.transform(QPointF(i, j)), lPixelSize, vPixels);
+				for (const CPixelDispatch& pixel : vPixels)
+					if (pixel.m_lX >= 0 && pixel.m_lX < resultWidth && pixel.m_lY >= 0 && pixel.m_lY < resultHeight)
+					{
+						left = std::min(left, pixel.m_lX);
+						top = std::min(top, pixel.m_lY);
+						right = std::max(right, pixel.m_lX + 1);
+						bottom = std::max(bottom, pixel.m_lY + 1);
+					}
+			}
+		return DSSRect{ left, top, right, bottom };
+	}
+
+	bool windowContains(const DSSRect& window, const DSSRect& rc)
+	{
+		return window.left <= rc.left && window.top <= rc.top && window.right >= rc.right && window.bottom >= rc.bottom;
+	}
+}
+
+TEST_CASE("Mosaic windows, rectangle covered by a frame", "[Stacking][Mosaic]")
+{
+	const int multiplier = GENERATE(1, 2);
+	const int resultWidth = 2 * Width * multiplier;
+	const int resultHeight = 2 * Height * multiplier;
+	CAPTURE(multiplier);
+
+	SECTION("The window holds the dispatched pixels with a margin")
+	{
+		for (const CPixelTransform& transform : makeTransforms(multiplier))
+		{
+			const DSSRect window = CStackingEngine::MosaicFrameWindow(transform, Width, Height, multiplier, resultWidth, resultHeight);
+			const DSSRect dispatched = dispatchedRectangle(transform, multiplier, resultWidth, resultHeight);
+			CAPTURE(window.left, window.top, window.right, window.bottom, dispatched.left, dispatched.top, dispatched.right, dispatched.bottom);
+			REQUIRE(windowContains(DSSRect{ 0, 0, resultWidth, resultHeight }, window));
+			REQUIRE(windowContains(window, dispatched));
+			// Not more than the footprint of the pixels and the margins.
+			REQUIRE(window.width() <= dispatched.width() + 6);
+			REQUIRE(window.height() <= dispatched.height() + 6);
+		}
+	}
+
+	SECTION("A frame outside of the result gets one pixel")
+	{
+		for (const double shift : { -1000.0, 1000.0 })
+		{
+			const CPixelTransform transform = makeTransform(shift, shift / 2, 0.0, multiplier);
+			const DSSRect window = CStackingEngine::MosaicFrameWindow(transform, Width, Height, multiplier, resultWidth, resultHeight);
+			CAPTURE(shift);
+			REQUIRE(window.left == 0);
+			REQUIRE(window.top == 0);
+			REQUIRE(window.right == 1);
+			REQUIRE(window.bottom == 1);
+		}
+	}
+}
+
+TEST_CASE("Mosaic windows, stacking in the window", "[Stacking][Mosaic]")
+{
+	// Pixel size 1 runs the AVX code, 2 the conventional one.
+	const int multiplier = GENERATE(1, 2);
+	const int resultWidth = 2 * Width * multiplier;
+	const int resultHeight = 2 * Height * multiplier;
+	CAPTURE(multiplier);
+	typedef float T;
+
+	std::shared_ptr<CMemoryBitmap> pBitmap = std::make_shared<CGrayBitmapT<T>>();
+	REQUIRE(pBitmap->Init(Width, Height) == true);
+	auto* pGray = dynamic_cast<CGrayBitmapT<T>*>(pBitmap.get());
+	for (int i = 0; i < Width * Height; ++i)
+		pGray->m_vPixels[i] = static_cast<T>(1 + i % 997);
+
+	CEntropyInfo entropyInfo;
+	entropyInfo.Init(pBitmap, 10, nullptr);
+	AvxEntropy avxEntropy(*pBitmap, entropyInfo, nullptr);
+	CTaskInfo taskInfo;
+	CBackgroundCalibration backgroundCalib;
+	backgroundCalib.SetMode(BCM_NONE, BCI_LINEAR, RBCM_MAXIMUM);
+	const DSSRect rect(0, 0, resultWidth, resultHeight);
+
+	for (const CPixelTransform& transform : makeTransforms(multiplier))
+	{
+		std::shared_ptr<CMemoryBitmap> pTempBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pTempBitmap->Init(resultWidth, resultHeight) == true);
+		AvxStacking avxStacking(0, Height, *pBitmap, *pTempBitmap, rect, avxEntropy);
+		REQUIRE(avxStacking.stack(transform, taskInfo, backgroundCalib, std::shared_ptr<CMemoryBitmap>{}, multiplier) == 0);
+		const auto* pFull = dynamic_cast<CGrayBitmapT<T>*>(pTempBitmap.get());
+
+		const DSSRect window = CStackingEngine::MosaicFrameWindow(transform, Width, Height, multiplier, resultWidth, resultHeight);
+		std::shared_ptr<CMemoryBitmap> pWindowBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pWindowBitmap->Init(window.width(), window.height()) == true);
+		AvxStacking windowStacking(0, Height, *pBitmap, *pWindowBitmap, rect, avxEntropy);
+		windowStacking.setWindow(window);
+		REQUIRE(windowStacking.stack(transform, taskInfo, backgroundCalib, std::shared_ptr<CMemoryBitmap>{}, multiplier) == 0);
+		const auto* pWindow = dynamic_cast<CGrayBitmapT<T>*>(pWindowBitmap.get());
+
+		// The window holds the same pixels as the whole result, which is empty around it.
+		int nrOutside = 0;
+		for (int j = 0; j < resultHeight; j++)
+			for (int i = 0; i < resultWidth; i++)
+				if (!window.contains(QPoint{ i, j }) && pFull->m_vPixels[static_cast<size_t>(j) * resultWidth + i] != 0)
+					++nrOutside;
+		REQUIRE(nrOutside == 0);
+		for (int j = 0; j < window.height(); j++)
+		{
+			CAPTURE(j);
+			REQUIRE(memcmp(pWindow->m_vPixels.data() + static_cast<size_t>(j) * window.width(),
+				pFull->m_vPixels.data() + static_cast<size_t>(window.top + j) * resultWidth + window.left, window.width() * sizeof(T)) == 0);
+		}
+	}
+}
+
+TEST_CASE("Mosaic windows, accumulation of the window", "[AVX][Accumulation][Mosaic]")
+{
+	constexpr int W = 166;
+	constexpr int H = 142;
+	// The window doesn't start on a vector of pixels, and its lines end with a partial vector.
+	const DSSRect window{ 13, 7, 13 + 91, 7 + 50 };
+	const int nrStacked = 3;
+	const MULTIBITMAPPROCESSMETHOD method = GENERATE(MBP_FASTAVERAGE, MBP_MAXIMUM);
+	CAPTURE(static_cast<int>(method));
+
+	CTaskInfo taskInfo;
+	taskInfo.SetMethod(method, 0, 0);
+	std::mt19937 generator{ 5 };
+	std::uniform_real_distribution<float> distribution{ 0.0f, 60000.0f };
+
+	// The output of the previous frames, and the temp bitmap of the frame which is 0 outside of the window.
+	C96BitFloatColorBitmap previous;
+	REQUIRE(previous.Init(W, H) == true);
+	const auto makeOutput = [&previous]() -> std::shared_ptr<C96BitFloatColorBitmap>
+	{
+		auto pOutput = std::make_shared<C96BitFloatColorBitmap>();
+		pOutput->Init(W, H);
+		pOutput->m_Red.m_vPixels = previous.m_Red.m_vPixels;
+		pOutput->m_Green.m_vPixels = previous.m_Green.m_vPixels;
+		pOutput->m_Blue.m_vPixels = previous.m_Blue.m_vPixels;
+		return pOutput;
+	};
+	const auto pFull = std::make_shared<C96BitFloatColorBitmap>();
+	C96BitFloatColorBitmap& full = *pFull;
+	REQUIRE(full.Init(W, H) == true);
+	for (auto* pPlanes : { &previous.m_Red.m_vPixels, &previous.m_Green.m_vPixels, &previous.m_Blue.m_vPixels })
+		for (float& pixel : *pPlanes)
+			pixel = distribution(generator);
+	for (auto* pPlanes : { &full.m_Red.m_vPixels, &full.m_Green.m_vPixels, &full.m_Blue.m_vPixels })
+		for (int j = window.top; j < window.bottom; j++)
+			for (int i = window.left; i < window.right; i++)
+				(*pPlanes)[static_cast<size_t>(j) * W + i] = distribution(generator);
+
+	std::shared_ptr<CMemoryBitmap> pWindowBitmap = std::make_shared<C96BitFloatColorBitmap>();
+	REQUIRE(pWindowBitmap->Init(window.width(), window.height()) == true);
+	auto* pWindow = dynamic_cast<C96BitFloatColorBitmap*>(pWindowBitmap.get());
+	for (int j = 0; j < window.height(); j++)
+		for (int i = 0; i < window.width(); i++)
+		{
+			const size_t offset = static_cast<size_t>(window.top + j) * W + window.left + i;
+			const size_t windowOffset = static_cast<size_t>(j) * window.width() + i;
+			pWindow->m_Red.m_vPixels[windowOffset] = full.m_Red.m_vPixels[offset];
+			pWindow->m_Green.m_vPixels[windowOffset] = full.m_Green.m_vPixels[offset];
+			pWindow->m_Blue.m_vPixels[windowOffset] = full.m_Blue.m_vPixels[offset];
+		}
+
+	CEntropyInfo entropyInfo;
+	entropyInfo.Init(pFull, 10, nullptr);
+	AvxEntropy avxEntropy(full, entropyInfo, nullptr);
+
+	const std::shared_ptr<C96BitFloatColorBitmap> pExpected = makeOutput();
+	AvxAccumulation fullAccumulation(DSSRect(0, 0, W, H), taskInfo, full, *pExpected, avxEntropy);
+	REQUIRE(fullAccumulation.accumulate(nrStacked) == 0);
+	const C96BitFloatColorBitmap& expected = *pExpected;
+
+	const auto sameOutput = [&expected](const C96BitFloatColorBitmap& output) -> bool
+	{
+		// Inside of the window, the vectors and the rest of the lines are not the same pixels.
+		const auto same = [](const std::vector<float>& lhs, const std::vector<float>& rhs)
+		{
+			return std::equal(lhs.cbegin(), lhs.cend(), rhs.cbegin(), [](const float a, const float b) { return std::abs(a - b) <= 1e-5f * std::max(std::abs(a), 1.0f); });
+		};
+		return same(output.m_Red.m_vPixels, expected.m_Red.m_vPixels) && same(output.m_Green.m_vPixels, expected.m_Green.m_vPixels) && same(output.m_Blue.m_vPixels, expected.m_Blue.m_vPixels);
+	};
+
+	SECTION("The pixels outside of the window are averaged with 0")
+	{
+		const std::shared_ptr<C96BitFloatColorBitmap> pOutput = makeOutput();
+		AvxAccumulation windowAccumulation(window, taskInfo, *pWindowBitmap, *pOutput, avxEntropy, true);
+		REQUIRE(windowAccumulation.accumulate(nrStacked) == 0);
+		REQUIRE(sameOutput(*pOutput));
+	}
+
+	SECTION("Without averaging, the pixels outside of the window are left")
+	{
+		const std::shared_ptr<C96BitFloatColorBitmap> pOutput = makeOutput();
+		AvxAccumulation windowAccumulation(window, taskInfo, *pWindowBitmap, *pOutput, avxEntropy);
+		REQUIRE(windowAccumulation.accumulate(nrStacked) == 0);
+		int nrDifferences = 0;
+		for (int j = 0; j < H; j++)
+			for (int i = 0; i < W; i++)
+			{
+				const size_t offset = static_cast<size_t>(j) * W + i;
+				if (!window.contains(QPoint{ i, j }) && pOutput->m_Green.m_vPixels[offset] != previous.m_Green.m_vPixels[offset])
+					++nrDifferences;
+			}
+		REQUIRE(nrDifferences == 0);
+		if (method == MBP_MAXIMUM)
+			REQUIRE(sameOutput(*pOutput));
+	}
+
+	SECTION("A window outside of the output is rejected")
+	{
+		const std::shared_ptr<C96BitFloatColorBitmap> pOutput = makeOutput();
+		AvxAccumulation windowAccumulation(DSSRect(W - 50, 7, W - 50 + 91, 57), taskInfo, *pWindowBitmap, *pOutput, avxEntropy, true);
+		REQUIRE(windowAccumulation.accumulate(nrStacked) != 0);
+		REQUIRE(pOutput->m_Red.m_vPixels == previous.m_Red.m_vPixels);
+	}
+}
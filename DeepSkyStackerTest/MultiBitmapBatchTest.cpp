@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "DSSTools.h"
+#include "MultiBitmapBatch.h"
+
+namespace
+{
+	//
+	// Combines random scan lines with MultiBitmapBatch and compares each pixel with the per-pixel functions of DSSTools.h.
+	//
+	template <class T>
+	bool batchEqualsPerPixel(const MULTIBITMAPPROCESSMETHOD method, const int nrIterations, const int nrFrames, const int width, const bool keepZeros, const std::uint32_t seed)
+	{
+		std::mt19937 engine{ seed };
+		std::vector<std::vector<T>> lines(nrFrames, std::vector<T>(width));
+		for (auto& line : lines)
+			for (auto& value : line)
+			{
+				const std::uint32_t r = engine();
+				// 10% zeros, 5% outliers.
+				value = (r % 100) < 10 ? T{ 0 } : static_cast<T>(1000 + (r >> 8) % 400 + ((r % 100) >= 95 ? 20000 : 0));
+			}
+		std::vector<void*> scanLines;
+		for (auto& line : lines)
+			scanLines.push_back(line.data());
+
+		std::vector<float> result(width);
+		DSS::MultiBitmapBatch<T> batch{ scanLines.size() };
+		for (int i = 0; i < width; i += batch.BatchSize)
+		{
+			batch.load(scanLines, i, width - i, keepZeros, false);
+			batch.combine(method, 2.0, nrIterations, result.data() + i);
+		}
+
+		std::vector<T> values, work1, work2;
+		for (int i = 0; i < width; ++i)
+		{
+			values.clear();
+			for (const auto& line : lines)
+				if (line[i] != 0 || keepZeros)
+					values.push_back(line[i]);
+
+			double expected = 0;
+			switch (method)
+			{
+			case MBP_MEDIAN: expected = Median(values); break;
+			case MBP_AVERAGE: expected = Average(values); break;
+			case MBP_MAXIMUM: expected = Maximum(values); break;
+			case MBP_SIGMACLIP: expected = KappaSigmaClip(values, 2.0, nrIterations, work1); break;
+			case MBP_MEDIANSIGMACLIP: expected = MedianKappaSigmaClip(values, 2.0, nrIterations, work1, work2); break;
+			default: return false;
+			}
+			const float expectedFloat = static_cast<float>(expected);
+			if (std::isnan(expectedFloat) ? !std::isnan(result[i]) : result[i] != expectedFloat)
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE("MultiBitmapBatch", "[MultiBitmap][Batch]")
+{
+	SECTION("Median")
+	{
+		for (const int nrFrames : { 1, 2, 5, 16, 33 })
+			REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_MEDIAN, 0, nrFrames, 200, false, nrFrames));
+	}
+
+	SECTION("Average and maximum")
+	{
+		REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_AVERAGE, 0, 9, 130, false, 1));
+		REQUIRE(batchEqualsPerPixel<float>(MBP_AVERAGE, 0, 9, 130, false, 2));
+		REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_MAXIMUM, 0, 9, 130, false, 3));
+	}
+
+	SECTION("Kappa-sigma clipping")
+	{
+		for (const int nrIterations : { 0, 1, 5 })
+		{
+			REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_SIGMACLIP, nrIterations, 12, 257, false, 10 + nrIterations));
+			REQUIRE(batchEqualsPerPixel<std::uint8_t>(MBP_SIGMACLIP, nrIterations, 7, 65, false, 20 + nrIterations));
+		}
+	}
+
+	SECTION("Median kappa-sigma clipping")
+	{
+		for (const int nrIterations : { 0, 1, 5 })
+			REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_MEDIANSIGMACLIP, nrIterations, 12, 257, false, 30 + nrIterations));
+	}
+
+	SECTION("Zeros are kept if requested (image order)")
+	{
+		REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_SIGMACLIP, 3, 10, 100, true, 40));
+		REQUIRE(batchEqualsPerPixel<std::uint16_t>(MBP_MEDIAN, 0, 10, 100, true, 41));
+	}
+}
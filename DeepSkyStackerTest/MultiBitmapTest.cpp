@@ -0,0 +1,417 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "GreyMultiBitmap.h"
+#include "ColorMultiBitmap.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+#include "DSSTools.h"
+#include "dssrect.h"
+#include <fstream>
+
+namespace
+{
+	constexpr int Width = 97;
+	constexpr int Height = 61;
+	constexpr int NrFrames = 6;
+
+	//
+	// Mosaic like frames: each one covers another rectangle of the output and is zero around it (the last frame is empty).
+	// Inside the rectangle some pixels are zero too, they must not be confused with the padding.
+	// The channels of a colour frame have different margins.
+	//
+	std::array<int, 4> coveredRectangle(const int frame, const int channel)
+	{
+		switch (frame)
+		{
+		case 0: return { 0, 0, Width, Height };
+		case 1: return { 5 + channel, 3, Width - 9, Height - 2 };
+		case 2: return { 0, 20, 40 - 2 * channel, Height };
+		case 3: return { 60, 0, Width, 35 + channel };
+		case 4: return { Width - 1, Height - 1, Width, Height };
+		default: return { 0, 0, 0, 0 };
+		}
+	}
+
+	template <class Bitmap>
+	std::shared_ptr<Bitmap> makeFrame(const int frame, const int nrChannels)
+	{
+		std::mt19937 generator{ static_cast<unsigned>(frame + 1) };
+		std::uniform_int_distribution<int> distribution{ 1, 65535 };
+		auto pBitmap = std::make_shared<Bitmap>();
+		pBitmap->Init(Width, Height);
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				std::array<double, 3> values{};
+				for (int c = 0; c < nrChannels; c++)
+				{
+					const auto [left, top, right, bottom] = coveredRectangle(frame, c);
+					if (i >= left && i < right && j >= top && j < bottom && (i * 7 + j * 3 + c) % 13 != 0)
+						values[c] = distribution(generator) / 256.0;
+				}
+				if (nrChannels == 1)
+					pBitmap->SetPixel(i, j, values[0]);
+				else
+					pBitmap->SetPixel(i, j, values[0], values[1], values[2]);
+			}
+		return pBitmap;
+	}
+
+	// The maximum, the average and the number of the non zero values of each pixel (CMultiBitmap ignores the zeros).
+	std::array<double, 3> expectedValues(const std::vector<std::shared_ptr<CMemoryBitmap>>& frames, const int i, const int j, const int channel)
+	{
+		std::vector<double> values;
+		for (const auto& pFrame : frames)
+		{
+			double gray, red, green, blue;
+			if (pFrame->IsMonochrome())
+				pFrame->GetPixel(i, j, gray);
+			else
+			{
+				pFrame->GetPixel(i, j, red, green, blue);
+				gray = channel == 0 ? red : (channel == 1 ? green : blue);
+			}
+			if (gray != 0)
+				values.push_back(gray);
+		}
+		return { Maximum(values), values.empty() ? 0.0 : Average(values), static_cast<double>(values.size()) };
+	}
+
+	void checkResult(CMultiBitmap& multiBitmap, const MULTIBITMAPPROCESSMETHOD method, const int nrBitmaps, const std::vector<std::shared_ptr<CMemoryBitmap>>& frames)
+	{
+		multiBitmap.SetNrBitmaps(nrBitmaps);
+		multiBitmap.SetProcessingMethod(method, 2.0, 1);
+		for (const auto& pFrame : frames)
+			REQUIRE(multiBitmap.AddBitmap(pFrame.get()));
+		REQUIRE(multiBitmap.GetNrAddedBitmaps() == NrFrames);
+
+		const std::shared_ptr<CMemoryBitmap> pResult = multiBitmap.GetResult();
+		REQUIRE(static_cast<bool>(pResult));
+		REQUIRE(pResult->Width() == Width);
+		REQUIRE(pResult->Height() == Height);
+
+		const int nrChannels = multiBitmap.GetNrChannels();
+		int nrDifferences = 0;
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				std::array<double, 3> result{};
+				if (nrChannels == 1)
+					pResult->GetPixel(i, j, result[0]);
+				else
+					pResult->GetPixel(i, j, result[0], result[1], result[2]);
+				for (int c = 0; c < nrChannels; c++)
+				{
+					const auto [maximum, average, count] = expectedValues(frames, i, j, c);
+					// The average is truncated to 16 bits, it is not defined without values.
+					const bool equal = method == MBP_MAXIMUM ? result[c] == maximum : (count == 0 || std::abs(result[c] - average) <= 1.0 / 256.0);
+					if (!equal)
+						++nrDifferences;
+				}
+			}
+		REQUIRE(nrDifferences == 0);
+	}
+
+	// The rectangle rc of a frame.
+	template <class Bitmap>
+	std::shared_ptr<Bitmap> makeWindow(const CMemoryBitmap& frame, const DSSRect& rc)
+	{
+		auto pWindow = std::make_shared<Bitmap>();
+		pWindow->Init(rc.width(), rc.height());
+		for (int j = 0; j < rc.height(); j++)
+			for (int i = 0; i < rc.width(); i++)
+			{
+				double gray, red, green, blue;
+				if (frame.IsMonochrome())
+				{
+					frame.GetPixel(rc.left + i, rc.top + j, gray);
+					pWindow->SetPixel(i, j, gray);
+				}
+				else
+				{
+					frame.GetPixel(rc.left + i, rc.top + j, red, green, blue);
+					pWindow->SetPixel(i, j, red, green, blue);
+				}
+			}
+		return pWindow;
+	}
+
+	// The lines [top, top + rows[ of a frame.
+	template <class Bitmap>
+	std::shared_ptr<Bitmap> makeBand(const CMemoryBitmap& frame, const int top, const int rows)
+	{
+		return makeWindow<Bitmap>(frame, DSSRect{ 0, top, Width, top + rows });
+	}
+
+	// The rectangle covered by all the channels of a frame with a margin of one pixel, one pixel for the empty frame.
+	DSSRect frameWindow(const int frame)
+	{
+		int left = Width, top = Height, right = 0, bottom = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			const auto [l, t, r, b] = coveredRectangle(frame, c);
+			if (l >= r || t >= b)
+				continue;
+			left = std::min(left, l);
+			top = std::min(top, t);
+			right = std::max(right, r);
+			bottom = std::max(bottom, b);
+		}
+		if (left >= right)
+			return DSSRect{ 0, 0, 1, 1 };
+		return DSSRect{ std::max(left - 1, 0), std::max(top - 1, 0), std::min(right + 1, Width), std::min(bottom + 1, Height) };
+	}
+
+	std::vector<char> readFile(const fs::path& file)
+	{
+		std::ifstream stream{ file, std::ios::binary };
+		return { std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{} };
+	}
+
+	// Gives access to the part files.
+	template <class MultiBitmap>
+	class PartFilesMultiBitmap : public MultiBitmap
+	{
+	public:
+		using MultiBitmap::m_vFiles;
+	};
+
+	//
+	// Each part file holds, for each frame, its lines and for each line and channel the [begin, end) byte range of
+	// the non zero values followed by these bytes.
+	//
+	void checkSpans(const std::vector<CBitmapPartFile>& vFiles, const std::vector<std::shared_ptr<CMemoryBitmap>>& frames, const int nrChannels)
+	{
+		const size_t channelSize = static_cast<size_t>(frames.front()->BitPerSample()) * Width / 8;
+		std::vector<std::uint8_t> scanLine(channelSize * nrChannels);
+
+		for (const CBitmapPartFile& partFile : vFiles)
+		{
+			const std::vector<char> content = readFile(partFile.file);
+			size_t position = 0;
+			for (const auto& pFrame : frames)
+				for (int j = partFile.m_lStartRow; j <= partFile.m_lEndRow; j++)
+				{
+					REQUIRE(pFrame->GetScanLine(j, scanLine.data()));
+					for (int c = 0; c < nrChannels; c++)
+					{
+						const std::uint8_t* const pChannel = scanLine.data() + c * channelSize;
+						size_t begin = 0;
+						size_t end = channelSize;
+						while (begin < end && pChannel[begin] == 0)
+							++begin;
+						while (end > begin && pChannel[end - 1] == 0)
+							--end;
+
+						std::uint32_t span[2];
+						REQUIRE(position + sizeof(span) <= content.size());
+						std::memcpy(span, content.data() + position, sizeof(span));
+						position += sizeof(span);
+						CAPTURE(j, c);
+						REQUIRE(span[0] == begin);
+						REQUIRE(span[1] == end);
+						REQUIRE(position + (end - begin) <= content.size());
+						REQUIRE(std::equal(pChannel + begin, pChannel + end, reinterpret_cast<const std::uint8_t*>(content.data() + position)));
+						position += end - begin;
+					}
+				}
+			REQUIRE(position == content.size());
+		}
+	}
+
+	template <class MultiBitmap>
+	void checkSameParts(PartFilesMultiBitmap<MultiBitmap>& whole, PartFilesMultiBitmap<MultiBitmap>& parts, const std::vector<std::shared_ptr<CMemoryBitmap>>& frames)
+	{
+		REQUIRE(parts.m_vFiles.size() == whole.m_vFiles.size());
+		for (size_t n = 0; n < whole.m_vFiles.size(); n++)
+		{
+			CAPTURE(n);
+			REQUIRE(parts.m_vFiles[n].m_lStartRow == whole.m_vFiles[n].m_lStartRow);
+			REQUIRE(parts.m_vFiles[n].m_lEndRow == whole.m_vFiles[n].m_lEndRow);
+			REQUIRE(readFile(parts.m_vFiles[n].file) == readFile(whole.m_vFiles[n].file));
+		}
+		checkSpans(parts.m_vFiles, frames, whole.GetNrChannels());
+
+		const std::shared_ptr<CMemoryBitmap> pWholeResult = whole.GetResult();
+		const std::shared_ptr<CMemoryBitmap> pPartsResult = parts.GetResult();
+		REQUIRE(static_cast<bool>(pWholeResult));
+		REQUIRE(static_cast<bool>(pPartsResult));
+		int nrDifferences = 0;
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				double wholeRed, wholeGreen, wholeBlue, partsRed, partsGreen, partsBlue;
+				pWholeResult->GetPixel(i, j, wholeRed, wholeGreen, wholeBlue);
+				pPartsResult->GetPixel(i, j, partsRed, partsGreen, partsBlue);
+				if (wholeRed != partsRed || wholeGreen != partsGreen || wholeBlue != partsBlue)
+					++nrDifferences;
+			}
+		REQUIRE(nrDifferences == 0);
+	}
+
+	template <class MultiBitmap, class Bitmap>
+	void checkBands(const int nrBitmaps, const int bandHeight, const std::vector<std::shared_ptr<CMemoryBitmap>>& frames)
+	{
+		PartFilesMultiBitmap<MultiBitmap> whole;
+		PartFilesMultiBitmap<MultiBitmap> bands;
+		for (CMultiBitmap* pMultiBitmap : { static_cast<CMultiBitmap*>(&whole), static_cast<CMultiBitmap*>(&bands) })
+		{
+			pMultiBitmap->SetNrBitmaps(nrBitmaps);
+			pMultiBitmap->SetProcessingMethod(MBP_AVERAGE, 2.0, 1);
+		}
+
+		for (int frame = 0; frame < NrFrames; frame++)
+		{
+			REQUIRE(whole.AddBitmap(frames[frame].get()));
+			for (int top = 0; top < Height; top += bandHeight)
+			{
+				const int rows = std::min(bandHeight, Height - top);
+				const auto pBand = makeBand<Bitmap>(*frames[frame], top, rows);
+				REQUIRE(bands.AddBitmapRows(pBand.get(), top, Height));
+				// The bitmap is counted with its last band.
+				CAPTURE(frame, top);
+				REQUIRE(bands.GetNrAddedBitmaps() == (top + rows == Height ? frame + 1 : frame));
+			}
+		}
+		REQUIRE(whole.GetNrAddedBitmaps() == NrFrames);
+
+		// The bands are appended to the part files they intersect: the same files as with the whole bitmaps.
+		checkSameParts(whole, bands, frames);
+	}
+
+	template <class MultiBitmap, class Bitmap>
+	void checkWindows(const int nrBitmaps, const std::vector<std::shared_ptr<CMemoryBitmap>>& frames)
+	{
+		PartFilesMultiBitmap<MultiBitmap> whole;
+		PartFilesMultiBitmap<MultiBitmap> windows;
+		for (CMultiBitmap* pMultiBitmap : { static_cast<CMultiBitmap*>(&whole), static_cast<CMultiBitmap*>(&windows) })
+		{
+			pMultiBitmap->SetNrBitmaps(nrBitmaps);
+			pMultiBitmap->SetProcessingMethod(MBP_AVERAGE, 2.0, 1);
+		}
+
+		for (int frame = 0; frame < NrFrames; frame++)
+		{
+			REQUIRE(whole.AddBitmap(frames[frame].get()));
+			const DSSRect rcWindow = frameWindow(frame);
+			const auto pWindow = makeWindow<Bitmap>(*frames[frame], rcWindow);
+			CAPTURE(frame);
+			REQUIRE(windows.AddBitmapRect(pWindow.get(), rcWindow, Width, Height));
+			REQUIRE(windows.GetNrAddedBitmaps() == frame + 1);
+		}
+		REQUIRE(whole.GetNrAddedBitmaps() == NrFrames);
+
+		// A rectangle that is not the size of the bitmap or is outside of the output is rejected.
+		const auto pWindow = makeWindow<Bitmap>(*frames[0], DSSRect{ 0, 0, 10, 10 });
+		REQUIRE_FALSE(windows.AddBitmapRect(pWindow.get(), DSSRect{ 0, 0, 10, 11 }, Width, Height));
+		REQUIRE_FALSE(windows.AddBitmapRect(pWindow.get(), DSSRect{ Width - 5, 0, Width + 5, 10 }, Width, Height));
+		REQUIRE(windows.GetNrAddedBitmaps() == NrFrames);
+
+		// The lines outside of the rectangles are empty: the same files as with the whole bitmaps.
+		checkSameParts(whole, windows, frames);
+	}
+}
+
+TEST_CASE("CMultiBitmap writes and reads back the non zero part of the rows", "[MultiBitmap]")
+{
+	const MULTIBITMAPPROCESSMETHOD method = GENERATE(MBP_MAXIMUM, MBP_AVERAGE);
+	// A single part file, and part files of a few rows (the number of lines per file is divided by the number of bitmaps).
+	const int nrBitmaps = GENERATE(NrFrames, 200000);
+	CAPTURE(static_cast<int>(method), nrBitmaps);
+
+	SECTION("Gray")
+	{
+		std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+		for (int frame = 0; frame < NrFrames; frame++)
+			frames.push_back(makeFrame<C16BitGrayBitmap>(frame, 1));
+
+		CGrayMultiBitmapT<std::uint16_t> multiBitmap;
+		checkResult(multiBitmap, method, nrBitmaps, frames);
+	}
+
+	SECTION("Colour")
+	{
+		std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+		for (int frame = 0; frame < NrFrames; frame++)
+			frames.push_back(makeFrame<C48BitColorBitmap>(frame, 3));
+
+		CColorMultiBitmapT<std::uint16_t> multiBitmap;
+		checkResult(multiBitmap, method, nrBitmaps, frames);
+	}
+}
+
+TEST_CASE("CMultiBitmap adds the bitmaps band by band", "[MultiBitmap][Drizzle]")
+{
+	const int nrBitmaps = GENERATE(NrFrames, 200000);
+	// Bands of a few lines (the last one partial), crossing the part files, and a single band.
+	const int bandHeight = GENERATE(4, 17, Height);
+	CAPTURE(nrBitmaps, bandHeight);
+
+	SECTION("Gray")
+	{
+		std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+		for (int frame = 0; frame < NrFrames; frame++)
+			frames.push_back(makeFrame<C16BitGrayBitmap>(frame, 1));
+
+		checkBands<CGrayMultiBitmapT<std::uint16_t>, C16BitGrayBitmap>(nrBitmaps, bandHeight, frames);
+	}
+
+	SECTION("Colour")
+	{
+		std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+		for (int frame = 0; frame < NrFrames; frame++)
+			frames.push_back(makeFrame<C48BitColorBitmap>(frame, 3));
+
+		checkBands<CColorMultiBitmapT<std::uint16_t>, C48BitColorBitmap>(nrBitmaps, bandHeight, frames);
+	}
+}
+
+TEST_CASE("CMultiBitmap adds the rectangle covered by each frame", "[MultiBitmap][Mosaic]")
+{
+	const int nrBitmaps = GENERATE(NrFrames, 200000);
+	CAPTURE(nrBitmaps);
+
+	SECTION("Gray")
+	{
+		std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+		for (int frame = 0; frame < NrFrames; frame++)
+			frames.push_back(makeFrame<C16BitGrayBitmap>(frame, 1));
+
+		checkWindows<CGrayMultiBitmapT<std::uint16_t>, C16BitGrayBitmap>(nrBitmaps, frames);
+	}
+
+	SECTION("Colour")
+	{
+		std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+		for (int frame = 0; frame < NrFrames; frame++)
+			frames.push_back(makeFrame<C48BitColorBitmap>(frame, 3));
+
+		checkWindows<CColorMultiBitmapT<std::uint16_t>, C48BitColorBitmap>(nrBitmaps, frames);
+	}
+}
+
+TEST_CASE("CMultiBitmap rejects a truncated part file", "[MultiBitmap]")
+{
+	const int nrBitmaps = GENERATE(NrFrames, 200000);
+	// The last byte, the middle of the file, and a cut in the span of the first row.
+	const int cut = GENERATE(0, 1, 2);
+	CAPTURE(nrBitmaps, cut);
+
+	std::vector<std::shared_ptr<CMemoryBitmap>> frames;
+	for (int frame = 0; frame < NrFrames; frame++)
+		frames.push_back(makeFrame<C16BitGrayBitmap>(frame, 1));
+
+	PartFilesMultiBitmap<CGrayMultiBitmapT<std::uint16_t>> multiBitmap;
+	multiBitmap.SetNrBitmaps(nrBitmaps);
+	multiBitmap.SetProcessingMethod(MBP_AVERAGE, 2.0, 1);
+	for (const auto& pFrame : frames)
+		REQUIRE(multiBitmap.AddBitmap(pFrame.get()));
+
+	const fs::path& file = multiBitmap.m_vFiles.back().file;
+	const std::uintmax_t size = fs::file_size(file);
+	REQUIRE(size > 8);
+	fs::resize_file(file, cut == 0 ? size - 1 : (cut == 1 ? size / 2 : 5));
+
+	REQUIRE_FALSE(static_cast<bool>(multiBitmap.GetResult()));
+}
@@ -0,0 +1,170 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "RawPixelConversion.h"
+#include "avx_bitmap_filler.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+
+using namespace DSS;
+
+namespace
+{
+	constexpr float RedScale = 1.8f;
+	constexpr float GreenScale = 1.0f;
+	constexpr float BlueScale = 1.35f;
+
+	// LibRaw::COLOR() of a 2x2 Bayer pattern: 0 = red, 1 = green, 2 = blue, 3 = second green.
+	int libRawColour(const int row, const int col, const CFATYPE cfaType)
+	{
+		switch (::GetBayerColor(col, row, cfaType))
+		{
+		case BAYER_RED: return 0;
+		case BAYER_BLUE: return 2;
+		default: return (row & 1) == 0 ? 1 : 3;
+		}
+	}
+
+	// 14 bit raw data, the scale factors make some pixels exceed 65535 after the stretch and 65534 after the colour factors.
+	std::vector<std::uint16_t> makeRawImage(const int width, const int height)
+	{
+		std::mt19937 generator{ 42 };
+		std::uniform_int_distribution<int> distribution{ 0, 16383 };
+		std::vector<std::uint16_t> image(static_cast<size_t>(width) * height);
+		for (auto& value : image)
+			value = static_cast<std::uint16_t>(distribution(generator));
+		image[0] = 16383;
+		image[1] = 0;
+		return image;
+	}
+
+	//
+	// The former Bayer path of CRawDecod::LoadRawFile(): linear stretch into a temporary buffer,
+	// conversion to big endian and the bitmap filler.
+	//
+	template <class Filler>
+	std::vector<std::uint16_t> bayerThroughFiller(std::vector<std::uint16_t> raw, const int width, const int height, const CFATYPE cfaType, const float(&scaleMul)[4])
+	{
+		for (int row = 0; row < height; row++)
+			for (int col = 0; col < width; col++)
+			{
+				std::uint16_t& value = raw[static_cast<size_t>(row) * width + col];
+				const float val = scaleMul[libRawColour(row, col, cfaType)] * static_cast<float>(value);
+				value = static_cast<std::uint16_t>(std::clamp(static_cast<int>(val), 0, 65535));
+			}
+		for (auto& value : raw)
+			value = _byteswap_ushort(value);
+
+		C16BitGrayBitmap bitmap;
+		bitmap.Init(width, height);
+		Filler filler{ &bitmap, nullptr, RedScale, GreenScale, BlueScale };
+		filler.SetCFAType(cfaType);
+		filler.setGrey(true);
+		filler.setWidth(width);
+		filler.setHeight(height);
+		filler.setMaxColors(65535);
+		for (int row = 0; row < height; row++)
+			filler.Write(&raw[static_cast<size_t>(row) * width], sizeof(std::uint16_t), width, row);
+
+		return bitmap.m_vPixels;
+	}
+
+	struct Flip
+	{
+		int width;
+		int height;
+		int startOffset;
+		int columnStep;
+		int rowStep;
+	};
+
+	// The former colour path: 16 bit PPM rows (curve[] applied, big endian) and the bitmap filler.
+	template <class Filler>
+	void colourThroughFiller(const std::vector<std::array<std::uint16_t, 4>>& image, const std::vector<std::uint16_t>& curve, const Flip& flip, C48BitColorBitmap& bitmap)
+	{
+		bitmap.Init(flip.width, flip.height);
+		Filler filler{ &bitmap, nullptr, RedScale, GreenScale, BlueScale };
+		filler.setGrey(false);
+		filler.setWidth(flip.width);
+		filler.setHeight(flip.height);
+		filler.setMaxColors(65535);
+
+		std::vector<std::uint16_t> ppm(static_cast<size_t>(flip.width) * 3);
+		for (int row = 0; row < flip.height; row++)
+		{
+			int soff = flip.startOffset + row * flip.rowStep;
+			for (int col = 0; col < flip.width; col++, soff += flip.columnStep)
+				for (int c = 0; c < 3; c++)
+					ppm[col * 3 + c] = _byteswap_ushort(curve[image[soff][c]]);
+			filler.Write(ppm.data(), 3 * sizeof(std::uint16_t), flip.width, row);
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("RAW Bayer conversion writes the same pixels as the bitmap filler", "[RAW][BitmapFiller]", AvxBitmapFiller, NonAvxBitmapFiller)
+{
+	constexpr int Width = 37; // Odd width and height: the last column and row start a new Bayer cell.
+	constexpr int Height = 11;
+	const float scaleMul[4] = { 2.1f * 65535.0f / 16383.0f, 65535.0f / 16383.0f, 1.6f * 65535.0f / 16383.0f, 1.02f * 65535.0f / 16383.0f };
+	const std::vector<std::uint16_t> raw = makeRawImage(Width, Height);
+
+	const CFATYPE cfaType = GENERATE(CFATYPE_NONE, CFATYPE_BGGR, CFATYPE_GRBG, CFATYPE_GBRG, CFATYPE_RGGB);
+	CAPTURE(static_cast<int>(cfaType));
+
+	const std::vector<std::uint16_t> expected = bayerThroughFiller<TestType>(raw, Width, Height, cfaType, scaleMul);
+
+	std::vector<std::uint16_t> direct = raw;
+	const auto colourOf = [cfaType](const int row, const int col) { return libRawColour(row, col, cfaType); };
+	const RawPixelConversion::BayerFactors factors = RawPixelConversion::bayerFactors(cfaType, RedScale, GreenScale, BlueScale);
+	for (int row = 0; row < Height; row++)
+		RawPixelConversion::stretchBayerRow(&direct[static_cast<size_t>(row) * Width], row, Width, colourOf, scaleMul, factors, RawPixelConversion::isRgbBayerPattern(cfaType));
+
+	REQUIRE(direct == expected);
+	if (RawPixelConversion::isRgbBayerPattern(cfaType))
+		REQUIRE(std::ranges::count(direct, std::uint16_t{ 65534 }) > 0); // Colour factors limited by adjustColor().
+	else
+		REQUIRE(std::ranges::count(direct, std::uint16_t{ 65535 }) > 0); // Clamped stretch without colour factors.
+}
+
+TEMPLATE_TEST_CASE("RAW colour conversion writes the same pixels as the bitmap filler", "[RAW][BitmapFiller]", AvxBitmapFiller, NonAvxBitmapFiller)
+{
+	constexpr int ImageWidth = 23;
+	constexpr int ImageHeight = 9;
+
+	std::vector<std::array<std::uint16_t, 4>> image(ImageWidth * ImageHeight);
+	std::mt19937 generator{ 7 };
+	std::uniform_int_distribution<int> distribution{ 0, 65535 };
+	for (auto& pixel : image)
+		for (auto& value : pixel)
+			value = static_cast<std::uint16_t>(distribution(generator));
+
+	// Gamma like output curve.
+	std::vector<std::uint16_t> curve(0x10000);
+	for (size_t i = 0; i < curve.size(); i++)
+		curve[i] = static_cast<std::uint16_t>(std::sqrt(static_cast<double>(i) / 65535.0) * 65535.0);
+
+	// The source offsets of write_ppm_tiff() for an unflipped, a 180 degree rotated and a transposed image.
+	const Flip flip = GENERATE(
+		Flip{ ImageWidth, ImageHeight, 0, 1, ImageWidth },
+		Flip{ ImageWidth, ImageHeight, ImageWidth * ImageHeight - 1, -1, -ImageWidth },
+		Flip{ ImageHeight, ImageWidth, 0, ImageWidth, 1 }
+	);
+	CAPTURE(flip.startOffset, flip.columnStep, flip.rowStep);
+
+	C48BitColorBitmap expected;
+	colourThroughFiller<TestType>(image, curve, flip, expected);
+
+	C48BitColorBitmap direct;
+	direct.Init(flip.width, flip.height);
+	const float scales[3] = { RedScale, GreenScale, BlueScale };
+	for (int row = 0; row < flip.height; row++)
+	{
+		const size_t outOffset = static_cast<size_t>(row) * flip.width;
+		RawPixelConversion::convertColourRow(reinterpret_cast<const std::uint16_t(*)[4]>(image.data()), curve.data(), flip.startOffset + row * flip.rowStep, flip.columnStep, flip.width,
+			scales, direct.m_Red.m_vPixels.data() + outOffset, direct.m_Green.m_vPixels.data() + outOffset, direct.m_Blue.m_vPixels.data() + outOffset);
+	}
+
+	REQUIRE(direct.m_Red.m_vPixels == expected.m_Red.m_vPixels);
+	REQUIRE(direct.m_Green.m_vPixels == expected.m_Green.m_vPixels);
+	REQUIRE(direct.m_Blue.m_vPixels == expected.m_Blue.m_vPixels);
+}
@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include <random>
+#include <numbers>
+#include "catch.h"
+#include "RunningStackingEngine.h"
+#include "PixelTransform.h"
+#include "dssrect.h"
+#include "GrayBitmap.h"
+#include "ColorBitmap.h"
+
+namespace
+{
+	constexpr int Width = 203; // Several blocks of input columns and bands of output rows, with partial ones.
+	constexpr int Height = 141;
+
+	template <class Bitmap>
+	std::shared_ptr<Bitmap> makeFrame(const unsigned seed)
+	{
+		std::mt19937 generator{ seed };
+		std::uniform_int_distribution<int> distribution{ 0, 65535 };
+		auto pBitmap = std::make_shared<Bitmap>();
+		pBitmap->Init(Width, Height);
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				// Some black pixels, they are not dispatched.
+				const bool black = (i + j) % 17 == 0;
+				const double red = black ? 0.0 : distribution(generator) / 256.0;
+				if constexpr (std::is_same_v<Bitmap, C48BitColorBitmap>)
+				{
+					const double green = black ? 0.0 : distribution(generator) / 256.0;
+					const double blue = black ? 0.0 : distribution(generator) / 256.0;
+					pBitmap->SetPixel(i, j, red, green, blue);
+				}
+				else
+					pBitmap->SetPixel(i, j, red);
+			}
+		return pBitmap;
+	}
+
+	CPixelTransform makeTransform(const double dx, const double dy, const double degrees, const bool bisquared)
+	{
+		const double angle = degrees * std::numbers::pi / 180.0;
+		CBilinearParameters parameters;
+		parameters.a0 = dx;
+		parameters.a1 = std::cos(angle);
+		parameters.a2 = -std::sin(angle);
+		parameters.b0 = dy;
+		parameters.b1 = std::sin(angle);
+		parameters.b2 = std::cos(angle);
+		if (bisquared)
+		{
+			parameters.Type = TT_BISQUARED;
+			parameters.a4 = 2e-4;
+			parameters.b5 = -3e-4;
+		}
+		return CPixelTransform{ parameters };
+	}
+
+	// The stacking loop of CRunningStackingEngine::AddImage before it was run in parallel (background calibration off).
+	void serialStackPixels(const CMemoryBitmap& input, const CPixelTransform& pixTransform, CMemoryBitmap& stack)
+	{
+		const int lWidth = input.Width();
+		const int lHeight = input.Height();
+		PIXELDISPATCHVECTOR vPixels;
+		for (int j = 0; j < lHeight; j++)
+			for (int i = 0; i < lWidth; i++)
+			{
+				double fRed, fGreen, fBlue;
+				const QPointF ptOut = pixTransform.transform(QPointF(i, j));
+				input.GetPixel(i, j, fRed, fGreen, fBlue);
+
+				if ((fRed != 0.0 || fGreen != 0.0 || fBlue != 0.0) && DSSRect{ 0, 0, lWidth, lHeight }.contains(ptOut))
+				{
+					vPixels.resize(0);
+					ComputePixelDispatch(ptOut, 1, vPixels);
+					for (const CPixelDispatch& Pixel : vPixels)
+					{
+						if (Pixel.m_lX >= 0 && Pixel.m_lX < lWidth && Pixel.m_lY >= 0 && Pixel.m_lY < lHeight)
+						{
+							double fPreviousRed, fPreviousGreen, fPreviousBlue;
+							stack.GetPixel(Pixel.m_lX, Pixel.m_lY, fPreviousRed, fPreviousGreen, fPreviousBlue);
+							fPreviousRed += fRed * Pixel.m_fPercentage;
+							fPreviousGreen += fGreen * Pixel.m_fPercentage;
+							fPreviousBlue += fBlue * Pixel.m_fPercentage;
+							stack.SetPixel(Pixel.m_lX, Pixel.m_lY, fPreviousRed, fPreviousGreen, fPreviousBlue);
+						}
+					}
+				}
+			}
+	}
+
+	// The float arithmetic of StackPixels in the order of the serial loop.
+	void serialFloatStackPixels(const CMemoryBitmap& input, const CPixelTransform& pixTransform, const double multiplier, float* pRed, float* pGreen, float* pBlue)
+	{
+		const int lWidth = input.Width();
+		const int lHeight = input.Height();
+		for (int j = 0; j < lHeight; j++)
+			for (int i = 0; i < lWidth; i++)
+			{
+				double fRed, fGreen, fBlue;
+				const QPointF ptOut = pixTransform.transform(QPointF(i, j));
+				input.GetPixel(i, j, fRed, fGreen, fBlue);
+
+				if ((fRed != 0.0 || fGreen != 0.0 || fBlue != 0.0) && DSSRect{ 0, 0, lWidth, lHeight }.contains(ptOut))
+				{
+					std::array<int, 4> xcoords, ycoords;
+					const std::array<double, 4> percents = ComputeAll4PixelDispatches(ptOut, xcoords, ycoords);
+					for (const int n : { 0, 1, 2, 3 })
+					{
+						if (percents[n] > 0.0 && xcoords[n] >= 0 && xcoords[n] < lWidth && ycoords[n] >= 0 && ycoords[n] < lHeight)
+						{
+							const size_t offset = static_cast<size_t>(lWidth) * ycoords[n] + xcoords[n];
+							const double weight = percents[n] * multiplier;
+							pRed[offset] += static_cast<float>(fRed * weight);
+							if (pGreen != nullptr)
+							{
+								pGreen[offset] += static_cast<float>(fGreen * weight);
+								pBlue[offset] += static_cast<float>(fBlue * weight);
+							}
+						}
+					}
+				}
+			}
+	}
+
+	CBackgroundCalibration noBackgroundCalibration()
+	{
+		CBackgroundCalibration backgroundCalibration;
+		backgroundCalibration.SetMode(BCM_NONE, BCI_LINEAR, RBCM_MAXIMUM);
+		return backgroundCalibration;
+	}
+
+	bool nearlyEqual(const std::vector<float>& values, const std::vector<float>& expected)
+	{
+		if (values.size() != expected.size())
+			return false;
+		for (size_t n = 0; n < values.size(); n++)
+			if (std::abs(values[n] - expected[n]) > 1e-5f * std::max(1.0f, std::abs(expected[n])))
+				return false;
+		return true;
+	}
+}
+
+TEST_CASE("Live stacking of the transformed pixels", "[RunningStacking]")
+{
+	const CBackgroundCalibration backgroundCalibration = noBackgroundCalibration();
+	// Reference frame, small shift, rotation across several output bands, and a bisquared transform.
+	const std::array<CPixelTransform, 4> transforms = {
+		makeTransform(0.0, 0.0, 0.0, false),
+		makeTransform(0.37, -1.6, 0.0, false),
+		makeTransform(-2.25, 3.5, 4.0, false),
+		makeTransform(1.1, 0.6, -2.5, true)
+	};
+
+	SECTION("Gray")
+	{
+		C32BitFloatGrayBitmap stack;
+		stack.Init(Width, Height);
+		C32BitFloatGrayBitmap serial;
+		serial.Init(Width, Height);
+		C32BitFloatGrayBitmap expected;
+		expected.Init(Width, Height);
+
+		for (size_t n = 0; n < transforms.size(); n++)
+		{
+			const auto pFrame = makeFrame<C16BitGrayBitmap>(static_cast<unsigned>(n + 1));
+			CRunningStackingEngine::StackPixels(*pFrame, transforms[n], backgroundCalibration, stack, nullptr);
+			serialFloatStackPixels(*pFrame, transforms[n], stack.GetMultiplier(), serial.m_vPixels.data(), nullptr, nullptr);
+			serialStackPixels(*pFrame, transforms[n], expected);
+		}
+
+		// Each output row is owned by one thread: same sums in the same order as the serial loop.
+		REQUIRE(stack.m_vPixels == serial.m_vPixels);
+		REQUIRE(nearlyEqual(stack.m_vPixels, expected.m_vPixels));
+	}
+
+	SECTION("Colour")
+	{
+		C96BitFloatColorBitmap stack;
+		stack.Init(Width, Height);
+		C96BitFloatColorBitmap serial;
+		serial.Init(Width, Height);
+		C96BitFloatColorBitmap expected;
+		expected.Init(Width, Height);
+
+		for (size_t n = 0; n < transforms.size(); n++)
+		{
+			const auto pFrame = makeFrame<C48BitColorBitmap>(static_cast<unsigned>(n + 11));
+			CRunningStackingEngine::StackPixels(*pFrame, transforms[n], backgroundCalibration, stack, nullptr);
+			serialFloatStackPixels(*pFrame, transforms[n], stack.GetMultiplier(), serial.m_Red.m_vPixels.data(), serial.m_Green.m_vPixels.data(), serial.m_Blue.m_vPixels.data());
+			serialStackPixels(*pFrame, transforms[n], expected);
+		}
+
+		REQUIRE(stack.m_Red.m_vPixels == serial.m_Red.m_vPixels);
+		REQUIRE(stack.m_Green.m_vPixels == serial.m_Green.m_vPixels);
+		REQUIRE(stack.m_Blue.m_vPixels == serial.m_Blue.m_vPixels);
+		REQUIRE(nearlyEqual(stack.m_Red.m_vPixels, expected.m_Red.m_vPixels));
+		REQUIRE(nearlyEqual(stack.m_Green.m_vPixels, expected.m_Green.m_vPixels));
+		REQUIRE(nearlyEqual(stack.m_Blue.m_vPixels, expected.m_Blue.m_vPixels));
+	}
+}
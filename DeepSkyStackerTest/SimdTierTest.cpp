@@ -0,0 +1,529 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "dssrect.h"
+
+#define UNIT_TESTS
+
+#include "avx_simd_check.h"
+#include "avx_avg.h"
+#include "avx_histogram.h"
+#include "TaskInfo.h"
+#include "EntropyInfo.h"
+#include "ColorBitmap.h"
+#include "MedianFilterEngine.h"
+#include "AHDDemosaicing.h"
+#include "avx_ahd.h"
+#include "FormerAhd.h"
+#include "avx_warp.h"
+#include "PixelTransform.h"
+#include "avx.h"
+#include "avx_entropy.h"
+#include "avx_output.h"
+#include "BackgroundCalibration.h"
+#include "GreyMultiBitmap.h"
+
+//
+// The same computation is run with every SIMD level the CPU supports. The results must not depend on the level.
+//
+namespace
+{
+	using SimdLevel = AvxSimdCheck::SimdLevel;
+
+	std::vector<SimdLevel> supportedLevels()
+	{
+		std::vector<SimdLevel> levels{ SimdLevel::Generic };
+		if (AvxSimdCheck::cpuSimdLevel() >= SimdLevel::Avx2)
+			levels.push_back(SimdLevel::Avx2);
+		if (AvxSimdCheck::cpuSimdLevel() >= SimdLevel::Avx512)
+			levels.push_back(SimdLevel::Avx512);
+		return levels;
+	}
+
+	// Resets the level limit, even if a REQUIRE fails.
+	struct SimdLevelGuard
+	{
+		~SimdLevelGuard() { AvxSimdCheck::limitSimdLevel(SimdLevel::Avx512); }
+	};
+
+	template <class T>
+	std::shared_ptr<CGrayBitmapT<T>> makeRandomGrayBitmap(const int width, const int height, const std::uint32_t seed)
+	{
+		auto pBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pBitmap->Init(width, height) == true);
+		std::mt19937 engine{ seed };
+		for (auto& pixel : pBitmap->m_vPixels)
+		{
+			const std::uint32_t value = engine() % 65536;
+			if constexpr (std::is_same_v<T, std::uint32_t>)
+				pixel = value << 16;
+			else
+				pixel = static_cast<T>(value);
+		}
+		return pBitmap;
+	}
+
+	template <class T>
+	std::vector<float> accumulateFrames(const int method, const SimdLevel level)
+	{
+		constexpr int W = 16 * 41 + 7;
+		constexpr int H = 16 * 9 + 5;
+		CTaskInfo taskInfo;
+		taskInfo.SetMethod(method, 0, 0);
+		AvxSimdCheck::limitSimdLevel(level);
+
+		auto pOutBitmap = std::make_shared<CGrayBitmapT<float>>();
+		REQUIRE(pOutBitmap->Init(W, H) == true);
+
+		for (int i = 0; i < 5; ++i)
+		{
+			std::shared_ptr<CMemoryBitmap> pTempBitmap = makeRandomGrayBitmap<T>(W, H, 17 + i);
+			CEntropyInfo entropyInfo;
+			entropyInfo.Init(pTempBitmap, 10, nullptr);
+			AvxEntropy avxEntropy(*pTempBitmap, entropyInfo, nullptr);
+
+			AvxAccumulation avxAccumulation(DSSRect(0, 0, W, H), taskInfo, *pTempBitmap, *pOutBitmap, avxEntropy);
+			REQUIRE(avxAccumulation.accumulate(i) == 0);
+		}
+		return pOutBitmap->m_vPixels;
+	}
+
+	std::vector<int> histogramOf(const std::shared_ptr<CMemoryBitmap>& pBitmap, const SimdLevel level)
+	{
+		AvxSimdCheck::limitSimdLevel(level);
+		AvxHistogram avxHistogram(*pBitmap);
+		REQUIRE(avxHistogram.calcHistogram(0, pBitmap->Height(), 1.0) == 0);
+		std::vector<int> redHisto(65536), greenHisto(65536), blueHisto(65536);
+		REQUIRE(avxHistogram.mergeHistograms(redHisto, greenHisto, blueHisto) == 0);
+		return redHisto;
+	}
+
+	// The AVX-512 kernels fall back to AVX-256, the generic level has no AVX code at all.
+	std::vector<SimdLevel> avxLevels()
+	{
+		std::vector<SimdLevel> levels = supportedLevels();
+		std::erase(levels, SimdLevel::Generic);
+		return levels;
+	}
+
+	// Stacks a random gray frame with the pixel transformation into a temp bitmap of the same size.
+	template <class T>
+	std::vector<T> stackTransformed(const CPixelTransform& pixelTransform, const SimdLevel level)
+	{
+		constexpr int W = 16 * 19 + 9;
+		constexpr int H = 16 * 7 + 3;
+		AvxSimdCheck::limitSimdLevel(level);
+
+		std::shared_ptr<CMemoryBitmap> pBitmap = makeRandomGrayBitmap<T>(W, H, 5150);
+		auto pTempBitmap = std::make_shared<CGrayBitmapT<T>>();
+		REQUIRE(pTempBitmap->Init(W, H) == true);
+
+		CEntropyInfo entropyInfo;
+		entropyInfo.Init(pTempBitmap, 10, nullptr);
+		AvxEntropy avxEntropy(*pTempBitmap, entropyInfo, nullptr);
+		CTaskInfo taskInfo;
+		CBackgroundCalibration backgroundCalib;
+		backgroundCalib.m_liRed.Initialize(0, 0, 1, 0, 0, 1); // in == out
+
+		AvxStacking avxStacking(0, H, *pBitmap, *pTempBitmap, DSSRect(0, 0, W, H), avxEntropy);
+		REQUIRE(avxStacking.stack(pixelTransform, taskInfo, backgroundCalib, std::shared_ptr<CMemoryBitmap>{}, 1) == 0);
+		return pTempBitmap->m_vPixels;
+	}
+
+	// The number of added bitmaps is only set by AddBitmap(), so that the scan lines can be composed without part files.
+	template <class T>
+	class ScanLineMultiBitmap : public CGrayMultiBitmapT<T, float>
+	{
+	public:
+		explicit ScanLineMultiBitmap(const int nrBitmaps)
+		{
+			this->m_lNrBitmaps = nrBitmaps;
+			this->m_lNrAddedBitmaps = nrBitmaps;
+		}
+	};
+
+	// Composes one line of random frames (10% zeros, 5% outliers) with AvxOutputComposition.
+	template <class T>
+	std::vector<float> composeLine(const MULTIBITMAPPROCESSMETHOD method, const int nrFrames, const SimdLevel level)
+	{
+		constexpr int W = 16 * 23 + 5;
+		std::mt19937 engine{ 333u + static_cast<std::uint32_t>(nrFrames) };
+		std::vector<std::vector<T>> lines(nrFrames, std::vector<T>(W));
+		for (auto& line : lines)
+			for (auto& value : line)
+			{
+				const std::uint32_t r = engine();
+				value = (r % 100) < 10 ? T{ 0 } : static_cast<T>(1000 + (r >> 8) % 400 + ((r % 100) >= 95 ? 20000 : 0));
+			}
+		std::vector<void*> scanLines;
+		for (auto& line : lines)
+			scanLines.push_back(line.data());
+
+		AvxSimdCheck::limitSimdLevel(level);
+		ScanLineMultiBitmap<T> multiBitmap{ nrFrames };
+		multiBitmap.SetProcessingMethod(method, 2.0, 3);
+		CGrayBitmapT<float> output;
+		REQUIRE(output.Init(W, 2) == true);
+		AvxOutputComposition avxOutputComposition{ multiBitmap, output };
+		REQUIRE(avxOutputComposition.compose(1, scanLines) == 0);
+		return output.m_vPixels;
+	}
+
+	bool almostEqual(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::equal(a.cbegin(), a.cend(), b.cbegin(), [](const float x, const float y)
+		{
+			return std::abs(x - y) <= 1e-5f * std::max(1.0f, std::abs(x));
+		});
+	}
+}
+
+TEST_CASE("SIMD tiers Accumulation", "[AVX][SimdTier][Accumulation]")
+{
+	SimdLevelGuard guard;
+	const auto levels = supportedLevels();
+
+	SECTION("FASTAVERAGE int16: AVX-512 and AVX2 identical, generic within rounding")
+	{
+		const auto reference = accumulateFrames<std::uint16_t>(MBP_FASTAVERAGE, levels.back());
+		for (const SimdLevel level : levels)
+		{
+			const auto result = accumulateFrames<std::uint16_t>(MBP_FASTAVERAGE, level);
+			if (level == SimdLevel::Generic)
+				REQUIRE(almostEqual(result, reference));
+			else
+				REQUIRE(memcmp(result.data(), reference.data(), reference.size() * sizeof(float)) == 0);
+		}
+	}
+
+	SECTION("FASTAVERAGE int32")
+	{
+		const auto reference = accumulateFrames<std::uint32_t>(MBP_FASTAVERAGE, levels.back());
+		for (const SimdLevel level : levels)
+		{
+			const auto result = accumulateFrames<std::uint32_t>(MBP_FASTAVERAGE, level);
+			if (level == SimdLevel::Generic)
+				REQUIRE(almostEqual(result, reference));
+			else
+				REQUIRE(memcmp(result.data(), reference.data(), reference.size() * sizeof(float)) == 0);
+		}
+	}
+
+	SECTION("MAXIMUM float is identical on all levels")
+	{
+		const auto reference = accumulateFrames<float>(MBP_MAXIMUM, levels.back());
+		for (const SimdLevel level : levels)
+		{
+			const auto result = accumulateFrames<float>(MBP_MAXIMUM, level);
+			REQUIRE(memcmp(result.data(), reference.data(), reference.size() * sizeof(float)) == 0);
+		}
+	}
+}
+
+TEST_CASE("SIMD tiers Histogram", "[AVX][SimdTier][Histogram]")
+{
+	SimdLevelGuard guard;
+	const auto levels = supportedLevels();
+
+	SECTION("Random gray int16 is identical on all levels")
+	{
+		const std::shared_ptr<CMemoryBitmap> pBitmap = makeRandomGrayBitmap<std::uint16_t>(256 + 16 * 5 + 3, 32 + 7, 4711);
+		const auto reference = histogramOf(pBitmap, SimdLevel::Generic);
+		REQUIRE(std::accumulate(reference.cbegin(), reference.cend(), 0) == pBitmap->Width() * pBitmap->Height());
+		for (const SimdLevel level : levels)
+			REQUIRE(histogramOf(pBitmap, level) == reference);
+	}
+
+	SECTION("Gray int16 with few distinct values (many equal pixels per vector)")
+	{
+		auto pGray = makeRandomGrayBitmap<std::uint16_t>(512, 64, 99);
+		for (auto& pixel : pGray->m_vPixels)
+			pixel = 1000 + pixel % 3;
+		const std::shared_ptr<CMemoryBitmap> pBitmap = pGray;
+		const auto reference = histogramOf(pBitmap, SimdLevel::Generic);
+		for (const SimdLevel level : levels)
+			REQUIRE(histogramOf(pBitmap, level) == reference);
+	}
+
+	SECTION("Random gray float is identical on all levels")
+	{
+		const std::shared_ptr<CMemoryBitmap> pBitmap = makeRandomGrayBitmap<float>(256 + 9, 40, 815);
+		const auto reference = histogramOf(pBitmap, SimdLevel::Generic);
+		for (const SimdLevel level : levels)
+			REQUIRE(histogramOf(pBitmap, level) == reference);
+	}
+}
+
+TEST_CASE("SIMD tiers AHD demosaicing", "[AVX][SimdTier][AHD]")
+{
+	SimdLevelGuard guard;
+	const auto levels = supportedLevels();
+
+	SECTION("Lab conversion within one LUT step of a conversion in double")
+	{
+		const auto f = [](const double value)
+		{
+			const float r = static_cast<float>(std::floor(value * 65535.0)) / 65535.0f;
+			return r > 0.008856f ? std::pow(r, float{ 1.0 / 3.0 }) : 7.787f * r + float{ 16.0 / 116.0 };
+		};
+		std::mt19937 engine{ 2024 };
+		for (int i = 0; i < 100000; ++i)
+		{
+			const float red = static_cast<float>(engine() % 65536);
+			const float green = static_cast<float>(engine() % 65536);
+			const float blue = static_cast<float>(engine() % 65536);
+			float L, a, b;
+			AvxAhd::rgbToLab(red, green, blue, L, a, b);
+
+			const double X = f((0.433953 * red + 0.376219 * green + 0.189828 * blue) / 65536.0);
+			const double Y = f((0.212671 * red + 0.715160 * green + 0.072169 * blue) / 65536.0);
+			const double Z = f((0.017758 * red + 0.109477 * green + 0.872766 * blue) / 65536.0);
+			REQUIRE(std::abs(L - (116.0 * Y - 16.0)) <= 0.015);
+			REQUIRE(std::abs(a - 500.0 * (X - Y)) <= 0.12);
+			REQUIRE(std::abs(b - 200.0 * (Y - Z)) <= 0.05);
+		}
+	}
+
+	constexpr int W = 256 * 2 + 37;
+	constexpr int H = 256 + 19;
+	// About 1 in 10000 output values changes where the float Lab conversion flips a homogeneity decision.
+	constexpr int MaxDifferences = 3 * W * H / 10000;
+
+	const auto demosaic = [](CGrayBitmapT<std::uint16_t>* pGray, const SimdLevel level)
+	{
+		AvxSimdCheck::limitSimdLevel(level);
+		std::shared_ptr<CMemoryBitmap> pColor;
+		REQUIRE(AHDDemosaicing(pGray, pColor, nullptr) == true);
+		return std::dynamic_pointer_cast<CColorBitmapT<std::uint16_t>>(pColor);
+	};
+
+	// The pixels of the borders are left out: the former windows don't set them, and next to the right and bottom
+	// edges they also depend on which thread processed which window.
+	const auto countDifferences = [](const CColorBitmapT<std::uint16_t>& result, const CColorBitmapT<std::uint16_t>& reference)
+	{
+		int differences = 0;
+		for (int y = 1; y < H - 2; ++y)
+			for (int x = 1; x < W - 2; ++x)
+			{
+				const size_t n = static_cast<size_t>(y) * W + x;
+				differences += result.m_Red.m_vPixels[n] != reference.m_Red.m_vPixels[n];
+				differences += result.m_Green.m_vPixels[n] != reference.m_Green.m_vPixels[n];
+				differences += result.m_Blue.m_vPixels[n] != reference.m_Blue.m_vPixels[n];
+			}
+		return differences;
+	};
+
+	SECTION("About 1 in 10000 values differ from the former double Lab conversion")
+	{
+		for (const std::uint32_t seed : { 1234, 1, 3, 77 })
+		{
+			CAPTURE(seed);
+			auto pGray = makeRandomGrayBitmap<std::uint16_t>(W, H, seed);
+			pGray->SetCFAType(CFATYPE_RGGB);
+			const auto reference = FormerAhd::Demosaic(pGray.get());
+			REQUIRE(reference != nullptr);
+
+			for (const SimdLevel level : levels)
+			{
+				CAPTURE(AvxSimdCheck::simdLevelName(level));
+				const auto result = demosaic(pGray.get(), level);
+				REQUIRE(result != nullptr);
+				REQUIRE(countDifferences(*result, *reference) <= MaxDifferences);
+			}
+		}
+	}
+
+	SECTION("Levels differ only in a few homogeneity decisions")
+	{
+		auto pGray = makeRandomGrayBitmap<std::uint16_t>(W, H, 1234);
+		pGray->SetCFAType(CFATYPE_RGGB);
+
+		const auto reference = demosaic(pGray.get(), SimdLevel::Generic);
+		REQUIRE(reference != nullptr);
+		for (const SimdLevel level : levels)
+		{
+			const auto result = demosaic(pGray.get(), level);
+			REQUIRE(result != nullptr);
+			// Each level is within MaxDifferences of the former code.
+			REQUIRE(countDifferences(*result, *reference) <= 2 * MaxDifferences);
+		}
+	}
+}
+
+TEST_CASE("SIMD tiers channel warp", "[AVX][SimdTier][Warp]")
+{
+	SimdLevelGuard guard;
+	const auto levels = supportedLevels();
+
+	constexpr int W = 128 * 2 + 13;
+	constexpr int H = 128 * 3 + 5;
+
+	// Serial warp with the pixel dispatch, as CChannelAlign::AlignChannel() did.
+	const auto dispatchWarp = [](const CMemoryBitmap& input, CMemoryBitmap& output, const CPixelTransform& pixelTransform)
+	{
+		PIXELDISPATCHVECTOR vPixels;
+		for (int j = 0; j < H; ++j)
+			for (int i = 0; i < W; ++i)
+			{
+				double fGray;
+				const QPointF ptOut = pixelTransform.transform(QPointF(i, j));
+				input.GetPixel(i, j, fGray);
+				if (fGray != 0 && DSSRect{ 0, 0, W, H }.contains(ptOut))
+				{
+					vPixels.resize(0);
+					ComputePixelDispatch(ptOut, 1, vPixels);
+					for (const CPixelDispatch& pixel : vPixels)
+						if (pixel.m_lX >= 0 && pixel.m_lX < W && pixel.m_lY >= 0 && pixel.m_lY < H)
+						{
+							double fPreviousGray;
+							output.GetPixel(pixel.m_lX, pixel.m_lY, fPreviousGray);
+							output.SetPixel(pixel.m_lX, pixel.m_lY, fPreviousGray + fGray * pixel.m_fPercentage);
+						}
+				}
+			}
+	};
+
+	const auto checkWarp = [&]<class T>(const TRANSFORMATIONTYPE type)
+	{
+		auto pInput = makeRandomGrayBitmap<T>(W, H, 4242 + type);
+		CPixelTransform pixelTransform;
+		CBilinearParameters& params = pixelTransform.m_BilinearParameters;
+		params.Type = type;
+		params.fXWidth = W;
+		params.fYWidth = H;
+		params.a0 = 0.0123; params.a1 = 0.998; params.a2 = 0.0141; params.a3 = 0.0007;
+		params.b0 = -0.0087; params.b1 = -0.0138; params.b2 = 1.003; params.b3 = -0.0005;
+		params.a4 = params.b5 = 0.0004; params.a8 = params.b6 = -0.0003;
+		params.a9 = params.b10 = 0.0002; params.a15 = params.b12 = -0.0001;
+		pixelTransform.SetShift(0.25, -0.5);
+
+		CGrayBitmapT<T> reference;
+		REQUIRE(reference.Init(W, H) == true);
+		dispatchWarp(*pInput, reference, pixelTransform);
+
+		for (const SimdLevel level : levels)
+		{
+			AvxSimdCheck::limitSimdLevel(level);
+			CGrayBitmapT<T> output;
+			REQUIRE(output.Init(W, H) == true);
+			AvxWarp avxWarp{ pixelTransform };
+			REQUIRE(avxWarp.warp(*pInput, output, nullptr) == 0);
+			REQUIRE(output.m_vPixels == reference.m_vPixels);
+		}
+	};
+
+	SECTION("Gray int16 is identical to the pixel dispatch")
+	{
+		checkWarp.operator()<std::uint16_t>(TT_BILINEAR);
+		checkWarp.operator()<std::uint16_t>(TT_BISQUARED);
+		checkWarp.operator()<std::uint16_t>(TT_BICUBIC);
+	}
+
+	SECTION("Gray float is identical to the pixel dispatch")
+	{
+		checkWarp.operator()<float>(TT_BILINEAR);
+		checkWarp.operator()<float>(TT_BICUBIC);
+	}
+
+	SECTION("Other types are not handled")
+	{
+		auto pInput = makeRandomGrayBitmap<std::uint32_t>(W, H, 1);
+		C32BitGrayBitmap output;
+		REQUIRE(output.Init(W, H) == true);
+		CPixelTransform pixelTransform;
+		AvxWarp avxWarp{ pixelTransform };
+		REQUIRE(avxWarp.warp(*pInput, output, nullptr) == 1);
+	}
+}
+
+TEST_CASE("SIMD tiers stacking pixel transformation", "[AVX][SimdTier][Stacking]")
+{
+	SimdLevelGuard guard;
+	const auto levels = avxLevels();
+	if (levels.empty())
+		return;
+
+	const auto checkTransform = [&levels]<class T>(const CPixelTransform& pixelTransform)
+	{
+		const auto reference = stackTransformed<T>(pixelTransform, levels.front());
+		for (const SimdLevel level : levels)
+			REQUIRE(stackTransformed<T>(pixelTransform, level) == reference);
+	};
+
+	const auto makeTransform = [](const TRANSFORMATIONTYPE type)
+	{
+		constexpr int W = 16 * 19 + 9;
+		constexpr int H = 16 * 7 + 3;
+		CPixelTransform pixelTransform;
+		CBilinearParameters& params = pixelTransform.m_BilinearParameters;
+		params.Type = type;
+		params.fXWidth = W;
+		params.fYWidth = H;
+		params.a0 = 0.0123; params.a1 = 0.998; params.a2 = 0.0141; params.a3 = 0.0007;
+		params.b0 = -0.0087; params.b1 = -0.0138; params.b2 = 1.003; params.b3 = -0.0005;
+		params.a4 = params.b5 = 0.0004; params.a8 = params.b6 = -0.0003;
+		params.a9 = params.b10 = 0.0002; params.a15 = params.b12 = -0.0001;
+		pixelTransform.SetShift(0.25, -0.5);
+		return pixelTransform;
+	};
+
+	SECTION("No transformation (shift only)")
+	{
+		CPixelTransform pixelTransform;
+		pixelTransform.SetShift(1.5, -2.25);
+		checkTransform.operator()<std::uint16_t>(pixelTransform);
+	}
+
+	SECTION("Bilinear, bisquared and bicubic int16 are identical on the AVX levels")
+	{
+		checkTransform.operator()<std::uint16_t>(makeTransform(TT_BILINEAR));
+		checkTransform.operator()<std::uint16_t>(makeTransform(TT_BISQUARED));
+		checkTransform.operator()<std::uint16_t>(makeTransform(TT_BICUBIC));
+	}
+
+	SECTION("Bisquared float is identical on the AVX levels")
+	{
+		checkTransform.operator()<float>(makeTransform(TT_BISQUARED));
+	}
+}
+
+TEST_CASE("SIMD tiers output composition", "[AVX][SimdTier][Output]")
+{
+	SimdLevelGuard guard;
+	const auto levels = avxLevels();
+	if (levels.empty())
+		return;
+
+	const auto checkCompose = [&levels]<class T>(const MULTIBITMAPPROCESSMETHOD method, const int nrFrames)
+	{
+		const auto reference = composeLine<T>(method, nrFrames, levels.front());
+		for (const SimdLevel level : levels)
+		{
+			const auto result = composeLine<T>(method, nrFrames, level);
+			REQUIRE(memcmp(result.data(), reference.data(), reference.size() * sizeof(float)) == 0);
+		}
+	};
+
+	SECTION("Kappa-sigma int16 is identical on the AVX levels")
+	{
+		checkCompose.operator()<std::uint16_t>(MBP_SIGMACLIP, 1);
+		checkCompose.operator()<std::uint16_t>(MBP_SIGMACLIP, 9);
+		checkCompose.operator()<std::uint16_t>(MBP_SIGMACLIP, 24);
+	}
+
+	SECTION("Kappa-sigma float is identical on the AVX levels")
+	{
+		checkCompose.operator()<float>(MBP_SIGMACLIP, 9);
+	}
+
+	SECTION("Auto adaptive weighted average int16 is identical on the AVX levels")
+	{
+		checkCompose.operator()<std::uint16_t>(MBP_AUTOADAPTIVE, 2);
+		checkCompose.operator()<std::uint16_t>(MBP_AUTOADAPTIVE, 9);
+	}
+
+	SECTION("Auto adaptive weighted average float is identical on the AVX levels")
+	{
+		checkCompose.operator()<float>(MBP_AUTOADAPTIVE, 9);
+	}
+}
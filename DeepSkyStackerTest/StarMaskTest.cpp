@@ -0,0 +1,102 @@
+#include "stdafx.h"
+#include <random>
+#include "catch.h"
+#include "StarMask.h"
+#include "Stars.h"
+#include "GrayBitmap.h"
+#include "TestMultitask.h"
+
+using namespace DSS;
+
+namespace
+{
+	constexpr int Width = 300; // Two tiles of the mask, stars are drawn across the tile border.
+	constexpr int Height = 200;
+
+	std::unique_ptr<StarMaskFunction> shapeFunction(const STARMASKSTYLE shape)
+	{
+		switch (shape)
+		{
+		case SMS_BELL: return std::make_unique<StarMaskFunction_Bell>();
+		case SMS_TRUNCATEDBELL: return std::make_unique<StarMaskFunction_BellTruncated>();
+		case SMS_LINEAR: return std::make_unique<StarMaskFunction_Linear>();
+		case SMS_TRUNCATEDLINEAR: return std::make_unique<StarMaskFunction_LinearTruncated>();
+		case SMS_CUBIC: return std::make_unique<StarMaskFunction_Cubic>();
+		case SMS_QUADRATIC: return std::make_unique<StarMaskFunction_Quadratic>();
+		}
+		return std::unique_ptr<StarMaskFunction>{};
+	}
+
+	// Random stars (some overlapping, some too small or too large for the default size limits 2 to 25) and stars on the borders.
+	std::vector<CStar> makeStars()
+	{
+		std::mt19937 generator{ 3 };
+		std::vector<CStar> vStars;
+		for (int k = 0; k < 60; k++)
+		{
+			const double x = (generator() % 30000) / 100.0;
+			const double y = (generator() % 20000) / 100.0;
+			CStar& star = vStars.emplace_back(x, y);
+			star.m_fMeanRadius = 0.5 + (generator() % 800) / 100.0;
+		}
+		for (const auto& [x, y] : { std::pair{ 0.0, 0.0 }, std::pair{ Width - 1.0, 100.3 }, std::pair{ 150.6, Height - 0.5 }, std::pair{ 255.5, 0.2 } })
+			vStars.emplace_back(x, y).m_fMeanRadius = 4.2;
+		return vStars;
+	}
+
+	// The former drawing of the mask: the shape function computed for each pixel of the star boxes (default settings).
+	std::vector<std::uint16_t> drawDirectly(const std::vector<CStar>& vStars, StarMaskFunction& function)
+	{
+		C16BitGrayBitmap bitmap;
+		bitmap.Init(Width, Height);
+		for (const CStar& star : vStars)
+		{
+			const double fRadius = star.m_fMeanRadius * (2.35 / 1.5);
+			if (2 * fRadius < 2 || 2 * fRadius > 25)
+				continue;
+			function.SetRadius(fRadius);
+			for (double i = std::max(0.0, star.m_fX - 3 * fRadius); i <= std::min(star.m_fX + 3 * fRadius, Width - 1.0); i++)
+				for (double j = std::max(0.0, star.m_fY - 3 * fRadius); j <= std::min(star.m_fY + 3 * fRadius, Height - 1.0); j++)
+				{
+					const double fDistance = std::sqrt((i - star.m_fX) * (i - star.m_fX) + (j - star.m_fY) * (j - star.m_fY));
+					const int x = static_cast<int>(i + 0.5);
+					const int y = static_cast<int>(j + 0.5);
+					double fOldPixelValue;
+					bitmap.GetPixel(x, y, fOldPixelValue);
+					bitmap.SetPixel(x, y, std::max(fOldPixelValue, std::max(0.0, std::min(function.Compute(fDistance) * 255.0, 255.0))));
+				}
+		}
+		return bitmap.m_vPixels;
+	}
+}
+
+TEST_CASE("Star mask", "[StarMask]")
+{
+	const std::vector<CStar> vStars = makeStars();
+	const STARMASKSTYLE shape = GENERATE(SMS_BELL, SMS_TRUNCATEDBELL, SMS_LINEAR, SMS_TRUNCATEDLINEAR, SMS_CUBIC, SMS_QUADRATIC);
+	CAPTURE(static_cast<int>(shape));
+
+	const std::vector<std::uint16_t> expected = drawDirectly(vStars, *shapeFunction(shape));
+	REQUIRE(std::ranges::count_if(expected, [](const std::uint16_t value) { return value != 0; }) > Width * Height / 2);
+
+	StarMaskEngine engine;
+	engine.SetStarShape(shape);
+	std::shared_ptr<CMemoryBitmap> pMask;
+	{
+		NrProcessorsGuard guard{ 4 };
+		pMask = engine.drawStarMask(vStars, Width, Height);
+	}
+	const auto* pGrayMask = dynamic_cast<const C16BitGrayBitmap*>(pMask.get());
+	REQUIRE(pGrayMask != nullptr);
+	REQUIRE(pGrayMask->Width() == Width);
+	REQUIRE(pGrayMask->Height() == Height);
+
+	// The tabulated and linearly interpolated shapes are at most 1/256 of a mask level (1 of 65280) from the shape functions.
+	constexpr int Tolerance = 1;
+	int maxDifference = 0;
+	for (size_t n = 0; n < expected.size(); n++)
+		maxDifference = std::max(maxDifference, std::abs(static_cast<int>(pGrayMask->m_vPixels[n]) - static_cast<int>(expected[n])));
+	REQUIRE(maxDifference <= Tolerance);
+	if (shape == SMS_LINEAR || shape == SMS_TRUNCATEDLINEAR)
+		REQUIRE(maxDifference == 0); // The linear shapes are exact.
+}
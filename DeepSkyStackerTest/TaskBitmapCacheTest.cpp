@@ -0,0 +1,154 @@
+#include "stdafx.h"
+#include <functional>
+#include <map>
+#include "catch.h"
+#include "TaskBitmapCache.h"
+#include "GrayBitmap.h"
+
+namespace
+{
+	constexpr std::uint64_t MasterSize = 10 * 10 * sizeof(std::uint16_t);
+
+	// Counts the loads of each file, the file "missing" cannot be loaded.
+	class TestCache
+	{
+	public:
+		std::map<fs::path, int> nrLoads;
+		std::uint64_t memoryLimit{ 3 * MasterSize };
+		CTaskBitmapCache cache;
+
+		TestCache() :
+			cache{ [this](const fs::path& file, PICTURETYPE, ProgressBase*, std::shared_ptr<CMemoryBitmap>& rpBitmap) -> bool
+				{
+					++nrLoads[file];
+					if (file == "missing")
+						return false;
+					auto pBitmap = std::make_shared<C16BitGrayBitmap>();
+					pBitmap->Init(10, 10);
+					rpBitmap = pBitmap;
+					return true;
+				},
+				[this]() { return memoryLimit; } }
+		{}
+
+		// Gets the master of the task, returns the number of times its file has been loaded.
+		int get(const std::uint32_t taskID, const fs::path& file, const PICTURETYPE type = PICTURETYPE_DARKFRAME)
+		{
+			CTaskInfo task;
+			task.m_dwTaskID = taskID;
+			task.m_strOutputFile = file;
+			task.m_TaskType = type;
+			std::shared_ptr<CMemoryBitmap> pBitmap;
+			REQUIRE(cache.GetTaskResult(&task, nullptr, pBitmap));
+			REQUIRE(static_cast<bool>(pBitmap));
+			return nrLoads[file];
+		}
+	};
+}
+
+TEST_CASE("Master cache", "[MasterCache]")
+{
+	TestCache test;
+
+	SECTION("The least recently used masters are dropped when the budget is exceeded")
+	{
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(2, "dark") == 1);
+		REQUIRE(test.get(3, "flat", PICTURETYPE_FLATFRAME) == 1);
+		REQUIRE(test.cache.GetNrMasters() == 3);
+		REQUIRE(test.cache.GetTotalSize() == 3 * MasterSize);
+
+		// Using the offset makes the dark the least recently used master: it is dropped for the new one.
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(4, "dark2") == 1);
+		REQUIRE(test.cache.GetNrMasters() == 3);
+		REQUIRE(test.cache.GetTotalSize() == 3 * MasterSize);
+
+		REQUIRE(test.get(3, "flat", PICTURETYPE_FLATFRAME) == 1);
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(4, "dark2") == 1);
+		REQUIRE(test.get(2, "dark") == 2);
+		// Now the flat was the least recently used one.
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(3, "flat", PICTURETYPE_FLATFRAME) == 2);
+	}
+
+	SECTION("The cached bitmap is returned")
+	{
+		CTaskInfo task;
+		task.m_dwTaskID = 1;
+		task.m_strOutputFile = "offset";
+		task.m_TaskType = PICTURETYPE_OFFSETFRAME;
+		std::shared_ptr<CMemoryBitmap> pFirst;
+		std::shared_ptr<CMemoryBitmap> pSecond;
+		REQUIRE(test.cache.GetTaskResult(&task, nullptr, pFirst));
+		REQUIRE(test.cache.GetTaskResult(&task, nullptr, pSecond));
+		REQUIRE(pFirst == pSecond);
+	}
+
+	SECTION("The last master used is always kept")
+	{
+		test.memoryLimit = MasterSize / 2;
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.cache.GetNrMasters() == 1);
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(2, "dark") == 1);
+		REQUIRE(test.cache.GetNrMasters() == 1);
+		REQUIRE(test.cache.GetTotalSize() == MasterSize);
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 2);
+	}
+
+	SECTION("A lower budget applies at the next load")
+	{
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(2, "dark") == 1);
+		test.memoryLimit = 2 * MasterSize;
+		REQUIRE(test.get(3, "flat", PICTURETYPE_FLATFRAME) == 1);
+		REQUIRE(test.cache.GetNrMasters() == 2);
+		REQUIRE(test.get(2, "dark") == 1);
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 2);
+	}
+
+	SECTION("A master is identified by its task and its file")
+	{
+		REQUIRE(test.get(1, "dark") == 1);
+		REQUIRE(test.get(2, "dark") == 2);
+		REQUIRE(test.get(2, "dark") == 2);
+		REQUIRE(test.get(2, "dark (1)") == 1);
+		REQUIRE(test.cache.GetNrMasters() == 3);
+	}
+
+	SECTION("Light frames and failed loads are not cached")
+	{
+		CTaskInfo task;
+		task.m_dwTaskID = 1;
+		task.m_strOutputFile = "light";
+		task.m_TaskType = PICTURETYPE_LIGHTFRAME;
+		std::shared_ptr<CMemoryBitmap> pBitmap;
+		REQUIRE_FALSE(test.cache.GetTaskResult(&task, nullptr, pBitmap));
+		REQUIRE(test.nrLoads.empty());
+
+		task.m_strOutputFile.clear();
+		task.m_TaskType = PICTURETYPE_DARKFRAME;
+		REQUIRE_FALSE(test.cache.GetTaskResult(&task, nullptr, pBitmap));
+		REQUIRE(test.nrLoads.empty());
+
+		task.m_strOutputFile = "missing";
+		REQUIRE_FALSE(test.cache.GetTaskResult(&task, nullptr, pBitmap));
+		REQUIRE_FALSE(test.cache.GetTaskResult(&task, nullptr, pBitmap));
+		REQUIRE(test.nrLoads["missing"] == 2);
+		REQUIRE_FALSE(static_cast<bool>(pBitmap));
+		REQUIRE(test.cache.GetNrMasters() == 0);
+		REQUIRE(test.cache.GetTotalSize() == 0);
+	}
+
+	SECTION("Clearing the cache drops all the masters")
+	{
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 1);
+		REQUIRE(test.get(2, "dark") == 1);
+		test.cache.ClearCache();
+		REQUIRE(test.cache.GetNrMasters() == 0);
+		REQUIRE(test.cache.GetTotalSize() == 0);
+		REQUIRE(test.get(1, "offset", PICTURETYPE_OFFSETFRAME) == 2);
+	}
+}
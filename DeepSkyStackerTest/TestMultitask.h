@@ -0,0 +1,20 @@
+#pragma once
+
+//
+// CMultitask::GetNrProcessors() of the test program returns this number: 1 (the parallel loops of the kernel run
+// serially) unless a test raises it with a NrProcessorsGuard.
+//
+extern int testNrProcessors;
+
+class NrProcessorsGuard
+{
+public:
+	explicit NrProcessorsGuard(const int nrProcessors)
+	{
+		testNrProcessors = nrProcessors;
+	}
+	~NrProcessorsGuard()
+	{
+		testNrProcessors = 1;
+	}
+};
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+#include <random>
+#include <thread>
+#include <QRgb>
+#include "catch.h"
+#include "TileRenderer.h"
+#include "StackedBitmap.h"
+#include "ColorBitmap.h"
+#include "TIFFUtil.h"
+
+using namespace DSS;
+
+namespace
+{
+	constexpr int Width = 1100; // 5 x 3 tiles, the last column and row partial.
+	constexpr int Height = 700;
+
+	// The renderer only reads a loaded StackedBitmap, so write a random colour image and load it.
+	void loadRandomImage(StackedBitmap& bitmap)
+	{
+		C48BitColorBitmap image;
+		image.Init(Width, Height);
+		std::mt19937 generator{ 5 };
+		std::uniform_real_distribution<double> distribution{ 0.0, 255.0 };
+		for (int j = 0; j < Height; j++)
+			for (int i = 0; i < Width; i++)
+			{
+				const double red = distribution(generator);
+				const double green = distribution(generator);
+				const double blue = distribution(generator);
+				image.SetPixel(i, j, red, green, blue);
+			}
+
+		const fs::path file = fs::temp_directory_path() / "DSSTileRendererTest.tif";
+		REQUIRE(WriteTIFF(file, &image, nullptr));
+		REQUIRE(bitmap.Load(file));
+		fs::remove(file);
+		REQUIRE(bitmap.GetWidth() == Width);
+		REQUIRE(bitmap.GetHeight() == Height);
+	}
+
+	std::vector<QRgb> renderDirectly(const StackedBitmap& bitmap, const BezierAdjust& bezier, const RGBHistogramAdjust& histogram)
+	{
+		std::vector<QRgb> image(static_cast<size_t>(Width) * Height);
+		bitmap.renderTile(reinterpret_cast<uchar*>(image.data()), Width * sizeof(QRgb), DSSRect{ 0, 0, Width, Height }, bezier, histogram, false);
+		return image;
+	}
+
+	// Collects the tiles until the rendering is complete (or a timeout), returns the number of collect() calls that copied tiles.
+	int collectAll(TileRenderer& renderer, std::vector<QRgb>& image)
+	{
+		int nrCollects = 0;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{ 30 };
+		while (renderer.percentComplete() < 100 && std::chrono::steady_clock::now() < deadline)
+		{
+			if (renderer.collect(reinterpret_cast<uchar*>(image.data()), Width * sizeof(QRgb)))
+				++nrCollects;
+			else
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+		return nrCollects;
+	}
+}
+
+TEST_CASE("TileRenderer", "[TileRenderer]")
+{
+	StackedBitmap bitmap;
+	loadRandomImage(bitmap);
+
+	const BezierAdjust bezierA;
+	BezierAdjust bezierB;
+	bezierB.m_fSaturationShift = 60;
+	bezierB.clear();
+	const RGBHistogramAdjust histogram;
+
+	const std::vector<QRgb> expectedA = renderDirectly(bitmap, bezierA, histogram);
+	const std::vector<QRgb> expectedB = renderDirectly(bitmap, bezierB, histogram);
+	REQUIRE(expectedA != expectedB);
+
+	TileRenderer renderer;
+	std::vector<QRgb> image(static_cast<size_t>(Width) * Height, 0);
+
+	SECTION("All the tiles are rendered with the settings")
+	{
+		renderer.start(bitmap, DSSRect{}, DSSRect{ 300, 200, 600, 400 }, bezierA, histogram, false);
+		REQUIRE(collectAll(renderer, image) > 0);
+		REQUIRE(renderer.percentComplete() == 100);
+		REQUIRE(image == expectedA);
+		REQUIRE_FALSE(renderer.collect(reinterpret_cast<uchar*>(image.data()), Width * sizeof(QRgb)));
+	}
+
+	SECTION("Only the tiles of the area are rendered")
+	{
+		const DSSRect area{ 200, 100, 700, 400 };
+		renderer.start(bitmap, area, DSSRect{}, bezierA, histogram, false);
+		collectAll(renderer, image);
+		REQUIRE(renderer.percentComplete() == 100);
+
+		std::vector<QRgb> expected(image.size(), 0);
+		for (int j = area.top; j < area.bottom; j++)
+		{
+			const size_t offset = static_cast<size_t>(Width) * j;
+			std::copy(expectedA.cbegin() + offset + area.left, expectedA.cbegin() + offset + area.right, expected.begin() + offset + area.left);
+		}
+		REQUIRE(image == expected);
+	}
+
+	SECTION("cancel() drops the queued and finished tiles")
+	{
+		renderer.start(bitmap, DSSRect{}, DSSRect{}, bezierA, histogram, false);
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+		renderer.cancel();
+		REQUIRE(renderer.percentComplete() == 100);
+		REQUIRE_FALSE(renderer.collect(reinterpret_cast<uchar*>(image.data()), Width * sizeof(QRgb)));
+
+		// The worker is idle: a tile being rendered during cancel() was not handed over afterwards.
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+		REQUIRE_FALSE(renderer.collect(reinterpret_cast<uchar*>(image.data()), Width * sizeof(QRgb)));
+		REQUIRE(std::ranges::all_of(image, [](const QRgb pixel) { return pixel == 0; }));
+
+		// And the renderer can be started again.
+		renderer.start(bitmap, DSSRect{}, DSSRect{}, bezierA, histogram, false);
+		collectAll(renderer, image);
+		REQUIRE(image == expectedA);
+	}
+
+	SECTION("A new start() invalidates the tiles of the previous generation")
+	{
+		for (const int delay : { 0, 2, 10 })
+		{
+			std::ranges::fill(image, 0);
+			renderer.start(bitmap, DSSRect{}, DSSRect{}, bezierA, histogram, false);
+			std::this_thread::sleep_for(std::chrono::milliseconds{ delay });
+			renderer.start(bitmap, DSSRect{}, DSSRect{}, bezierB, histogram, false);
+			collectAll(renderer, image);
+			REQUIRE(renderer.percentComplete() == 100);
+			// No tile of the first rendering may be collected, and each tile of the second one exactly once.
+			REQUIRE(image == expectedB);
+		}
+	}
+}